@@ -0,0 +1,34 @@
+#include "backgroundjobs.h"
+
+BackgroundJobs::~BackgroundJobs()
+{
+    for (Job &job : jobs) {
+        if (job.thread.joinable()) {
+            job.thread.join();
+        }
+    }
+}
+
+void BackgroundJobs::run(std::function<void()> job)
+{
+    reap();
+    jobs.emplace_back();
+    Job &entry = jobs.back();
+    std::atomic<bool> *finished = &entry.finished;
+    entry.thread = std::thread([job, finished]() {
+        job();
+        finished->store(true, std::memory_order_release);
+    });
+}
+
+void BackgroundJobs::reap()
+{
+    for (auto it = jobs.begin(); it != jobs.end();) {
+        if (it->finished.load(std::memory_order_acquire)) {
+            it->thread.join();
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
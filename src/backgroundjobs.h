@@ -0,0 +1,37 @@
+#ifndef BACKGROUNDJOBS_H
+#define BACKGROUNDJOBS_H
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <thread>
+
+// 一次性后台任务
+//
+// 合并解压、从去重存储解压、日志查询等互不相关，每个任务一个线程，不排队。
+// 线程不 detach：析构时等待所有未结束的任务，任务中用到的对象（日志存储、去重存储）
+// 必须在它之后析构。任务的结果用 QMetaObject::invokeMethod(..., Qt::QueuedConnection)
+// 交回主线程；持有者析构时还没处理的投递会随 QObject 一起丢弃。
+// run() 只能在创建者所在的线程上调用。
+class BackgroundJobs
+{
+public:
+    BackgroundJobs() = default;
+    ~BackgroundJobs();
+
+    void run(std::function<void()> job);
+
+private:
+    struct Job
+    {
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    // 回收已经结束的线程
+    void reap();
+
+    std::list<Job> jobs;    // 节点地址不变，线程可以直接写自己的 finished
+};
+
+#endif // BACKGROUNDJOBS_H
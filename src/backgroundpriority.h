@@ -0,0 +1,29 @@
+#ifndef BACKGROUNDPRIORITY_H
+#define BACKGROUNDPRIORITY_H
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+// 把当前线程降为空闲优先级：CPU 使用 SCHED_IDLE + nice 19，磁盘 IO 使用 IOPRIO_CLASS_IDLE。
+// 用于预解压、垃圾回收、日志压缩等后台工作，避免和 QT 服务器、更新脚本争抢资源。
+inline void setCurrentThreadIdlePriority()
+{
+    const pid_t tid = static_cast<pid_t>(::syscall(SYS_gettid));
+
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(tid), 19);
+
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+
+    // ioprio_set(IOPRIO_WHO_PROCESS, tid, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0))
+    const int ioprioWhoProcess = 1;
+    const int ioprioClassIdle = 3;
+    const int ioprioClassShift = 13;
+    ::syscall(SYS_ioprio_set, ioprioWhoProcess, tid, ioprioClassIdle << ioprioClassShift);
+}
+
+#endif // BACKGROUNDPRIORITY_H
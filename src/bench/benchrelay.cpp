@@ -0,0 +1,203 @@
+#include "benchrelay.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+qint64 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+QByteArray benchFrame(const QString &type, const QString &message)
+{
+    QJsonObject obj;
+    obj["type"] = type;
+    obj["message"] = message;
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+bool writeTextFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    return file.write(data) == data.size();
+}
+
+QByteArray readTextFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll().trimmed();
+}
+
+QString optionValue(const QStringList &args, const QString &name, const QString &def)
+{
+    const int i = args.indexOf(name);
+    return (i >= 0 && i + 1 < args.size()) ? args[i + 1] : def;
+}
+
+QProcessEnvironment isolatedEnvironment(const QString &dir, quint16 port)
+{
+    QDir(dir).mkpath("update_pack");
+
+    // QMANAGE 按路径 pkill 旧的 QT 端，因此包装脚本把自身路径留在命令行里
+    const QString clientPath = dir + "/client";
+    writeTextFile(clientPath, QString("#!/bin/sh\nexec \"%1\" fake-client \"$0\"\n")
+                                  .arg(QCoreApplication::applicationFilePath()).toLocal8Bit());
+    QFile::setPermissions(clientPath, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.remove("NOTIFY_SOCKET");
+    env.remove("QUARCS_RECORD");
+    env.insert("QUARCS_CLIENT_PATH", clientPath);
+    env.insert("QUARCS_WS_URL", QString("ws://127.0.0.1:%1").arg(port));
+    env.insert("QUARCS_UPDATE_PACK_PATH", dir + "/update_pack");
+    env.insert("QUARCS_LOG_DIR", dir + "/logs");
+    env.insert("QUARCS_CRASH_DIR", dir + "/crashes");
+    env.insert("QUARCS_PACKAGE_STORE_DIR", dir + "/package-store");
+    env.insert("QUARCS_STATE_JOURNAL", dir + "/state.journal");
+    env.insert("QUARCS_CONFIG", dir + "/qmanage.json");
+    return env;
+}
+
+bool BenchRelay::listen(quint16 port)
+{
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        fprintf(stderr, "cannot listen on 127.0.0.1:%u: %s\n", port, qPrintable(server.errorString()));
+        return false;
+    }
+    QObject::connect(&server, &QWebSocketServer::newConnection, [this]() {
+        while (server.hasPendingConnections()) {
+            QWebSocket *socket = server.nextPendingConnection();
+            sockets.append(socket);
+            QObject::connect(socket, &QWebSocket::textMessageReceived, [this, socket](const QString &text) {
+                onText(socket, text);
+            });
+            QObject::connect(socket, &QWebSocket::disconnected, [this, socket]() {
+                sockets.removeAll(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+    return true;
+}
+
+void BenchRelay::onText(QWebSocket *from, const QString &text)
+{
+    const qint64 now = monotonicNs();
+    const QJsonObject obj = QJsonDocument::fromJson(text.toUtf8()).object();
+    BenchFrame f;
+    f.ns = now;
+    f.type = obj["type"].toString();
+    f.message = obj["message"].toString();
+    frames.push_back(f);
+    foreach (QWebSocket *socket, sockets) {
+        if (socket != from) {
+            socket->sendTextMessage(text);
+        }
+    }
+}
+
+bool BenchRelay::startMonitor(const QString &program, const QProcessEnvironment &env, const QString &logPath)
+{
+    monitor.setProcessEnvironment(env);
+    monitor.setStandardOutputFile(logPath.isEmpty() ? QProcess::nullDevice() : logPath);
+    monitor.setStandardErrorFile(logPath.isEmpty() ? QProcess::nullDevice() : logPath, QIODevice::Append);
+    monitor.start(program, QStringList() << "--normal");
+    if (!monitor.waitForStarted(5000)) {
+        fprintf(stderr, "failed to start %s\n", qPrintable(program));
+        return false;
+    }
+    return true;
+}
+
+void BenchRelay::stopMonitor()
+{
+    monitor.terminate();
+    if (!monitor.waitForFinished(10000)) {
+        monitor.kill();
+        monitor.waitForFinished(3000);
+    }
+}
+
+qint64 BenchRelay::inject(const QString &message)
+{
+    const QString data = QString::fromUtf8(benchFrame("Process_Command_Return", message));
+    const qint64 now = monotonicNs();
+    foreach (QWebSocket *socket, sockets) {
+        socket->sendTextMessage(data);
+    }
+    return now;
+}
+
+bool BenchRelay::waitUntil(const std::function<bool()> &done, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QEventLoop loop;
+    QTimer tick;
+    tick.setInterval(5);
+    QObject::connect(&tick, &QTimer::timeout, [&]() {
+        if (done() || timer.elapsed() > timeoutMs || monitor.state() == QProcess::NotRunning) {
+            loop.quit();
+        }
+    });
+    tick.start();
+    if (!done()) {
+        loop.exec();
+    }
+    return done();
+}
+
+qint64 BenchRelay::waitFrame(qint64 since, const QString &type, const QString &message, int timeoutMs)
+{
+    qint64 found = -1;
+    waitUntil([&]() {
+        for (size_t i = frames.size(); i > 0; i--) {
+            const BenchFrame &f = frames[i - 1];
+            if (f.ns < since) {
+                break;
+            }
+            if (f.type == type && f.message.startsWith(message)) {
+                found = f.ns;
+            }
+        }
+        return found >= 0;
+    }, timeoutMs);
+    if (found < 0) {
+        fprintf(stderr, "timeout waiting for %s:%s\n", qPrintable(type), qPrintable(message));
+        failed = true;
+    }
+    return found;
+}
+
+double BenchRelay::monitorCpuSeconds()
+{
+    const QByteArray stat = readTextFile(QString("/proc/%1/stat").arg(monitor.processId()));
+    const int end = stat.lastIndexOf(')');
+    if (end < 0) {
+        return 0;
+    }
+    // ')' 之后依次是 state(3) ppid(4) ... utime(14) stime(15)
+    const QList<QByteArray> fields = stat.mid(end + 2).split(' ');
+    if (fields.size() < 13) {
+        return 0;
+    }
+    const double ticks = fields[11].toDouble() + fields[12].toDouble();
+    return ticks / sysconf(_SC_CLK_TCK);
+}
@@ -0,0 +1,72 @@
+#ifndef BENCHRELAY_H
+#define BENCHRELAY_H
+
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QStringList>
+#include <QList>
+#include <functional>
+#include <vector>
+
+// 基准程序共用的工具：代替 8600 端口转发服务器的本地 WebSocket 服务器，
+// 并负责启动被测的 QMANAGE 进程。
+
+// CLOCK_MONOTONIC 纳秒，在进程之间共享，子进程写下的时间戳可以直接比较
+qint64 monotonicNs();
+
+// 构造 {"type":..., "message":...} 帧
+QByteArray benchFrame(const QString &type, const QString &message);
+
+bool writeTextFile(const QString &path, const QByteArray &data);
+QByteArray readTextFile(const QString &path);   // 读取并去掉首尾空白，失败返回空
+
+// 取命令行中 name 后面的一个参数
+QString optionValue(const QStringList &args, const QString &name, const QString &def);
+
+// 被测 QMANAGE 的隔离环境：更新包、日志、崩溃快照、去重存储、状态日志和配置文件都放在 dir 下，
+// 连接 127.0.0.1:port。QT 端是 dir/client 包装脚本，以 fake-client 参数重新执行本程序，
+// 调用方的 main() 需要处理这个参数。不继承 NOTIFY_SOCKET 与 QUARCS_RECORD
+QProcessEnvironment isolatedEnvironment(const QString &dir, quint16 port);
+
+struct BenchFrame
+{
+    qint64 ns;
+    QString type;
+    QString message;
+};
+
+class BenchRelay
+{
+public:
+    QWebSocketServer server{QStringLiteral("qmanage-bench"), QWebSocketServer::NonSecureMode};
+    QList<QWebSocket *> sockets;
+    std::vector<BenchFrame> frames;     // 收到的所有帧，带到达时间
+    QProcess monitor;                   // 被测的 QMANAGE
+    bool failed = false;                // 有等待超时
+
+    // 在 127.0.0.1:port 上监听，与真实的转发服务器一样把每一帧转发给其它所有连接
+    bool listen(quint16 port);
+
+    // 以 --normal 启动 QMANAGE；logPath 为空时输出丢弃
+    bool startMonitor(const QString &program, const QProcessEnvironment &env, const QString &logPath);
+    void stopMonitor();
+
+    // 扮演前端，向 QMANAGE 发送 Process_Command_Return，返回发送时间
+    qint64 inject(const QString &message);
+
+    // 运行事件循环直到 done() 为真、超时或 QMANAGE 退出
+    bool waitUntil(const std::function<bool()> &done, int timeoutMs);
+
+    // 等待 since 之后出现的第一帧 type/message（前缀匹配），返回其时间戳，超时返回 -1
+    qint64 waitFrame(qint64 since, const QString &type, const QString &message, int timeoutMs);
+
+    // QMANAGE 累计 CPU 时间（秒），读取 /proc/<pid>/stat 的 utime + stime
+    double monitorCpuSeconds();
+
+private:
+    void onText(QWebSocket *from, const QString &text);
+};
+
+#endif // BENCHRELAY_H
@@ -0,0 +1,348 @@
+// 消息、版本号解析与命令分发热路径的微基准
+//
+// 每一项对一组贴近现场的消息语料反复执行，输出每条消息的平均耗时（ns）与堆分配次数：
+//   classify_broadcast   WebSocketClient::classifyMessage，前端/QT 端广播的无关消息
+//   classify_commands    WebSocketClient::classifyMessage，Process_Command_Return 命令
+//   build_command        WebSocketClient::buildProcessCommand，发往前端的进度/状态消息
+//   dispatch_commands    QuarcsMonitor::receivedMessage，不会启动/杀进程的命令
+//   parse_version_key    PackageIndex::parseVersionKey（取代原来的 parseVersionToInt）
+//   version_from_file    PackageIndex::versionFromFileName
+//   update_script_lines  LineAssembler 分行 + parseUpdateScriptLine
+//
+// 用法：hotpathbench [--min-ms N] [--save FILE] [--baseline FILE]
+// --save 把本次结果写入文件，--baseline 读入之前保存的结果并打印相对变化。
+// 分配次数通过替换 malloc/calloc/realloc（glibc 的 __libc_* 实现）统计，只计入基准线程。
+
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QTextStream>
+#include <QMap>
+#include <QStringList>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "websocketclient.h"
+#include "quarcsmonitor.h"
+#include "packageindex.h"
+#include "lineassembler.h"
+#include "benchrelay.h"
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static thread_local bool countAllocations = false;
+static thread_local quint64 allocationCount = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    if (countAllocations) {
+        allocationCount++;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    if (countAllocations) {
+        allocationCount++;
+    }
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if (countAllocations) {
+        allocationCount++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+static qint64 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 防止编译器把基准循环优化掉
+static volatile size_t sink = 0;
+
+static QString jsonFrame(const QString &type, const QString &message)
+{
+    QJsonObject obj;
+    obj["type"] = type;
+    obj["message"] = message;
+    return QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+// ---------------------------------------------------------------------------
+// 语料
+// ---------------------------------------------------------------------------
+static QStringList broadcastCorpus()
+{
+    QStringList list;
+    list << jsonFrame("Vue_Command", "getMountParameters")
+         << jsonFrame("Vue_Command", "MountMoveWest:Start")
+         << jsonFrame("QT_Return", "TelescopeRADEC:5.588138:-5.391111")
+         << jsonFrame("QT_Return", "MainCameraTemperature:-9.8")
+         << jsonFrame("QT_Return", "AddScatterChartData:0.12:-0.34")
+         << jsonFrame("QT_Return", "GuiderStatus:Guiding:0.42:0.37")
+         << jsonFrame("QT_Confirm", "msgid-1024")
+         << jsonFrame("Server_msg", "client connected: 192.168.1.23");
+    // 星点列表这类较长的广播
+    QString stars = "DetectedStars";
+    for (int i = 0; i < 40; i++) {
+        stars += QString(":%1,%2,%3").arg(100 + i * 13).arg(200 + i * 7).arg(2.5 + i * 0.01);
+    }
+    list << jsonFrame("QT_Return", stars);
+    return list;
+}
+
+static QStringList commandCorpus()
+{
+    QStringList list;
+    list << "ServerInitSuccess"
+         << "VueClientVersion:1.2.3"
+         << "testQtServerProcess"
+         << "getQtServerStatus"
+         << "VueClientVersion:20240101"
+         << "unknownCommand:with:several:fields";
+    return list;
+}
+
+static QStringList outgoingCorpus()
+{
+    QStringList list;
+    list << "update_sequence_start:3"
+         << "update_progress:1:42:正在复制文件"
+         << "update_progress:2:88:Copying /home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram/src/BUILD/client"
+         << "update_step_finished:2:1.2.3"
+         << "qtServerIsOver"
+         << "No_update_pack_found"
+         << "checkHasNewUpdatePack:1.2.3:1.3.0";
+    return list;
+}
+
+static QStringList versionCorpus()
+{
+    QStringList list;
+    list << "1.2.3" << "0.0.0" << "12.34.567" << "20240101" << "1002003" << "v1.2" << "bad.version";
+    return list;
+}
+
+static QStringList fileNameCorpus()
+{
+    QStringList list;
+    list << "1.2.3.zip" << "QUARCS_1.2.3.zip" << "20240101.zip" << "1.2.2_1.2.3.qdelta" << "readme.txt";
+    return list;
+}
+
+static QByteArray updateScriptOutput(int lines)
+{
+    QByteArray out;
+    for (int i = 0; i < lines; i++) {
+        switch (i % 5) {
+        case 0: out += "PROGRESS:" + QByteArray::number(i % 100) + ":Copying files\n"; break;
+        case 1: out += "cp: '/tmp/update/lib/libfoo.so.1' -> '/usr/lib/libfoo.so.1'\n"; break;
+        case 2: out += "PROGRESS:" + QByteArray::number(i % 100) + ":正在安装依赖\n"; break;
+        case 3: out += "ERROR:1:dpkg returned 1\n"; break;
+        default: out += "\n"; break;
+        }
+    }
+    out += "SUCCESS:100:done\nREBOOT:1:reboot required\n";
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// 驱动
+// ---------------------------------------------------------------------------
+struct Result
+{
+    double nsPerMessage;
+    double allocsPerMessage;
+};
+
+// pass() 每次处理 messagesPerPass 条消息；先热身一轮，再重复直到超过 minMs
+static Result measure(int messagesPerPass, int minMs, const std::function<void()> &pass)
+{
+    pass();
+    quint64 passes = 0;
+    allocationCount = 0;
+    countAllocations = true;
+    const qint64 start = monotonicNs();
+    qint64 elapsed = 0;
+    do {
+        pass();
+        passes++;
+        elapsed = monotonicNs() - start;
+    } while (elapsed < static_cast<qint64>(minMs) * 1000000);
+    countAllocations = false;
+
+    const double messages = static_cast<double>(passes) * messagesPerPass;
+    Result r;
+    r.nsPerMessage = elapsed / messages;
+    r.allocsPerMessage = allocationCount / messages;
+    return r;
+}
+
+static void discardMessages(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // 与其它基准相同的隔离环境：更新包、日志、崩溃快照、状态日志等都在临时目录下。
+    // WebSocket 指向不存在的端口，分发时发送的消息直接丢弃；不启动 QT 端
+    QTemporaryDir dir;
+    const QProcessEnvironment env = isolatedEnvironment(dir.path(), 1);
+    qunsetenv("NOTIFY_SOCKET");
+    qunsetenv("QUARCS_RECORD");
+    foreach (const QString &name, env.keys()) {
+        if (name.startsWith("QUARCS_")) {
+            qputenv(name.toLocal8Bit().constData(), env.value(name).toLocal8Bit());
+        }
+    }
+    qputenv("QUARCS_CLIENT_PATH", "/bin/false");
+
+    const QStringList args = app.arguments();
+    const int minMs = optionValue(args, "--min-ms", "300").toInt();
+    const QString savePath = optionValue(args, "--save", QString());
+    const QString baselinePath = optionValue(args, "--baseline", QString());
+
+    // 分发路径里有 qDebug，基准中不输出，但格式化的开销仍然计入
+    qInstallMessageHandler(discardMessages);
+
+    QMap<QString, Result> results;
+    QStringList order;
+    auto run = [&](const QString &name, int messagesPerPass, const std::function<void()> &pass) {
+        results[name] = measure(messagesPerPass, minMs, pass);
+        order << name;
+    };
+
+    const QStringList broadcast = broadcastCorpus();
+    run("classify_broadcast", broadcast.size(), [&]() {
+        QString message;
+        foreach (const QString &text, broadcast) {
+            sink += WebSocketClient::classifyMessage(text, &message);
+        }
+    });
+
+    QStringList commandFrames;
+    foreach (const QString &command, commandCorpus()) {
+        commandFrames << jsonFrame("Process_Command_Return", command);
+    }
+    run("classify_commands", commandFrames.size(), [&]() {
+        QString message;
+        foreach (const QString &text, commandFrames) {
+            sink += WebSocketClient::classifyMessage(text, &message);
+            sink += message.size();
+        }
+    });
+
+    const QStringList outgoing = outgoingCorpus();
+    run("build_command", outgoing.size(), [&]() {
+        foreach (const QString &message, outgoing) {
+            sink += WebSocketClient::buildProcessCommand(message).size();
+        }
+    });
+
+    // ServerInitSuccess 第一次到达时会把启动耗时追加到设备上的启动日志，这里不参与分发
+    QuarcsMonitor monitor;
+    QStringList commands = commandCorpus();
+    commands.removeAll("ServerInitSuccess");
+    run("dispatch_commands", commands.size(), [&]() {
+        foreach (const QString &command, commands) {
+            monitor.receivedMessage(command);
+        }
+    });
+
+    const QStringList versions = versionCorpus();
+    run("parse_version_key", versions.size(), [&]() {
+        foreach (const QString &version, versions) {
+            bool ok = false;
+            sink += PackageIndex::parseVersionKey(version, ok);
+        }
+    });
+
+    const QStringList fileNames = fileNameCorpus();
+    run("version_from_file", fileNames.size(), [&]() {
+        foreach (const QString &fileName, fileNames) {
+            sink += PackageIndex::versionFromFileName(fileName).size();
+        }
+    });
+
+    const int scriptLines = 1000;
+    const QByteArray scriptOutput = updateScriptOutput(scriptLines);
+    LineAssembler assembler;
+    run("update_script_lines", scriptLines + 2, [&]() {
+        // 以 QProcess 常见的 4 KiB 分块喂入
+        const auto onLine = [](const char *line, size_t size) {
+            sink += parseUpdateScriptLine(line, size).kind;
+        };
+        for (int offset = 0; offset < scriptOutput.size(); offset += 4096) {
+            const int chunk = qMin(4096, scriptOutput.size() - offset);
+            assembler.feed(scriptOutput.constData() + offset, static_cast<size_t>(chunk), onLine);
+        }
+        assembler.finish(onLine);
+    });
+
+    // 读取基线
+    QMap<QString, Result> baseline;
+    if (!baselinePath.isEmpty()) {
+        QFile file(baselinePath);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            QTextStream in(&file);
+            while (!in.atEnd()) {
+                const QStringList fields = in.readLine().split(' ', Qt::SkipEmptyParts);
+                if (fields.size() == 3) {
+                    Result r;
+                    r.nsPerMessage = fields[1].toDouble();
+                    r.allocsPerMessage = fields[2].toDouble();
+                    baseline[fields[0]] = r;
+                }
+            }
+        } else {
+            fprintf(stderr, "cannot read baseline %s\n", qPrintable(baselinePath));
+        }
+    }
+
+    printf("%-22s %12s %12s", "benchmark", "ns/msg", "allocs/msg");
+    if (!baseline.isEmpty()) {
+        printf(" %10s %12s", "time", "allocs");
+    }
+    printf("\n");
+    foreach (const QString &name, order) {
+        const Result &r = results[name];
+        printf("%-22s %12.1f %12.2f", qPrintable(name), r.nsPerMessage, r.allocsPerMessage);
+        if (baseline.contains(name)) {
+            const Result &b = baseline[name];
+            const double change = b.nsPerMessage > 0 ? (r.nsPerMessage / b.nsPerMessage - 1) * 100 : 0;
+            printf(" %+9.1f%% %+12.2f", change, r.allocsPerMessage - b.allocsPerMessage);
+        }
+        printf("\n");
+    }
+
+    if (!savePath.isEmpty()) {
+        QFile file(savePath);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            QTextStream out(&file);
+            foreach (const QString &name, order) {
+                out << name << ' ' << results[name].nsPerMessage << ' ' << results[name].allocsPerMessage << '\n';
+            }
+        } else {
+            fprintf(stderr, "cannot write %s\n", qPrintable(savePath));
+            return 1;
+        }
+    }
+
+    // Led 的闪烁线程不会退出，直接结束进程
+    fflush(stdout);
+    _exit(0);
+}
@@ -0,0 +1,144 @@
+// LineAssembler 分块边界随机测试
+//
+// 随机生成子进程输出（空行、\r\n 行尾、超长行、末尾无换行的残行），按随机的块边界
+// （包括 0 字节的块和把 \r\n 拆开的边界）喂给 LineAssembler，与整段按 '\n' 切分的
+// 参考结果逐行比较：不能丢行、拆行、多出行，超长行按 maxLineLength 截断且只输出一次，
+// truncatedLineCount() 与超长行数一致。
+//
+// 用法：lineassemblerfuzz [--iterations N] [--seed S]
+// 全部一致时返回 0；有不一致时打印复现用的种子和第一处差异，返回 1。
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lineassembler.h"
+
+struct Expected
+{
+    std::vector<std::string> lines;
+    size_t truncated = 0;
+};
+
+// 参考实现：整段输入一次切分
+static Expected splitWhole(const std::string &input, size_t maxLength)
+{
+    Expected out;
+    size_t start = 0;
+    while (start < input.size()) {
+        const size_t nl = input.find('\n', start);
+        const size_t end = nl == std::string::npos ? input.size() : nl;
+        std::string line = input.substr(start, end - start);
+        if (line.size() > maxLength) {
+            line.resize(maxLength);
+            out.truncated++;
+        }
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.resize(line.size() - 1);
+        }
+        // 末尾没有换行符且为空的残行不输出
+        if (nl != std::string::npos || end > start) {
+            out.lines.push_back(line);
+        }
+        if (nl == std::string::npos) {
+            break;
+        }
+        start = nl + 1;
+    }
+    return out;
+}
+
+static std::string randomOutput(std::mt19937 &rng, size_t maxLength)
+{
+    std::uniform_int_distribution<int> lineCount(0, 40);
+    std::uniform_int_distribution<int> shape(0, 9);
+    std::uniform_int_distribution<int> byte(0x20, 0x7e);
+    std::string out;
+    const int lines = lineCount(rng);
+    for (int i = 0; i < lines; i++) {
+        size_t length;
+        switch (shape(rng)) {
+        case 0: length = 0; break;                                  // 空行
+        case 1: length = maxLength; break;                          // 正好到上限
+        case 2: length = maxLength + 1; break;                      // 超出 1 字节
+        case 3: length = maxLength * 3 + rng() % 7; break;          // 远超上限
+        default: length = rng() % (maxLength + 1); break;
+        }
+        for (size_t j = 0; j < length; j++) {
+            out += static_cast<char>(byte(rng));
+        }
+        if (rng() % 4 == 0) {
+            out += '\r';
+        }
+        out += '\n';
+    }
+    // 一半的输出以没有换行符的残行结束（子进程退出前最后一行）
+    if (rng() % 2) {
+        const size_t length = rng() % (maxLength * 2 + 2);
+        for (size_t j = 0; j < length; j++) {
+            out += static_cast<char>(byte(rng));
+        }
+    }
+    return out;
+}
+
+int main(int argc, char *argv[])
+{
+    long iterations = 20000;
+    unsigned long seed = std::random_device()();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--iterations") == 0) {
+            iterations = strtol(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+    printf("seed %lu, %ld iterations\n", seed, iterations);
+
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+    size_t totalLines = 0;
+    size_t totalChunks = 0;
+    for (long iter = 0; iter < iterations; iter++) {
+        const size_t maxLength = 1 + rng() % 48;
+        const std::string input = randomOutput(rng, maxLength);
+        const Expected expected = splitWhole(input, maxLength);
+
+        // 随机块边界：多数为小块，偶尔一次给完剩余部分
+        LineAssembler assembler(maxLength);
+        std::vector<std::string> got;
+        auto onLine = [&got](const char *data, size_t size) { got.push_back(std::string(data, size)); };
+        size_t pos = 0;
+        while (pos < input.size()) {
+            const size_t remaining = input.size() - pos;
+            const size_t chunk = rng() % 8 == 0 ? remaining : std::min(remaining, static_cast<size_t>(rng() % (maxLength + 3)));
+            assembler.feed(input.data() + pos, chunk, onLine);
+            pos += chunk;
+            totalChunks++;
+        }
+        const size_t truncated = assembler.truncatedLineCount();
+        assembler.finish(onLine);
+
+        if (got != expected.lines || truncated != expected.truncated) {
+            printf("MISMATCH at iteration %ld (rerun with --seed %lu), maxLineLength %zu\n", iter, seed, maxLength);
+            printf("  lines: expected %zu, got %zu; truncated: expected %zu, got %zu\n", expected.lines.size(),
+                   got.size(), expected.truncated, truncated);
+            for (size_t i = 0; i < std::max(got.size(), expected.lines.size()); i++) {
+                const std::string e = i < expected.lines.size() ? expected.lines[i] : "(none)";
+                const std::string g = i < got.size() ? got[i] : "(none)";
+                if (e != g) {
+                    printf("  first difference at line %zu:\n    expected \"%s\"\n    got      \"%s\"\n", i, e.c_str(),
+                           g.c_str());
+                    break;
+                }
+            }
+            return 1;
+        }
+        totalLines += got.size();
+    }
+    printf("ok: %zu lines over %zu chunks, no lines lost or split\n", totalLines, totalChunks);
+    return 0;
+}
@@ -0,0 +1,254 @@
+// QMANAGE 录制回放
+//
+// 回放 QUARCS_RECORD 录下的流量（见 trafficrecorder.h）。启动真实的 QMANAGE（--normal），
+// 本程序扮演 8600 端口的转发服务器和 QT 端：
+//   - 录制中 QMANAGE 收到的帧按原顺序发给它：--speed realtime 按录制时的时间点，
+//     --speed max 在录制中先于该帧的输出都已出现后立即发送
+//   - 录制中不是 QMANAGE 主动结束的 QT 端退出（崩溃、自行退出），由假 QT 端以相同方式退出来复现
+//   - QMANAGE 发出的 Process_Command 与录制逐条比较（重发的同一 msgid 只算一次），
+//     报告第一处分歧和录制中它之前的事件（收发的帧、子进程事件、定时器触发）
+//   - --speed max 时报告吞吐（帧/秒）和相对录制时长的加速比
+// 定时器触发只用于分歧时的上下文：回放中 QMANAGE 的定时器照常运行，不由录制驱动。
+// 更新流程依赖更新包，回放含更新的录制时用 --update-pack 指向录制时的更新包目录（会被修改，请用副本）。
+//
+// 用法：replaybench --recording FILE [--qmanage PATH] [--port N] [--speed realtime|max]
+//                   [--update-pack DIR] [--step-timeout-ms N] [--log FILE]
+// 输出与录制一致时返回 0，有分歧或 QMANAGE 提前退出时返回 1。
+// 注意：QMANAGE 使用 /tmp/QUARCS_QMANAGE.lock 单实例锁，本机已有 QMANAGE 在运行时无法回放。
+
+#include <QCoreApplication>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QTimer>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchrelay.h"
+#include "trafficrecorder.h"
+
+#ifndef QMANAGE_BINARY
+#define QMANAGE_BINARY ""
+#endif
+
+// ---------------------------------------------------------------------------
+// 假 QT 端：不连接 WebSocket（它发过的帧都在录制里），只按 BENCH_CONTROL 控制文件退出
+//   exit <code>   以 code 退出
+//   crash         abort()
+// 执行后删除控制文件，避免下一个实例读到
+// ---------------------------------------------------------------------------
+static int runFakeClient()
+{
+    const QString controlPath = QString::fromLocal8Bit(qgetenv("BENCH_CONTROL"));
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [controlPath]() {
+        const QList<QByteArray> control = readTextFile(controlPath).split(' ');
+        if (control.value(0) == "exit") {
+            QFile::remove(controlPath);
+            exit(control.value(1).toInt());
+        } else if (control.value(0) == "crash") {
+            QFile::remove(controlPath);
+            abort();
+        }
+    });
+    poll.start(20);
+    return QCoreApplication::exec();
+}
+
+// 录制中的一条 Process_Command 输出
+struct ExpectedFrame
+{
+    int record;         // 在录制中的下标
+    QString message;
+};
+
+static QString describe(const TrafficRecorder::Record &r)
+{
+    QString payload = QString::fromUtf8(r.payload).simplified();
+    if (payload.size() > 160) {
+        payload = payload.left(157) + "...";
+    }
+    return QString("%1 ms  %2  %3").arg(r.ns / 1e6, 10, 'f', 3).arg(QChar::fromLatin1(static_cast<char>(r.kind))).arg(payload);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() > 1 && args[1] == "fake-client") {
+        return runFakeClient();
+    }
+
+    const QString recordingPath = optionValue(args, "--recording", QString());
+    const QString qmanage = optionValue(args, "--qmanage", QStringLiteral(QMANAGE_BINARY));
+    const quint16 port = static_cast<quint16>(optionValue(args, "--port", "8600").toUInt());
+    const bool maxSpeed = optionValue(args, "--speed", "max") == "max";
+    const QString updatePack = optionValue(args, "--update-pack", QString());
+    const int stepTimeoutMs = optionValue(args, "--step-timeout-ms", "2000").toInt();
+    const QString logPath = optionValue(args, "--log", QString());
+    if (recordingPath.isEmpty()) {
+        fprintf(stderr, "usage: replaybench --recording FILE [--qmanage PATH] [--speed realtime|max]\n");
+        return 2;
+    }
+    if (qmanage.isEmpty() || !QFileInfo(qmanage).isExecutable()) {
+        fprintf(stderr, "QMANAGE binary not found, pass --qmanage PATH\n");
+        return 2;
+    }
+
+    QVector<TrafficRecorder::Record> records;
+    QString error;
+    if (!TrafficRecorder::load(recordingPath, &records, &error)) {
+        fprintf(stderr, "cannot read %s: %s\n", qPrintable(recordingPath), qPrintable(error));
+        return 2;
+    }
+
+    // 录制中的输出；重发沿用原 msgid，只保留第一次
+    QVector<ExpectedFrame> expected;
+    QVector<int> expectedBefore(records.size() + 1, 0);   // 录制中第 i 条记录之前的输出条数
+    QSet<QString> seenIds;
+    int inboundCount = 0;
+    for (int i = 0; i < records.size(); i++) {
+        expectedBefore[i] = expected.size();
+        const TrafficRecorder::Record &r = records[i];
+        if (r.kind == TrafficRecorder::Inbound) {
+            inboundCount++;
+        } else if (r.kind == TrafficRecorder::Outbound) {
+            const QJsonObject obj = QJsonDocument::fromJson(r.payload).object();
+            const QString msgid = obj["msgid"].toString();
+            if (obj["type"].toString() != "Process_Command" || (!msgid.isEmpty() && seenIds.contains(msgid))) {
+                continue;
+            }
+            seenIds.insert(msgid);
+            ExpectedFrame f;
+            f.record = i;
+            f.message = obj["message"].toString();
+            expected.append(f);
+        }
+    }
+    expectedBefore[records.size()] = expected.size();
+    const qint64 recordedNs = records.isEmpty() ? 0 : records.last().ns;
+    printf("recording: %d records, %d inbound, %d expected outbound, %.1f s\n", records.size(), inboundCount,
+           expected.size(), recordedNs / 1e9);
+
+    QTemporaryDir tmp(QDir::tempPath() + "/replaybench-XXXXXX");
+    BenchRelay relay;
+    if (!tmp.isValid() || !relay.listen(port)) {
+        return 2;
+    }
+    const QString dir = tmp.path();
+    QProcessEnvironment env = isolatedEnvironment(dir, port);
+    if (!updatePack.isEmpty()) {
+        env.insert("QUARCS_UPDATE_PACK_PATH", updatePack);
+    }
+    env.insert("BENCH_CONTROL", dir + "/control");
+
+    const qint64 launchNs = monotonicNs();
+    if (!relay.startMonitor(qmanage, env, logPath)) {
+        return 2;
+    }
+
+    // relay.frames 只会追加，增量计数
+    size_t scanned = 0;
+    int outbound = 0;
+    auto outboundCount = [&]() {
+        for (; scanned < relay.frames.size(); scanned++) {
+            if (relay.frames[scanned].type == "Process_Command") {
+                outbound++;
+            }
+        }
+        return outbound;
+    };
+
+    // 按录制驱动 QMANAGE
+    int stalls = 0;
+    qint64 firstSendNs = 0;
+    for (int i = 0; i < records.size() && relay.monitor.state() != QProcess::NotRunning; i++) {
+        const TrafficRecorder::Record &r = records[i];
+        const bool qtServerExit = r.kind == TrafficRecorder::Child && r.payload.startsWith("qtServer:finished:")
+                                  && r.payload.endsWith(":0");
+        if (r.kind != TrafficRecorder::Inbound && !qtServerExit) {
+            continue;
+        }
+
+        if (maxSpeed) {
+            const int want = expectedBefore[i];
+            if (!relay.waitUntil([&]() { return outboundCount() >= want; }, stepTimeoutMs)) {
+                stalls++;
+            }
+        } else {
+            relay.waitUntil([&]() { return monotonicNs() - launchNs >= r.ns; }, static_cast<int>(r.ns / 1000000) + 1000);
+        }
+
+        if (qtServerExit) {
+            // qtServer:finished:<exitCode>:<crashed>:<requested>
+            const QList<QByteArray> fields = r.payload.split(':');
+            writeTextFile(dir + "/control", fields.value(3) == "1" ? QByteArray("crash")
+                                                                   : QByteArray("exit ") + fields.value(2));
+            continue;
+        }
+        if (relay.sockets.isEmpty()) {
+            relay.waitUntil([&]() { return !relay.sockets.isEmpty(); }, 20000);
+        }
+        const QString text = QString::fromUtf8(r.payload);
+        foreach (QWebSocket *socket, relay.sockets) {
+            socket->sendTextMessage(text);
+        }
+        if (!firstSendNs) {
+            firstSendNs = monotonicNs();
+        }
+    }
+    const qint64 remainingNs = maxSpeed ? 0 : qMax<qint64>(0, recordedNs - (monotonicNs() - launchNs));
+    relay.waitUntil([&]() { return outboundCount() >= expected.size(); },
+                    static_cast<int>(remainingNs / 1000000) + stepTimeoutMs);
+    const qint64 endNs = monotonicNs();
+    const bool exitedEarly = relay.monitor.state() == QProcess::NotRunning;
+
+    // 逐条比较
+    QStringList observed;
+    for (const BenchFrame &f : relay.frames) {
+        if (f.type == "Process_Command") {
+            observed << f.message;
+        }
+    }
+    int matched = 0;
+    while (matched < expected.size() && matched < observed.size() && expected[matched].message == observed[matched]) {
+        matched++;
+    }
+    const bool identical = matched == expected.size() && matched == observed.size();
+
+    printf("\n%-28s %d/%d\n", "outbound_matched", matched, expected.size());
+    printf("%-28s %d\n", "outbound_observed", observed.size());
+    if (!identical) {
+        printf("\nfirst divergence at outbound #%d\n", matched);
+        printf("  expected: %s\n", matched < expected.size() ? qPrintable(expected[matched].message) : "(end of recording)");
+        printf("  observed: %s\n", matched < observed.size() ? qPrintable(observed[matched]) : "(nothing)");
+        if (matched < expected.size()) {
+            printf("  recorded events before it:\n");
+            const int at = expected[matched].record;
+            for (int i = qMax(0, at - 8); i <= at; i++) {
+                printf("    %s\n", qPrintable(describe(records[i])));
+            }
+        }
+    }
+    if (maxSpeed && firstSendNs) {
+        const double secs = (endNs - firstSendNs) / 1e9;
+        const int frames = inboundCount + observed.size();
+        printf("\n%-28s %9.2f s\n", "replay_time", secs);
+        printf("%-28s %9.0f frames/s\n", "replay_throughput", secs > 0 ? frames / secs : 0.0);
+        printf("%-28s %9.1f x\n", "speedup_vs_recording", secs > 0 ? recordedNs / 1e9 / secs : 0.0);
+        printf("%-28s %d\n", "step_timeouts", stalls);
+    }
+    if (exitedEarly) {
+        fprintf(stderr, "QMANAGE exited during replay (another instance holding /tmp/QUARCS_QMANAGE.lock?)\n");
+    }
+
+    relay.stopMonitor();
+    // SIGTERM 结束的 QMANAGE 不会清理 QT 端，这里把残留的假 QT 端一并清掉
+    QProcess::execute("pkill", QStringList() << "-f" << env.value("QUARCS_CLIENT_PATH"));
+    return identical && !exitedEarly ? 0 : 1;
+}
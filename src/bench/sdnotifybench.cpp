@@ -0,0 +1,249 @@
+// systemd 通知（sd_notify）测试
+//
+// 本程序代替 systemd：绑定一个抽象命名空间的 AF_UNIX 数据报套接字，把地址写入 NOTIFY_SOCKET
+// （'@' 开头），然后检查收到的通知：
+//   - direct：直接调用 SdNotify，READY=1 / STATUS= / WATCHDOG=1 原样到达；WATCHDOG_PID
+//     不是本进程时 watchdogUsec() 为 0；未设置 NOTIFY_SOCKET 时不发送
+//   - qmanage：以 NOTIFY_SOCKET + WATCHDOG_USEC 启动真实的 QMANAGE（--normal），
+//     READY=1 带 MAINPID、STATUS= 报告 QT 端状态、WATCHDOG=1 按 WATCHDOG_USEC/2 的间隔持续到达
+//
+// 用法：sdnotifybench [--qmanage PATH] [--port N] [--watchdog-ms N] [--log FILE]
+// 全部检查通过时返回 0，否则返回 1。
+// 注意：QMANAGE 使用 /tmp/QUARCS_QMANAGE.lock 单实例锁，本机已有 QMANAGE 在运行时无法测试 qmanage 部分。
+
+#include <QCoreApplication>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <vector>
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "benchrelay.h"
+#include "sdnotify.h"
+
+#ifndef QMANAGE_BINARY
+#define QMANAGE_BINARY ""
+#endif
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 抽象命名空间的数据报套接字，返回 fd，name 不含开头的 '@'
+static int bindAbstractSocket(const QByteArray &name)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, name.constData(), static_cast<size_t>(name.size()));
+    const socklen_t addrLen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + name.size());
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&addr), addrLen) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+struct Notification
+{
+    qint64 ns;
+    QList<QByteArray> lines;   // 一条数据报中的 KEY=VALUE
+};
+
+// 取出已到达的所有数据报；timeoutMs > 0 时至少等到一条或超时
+static void drain(int fd, std::vector<Notification> *out, int timeoutMs)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (timeoutMs > 0 && ::poll(&pfd, 1, timeoutMs) <= 0) {
+        return;
+    }
+    char buffer[4096];
+    for (;;) {
+        const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            return;
+        }
+        Notification note;
+        note.ns = monotonicNs();
+        note.lines = QByteArray(buffer, static_cast<int>(n)).split('\n');
+        out->push_back(note);
+    }
+}
+
+static bool hasLine(const std::vector<Notification> &notes, const QByteArray &prefix, QByteArray *value = nullptr)
+{
+    for (const Notification &note : notes) {
+        foreach (const QByteArray &line, note.lines) {
+            if (line.startsWith(prefix)) {
+                if (value) {
+                    *value = line.mid(prefix.size());
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void testDirect(int fd)
+{
+    printf("direct:\n");
+    std::vector<Notification> notes;
+
+    check(SdNotify::isAvailable(), "isAvailable with NOTIFY_SOCKET");
+    check(SdNotify::notify("READY=1"), "notify READY=1");
+    drain(fd, &notes, 1000);
+    check(notes.size() == 1 && notes[0].lines == QList<QByteArray>() << "READY=1", "READY=1 arrives as sent");
+
+    notes.clear();
+    SdNotify::notify("STATUS=QT server running, update idle");
+    SdNotify::notify("WATCHDOG=1");
+    drain(fd, &notes, 1000);
+    drain(fd, &notes, 100);
+    check(hasLine(notes, "STATUS=QT server running"), "STATUS= arrives");
+    check(hasLine(notes, "WATCHDOG=1"), "WATCHDOG=1 arrives");
+
+    qputenv("WATCHDOG_USEC", "200000");
+    qputenv("WATCHDOG_PID", QByteArray::number(static_cast<qint64>(getpid())));
+    check(SdNotify::watchdogUsec() == 200000, "watchdogUsec for this pid");
+    qputenv("WATCHDOG_PID", QByteArray::number(static_cast<qint64>(getpid()) + 1));
+    check(SdNotify::watchdogUsec() == 0, "watchdogUsec is 0 for another pid");
+    qunsetenv("WATCHDOG_PID");
+    qunsetenv("WATCHDOG_USEC");
+    check(SdNotify::watchdogUsec() == 0, "watchdogUsec is 0 without WATCHDOG_USEC");
+
+    const QByteArray saved = qgetenv("NOTIFY_SOCKET");
+    qunsetenv("NOTIFY_SOCKET");
+    notes.clear();
+    check(!SdNotify::isAvailable() && !SdNotify::notify("READY=1"), "no-op without NOTIFY_SOCKET");
+    drain(fd, &notes, 100);
+    check(notes.empty(), "nothing sent without NOTIFY_SOCKET");
+    qputenv("NOTIFY_SOCKET", saved);
+}
+
+static bool testMonitor(int fd, const QString &qmanage, quint16 port, int watchdogMs, const QString &logPath)
+{
+    printf("qmanage:\n");
+    QTemporaryDir tmp(QDir::tempPath() + "/sdnotifybench-XXXXXX");
+    BenchRelay relay;
+    if (!tmp.isValid() || !relay.listen(port)) {
+        return false;
+    }
+    const QString dir = tmp.path();
+    // QT 端只需一直运行；NOTIFY_SOCKET 指向本程序绑定的套接字
+    QProcessEnvironment env = isolatedEnvironment(dir, port);
+    env.insert("NOTIFY_SOCKET", QString::fromLocal8Bit(qgetenv("NOTIFY_SOCKET")));
+    env.remove("WATCHDOG_PID");     // systemd 在 fork 后才知道 pid，这里不设置，QMANAGE 视为发给自己
+    env.insert("WATCHDOG_USEC", QString::number(watchdogMs * 1000LL));
+
+    std::vector<Notification> notes;
+    auto watchdogCount = [&notes]() {
+        int count = 0;
+        for (const Notification &note : notes) {
+            count += note.lines.contains("WATCHDOG=1") ? 1 : 0;
+        }
+        return count;
+    };
+
+    const qint64 launchNs = monotonicNs();
+    if (!relay.startMonitor(qmanage, env, logPath)) {
+        return false;
+    }
+    const bool ready = relay.waitUntil([&]() {
+        drain(fd, &notes, 0);
+        return hasLine(notes, "READY=1");
+    }, 10000);
+    const qint64 readyNs = monotonicNs();
+    relay.waitUntil([&]() {
+        drain(fd, &notes, 0);
+        return watchdogCount() >= 5 && hasLine(notes, "STATUS=");
+    }, watchdogMs * 5 + 5000);
+    const bool exitedEarly = relay.monitor.state() == QProcess::NotRunning;
+
+    QByteArray mainPid;
+    QByteArray status;
+    check(ready, "READY=1");
+    check(hasLine(notes, "MAINPID=", &mainPid) && mainPid.toLongLong() == relay.monitor.processId(),
+          "MAINPID= is the QMANAGE pid");
+    check(hasLine(notes, "STATUS=", &status) && status.startsWith("QT server "), "STATUS= reports the QT server");
+    check(watchdogCount() >= 5, "WATCHDOG=1 keeps arriving");
+
+    // 心跳间隔应接近 WATCHDOG_USEC/2，远小于 WATCHDOG_USEC
+    qint64 lastNs = 0;
+    qint64 maxGapNs = 0;
+    for (const Notification &note : notes) {
+        if (note.lines.contains("WATCHDOG=1")) {
+            if (lastNs) {
+                maxGapNs = qMax(maxGapNs, note.ns - lastNs);
+            }
+            lastNs = note.ns;
+        }
+    }
+    check(maxGapNs > 0 && maxGapNs < watchdogMs * 1000000LL, "watchdog gap below WATCHDOG_USEC");
+    if (ready) {
+        printf("  %-52s %.1f ms\n", "launch to READY=1", (readyNs - launchNs) / 1e6);
+    }
+    printf("  %-52s %.1f ms (WATCHDOG_USEC %d ms)\n", "max watchdog gap", maxGapNs / 1e6, watchdogMs);
+    if (exitedEarly) {
+        fprintf(stderr, "QMANAGE exited early (another instance holding /tmp/QUARCS_QMANAGE.lock?)\n");
+        failures++;
+    }
+
+    relay.stopMonitor();
+    QProcess::execute("pkill", QStringList() << "-f" << env.value("QUARCS_CLIENT_PATH"));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() > 1 && args[1] == "fake-client") {
+        return QCoreApplication::exec();
+    }
+
+    const QString qmanage = optionValue(args, "--qmanage", QStringLiteral(QMANAGE_BINARY));
+    const quint16 port = static_cast<quint16>(optionValue(args, "--port", "8600").toUInt());
+    const int watchdogMs = qMax(200, optionValue(args, "--watchdog-ms", "1000").toInt());
+    const QString logPath = optionValue(args, "--log", QString());
+
+    const QByteArray name = "qmanage-sdnotifybench-" + QByteArray::number(static_cast<qint64>(getpid()));
+    const int fd = bindAbstractSocket(name);
+    if (fd < 0) {
+        fprintf(stderr, "cannot bind abstract socket @%s: %s\n", name.constData(), strerror(errno));
+        return 2;
+    }
+    qputenv("NOTIFY_SOCKET", "@" + name);
+
+    testDirect(fd);
+    if (qmanage.isEmpty() || !QFileInfo(qmanage).isExecutable()) {
+        fprintf(stderr, "QMANAGE binary not found, pass --qmanage PATH\n");
+        failures++;
+    } else if (!testMonitor(fd, qmanage, port, watchdogMs, logPath)) {
+        failures++;
+    }
+
+    ::close(fd);
+    printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,313 @@
+// QMANAGE 端到端监控基准
+//
+// 启动真实的 QMANAGE（--normal），用本程序替换 QT 端（fake-client 模式）和 8600 端口的
+// WebSocket 转发服务器，测量：
+//   - 启动到 ServerInitSuccess 的时间
+//   - QT 端崩溃到 qtServerIsOver 的延迟
+//   - restartQtServer 到新 QT 端初始化完成的时间（正常 / 启动慢 / 卡死不响应 SIGTERM）
+//   - Process_Command_Return -> Process_Command 的消息往返时间（空闲 / 卡死重启 / 输出洪泛期间）
+//   - QMANAGE 自身的 CPU 占用（空闲 / 输出洪泛期间）
+//
+// 用法：supervisionbench [--qmanage PATH] [--port N] [--rounds N] [--flood-mb N] [--log FILE]
+// 所有场景都完成时返回 0，有场景超时返回 1，可直接在 CI 中运行。
+// 注意：QMANAGE 使用 /tmp/QUARCS_QMANAGE.lock 单实例锁，本机已有 QMANAGE 在运行时无法测试。
+
+#include <QCoreApplication>
+#include <QProcessEnvironment>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+#include <algorithm>
+#include <vector>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "benchrelay.h"
+
+#ifndef QMANAGE_BINARY
+#define QMANAGE_BINARY ""
+#endif
+
+// ---------------------------------------------------------------------------
+// 假 QT 端：由 QMANAGE 通过包装脚本拉起，行为由 BENCH_CONTROL 指向的控制文件决定
+//   normal            连接后立即发送 ServerInitSuccess
+//   slow <ms>         延迟 ms 后再发送 ServerInitSuccess
+//   crash <ms>        初始化成功 ms 后写下时间戳并 abort()
+//   hang              初始化成功后忽略 SIGTERM 并停止响应
+//   flood <MB>        初始化成功后向 stdout 写出 MB 兆字节日志，完成后写下时间戳
+// ---------------------------------------------------------------------------
+static int runFakeClient()
+{
+    const QString controlPath = QString::fromLocal8Bit(qgetenv("BENCH_CONTROL"));
+    const QString dir = QFileInfo(controlPath).absolutePath();
+    const QList<QByteArray> control = readTextFile(controlPath).split(' ');
+    const QByteArray mode = control.value(0, "normal");
+    const int arg = control.value(1).toInt();
+
+    QWebSocket socket;
+    QTimer retryTimer;
+    retryTimer.setSingleShot(true);
+    const QUrl url(QString::fromUtf8(qgetenv("BENCH_WS_URL")));
+
+    auto afterInit = [&]() {
+        if (mode == "crash") {
+            QTimer::singleShot(arg, [dir]() {
+                writeTextFile(dir + "/crash_ns", QByteArray::number(monotonicNs()));
+                // 不生成 core 文件，避免 CI 上的崩溃处理拖慢测量
+                struct rlimit noCore = {0, 0};
+                setrlimit(RLIMIT_CORE, &noCore);
+                abort();
+            });
+        } else if (mode == "hang") {
+            signal(SIGTERM, SIG_IGN);
+            for (;;) {
+                pause();
+            }
+        } else if (mode == "flood") {
+            QByteArray line(119, 'x');
+            line.prepend("[flood] ");
+            line.append('\n');
+            const qint64 total = static_cast<qint64>(arg) * 1024 * 1024;
+            for (qint64 written = 0; written < total; written += line.size()) {
+                fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+            }
+            fflush(stdout);
+            writeTextFile(dir + "/flood_done_ns", QByteArray::number(monotonicNs()));
+        }
+    };
+
+    auto sendInit = [&]() {
+        socket.sendTextMessage(QString::fromUtf8(benchFrame("Process_Command_Return", "ServerInitSuccess")));
+        socket.flush();
+        afterInit();
+    };
+
+    QObject::connect(&socket, &QWebSocket::connected, [&]() {
+        if (mode == "slow") {
+            QTimer::singleShot(arg, sendInit);
+        } else {
+            sendInit();
+        }
+    });
+    // WebSocket 服务器还没起来或连接断开时，每 100ms 重试
+    QObject::connect(&socket, &QWebSocket::disconnected, [&]() {
+        retryTimer.start(100);
+    });
+    QObject::connect(&socket, QOverload<QAbstractSocket::SocketError>::of(&QWebSocket::error), [&]() {
+        retryTimer.start(100);
+    });
+    QObject::connect(&retryTimer, &QTimer::timeout, [&]() {
+        socket.open(url);
+    });
+    socket.open(url);
+
+    return QCoreApplication::exec();
+}
+
+// ---------------------------------------------------------------------------
+// 基准主体
+// ---------------------------------------------------------------------------
+class Bench : public BenchRelay
+{
+public:
+    QString dir;
+
+    qint64 waitFileNs(const QString &name, int timeoutMs)
+    {
+        const QString path = dir + "/" + name;
+        waitUntil([&]() { return !readTextFile(path).isEmpty(); }, timeoutMs);
+        const QByteArray data = readTextFile(path);
+        QFile::remove(path);
+        if (data.isEmpty()) {
+            fprintf(stderr, "timeout waiting for %s\n", qPrintable(name));
+            failed = true;
+            return -1;
+        }
+        return data.toLongLong();
+    }
+
+    void setClientMode(const QByteArray &mode)
+    {
+        writeTextFile(dir + "/control", mode);
+    }
+
+    // 重启 QT 端并等待新实例初始化完成，返回耗时（毫秒）
+    double restartClient()
+    {
+        const qint64 t0 = inject("restartQtServer");
+        const qint64 t1 = waitFrame(t0, "Process_Command_Return", "ServerInitSuccess", 20000);
+        return t1 < 0 ? -1 : (t1 - t0) / 1e6;
+    }
+
+    // 一次消息往返：updateCurrentClient 在更新包目录为空时立即回复 No_update_pack_found
+    double roundTrip()
+    {
+        const qint64 t0 = inject("updateCurrentClient:0");
+        const qint64 t1 = waitFrame(t0, "Process_Command", "No_update_pack_found", 10000);
+        return t1 < 0 ? -1 : (t1 - t0) / 1e6;
+    }
+};
+
+struct Stats
+{
+    QString name;
+    std::vector<double> values;
+
+    explicit Stats(const QString &n) : name(n) {}
+
+    void add(double v)
+    {
+        if (v >= 0) {
+            values.push_back(v);
+        }
+    }
+
+    void print() const
+    {
+        if (values.empty()) {
+            printf("%-28s n=0\n", qPrintable(name));
+            return;
+        }
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        const auto at = [&sorted](double q) {
+            return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+        };
+        printf("%-28s n=%-4zu min=%9.2f p50=%9.2f p95=%9.2f max=%9.2f ms\n", qPrintable(name),
+               sorted.size(), sorted.front(), at(0.5), at(0.95), sorted.back());
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() > 1 && args[1] == "fake-client") {
+        return runFakeClient();
+    }
+
+    const QString qmanage = optionValue(args, "--qmanage", QStringLiteral(QMANAGE_BINARY));
+    const quint16 port = static_cast<quint16>(optionValue(args, "--port", "8600").toUInt());
+    const int rounds = optionValue(args, "--rounds", "5").toInt();
+    const int floodMb = optionValue(args, "--flood-mb", "64").toInt();
+    const QString logPath = optionValue(args, "--log", QString());
+    if (qmanage.isEmpty() || !QFileInfo(qmanage).isExecutable()) {
+        fprintf(stderr, "QMANAGE binary not found, pass --qmanage PATH\n");
+        return 2;
+    }
+
+    QTemporaryDir tmp(QDir::tempPath() + "/supervisionbench-XXXXXX");
+    Bench bench;
+    bench.dir = tmp.path();
+    if (!tmp.isValid() || !bench.listen(port)) {
+        return 2;
+    }
+    QProcessEnvironment env = isolatedEnvironment(bench.dir, port);
+    bench.setClientMode("normal");
+    env.insert("BENCH_CONTROL", bench.dir + "/control");
+    env.insert("BENCH_WS_URL", env.value("QUARCS_WS_URL"));
+
+    printf("QMANAGE: %s\n", qPrintable(qmanage));
+    const qint64 launchNs = monotonicNs();
+    if (!bench.startMonitor(qmanage, env, logPath)) {
+        return 2;
+    }
+
+    // 1. 启动：QMANAGE 启动到第一个 ServerInitSuccess
+    const qint64 initNs = bench.waitFrame(launchNs, "Process_Command_Return", "ServerInitSuccess", 20000);
+    if (initNs < 0) {
+        if (bench.monitor.state() == QProcess::NotRunning) {
+            fprintf(stderr, "QMANAGE exited early (another instance holding /tmp/QUARCS_QMANAGE.lock?)\n");
+        }
+        return 1;
+    }
+    printf("%-28s %9.2f ms\n", "startup_to_init", (initNs - launchNs) / 1e6);
+
+    // 2. 空闲：消息往返与 CPU
+    Stats idleRtt("rtt_idle");
+    for (int i = 0; i < rounds * 10; i++) {
+        idleRtt.add(bench.roundTrip());
+    }
+    const double idleCpu0 = bench.monitorCpuSeconds();
+    bench.waitUntil([]() { return false; }, 5000);
+    const double idleCpu = (bench.monitorCpuSeconds() - idleCpu0) / 5.0;
+
+    // 3. 崩溃：restartQtServer 拉起会崩溃的 QT 端，测重启时间与崩溃上报延迟
+    Stats restartNormal("kill_to_restart");
+    Stats crashLatency("crash_to_qtServerIsOver");
+    for (int i = 0; i < rounds; i++) {
+        bench.setClientMode("crash 300");
+        restartNormal.add(bench.restartClient());
+        const qint64 crashNs = bench.waitFileNs("crash_ns", 5000);
+        if (crashNs > 0) {
+            const qint64 overNs = bench.waitFrame(crashNs, "Process_Command", "qtServerIsOver", 10000);
+            crashLatency.add(overNs < 0 ? -1 : (overNs - crashNs) / 1e6);
+        }
+    }
+
+    // 4. 启动慢的 QT 端
+    Stats restartSlow("kill_to_restart_slow2s");
+    bench.setClientMode("slow 2000");
+    for (int i = 0; i < rounds; i++) {
+        restartSlow.add(bench.restartClient());
+    }
+
+    // 5. 卡死且忽略 SIGTERM 的 QT 端：重启要等到强制 kill，期间测一次消息往返
+    Stats restartHang("kill_to_restart_hung");
+    Stats hangRtt("rtt_during_hung_kill");
+    for (int i = 0; i < rounds; i++) {
+        bench.setClientMode("hang");
+        bench.restartClient();
+        bench.setClientMode("normal");
+        const qint64 t0 = bench.inject("restartQtServer");
+        hangRtt.add(bench.roundTrip());
+        const qint64 t1 = bench.waitFrame(t0, "Process_Command_Return", "ServerInitSuccess", 20000);
+        restartHang.add(t1 < 0 ? -1 : (t1 - t0) / 1e6);
+    }
+
+    // 6. 输出洪泛：QMANAGE 透传 QT 端 stdout 的吞吐、CPU 与响应
+    Stats floodRtt("rtt_during_flood");
+    bench.setClientMode(QByteArray("flood ") + QByteArray::number(floodMb));
+    bench.restartClient();
+    const qint64 floodStart = monotonicNs();
+    const double floodCpu0 = bench.monitorCpuSeconds();
+    bool floodDone = false;
+    qint64 floodDoneNs = -1;
+    while (!floodDone && !bench.failed) {
+        floodRtt.add(bench.roundTrip());
+        const QByteArray done = readTextFile(bench.dir + "/flood_done_ns");
+        if (!done.isEmpty()) {
+            floodDoneNs = done.toLongLong();
+            floodDone = true;
+        } else if (monotonicNs() - floodStart > 120LL * 1000000000LL) {
+            fprintf(stderr, "timeout waiting for flood to finish\n");
+            bench.failed = true;
+        }
+    }
+    const double floodCpu = bench.monitorCpuSeconds() - floodCpu0;
+
+    printf("\n");
+    idleRtt.print();
+    printf("%-28s %9.2f %%\n", "monitor_cpu_idle", idleCpu * 100);
+    restartNormal.print();
+    restartSlow.print();
+    restartHang.print();
+    hangRtt.print();
+    crashLatency.print();
+    floodRtt.print();
+    if (floodDone) {
+        const double secs = (floodDoneNs - floodStart) / 1e9;
+        printf("%-28s %9.2f MB/s\n", "flood_throughput", secs > 0 ? floodMb / secs : 0.0);
+        printf("%-28s %9.2f ms/MB\n", "monitor_cpu_flood", floodCpu * 1000 / std::max(1, floodMb));
+    }
+
+    bench.stopMonitor();
+    // SIGTERM 结束的 QMANAGE 不会清理 QT 端，这里把残留的假 QT 端一并清掉
+    QProcess::execute("pkill", QStringList() << "-f" << env.value("QUARCS_CLIENT_PATH"));
+    return bench.failed ? 1 : 0;
+}
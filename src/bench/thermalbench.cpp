@@ -0,0 +1,172 @@
+// ThermalMonitor 等级测试
+//
+// 在临时目录下搭一组假的 sysfs（class/thermal/thermal_zone*/{type,temp} 与
+// devices/platform/soc/soc:firmware/get_throttled），改写文件内容后用 setLimits() 触发重读，
+// 检查等级变化：
+//   - Normal → Warm → Hot 立即升级，降级要低于阈值 3°C 的回差
+//   - get_throttled 的限频/降频位单独即可升到 Warm，清除后回落
+//   - 温度读不到（空文件、无法解析）时保持当前等级，Hot 不会掉回 Normal
+//   - 有 cpu/soc 类型的 zone 时优先使用；只有 get_throttled 时按降频状态升降
+//
+// 用法：thermalbench
+// 全部检查通过时返回 0，否则返回 1。
+
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <stdio.h>
+
+#include "thermalmonitor.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) {
+        failures++;
+    }
+}
+
+// 原地改写：ThermalMonitor 持有打开的 fd，文件不能换成新的 inode
+static void writeFile(const QString &path, const QByteArray &content)
+{
+    QDir().mkpath(path.section('/', 0, -2));
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(content);
+    }
+}
+
+struct FakeSysfs
+{
+    QString root;
+
+    QString zoneFile(int zone, const char *name) const
+    {
+        return QString("%1/class/thermal/thermal_zone%2/%3").arg(root).arg(zone).arg(name);
+    }
+    void setTemp(int zone, const QByteArray &milliCelsius) const { writeFile(zoneFile(zone, "temp"), milliCelsius + "\n"); }
+    void setThrottled(quint32 bits) const
+    {
+        writeFile(root + "/devices/platform/soc/soc:firmware/get_throttled",
+                  "0x" + QByteArray::number(bits, 16) + "\n");
+    }
+};
+
+// 改写后重读一次，返回新等级
+static ThermalMonitor::Level repoll(ThermalMonitor &monitor)
+{
+    monitor.setLimits(70, 80);
+    return monitor.level();
+}
+
+static void testLevels(const QString &root)
+{
+    printf("levels:\n");
+    FakeSysfs fs{root};
+    writeFile(fs.zoneFile(0, "type"), "cpu-thermal\n");
+    fs.setTemp(0, "50000");
+    fs.setThrottled(0);
+
+    ThermalMonitor monitor(root);
+    int changes = 0;
+    QObject::connect(&monitor, &ThermalMonitor::levelChanged, [&changes](int) { changes++; });
+    check(monitor.isAvailable(), "temp and get_throttled found");
+    check(repoll(monitor) == ThermalMonitor::Normal, "50.0C is normal");
+
+    fs.setTemp(0, "70000");
+    check(repoll(monitor) == ThermalMonitor::Warm, "70.0C is warm");
+    fs.setTemp(0, "68000");
+    check(repoll(monitor) == ThermalMonitor::Warm, "68.0C stays warm (hysteresis)");
+    fs.setTemp(0, "66900");
+    check(repoll(monitor) == ThermalMonitor::Normal, "66.9C drops to normal");
+
+    fs.setTemp(0, "80000");
+    check(repoll(monitor) == ThermalMonitor::Hot, "80.0C is hot");
+    check(monitor.stateText() == "hot:80.0:0", "stateText hot:80.0:0");
+    fs.setTemp(0, "78000");
+    check(repoll(monitor) == ThermalMonitor::Hot, "78.0C stays hot (hysteresis)");
+
+    fs.setTemp(0, "");
+    check(repoll(monitor) == ThermalMonitor::Hot, "empty temp keeps hot");
+    check(monitor.stateText().startsWith("hot:unknown:"), "stateText reports unknown temperature");
+    fs.setTemp(0, "garbage");
+    check(repoll(monitor) == ThermalMonitor::Hot, "unparsable temp keeps hot");
+
+    fs.setTemp(0, "76000");
+    check(repoll(monitor) == ThermalMonitor::Warm, "76.0C drops to warm");
+    fs.setTemp(0, "60000");
+    check(repoll(monitor) == ThermalMonitor::Normal, "60.0C drops to normal");
+
+    fs.setThrottled(0x4);
+    check(repoll(monitor) == ThermalMonitor::Warm, "throttled bit raises to warm");
+    fs.setThrottled(0x50000);     // 只有“曾经发生”的历史位
+    check(repoll(monitor) == ThermalMonitor::Normal, "history bits only drop to normal");
+
+    fs.setTemp(0, "");
+    fs.setThrottled(0x2);
+    check(repoll(monitor) == ThermalMonitor::Warm, "no temp + capped raises to warm");
+    fs.setThrottled(0);
+    check(repoll(monitor) == ThermalMonitor::Warm, "no temp keeps warm");
+    fs.setTemp(0, "50000");
+    check(repoll(monitor) == ThermalMonitor::Normal, "temp back drops to normal");
+
+    fs.setTemp(0, "85000");
+    repoll(monitor);
+    fs.setTemp(0, "50000");
+    check(repoll(monitor) == ThermalMonitor::Normal, "hot to normal in one step");
+    check(changes == 11, "levelChanged once per change");
+}
+
+static void testZoneChoice(const QString &root)
+{
+    printf("zone choice:\n");
+    FakeSysfs fs{root};
+    writeFile(fs.zoneFile(0, "type"), "gpu-thermal\n");
+    fs.setTemp(0, "90000");
+    writeFile(fs.zoneFile(1, "type"), "cpu-thermal\n");
+    fs.setTemp(1, "50000");
+
+    ThermalMonitor monitor(root);
+    check(repoll(monitor) == ThermalMonitor::Normal, "cpu zone preferred over zone0");
+    check(monitor.lastSample().hasTemperature && monitor.lastSample().milliCelsius == 50000, "sample from cpu zone");
+}
+
+static void testThrottledOnly(const QString &root)
+{
+    printf("get_throttled only:\n");
+    FakeSysfs fs{root};
+    fs.setThrottled(0);
+
+    ThermalMonitor monitor(root);
+    check(monitor.isAvailable(), "available without thermal zone");
+    check(repoll(monitor) == ThermalMonitor::Normal, "not throttled is normal");
+    fs.setThrottled(0x4);
+    check(repoll(monitor) == ThermalMonitor::Warm, "throttled is warm");
+    fs.setThrottled(0);
+    check(repoll(monitor) == ThermalMonitor::Normal, "throttle cleared drops to normal");
+    check(monitor.stateText() == "normal:unknown:0", "stateText normal:unknown:0");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir tmp(QDir::tempPath() + "/thermalbench-XXXXXX");
+    if (!tmp.isValid()) {
+        fprintf(stderr, "cannot create temporary directory\n");
+        return 1;
+    }
+
+    testLevels(tmp.path() + "/levels");
+    testZoneChoice(tmp.path() + "/zones");
+    testThrottledOnly(tmp.path() + "/throttled");
+
+    ThermalMonitor missing(tmp.path() + "/missing");
+    printf("missing sysfs:\n");
+    check(!missing.isAvailable() && missing.level() == ThermalMonitor::Normal, "no files, stays normal");
+
+    printf("\n%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,870 @@
+// 更新流水线吞吐基准
+//
+// 启动真实的 QMANAGE（--normal），在临时 UpdatePackPath 中生成合成更新包，扮演前端发送
+// updateCurrentClient，让真实的状态机走完 checkVueClientVersion → startSequentialUpdate →
+// updateCurrentClient → 解压 → Update.sh → startNextUpdateInQueue 全流程。
+// sudo 由 PATH 中的本地替身代替（直接以当前用户执行）；系统没有 unzip 时，用本程序的
+// unzip 模式（基于 ZipReader）代替。
+//
+// 每个场景输出：
+//   - 各阶段耗时：合并解压、每步的准备（解压/换脚本）与 Update.sh 执行时间
+//   - QMANAGE 及其已回收子进程写出的字节数（/proc/<pid>/io 的 wchar 与 write_bytes）
+//   - 发往前端的 update_* / REBOOT 消息序列是否与预期一致，以及安装结果是否正确
+//
+// 场景跑完、QMANAGE 退出后，再对同一对版本比较完整包解压与增量包（*.qdelta）解压 + 应用的耗时，
+// 解压方式与 QMANAGE 相同；增量应用后的更新树必须与完整包解压结果一致。
+//
+// 用法：updatebench [--qmanage PATH] [--port N] [--scale N] [--log FILE] [--total-version V]
+// --total-version 默认 999.0.0，使新包不被后台预解压（测冷启动解压）；传 0.0.0 可测预解压路径。
+// 所有场景通过时返回 0，否则返回 1。
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcessEnvironment>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QVector>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "benchrelay.h"
+#include "deltaupdate.h"
+#include "zipreader.h"
+
+#ifndef QMANAGE_BINARY
+#define QMANAGE_BINARY ""
+#endif
+
+// ---------------------------------------------------------------------------
+// 最小 zip 写入器：stored / raw deflate，带 Unix 权限位，足够生成合成更新包
+// ---------------------------------------------------------------------------
+static void appendLE16(QByteArray &out, quint16 v)
+{
+    out.append(static_cast<char>(v & 0xff));
+    out.append(static_cast<char>((v >> 8) & 0xff));
+}
+
+static void appendLE32(QByteArray &out, quint32 v)
+{
+    appendLE16(out, static_cast<quint16>(v & 0xffff));
+    appendLE16(out, static_cast<quint16>(v >> 16));
+}
+
+class ZipWriter
+{
+public:
+    explicit ZipWriter(const QString &path) : file(path) {}
+
+    bool open() { return file.open(QIODevice::WriteOnly | QIODevice::Truncate); }
+
+    bool addFile(const QString &name, const QByteArray &data, quint32 mode = 0100644)
+    {
+        Entry e;
+        e.name = name.toUtf8();
+        e.mode = mode;
+        e.crc = static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef *>(data.constData()),
+                                           static_cast<uInt>(data.size())));
+        e.size = static_cast<quint32>(data.size());
+        e.offset = static_cast<quint32>(file.pos());
+
+        QByteArray payload = deflateRaw(data);
+        e.method = 8;
+        if (payload.isNull() || payload.size() >= data.size()) {
+            payload = data;
+            e.method = 0;
+        }
+        e.compressedSize = static_cast<quint32>(payload.size());
+
+        QByteArray header;
+        appendLE32(header, 0x04034b50);
+        appendLE16(header, 20);
+        appendLE16(header, 0);
+        appendLE16(header, e.method);
+        appendLE16(header, 0);          // 时间
+        appendLE16(header, 0x21);       // 日期 1980-01-01
+        appendLE32(header, e.crc);
+        appendLE32(header, e.compressedSize);
+        appendLE32(header, e.size);
+        appendLE16(header, static_cast<quint16>(e.name.size()));
+        appendLE16(header, 0);
+        header.append(e.name);
+        entries.append(e);
+        return file.write(header) == header.size() && file.write(payload) == payload.size();
+    }
+
+    bool addDir(const QString &name)
+    {
+        return addFile(name.endsWith('/') ? name : name + '/', QByteArray(), 040755);
+    }
+
+    bool close()
+    {
+        const quint32 cdOffset = static_cast<quint32>(file.pos());
+        QByteArray cd;
+        foreach (const Entry &e, entries) {
+            appendLE32(cd, 0x02014b50);
+            appendLE16(cd, (3 << 8) | 20);  // 由 Unix 生成
+            appendLE16(cd, 20);
+            appendLE16(cd, 0);
+            appendLE16(cd, e.method);
+            appendLE16(cd, 0);
+            appendLE16(cd, 0x21);
+            appendLE32(cd, e.crc);
+            appendLE32(cd, e.compressedSize);
+            appendLE32(cd, e.size);
+            appendLE16(cd, static_cast<quint16>(e.name.size()));
+            appendLE16(cd, 0);
+            appendLE16(cd, 0);
+            appendLE16(cd, 0);
+            appendLE16(cd, 0);
+            appendLE32(cd, e.mode << 16);
+            appendLE32(cd, e.offset);
+            cd.append(e.name);
+        }
+        QByteArray eocd;
+        appendLE32(eocd, 0x06054b50);
+        appendLE16(eocd, 0);
+        appendLE16(eocd, 0);
+        appendLE16(eocd, static_cast<quint16>(entries.size()));
+        appendLE16(eocd, static_cast<quint16>(entries.size()));
+        appendLE32(eocd, static_cast<quint32>(cd.size()));
+        appendLE32(eocd, cdOffset);
+        appendLE16(eocd, 0);
+        const bool ok = file.write(cd) == cd.size() && file.write(eocd) == eocd.size();
+        file.close();
+        return ok;
+    }
+
+private:
+    struct Entry
+    {
+        QByteArray name;
+        quint16 method = 0;
+        quint32 mode = 0;
+        quint32 crc = 0;
+        quint32 size = 0;
+        quint32 compressedSize = 0;
+        quint32 offset = 0;
+    };
+
+    static QByteArray deflateRaw(const QByteArray &data)
+    {
+        if (data.isEmpty()) {
+            return QByteArray();
+        }
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        if (deflateInit2(&zs, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return QByteArray();
+        }
+        QByteArray out(static_cast<int>(deflateBound(&zs, static_cast<uLong>(data.size()))), Qt::Uninitialized);
+        zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+        zs.avail_in = static_cast<uInt>(data.size());
+        zs.next_out = reinterpret_cast<Bytef *>(out.data());
+        zs.avail_out = static_cast<uInt>(out.size());
+        const int ret = deflate(&zs, Z_FINISH);
+        out.resize(static_cast<int>(zs.total_out));
+        deflateEnd(&zs);
+        return ret == Z_STREAM_END ? out : QByteArray();
+    }
+
+    QFile file;
+    QVector<Entry> entries;
+};
+
+// ---------------------------------------------------------------------------
+// unzip 替身：unzip -o ARCHIVE -d DEST
+// ---------------------------------------------------------------------------
+static int runUnzip(const QStringList &args)
+{
+    QString archive;
+    QString dest = ".";
+    for (int i = 0; i < args.size(); i++) {
+        if (args[i] == "-d" && i + 1 < args.size()) {
+            dest = args[++i];
+        } else if (!args[i].startsWith('-') && archive.isEmpty()) {
+            archive = args[i];
+        }
+    }
+    ZipReader reader(archive);
+    if (!reader.open()) {
+        fprintf(stderr, "unzip: cannot open %s: %s\n", qPrintable(archive), qPrintable(reader.errorString()));
+        return 9;
+    }
+    if (!reader.extractAll(dest)) {
+        fprintf(stderr, "unzip: %s\n", qPrintable(reader.errorString()));
+        return 2;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 合成更新包
+// ---------------------------------------------------------------------------
+enum ScriptKind { ScriptNormal, ScriptFail, ScriptReboot };
+
+struct SyntheticPackage
+{
+    QString version;
+    QMap<QString, QByteArray> files;    // update/files/ 下的相对路径 -> 内容
+    ScriptKind script = ScriptNormal;
+    bool corrupt = false;               // 截断压缩包，解压必然失败
+};
+
+struct Scenario
+{
+    QString name;
+    QList<SyntheticPackage> packages;
+};
+
+// 可压缩的文本内容
+static QByteArray textData(int size, int seed)
+{
+    QByteArray line = QString("line %1 of synthetic update payload for QMANAGE bench\n").arg(seed).toUtf8();
+    QByteArray out;
+    out.reserve(size);
+    while (out.size() < size) {
+        out.append(line);
+    }
+    out.resize(size);
+    return out;
+}
+
+// 不可压缩的伪随机内容（xorshift）
+static QByteArray randomData(int size, quint32 seed)
+{
+    QByteArray out(size, Qt::Uninitialized);
+    quint32 x = seed | 1;
+    for (int i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        out[i] = static_cast<char>(x);
+    }
+    return out;
+}
+
+static QByteArray updateScript(const SyntheticPackage &pkg, const QString &installRoot)
+{
+    QString s = "#!/bin/bash\n";
+    s += QString("echo \"PROGRESS:1:start %1\"\n").arg(pkg.version);
+    s += QString("mkdir -p \"%1\"\n").arg(installRoot);
+    s += QString("cp -r files/. \"%1/\" || { echo \"ERROR:10:copy failed\"; exit 1; }\n").arg(installRoot);
+    // 普通输出行，模拟 apt/cp 等命令的日志
+    s += "for i in $(seq 1 50); do echo \"installing component $i\"; done\n";
+    if (pkg.script == ScriptFail) {
+        s += "echo \"ERROR:7:disk full\"\nexit 1\n";
+        return s.toUtf8();
+    }
+    s += "echo \"PROGRESS:90:files installed\"\n";
+    if (pkg.script == ScriptReboot) {
+        s += "echo \"REBOOT:1:reboot required\"\n";
+    }
+    s += QString("echo \"SUCCESS:100:%1\"\n").arg(pkg.version);
+    return s.toUtf8();
+}
+
+static bool writePackage(const SyntheticPackage &pkg, const QString &stagingDir, const QString &packDir,
+                         const QString &installRoot)
+{
+    const QString fileName = pkg.version + ".zip";
+    const QString tmpPath = stagingDir + "/" + fileName;
+    ZipWriter zip(tmpPath);
+    if (!zip.open()) {
+        return false;
+    }
+    bool ok = zip.addDir("update/")
+              && zip.addFile("update/Update.sh", updateScript(pkg, installRoot), 0100755)
+              && zip.addDir("update/files/");
+    for (auto it = pkg.files.constBegin(); ok && it != pkg.files.constEnd(); ++it) {
+        ok = zip.addFile("update/files/" + it.key(), it.value());
+    }
+    ok = zip.close() && ok;
+    if (ok && pkg.corrupt) {
+        QFile f(tmpPath);
+        ok = f.resize(f.size() / 2);
+    }
+    // 同一文件系统内 rename，索引只看到完整的文件（IN_MOVED_TO）
+    return ok && QFile::rename(tmpPath, packDir + "/" + fileName);
+}
+
+static QList<Scenario> buildScenarios(int scale)
+{
+    QList<Scenario> list;
+
+    Scenario small;
+    small.name = "small";
+    SyntheticPackage p;
+    p.version = "1.0.1";
+    for (int i = 0; i < 50; i++) {
+        p.files[QString("etc/conf%1.txt").arg(i)] = textData(4096, i);
+    }
+    small.packages << p;
+    list << small;
+
+    Scenario large;
+    large.name = "large";
+    p = SyntheticPackage();
+    p.version = "2.0.1";
+    for (int i = 0; i < 4; i++) {
+        p.files[QString("lib/libbig%1.so").arg(i)] = randomData(16 * 1024 * 1024 * scale, 1000 + i);
+    }
+    large.packages << p;
+    list << large;
+
+    Scenario many;
+    many.name = "many_files";
+    p = SyntheticPackage();
+    p.version = "3.0.1";
+    for (int i = 0; i < 3000 * scale; i++) {
+        p.files[QString("share/d%1/f%2.json").arg(i % 30).arg(i)] = textData(1024, i);
+    }
+    many.packages << p;
+    list << many;
+
+    // 5 个版本的更新链：公共文件每个版本都改，另有各版本独有文件（走合并解压路径）
+    Scenario chain;
+    chain.name = "chain5";
+    for (int v = 0; v < 5; v++) {
+        p = SyntheticPackage();
+        p.version = QString("4.0.%1").arg(v + 1);
+        for (int i = 0; i < 100; i++) {
+            p.files[QString("common/c%1.bin").arg(i)] = randomData(16 * 1024 * scale, v * 1000 + i);
+            p.files[QString("v%1/u%2.txt").arg(v).arg(i)] = textData(16 * 1024 * scale, i);
+        }
+        chain.packages << p;
+    }
+    list << chain;
+
+    Scenario corrupt;
+    corrupt.name = "corrupt";
+    p = SyntheticPackage();
+    p.version = "5.0.1";
+    for (int i = 0; i < 20; i++) {
+        p.files[QString("bin/tool%1").arg(i)] = randomData(64 * 1024, i);
+    }
+    p.corrupt = true;
+    corrupt.packages << p;
+    list << corrupt;
+
+    Scenario failing;
+    failing.name = "script_error";
+    for (int v = 0; v < 2; v++) {
+        p = SyntheticPackage();
+        p.version = QString("6.0.%1").arg(v + 1);
+        p.files["etc/app.conf"] = textData(2048, v);
+        p.script = v == 1 ? ScriptFail : ScriptNormal;
+        failing.packages << p;
+    }
+    list << failing;
+
+    Scenario reboot;
+    reboot.name = "reboot";
+    p = SyntheticPackage();
+    p.version = "7.0.1";
+    p.files["boot/config.txt"] = textData(1024, 7);
+    p.script = ScriptReboot;
+    reboot.packages << p;
+    list << reboot;
+
+    return list;
+}
+
+// 前端应当收到的 update_* / REBOOT 消息序列
+static QStringList expectedMessages(const Scenario &scenario)
+{
+    const int n = scenario.packages.size();
+    QStringList out;
+    out << QString("update_sequence_start:%1").arg(n);
+    for (int i = 0; i < n; i++) {
+        const SyntheticPackage &pkg = scenario.packages[i];
+        out << QString("update_sequence_step:%1:%2:%3").arg(i + 1).arg(n).arg(pkg.version);
+        if (pkg.corrupt) {
+            out << "update_error:0:Failed to extract update package"
+                << QString("update_sequence_failed:%1").arg(i);
+            return out;
+        }
+        out << QString("update_progress:1:start %1").arg(pkg.version);
+        if (pkg.script == ScriptFail) {
+            out << "update_error:7:disk full" << "update_failed:1" << QString("update_sequence_failed:%1").arg(i);
+            return out;
+        }
+        out << "update_progress:90:files installed";
+        if (pkg.script == ScriptReboot) {
+            out << "REBOOT:1:reboot required";
+        }
+        out << QString("update_success:100:%1").arg(pkg.version);
+    }
+    out << "update_sequence_finished";
+    return out;
+}
+
+// 成功执行的版本按顺序覆盖，最终安装目录应与此一致
+static QMap<QString, QByteArray> expectedInstall(const Scenario &scenario)
+{
+    QMap<QString, QByteArray> files;
+    foreach (const SyntheticPackage &pkg, scenario.packages) {
+        if (pkg.corrupt) {
+            break;
+        }
+        for (auto it = pkg.files.constBegin(); it != pkg.files.constEnd(); ++it) {
+            files[it.key()] = it.value();
+        }
+        if (pkg.script == ScriptFail) {
+            break;
+        }
+    }
+    return files;
+}
+
+static bool verifyInstall(const QString &root, const QMap<QString, QByteArray> &expected, QString &error)
+{
+    int count = 0;
+    QDirIterator it(root, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        const QString rel = QDir(root).relativeFilePath(path);
+        if (!expected.contains(rel)) {
+            error = "unexpected file " + rel;
+            return false;
+        }
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly) || f.readAll() != expected.value(rel)) {
+            error = "content mismatch " + rel;
+            return false;
+        }
+        count++;
+    }
+    if (count != expected.size()) {
+        error = QString("%1 of %2 files installed").arg(count).arg(expected.size());
+        return false;
+    }
+    return true;
+}
+
+// /proc/<pid>/io 中的 wchar 与 write_bytes；已回收子进程的计数会累加到父进程
+static void readProcIo(qint64 pid, quint64 &wchar, quint64 &writeBytes)
+{
+    wchar = 0;
+    writeBytes = 0;
+    const QList<QByteArray> lines = readTextFile(QString("/proc/%1/io").arg(pid)).split('\n');
+    foreach (const QByteArray &line, lines) {
+        if (line.startsWith("wchar:")) {
+            wchar = line.mid(6).trimmed().toULongLong();
+        } else if (line.startsWith("write_bytes:")) {
+            writeBytes = line.mid(12).trimmed().toULongLong();
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 增量包与完整包对比：同一对版本，分别计时完整包解压与增量包解压 + 应用
+// ---------------------------------------------------------------------------
+// bsdiff 的 offtout：8 字节小端，最高位为符号位
+static void appendOfftout(QByteArray &out, qint64 v)
+{
+    quint64 magnitude = static_cast<quint64>(v < 0 ? -v : v);
+    for (int i = 0; i < 8; i++) {
+        char b = static_cast<char>(magnitude & 0xff);
+        if (i == 7 && v < 0) {
+            b = static_cast<char>(b | 0x80);
+        }
+        out.append(b);
+        magnitude >>= 8;
+    }
+}
+
+// 最简单的 QBSDIFF1 补丁：一个控制三元组，重叠部分逐字节做差，多出的部分放进附加块。
+// 只改动少量字节的文件差分块几乎全是 0，外层 zip 压缩后很小
+static QByteArray makePatch(const QByteArray &oldData, const QByteArray &newData)
+{
+    const int common = qMin(oldData.size(), newData.size());
+    QByteArray ctrl;
+    appendOfftout(ctrl, common);
+    appendOfftout(ctrl, newData.size() - common);
+    appendOfftout(ctrl, 0);
+    QByteArray diff(common, Qt::Uninitialized);
+    for (int i = 0; i < common; i++) {
+        diff[i] = static_cast<char>(newData[i] - oldData[i]);
+    }
+    QByteArray patch("QBSDIFF1");
+    appendOfftout(patch, ctrl.size());
+    appendOfftout(patch, diff.size());
+    appendOfftout(patch, newData.size());
+    patch += ctrl;
+    patch += diff;
+    patch += newData.mid(common);
+    return patch;
+}
+
+// 一对相邻版本：大文件只改少量字节（走补丁），部分配置整体替换、删除、新增
+static void buildDeltaPair(int scale, SyntheticPackage &from, SyntheticPackage &to)
+{
+    from = SyntheticPackage();
+    to = SyntheticPackage();
+    from.version = "8.0.1";
+    to.version = "8.0.2";
+    for (int i = 0; i < 4; i++) {
+        const QString name = QString("lib/libcore%1.so").arg(i);
+        QByteArray data = randomData(8 * 1024 * 1024 * scale, 2000 + i);
+        from.files[name] = data;
+        for (quint32 k = 0; k < 64; k++) {
+            const int pos = static_cast<int>((k * 2654435761u + static_cast<quint32>(i)) % static_cast<quint32>(data.size()));
+            data[pos] = static_cast<char>(data[pos] ^ 0x5a);
+        }
+        to.files[name] = data;
+    }
+    for (int i = 0; i < 200; i++) {
+        const QString name = QString("share/conf%1.txt").arg(i);
+        from.files[name] = textData(16 * 1024, i);
+        if (i >= 10) {
+            to.files[name] = i < 30 ? textData(16 * 1024, 1000 + i) : from.files[name];
+        }
+    }
+    for (int i = 0; i < 10; i++) {
+        to.files[QString("share/new%1.txt").arg(i)] = textData(16 * 1024, 500 + i);
+    }
+}
+
+// 按 deltaupdate.h 的格式生成 from -> to 的增量包，路径相对于更新树（压缩包里的 update/）
+static bool writeDelta(const SyntheticPackage &from, const SyntheticPackage &to, const QString &installRoot,
+                       const QString &path)
+{
+    ZipWriter zip(path);
+    if (!zip.open()) {
+        return false;
+    }
+    auto sha256 = [](const QByteArray &data) {
+        return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+    };
+    QJsonArray add, patch, remove;
+    QJsonObject target;
+
+    const QByteArray script = updateScript(to, installRoot);
+    bool ok = zip.addFile("add/Update.sh", script, 0100755);
+    add.append(QString("Update.sh"));
+    target["Update.sh"] = sha256(script);
+
+    for (auto it = to.files.constBegin(); ok && it != to.files.constEnd(); ++it) {
+        const QString rel = "files/" + it.key();
+        target[rel] = sha256(it.value());
+        const bool existed = from.files.contains(it.key());
+        const QByteArray old = from.files.value(it.key());
+        if (existed && old == it.value()) {
+            continue;
+        }
+        if (existed && it.value().size() >= 64 * 1024) {
+            QJsonObject entry;
+            entry["path"] = rel;
+            entry["source"] = sha256(old);
+            entry["target"] = sha256(it.value());
+            patch.append(entry);
+            ok = zip.addFile("patch/" + rel, makePatch(old, it.value()));
+        } else {
+            add.append(rel);
+            ok = zip.addFile("add/" + rel, it.value());
+        }
+    }
+    for (auto it = from.files.constBegin(); it != from.files.constEnd(); ++it) {
+        if (!to.files.contains(it.key())) {
+            remove.append("files/" + it.key());
+        }
+    }
+
+    QJsonObject manifest;
+    manifest["from"] = from.version;
+    manifest["to"] = to.version;
+    manifest["add"] = add;
+    manifest["patch"] = patch;
+    manifest["remove"] = remove;
+    manifest["target"] = target;
+    ok = ok && zip.addFile("manifest.json", QJsonDocument(manifest).toJson());
+    return zip.close() && ok;
+}
+
+// 与 QMANAGE 一致：有系统 unzip 时用它，否则用 ZipReader
+static bool extractArchive(const QString &archive, const QString &destDir, bool systemUnzip)
+{
+    QDir().mkpath(destDir);
+    if (systemUnzip) {
+        return QProcess::execute("unzip", QStringList() << "-qo" << archive << "-d" << destDir) == 0;
+    }
+    ZipReader reader(archive);
+    return reader.open() && reader.extractAll(destDir);
+}
+
+static bool copyTree(const QString &src, const QString &dst)
+{
+    QDirIterator it(src, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        const QString target = dst + "/" + QDir(src).relativeFilePath(path);
+        QDir().mkpath(QFileInfo(target).absolutePath());
+        if (!QFile::copy(path, target)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static QMap<QString, QByteArray> readTree(const QString &root)
+{
+    QMap<QString, QByteArray> files;
+    QDirIterator it(root, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        QFile f(path);
+        files[QDir(root).relativeFilePath(path)] = f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+    }
+    return files;
+}
+
+// 每种方式跑 3 轮取最快的一轮；增量包应用到旧版本已安装树的副本上（复制不计时），
+// 结果树必须与完整包解压出的 update/ 逐文件一致
+static bool runDeltaComparison(const QString &dir, const QString &stagingDir, int scale, bool systemUnzip)
+{
+    SyntheticPackage from, to;
+    buildDeltaPair(scale, from, to);
+    const QString pairDir = dir + "/deltapair";
+    const QString installRoot = dir + "/install/deltapair";
+    const QString fullZip = pairDir + "/" + to.version + ".zip";
+    const QString deltaZip = pairDir + "/" + from.version + "_" + to.version + ".qdelta";
+    const QString oldTree = dir + "/deltapair-old";
+    QDir().mkpath(pairDir);
+
+    printf("\ndelta vs full (%s -> %s):\n", qPrintable(from.version), qPrintable(to.version));
+    if (!writePackage(from, stagingDir, pairDir, installRoot) || !writePackage(to, stagingDir, pairDir, installRoot)
+        || !writeDelta(from, to, installRoot, deltaZip)
+        || !extractArchive(pairDir + "/" + from.version + ".zip", oldTree, systemUnzip)) {
+        fprintf(stderr, "delta pair: failed to generate packages\n");
+        return false;
+    }
+
+    const QString fullDir = dir + "/deltapair-full";
+    const QString deltaDir = dir + "/deltapair-delta";
+    const QString treeDir = dir + "/deltapair-tree";
+    qint64 fullNs = -1, deltaExtractNs = -1, applyNs = -1;
+    bool ok = true;
+    QString error;
+    for (int round = 0; ok && round < 3; round++) {
+        QDir(fullDir).removeRecursively();
+        const qint64 t0 = monotonicNs();
+        ok = extractArchive(fullZip, fullDir, systemUnzip);
+        const qint64 t1 = monotonicNs();
+
+        QDir(deltaDir).removeRecursively();
+        QDir(treeDir).removeRecursively();
+        ok = ok && copyTree(oldTree + "/update", treeDir);
+        const qint64 t2 = monotonicNs();
+        ok = ok && extractArchive(deltaZip, deltaDir, systemUnzip);
+        const qint64 t3 = monotonicNs();
+        ok = ok && DeltaUpdate::apply(deltaDir, treeDir, error);
+        const qint64 t4 = monotonicNs();
+
+        if (fullNs < 0 || t1 - t0 < fullNs) {
+            fullNs = t1 - t0;
+        }
+        if (deltaExtractNs < 0 || (t3 - t2) + (t4 - t3) < deltaExtractNs + applyNs) {
+            deltaExtractNs = t3 - t2;
+            applyNs = t4 - t3;
+        }
+    }
+    if (ok && readTree(treeDir) != readTree(fullDir + "/update")) {
+        ok = false;
+        error = "delta result differs from full extract";
+    }
+
+    const double fullMs = fullNs / 1e6;
+    const double deltaMs = (deltaExtractNs + applyNs) / 1e6;
+    printf("  %-8s %9.2f MB  extract %8.1f ms\n", "full", QFileInfo(fullZip).size() / (1024.0 * 1024.0), fullMs);
+    printf("  %-8s %9.2f MB  extract %8.1f ms + apply %8.1f ms = %8.1f ms\n", "delta",
+           QFileInfo(deltaZip).size() / (1024.0 * 1024.0), deltaExtractNs / 1e6, applyNs / 1e6, deltaMs);
+    printf("  result %s, delta/full %.2f\n", ok ? "PASS" : "FAIL", fullMs > 0 ? deltaMs / fullMs : 0.0);
+    if (!ok) {
+        printf("  %s\n", error.isEmpty() ? "extract failed" : qPrintable(error));
+    }
+    return ok;
+}
+
+static bool isUpdateMessage(const BenchFrame &f)
+{
+    return f.type == "Process_Command"
+           && (f.message.startsWith("update_") || f.message.startsWith("REBOOT"));
+}
+
+static bool isTerminal(const QString &message)
+{
+    return message == "update_sequence_finished" || message.startsWith("update_sequence_failed:");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() > 1 && args[1] == "unzip") {
+        return runUnzip(args.mid(2));
+    }
+    if (args.size() > 1 && args[1] == "fake-client") {
+        return QCoreApplication::exec();    // QT 端替身：一直运行即可
+    }
+
+    const QString qmanage = optionValue(args, "--qmanage", QStringLiteral(QMANAGE_BINARY));
+    const quint16 port = static_cast<quint16>(optionValue(args, "--port", "8600").toUInt());
+    const int scale = qMax(1, optionValue(args, "--scale", "1").toInt());
+    const QString logPath = optionValue(args, "--log", QString());
+    const QString totalVersion = optionValue(args, "--total-version", "999.0.0");
+    if (qmanage.isEmpty() || !QFileInfo(qmanage).isExecutable()) {
+        fprintf(stderr, "QMANAGE binary not found, pass --qmanage PATH\n");
+        return 2;
+    }
+
+    QTemporaryDir tmp(QDir::tempPath() + "/updatebench-XXXXXX");
+    BenchRelay bench;
+    if (!tmp.isValid() || !bench.listen(port)) {
+        return 2;
+    }
+    const QString dir = tmp.path();
+    const QString packDir = dir + "/update_pack";
+    const QString stagingDir = dir + "/staging";
+    const QString binDir = dir + "/bin";
+    QDir().mkpath(packDir);
+    QDir().mkpath(stagingDir);
+    QDir().mkpath(binDir);
+
+    const QFile::Permissions exec = QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner;
+    writeTextFile(binDir + "/sudo", "#!/bin/sh\n# 基准中代替 sudo：直接以当前用户执行\nexec \"$@\"\n");
+    QFile::setPermissions(binDir + "/sudo", exec);
+    const bool haveUnzip = !QStandardPaths::findExecutable("unzip").isEmpty();
+    if (!haveUnzip) {
+        writeTextFile(binDir + "/unzip", QString("#!/bin/sh\nexec \"%1\" unzip \"$@\"\n")
+                                             .arg(QCoreApplication::applicationFilePath()).toLocal8Bit());
+        QFile::setPermissions(binDir + "/unzip", exec);
+    }
+    QProcessEnvironment env = isolatedEnvironment(dir, port);
+    env.insert("PATH", binDir + ":" + env.value("PATH"));
+    env.insert("QUARCS_TOTAL_VERSION", totalVersion);
+
+    printf("QMANAGE: %s\nunzip: %s\n", qPrintable(qmanage), haveUnzip ? "system" : "ZipReader stand-in");
+    if (!bench.startMonitor(qmanage, env, logPath)) {
+        return 2;
+    }
+    if (!bench.waitUntil([&bench]() { return !bench.sockets.isEmpty(); }, 20000)) {
+        fprintf(stderr, "QMANAGE did not connect (another instance holding /tmp/QUARCS_QMANAGE.lock?)\n");
+        return 1;
+    }
+
+    printf("\n%-13s %-6s %9s %9s %10s %9s %9s %8s %9s %9s\n", "scenario", "result", "total_ms", "squash_ms",
+           "prepare_ms", "script_ms", "payload_MB", "MB/s", "wchar_MB", "disk_MB");
+
+    bool allPassed = true;
+    foreach (const Scenario &scenario, buildScenarios(scale)) {
+        // 清空上一个场景的更新包，生成本场景的包，并给 inotify 索引留出时间
+        foreach (const QString &old, QDir(packDir).entryList(QStringList() << "*.zip", QDir::Files)) {
+            QFile::remove(packDir + "/" + old);
+        }
+        const QString installRoot = dir + "/install/" + scenario.name;
+        quint64 payload = 0;
+        bool generated = true;
+        foreach (const SyntheticPackage &pkg, scenario.packages) {
+            generated = generated && writePackage(pkg, stagingDir, packDir, installRoot);
+            foreach (const QByteArray &data, pkg.files) {
+                payload += static_cast<quint64>(data.size());
+            }
+        }
+        if (!generated) {
+            fprintf(stderr, "%s: failed to generate packages\n", qPrintable(scenario.name));
+            allPassed = false;
+            continue;
+        }
+        bench.waitUntil([]() { return false; }, 500);
+
+        quint64 wchar0, disk0, wchar1, disk1;
+        readProcIo(bench.monitor.processId(), wchar0, disk0);
+        const size_t firstFrame = bench.frames.size();
+        const qint64 t0 = bench.inject("updateCurrentClient:" + scenario.packages.last().version);
+        const qint64 tEnd = bench.waitUntil([&]() {
+            for (size_t i = firstFrame; i < bench.frames.size(); i++) {
+                if (isUpdateMessage(bench.frames[i]) && isTerminal(bench.frames[i].message)) {
+                    return true;
+                }
+            }
+            return false;
+        }, 600000) ? monotonicNs() : -1;
+        readProcIo(bench.monitor.processId(), wchar1, disk1);
+
+        // 按消息时间戳划分阶段：step -> 脚本第一行 为准备阶段，脚本第一行 -> 下一步 为脚本阶段
+        QStringList actual;
+        qint64 startNs = -1, firstStepNs = -1, stepNs = -1, scriptNs = -1, endNs = -1;
+        double prepareMs = 0, scriptMs = 0;
+        for (size_t i = firstFrame; i < bench.frames.size(); i++) {
+            const BenchFrame &f = bench.frames[i];
+            if (!isUpdateMessage(f)) {
+                continue;
+            }
+            actual << f.message;
+            if (f.message.startsWith("update_sequence_start:")) {
+                startNs = f.ns;
+            } else if (f.message.startsWith("update_sequence_step:") || isTerminal(f.message)) {
+                if (scriptNs >= 0) {
+                    scriptMs += (f.ns - scriptNs) / 1e6;
+                } else if (stepNs >= 0) {
+                    prepareMs += (f.ns - stepNs) / 1e6;
+                }
+                stepNs = f.ns;
+                scriptNs = -1;
+                if (firstStepNs < 0) {
+                    firstStepNs = f.ns;
+                }
+                if (isTerminal(f.message)) {
+                    endNs = f.ns;
+                    break;
+                }
+            } else if (scriptNs < 0 && stepNs >= 0) {
+                scriptNs = f.ns;
+                prepareMs += (f.ns - stepNs) / 1e6;
+            }
+        }
+
+        const QStringList expected = expectedMessages(scenario);
+        QString installError;
+        const bool messagesOk = tEnd >= 0 && actual == expected;
+        const bool installOk = verifyInstall(installRoot, expectedInstall(scenario), installError);
+        const bool passed = messagesOk && installOk;
+        allPassed = allPassed && passed;
+
+        const double totalMs = endNs >= 0 ? (endNs - t0) / 1e6 : -1;
+        const double squashMs = (startNs >= 0 && firstStepNs >= 0) ? (firstStepNs - startNs) / 1e6 : 0;
+        const double payloadMb = payload / (1024.0 * 1024.0);
+        printf("%-13s %-6s %9.1f %9.1f %10.1f %9.1f %9.2f %8.1f %9.2f %9.2f\n", qPrintable(scenario.name),
+               passed ? "PASS" : "FAIL", totalMs, squashMs, prepareMs, scriptMs, payloadMb,
+               totalMs > 0 ? payloadMb * 1000 / totalMs : 0.0,
+               (wchar1 - wchar0) / (1024.0 * 1024.0), (disk1 - disk0) / (1024.0 * 1024.0));
+
+        if (!messagesOk) {
+            printf("  expected messages:\n    %s\n  actual messages:\n    %s\n",
+                   qPrintable(expected.join("\n    ")), qPrintable(actual.join("\n    ")));
+        }
+        if (!installOk) {
+            printf("  install check: %s\n", qPrintable(installError));
+        }
+        if (bench.monitor.state() == QProcess::NotRunning) {
+            fprintf(stderr, "QMANAGE exited during %s\n", qPrintable(scenario.name));
+            return 1;
+        }
+    }
+
+    bench.stopMonitor();
+    QProcess::execute("pkill", QStringList() << "-f" << env.value("QUARCS_CLIENT_PATH"));
+
+    allPassed = runDeltaComparison(dir, stagingDir, scale, haveUnzip) && allPassed;
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,691 @@
+#include "chunkstore.h"
+#include "zipreader.h"
+#include "backgroundpriority.h"
+#include "thermalmonitor.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 分块参数；gear 表和掩码一旦改变，新入库的包就无法与旧块去重（已有数据仍然可读）
+static const int kMinChunk = 4 * 1024;
+static const int kAvgChunk = 16 * 1024;
+static const int kMaxChunk = 64 * 1024;
+// 归一化分块：平均长度之前用更严格的掩码（16 位），之后用更宽松的掩码（12 位），
+// 让块长集中在平均值附近。gear 哈希左移累加，高位取决于最近约 64 个字节，因此掩码取高位
+static const quint64 kMaskSmall = 0xFFFF000000000000ULL;
+static const quint64 kMaskLarge = 0xFFF0000000000000ULL;
+
+static const qint64 kPackBytes = 64LL * 1024 * 1024;    // 单个 pack 文件的大小上限
+static const int kReadBlock = 1024 * 1024;              // 入库时顺序读取 zip 的块大小
+static const int kReadWindow = 1024 * 1024;             // 重建时合并连续块的最大读取量
+
+static const quint64 *gearTable()
+{
+    // splitmix64 生成的固定伪随机表，不依赖运行环境
+    static quint64 table[256];
+    static std::once_flag once;
+    std::call_once(once, []() {
+        quint64 x = 0x9E3779B97F4A7C15ULL;
+        for (int i = 0; i < 256; i++) {
+            x += 0x9E3779B97F4A7C15ULL;
+            quint64 z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            table[i] = z ^ (z >> 31);
+        }
+    });
+    return table;
+}
+
+// 返回从 p 开始的下一个块的长度；n 为可用字节数（未到文件末尾时至少为 kMaxChunk）
+static int findChunkEnd(const uchar *p, int n)
+{
+    if (n <= kMinChunk) {
+        return n;
+    }
+    const quint64 *gear = gearTable();
+    const int normal = qMin(n, kAvgChunk);
+    const int limit = qMin(n, kMaxChunk);
+    quint64 fp = 0;
+    int i = kMinChunk;
+    for (; i < normal; i++) {
+        fp = (fp << 1) + gear[p[i]];
+        if (!(fp & kMaskSmall)) {
+            return i + 1;
+        }
+    }
+    for (; i < limit; i++) {
+        fp = (fp << 1) + gear[p[i]];
+        if (!(fp & kMaskLarge)) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+static bool preadAll(int fd, char *data, qint64 size, qint64 offset)
+{
+    while (size > 0) {
+        const ssize_t n = ::pread(fd, data, static_cast<size_t>(size), offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// 按 recipe 把各个块拼接成原 zip 的只读随机访问设备。
+// 顺序读取时把 pack 中首尾相接的块合并成一次最多 1 MiB 的 pread。
+class ChunkStore::ArchiveDevice : public QIODevice
+{
+public:
+    ArchiveDevice(const ChunkStore *store, const Recipe &recipe) :
+        store(store), refs(recipe.refs)
+    {
+        starts.reserve(refs.size());
+        for (const ChunkRef &ref : refs) {
+            starts.append(total);
+            total += ref.size;
+        }
+    }
+
+    ~ArchiveDevice()
+    {
+        foreach (int fd, packFds) {
+            ::close(fd);
+        }
+    }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return total; }
+
+    bool seek(qint64 pos) override
+    {
+        if (pos < 0 || pos > total) {
+            return false;
+        }
+        readPos = pos;
+        return QIODevice::seek(pos);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        qint64 copied = 0;
+        while (copied < maxSize && readPos < total) {
+            if (readPos < windowStart || readPos >= windowStart + window.size()) {
+                if (!fillWindow(readPos)) {
+                    setErrorString("chunk store read failed");
+                    return copied > 0 ? copied : -1;
+                }
+            }
+            const qint64 n = qMin<qint64>(maxSize - copied, windowStart + window.size() - readPos);
+            memcpy(data + copied, window.constData() + (readPos - windowStart), static_cast<size_t>(n));
+            copied += n;
+            readPos += n;
+        }
+        return copied;
+    }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    int packFd(int pack)
+    {
+        auto it = packFds.constFind(pack);
+        if (it != packFds.constEnd()) {
+            return it.value();
+        }
+        const int fd = ::open(QFile::encodeName(store->packPath(pack)).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            packFds.insert(pack, fd);
+        }
+        return fd;
+    }
+
+    bool fillWindow(qint64 pos)
+    {
+        const int first = static_cast<int>(std::upper_bound(starts.constBegin(), starts.constEnd(), pos)
+                                           - starts.constBegin()) - 1;
+        if (first < 0) {
+            return false;
+        }
+        int last = first;
+        qint64 bytes = refs[first].size;
+        while (last + 1 < refs.size()
+               && refs[last + 1].pack == refs[first].pack
+               && refs[last + 1].offset == refs[last].offset + refs[last].size
+               && bytes + refs[last + 1].size <= kReadWindow) {
+            last++;
+            bytes += refs[last].size;
+        }
+
+        const int fd = packFd(refs[first].pack);
+        window.resize(static_cast<int>(bytes));
+        if (fd < 0 || !preadAll(fd, window.data(), bytes, refs[first].offset)) {
+            window.clear();
+            return false;
+        }
+        windowStart = starts[first];
+        return true;
+    }
+
+    const ChunkStore *store;
+    const QVector<ChunkRef> refs;
+    QVector<qint64> starts;       // 每个块在 zip 中的起始偏移
+    qint64 total = 0;
+    qint64 readPos = 0;
+    QByteArray window;
+    qint64 windowStart = 0;
+    QHash<int, int> packFds;
+};
+
+ChunkStore::ChunkStore(const QString &storeDir, const QString &packDir, QObject *parent) :
+    QObject(parent), storeDir(storeDir), packDir(packDir)
+{
+    QDir().mkpath(storeDir + "/packs");
+    QDir().mkpath(storeDir + "/recipes");
+
+    // 这里只读 recipe 的第一行，块索引在工作线程中重建
+    QDir recipeDir(storeDir + "/recipes");
+    foreach (const QString &name, recipeDir.entryList(QStringList() << "*.tmp", QDir::Files)) {
+        recipeDir.remove(name);
+    }
+    foreach (const QString &name, recipeDir.entryList(QStringList() << "*.recipe", QDir::Files)) {
+        Recipe recipe;
+        if (readRecipe(recipeDir.filePath(name), true, &recipe)) {
+            recipes.insert(recipe.info.fileName, recipe);
+            currentStats.packages++;
+            currentStats.logicalBytes += recipe.info.size;
+        } else {
+            qDebug() << "去重存储：recipe 损坏，删除" << name;
+            recipeDir.remove(name);
+        }
+    }
+    foreach (const QString &name, QDir(storeDir + "/packs").entryList(QStringList() << "pack-*.dat", QDir::Files)) {
+        currentStats.storedBytes += QFileInfo(storeDir + "/packs/" + name).size();
+    }
+
+    worker = std::thread(&ChunkStore::workerLoop, this);
+}
+
+ChunkStore::~ChunkStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    if (writeFd >= 0) {
+        ::close(writeFd);
+    }
+}
+
+QString ChunkStore::recipePath(const QString &fileName) const
+{
+    return storeDir + "/recipes/" + fileName + ".recipe";
+}
+
+QString ChunkStore::packPath(int pack) const
+{
+    return QString("%1/packs/pack-%2.dat").arg(storeDir).arg(pack, 6, 10, QChar('0'));
+}
+
+bool ChunkStore::readRecipe(const QString &path, bool headerOnly, Recipe *recipe)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QList<QByteArray> header = file.readLine().trimmed().split(' ');
+    if (header.size() != 5) {
+        return false;
+    }
+    bool ok = false;
+    recipe->info.version = QString::fromUtf8(header[0]);
+    recipe->info.fileName = QString::fromUtf8(header[1]);
+    recipe->info.size = header[2].toLongLong();
+    recipe->info.modified = QDateTime::fromMSecsSinceEpoch(header[3].toLongLong());
+    recipe->info.key = PackageIndex::parseVersionKey(recipe->info.version, ok);
+    recipe->info.inStore = true;
+    recipe->sha256 = header[4];
+    if (!ok || recipe->sha256.size() != 64) {
+        return false;
+    }
+    if (headerOnly) {
+        return true;
+    }
+
+    qint64 total = 0;
+    while (!file.atEnd()) {
+        const QList<QByteArray> fields = file.readLine().trimmed().split(' ');
+        if (fields.size() != 4 || fields[0].size() != 64) {
+            return false;
+        }
+        ChunkRef ref;
+        ref.pack = fields[1].toInt();
+        ref.offset = fields[2].toLongLong();
+        ref.size = fields[3].toInt();
+        if (ref.pack <= 0 || ref.offset < 0 || ref.size <= 0 || ref.size > kMaxChunk) {
+            return false;
+        }
+        recipe->hashes.append(QByteArray::fromHex(fields[0]));
+        recipe->refs.append(ref);
+        total += ref.size;
+    }
+    return total == recipe->info.size;
+}
+
+void ChunkStore::enqueue(const PackageIndex::PackageInfo &info)
+{
+    if (info.inStore) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = recipes.constFind(info.fileName);
+        if (it != recipes.constEnd() && it.value().info.size == info.size
+            && it.value().info.modified.toMSecsSinceEpoch() == info.modified.toMSecsSinceEpoch()) {
+            return;
+        }
+        for (const PackageIndex::PackageInfo &queued : queue) {
+            if (queued.fileName == info.fileName) {
+                return;
+            }
+        }
+        queue.push_back(info);
+    }
+    wakeup.notify_one();
+}
+
+bool ChunkStore::contains(const PackageIndex::PackageInfo &info) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = recipes.constFind(info.fileName);
+    return it != recipes.constEnd() && it.value().info.size == info.size
+           && it.value().info.modified.toMSecsSinceEpoch() == info.modified.toMSecsSinceEpoch();
+}
+
+QList<PackageIndex::PackageInfo> ChunkStore::storedPackages() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    QList<PackageIndex::PackageInfo> result;
+    foreach (const Recipe &recipe, recipes) {
+        result.append(recipe.info);
+    }
+    return result;
+}
+
+ChunkStore::Stats ChunkStore::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return currentStats;
+}
+
+bool ChunkStore::rebuildArchive(const QString &fileName, const QString &destPath, QString *error) const
+{
+    Recipe recipe;
+    if (!readRecipe(recipePath(fileName), false, &recipe)) {
+        *error = "not in chunk store: " + fileName;
+        return false;
+    }
+
+    ArchiveDevice device(this, recipe);
+    device.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    QFile out(destPath + ".tmp");
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = "cannot write " + out.fileName() + ": " + out.errorString();
+        return false;
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QByteArray buf(kReadWindow, Qt::Uninitialized);
+    bool ok = true;
+    while (ok && !device.atEnd()) {
+        const qint64 n = device.read(buf.data(), buf.size());
+        if (n <= 0) {
+            *error = "chunk store read failed: " + fileName;
+            ok = false;
+            break;
+        }
+        hash.addData(buf.constData(), static_cast<int>(n));
+        if (out.write(buf.constData(), n) != n) {
+            *error = "write failed: " + out.fileName();
+            ok = false;
+        }
+    }
+    out.close();
+    if (ok && hash.result().toHex() != recipe.sha256) {
+        *error = "SHA-256 mismatch after rebuild: " + fileName;
+        ok = false;
+    }
+    if (!ok) {
+        out.remove();
+        return false;
+    }
+
+    // 改名前恢复原修改时间，让包索引与存储中的记录对得上
+    const qint64 modifiedMs = recipe.info.modified.toMSecsSinceEpoch();
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = static_cast<time_t>(modifiedMs / 1000);
+    times[1].tv_nsec = static_cast<long>(modifiedMs % 1000) * 1000000;
+    ::utimensat(AT_FDCWD, QFile::encodeName(out.fileName()).constData(), times, 0);
+
+    QFile::remove(destPath);
+    if (!out.rename(destPath)) {
+        *error = "cannot rename to " + destPath;
+        out.remove();
+        return false;
+    }
+    return true;
+}
+
+bool ChunkStore::extractTree(const QString &fileName, const QString &destDir, QString *error) const
+{
+    Recipe recipe;
+    if (!readRecipe(recipePath(fileName), false, &recipe)) {
+        *error = "not in chunk store: " + fileName;
+        return false;
+    }
+
+    ArchiveDevice device(this, recipe);
+    device.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    ZipReader reader(&device, fileName);
+    if (!reader.open() || !reader.extractAll(destDir)) {
+        *error = reader.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ChunkStore::workerLoop()
+{
+    setCurrentThreadIdlePriority();
+    loadChunkIndex();
+
+    while (true) {
+        PackageIndex::PackageInfo info;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            info = queue.front();
+            queue.pop_front();
+        }
+        storePackage(info);
+    }
+}
+
+// 由所有 recipe 重建块索引，并截掉最后一个 pack 末尾未被引用的数据（上次入库中途退出留下的）
+void ChunkStore::loadChunkIndex()
+{
+    QStringList names;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        names = recipes.keys();
+    }
+
+    QHash<int, qint64> packEnds;
+    foreach (const QString &name, names) {
+        Recipe recipe;
+        if (!readRecipe(recipePath(name), false, &recipe)) {
+            qDebug() << "去重存储：无法读取 recipe" << name;
+            continue;
+        }
+        for (int i = 0; i < recipe.refs.size(); i++) {
+            const ChunkRef &ref = recipe.refs[i];
+            chunkIndex.insert(recipe.hashes[i], ref);
+            packEnds[ref.pack] = qMax(packEnds.value(ref.pack), ref.offset + ref.size);
+        }
+    }
+
+    const QStringList packs = QDir(storeDir + "/packs").entryList(QStringList() << "pack-*.dat",
+                                                                  QDir::Files, QDir::Name);
+    if (!packs.isEmpty()) {
+        writePack = packs.last().mid(5, 6).toInt();
+        writeOffset = packEnds.value(writePack);
+        const QString path = packPath(writePack);
+        if (QFileInfo(path).size() > writeOffset) {
+            qDebug() << "去重存储：截断" << path << "末尾未被引用的" << (QFileInfo(path).size() - writeOffset) << "字节";
+            ::truncate(QFile::encodeName(path).constData(), writeOffset);
+        }
+    }
+
+    qint64 packBytes = 0;
+    foreach (const QString &name, packs) {
+        packBytes += QFileInfo(storeDir + "/packs/" + name).size();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    currentStats.chunks = chunkIndex.size();
+    currentStats.storedBytes = packBytes;
+}
+
+bool ChunkStore::appendChunk(const char *data, int size, ChunkRef *ref)
+{
+    if (writeFd < 0 || writeOffset + size > kPackBytes) {
+        if (writeFd >= 0) {
+            // 旧 pack 写满：先落盘再切换，之后的 recipe 可能引用其中的块
+            ::fdatasync(writeFd);
+            ::close(writeFd);
+            writeFd = -1;
+        }
+        if (writePack == 0 || writeOffset + size > kPackBytes) {
+            writePack++;
+            writeOffset = 0;
+        }
+        writeFd = ::open(QFile::encodeName(packPath(writePack)).constData(),
+                         O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (writeFd < 0) {
+            return false;
+        }
+    }
+
+    const char *p = data;
+    qint64 remaining = size;
+    qint64 offset = writeOffset;
+    while (remaining > 0) {
+        const ssize_t n = ::pwrite(writeFd, p, static_cast<size_t>(remaining), offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;     // 例如磁盘已满；部分写入的数据会在下次追加时被覆盖
+        }
+        p += n;
+        remaining -= n;
+        offset += n;
+    }
+
+    ref->pack = writePack;
+    ref->offset = writeOffset;
+    ref->size = size;
+    writeOffset += size;
+    return true;
+}
+
+void ChunkStore::storePackage(const PackageIndex::PackageInfo &info)
+{
+    const QString zipPath = QDir(packDir).filePath(info.fileName);
+    const int fd = ::open(QFile::encodeName(zipPath).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Recipe recipe;
+    recipe.info = info;
+    recipe.info.inStore = true;
+    QCryptographicHash fileHash(QCryptographicHash::Sha256);
+    qint64 total = 0;
+    qint64 newBytes = 0;
+    int newChunks = 0;
+    bool ok = true;
+
+    // 缓冲区中保留不足一个最大块的尾部，与下一次读取的数据拼接后再切分
+    QByteArray buf(kReadBlock + kMaxChunk, Qt::Uninitialized);
+    int begin = 0;
+    int end = 0;
+    bool eof = false;
+    while (ok) {
+        if (!eof && end - begin < kMaxChunk) {
+            memmove(buf.data(), buf.constData() + begin, static_cast<size_t>(end - begin));
+            end -= begin;
+            begin = 0;
+            // 每读入一块检查一次温控：偏热时放慢，过热时等降温
+            ThermalMonitor::throttleBackgroundWork([this]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return stopping;
+            });
+            const ssize_t n = ::read(fd, buf.data() + end, static_cast<size_t>(buf.size() - end));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                ok = false;
+                break;
+            }
+            eof = n == 0;
+            end += static_cast<int>(n);
+            continue;
+        }
+        if (begin == end) {
+            break;
+        }
+
+        const char *chunk = buf.constData() + begin;
+        const int size = findChunkEnd(reinterpret_cast<const uchar *>(chunk), end - begin);
+        const QByteArray hash = QCryptographicHash::hash(QByteArray::fromRawData(chunk, size),
+                                                         QCryptographicHash::Sha256);
+        fileHash.addData(chunk, size);
+
+        ChunkRef ref;
+        auto found = chunkIndex.constFind(hash);
+        if (found != chunkIndex.constEnd()) {
+            ref = found.value();
+        } else if (appendChunk(chunk, size, &ref)) {
+            chunkIndex.insert(hash, ref);
+            newBytes += size;
+            newChunks++;
+        } else {
+            qDebug() << "去重存储：写入块失败:" << strerror(errno);
+            ok = false;
+            break;
+        }
+        recipe.hashes.append(hash);
+        recipe.refs.append(ref);
+        total += size;
+        begin += size;
+    }
+
+    // 入库期间文件被替换或仍在写入时放弃，等下一次 inotify 事件
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size != total || total != info.size
+        || static_cast<qint64>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000
+               != info.modified.toMSecsSinceEpoch()) {
+        ok = false;
+    }
+    ::close(fd);
+    if (!ok) {
+        qDebug() << "去重存储：入库失败或更新包已变化，跳过" << info.fileName;
+        return;
+    }
+    if (writeFd >= 0 && ::fdatasync(writeFd) != 0) {
+        qDebug() << "去重存储：pack 落盘失败:" << strerror(errno);
+        return;
+    }
+    recipe.sha256 = fileHash.result().toHex();
+
+    // 先写临时 recipe，用它把整包读回来核对哈希，通过后才改名生效
+    const QString path = recipePath(info.fileName);
+    QFile out(path + ".tmp");
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return;
+    }
+    QByteArray text;
+    text += info.version.toUtf8() + ' ' + info.fileName.toUtf8() + ' ' + QByteArray::number(info.size) + ' '
+            + QByteArray::number(info.modified.toMSecsSinceEpoch()) + ' ' + recipe.sha256 + '\n';
+    for (int i = 0; i < recipe.refs.size(); i++) {
+        const ChunkRef &ref = recipe.refs[i];
+        text += recipe.hashes[i].toHex() + ' ' + QByteArray::number(ref.pack) + ' '
+                + QByteArray::number(ref.offset) + ' ' + QByteArray::number(ref.size) + '\n';
+    }
+    const bool written = out.write(text) == text.size() && out.flush() && ::fdatasync(out.handle()) == 0;
+    out.close();
+
+    bool verified = false;
+    if (written) {
+        ArchiveDevice device(this, recipe);
+        device.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        QCryptographicHash check(QCryptographicHash::Sha256);
+        QByteArray block(kReadWindow, Qt::Uninitialized);
+        qint64 n;
+        while ((n = device.read(block.data(), block.size())) > 0) {
+            check.addData(block.constData(), static_cast<int>(n));
+        }
+        verified = n == 0 && check.result().toHex() == recipe.sha256;
+    }
+    if (!verified) {
+        qDebug() << "去重存储：" << info.fileName << "读回校验失败，不入库";
+        out.remove();
+        return;
+    }
+    QFile::remove(path);
+    if (!out.rename(path)) {
+        out.remove();
+        return;
+    }
+
+    Stats snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto old = recipes.constFind(info.fileName);
+        if (old != recipes.constEnd()) {
+            // 同名包被替换：旧包独有的块留在 pack 中，不再被引用
+            currentStats.packages--;
+            currentStats.logicalBytes -= old.value().info.size;
+        }
+        Recipe header = recipe;
+        header.hashes.clear();
+        header.refs.clear();
+        recipes.insert(info.fileName, header);
+        currentStats.packages++;
+        currentStats.logicalBytes += info.size;
+        currentStats.chunks = chunkIndex.size();
+        currentStats.storedBytes += newBytes;
+        snapshot = currentStats;
+    }
+
+    qDebug() << "去重存储：" << info.fileName << "入库完成，" << recipe.refs.size() << "个块，其中新块"
+             << newChunks << "个（" << newBytes << "字节）；总去重比"
+             << QString::number(snapshot.ratio(), 'f', 2);
+
+    const PackageIndex::PackageInfo stored = recipe.info;
+    QMetaObject::invokeMethod(this, [this, stored]() {
+        emit packageStored(stored);
+    }, Qt::QueuedConnection);
+}
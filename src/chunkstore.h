@@ -0,0 +1,113 @@
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include "packageindex.h"
+
+// 更新包的内容寻址去重存储
+//
+// 相邻版本的完整包大部分字节相同。后台线程（空闲 CPU/IO 优先级）用基于内容的分块
+// （gear 滚动哈希，最小 4 KiB / 平均约 16 KiB / 最大 64 KiB）切分 zip，每个块按 SHA-256
+// 只保存一次；块顺序追加到 packs/pack-NNNNNN.dat，同一个包新增的块在 pack 中连续存放。
+//
+// 每个包对应一份 recipes/<文件名>.recipe：
+//   第一行  <版本号> <文件名> <大小> <修改时间毫秒> <整包 SHA-256>
+//   其余行  <块 SHA-256> <pack 编号> <偏移> <长度>，按在 zip 中的顺序排列
+// recipe 写完整包校验通过后才改名生效，因此总是完整的；块索引在启动时由所有 recipe 重建，
+// 不单独保存。pack 只追加不改写，读写可以并发。
+//
+// 已经保存的包可以重建出原 zip（rebuildArchive），也可以不落地 zip、直接流式解压出文件树
+// （extractTree）。读取时把 pack 中连续存放的块合并为一次大块顺序读。
+class ChunkStore : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats
+    {
+        int packages = 0;
+        int chunks = 0;               // 不重复的块数
+        qint64 logicalBytes = 0;      // 所有包的原始大小之和
+        qint64 storedBytes = 0;       // 不重复块的大小之和
+        double ratio() const { return storedBytes > 0 ? static_cast<double>(logicalBytes) / storedBytes : 0.0; }
+    };
+
+    ChunkStore(const QString &storeDir, const QString &packDir, QObject *parent = nullptr);
+    ~ChunkStore();
+
+    // 把更新包加入后台入库队列（已保存且大小、修改时间未变的会被忽略）
+    void enqueue(const PackageIndex::PackageInfo &info);
+
+    // info 对应的更新包是否已完整保存（只比较文件名、大小和修改时间）
+    bool contains(const PackageIndex::PackageInfo &info) const;
+    // 已保存的全部更新包
+    QList<PackageIndex::PackageInfo> storedPackages() const;
+    Stats stats() const;
+
+    // 以下函数只读 recipe 和 pack，可在任意线程调用
+    // 重建原 zip 到 destPath，并校验整包 SHA-256
+    bool rebuildArchive(const QString &fileName, const QString &destPath, QString *error) const;
+    // 不落地 zip，直接把压缩包内容解压到 destDir（逐条目校验 CRC32）
+    bool extractTree(const QString &fileName, const QString &destDir, QString *error) const;
+
+signals:
+    // 更新包已入库并校验通过（在主线程发出）
+    void packageStored(const PackageIndex::PackageInfo &info);
+
+private:
+    struct ChunkRef
+    {
+        int pack = 0;
+        qint64 offset = 0;
+        int size = 0;
+    };
+
+    struct Recipe
+    {
+        PackageIndex::PackageInfo info;
+        QByteArray sha256;            // 十六进制
+        QVector<QByteArray> hashes;   // 原始 32 字节
+        QVector<ChunkRef> refs;
+    };
+
+    class ArchiveDevice;
+
+    static bool readRecipe(const QString &path, bool headerOnly, Recipe *recipe);
+    QString recipePath(const QString &fileName) const;
+    QString packPath(int pack) const;
+
+    void workerLoop();
+    void loadChunkIndex();
+    void storePackage(const PackageIndex::PackageInfo &info);
+    bool appendChunk(const char *data, int size, ChunkRef *ref);
+
+    const QString storeDir;
+    const QString packDir;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<PackageIndex::PackageInfo> queue;
+    QMap<QString, Recipe> recipes;              // 文件名 -> recipe（只有第一行信息）
+    QHash<QByteArray, ChunkRef> chunkIndex;     // 块 SHA-256 -> 位置（仅工作线程访问）
+    Stats currentStats;
+    bool stopping = false;
+
+    // 当前追加中的 pack（仅工作线程访问）
+    int writePack = 0;
+    int writeFd = -1;
+    qint64 writeOffset = 0;
+
+    std::thread worker;
+};
+
+#endif // CHUNKSTORE_H
@@ -0,0 +1,88 @@
+#ifndef CONTROLPROTOCOL_H
+#define CONTROLPROTOCOL_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// 本地控制通道协议，监控程序（ControlServer）和 qmanagectl 共用，不依赖 Qt。
+//
+// 使用抽象命名空间的 Unix 域套接字（名字以 '\0' 开头，不在文件系统中出现，进程退出即消失），
+// 不受 /tmp 清理影响，也不依赖网络和 8600 端口的转发服务器。
+//
+// 帧格式：4 字节负载长度（网络字节序）+ 1 字节类型 + 负载
+//   请求  'Q'：命令和参数，以空格分隔，例如 "tail-log 100"
+//   应答  'O'：成功，负载为输出文本；'E'：失败，负载为错误信息
+// 每个请求只有一个应答，一个连接上可以依次发送多个请求。
+namespace ControlProtocol
+{
+
+static const char kSocketName[] = "QUARCS_QMANAGE.ctl";
+
+enum {
+    HeaderSize = 5,
+    MaxRequestBytes = 4096,
+    MaxReplyBytes = 4 * 1024 * 1024
+};
+
+enum Kind {
+    Request = 'Q',
+    ReplyOk = 'O',
+    ReplyError = 'E'
+};
+
+// 填写抽象套接字地址，返回地址长度
+inline socklen_t socketAddress(struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path + 1, kSocketName, sizeof(kSocketName) - 1);
+    return static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + 1 + sizeof(kSocketName) - 1);
+}
+
+inline std::string encodeFrame(char kind, const char *data, size_t size)
+{
+    std::string frame;
+    frame.reserve(HeaderSize + size);
+    const uint32_t len = static_cast<uint32_t>(size);
+    frame += static_cast<char>((len >> 24) & 0xFF);
+    frame += static_cast<char>((len >> 16) & 0xFF);
+    frame += static_cast<char>((len >> 8) & 0xFF);
+    frame += static_cast<char>(len & 0xFF);
+    frame += kind;
+    frame.append(data, size);
+    return frame;
+}
+
+// 解析帧头，data 至少有 HeaderSize 字节
+inline void decodeHeader(const char *data, char *kind, uint32_t *size)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    *size = (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+            | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    *kind = static_cast<char>(p[4]);
+}
+
+// 连接正在运行的监控程序，返回阻塞模式的套接字，没有实例在运行时返回 -1
+inline int connectToDaemon()
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    const socklen_t len = socketAddress(&addr);
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), len) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace ControlProtocol
+
+#endif // CONTROLPROTOCOL_H
@@ -0,0 +1,197 @@
+#include "controlserver.h"
+#include "controlprotocol.h"
+
+#include <QSocketNotifier>
+#include <QDebug>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+ControlServer::ControlServer(QObject *parent) : QObject(parent)
+{
+}
+
+ControlServer::~ControlServer()
+{
+    foreach (const Client &client, clients) {
+        ::close(client.fd);
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+    }
+}
+
+bool ControlServer::listen()
+{
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listenFd < 0) {
+        qDebug() << "控制通道：无法创建套接字:" << strerror(errno);
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    const socklen_t len = ControlProtocol::socketAddress(&addr);
+    if (::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), len) != 0
+        || ::listen(listenFd, 8) != 0) {
+        qDebug() << "控制通道：无法监听 @" << ControlProtocol::kSocketName << ":" << strerror(errno);
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+
+    listenNotifier = new QSocketNotifier(listenFd, QSocketNotifier::Read, this);
+    connect(listenNotifier, &QSocketNotifier::activated, this, &ControlServer::acceptClients);
+    qDebug() << "控制通道：监听 @" << ControlProtocol::kSocketName;
+    return true;
+}
+
+void ControlServer::acceptClients()
+{
+    for (;;) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;     // EAGAIN：已经没有待接受的连接
+        }
+
+        // 抽象套接字没有文件权限，用对端凭据限制为 root 或同一用户
+        struct ucred cred;
+        socklen_t credLen = sizeof(cred);
+        if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) != 0
+            || (cred.uid != 0 && cred.uid != ::getuid())) {
+            ::close(fd);
+            continue;
+        }
+
+        const int clientId = nextClientId++;
+        Client &client = clients[clientId];
+        client.fd = fd;
+        client.readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(client.readNotifier, &QSocketNotifier::activated, this, [this, clientId]() {
+            readClient(clientId);
+        });
+    }
+}
+
+void ControlServer::readClient(int clientId)
+{
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+
+    char buf[4096];
+    for (;;) {
+        const ssize_t n = ::read(it->fd, buf, sizeof(buf));
+        if (n > 0) {
+            it->input.append(buf, static_cast<int>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        closeClient(clientId);     // 对端关闭或出错
+        return;
+    }
+
+    while (it->input.size() >= ControlProtocol::HeaderSize) {
+        char kind;
+        uint32_t size;
+        ControlProtocol::decodeHeader(it->input.constData(), &kind, &size);
+        if (kind != ControlProtocol::Request || size > ControlProtocol::MaxRequestBytes) {
+            closeClient(clientId);
+            return;
+        }
+        if (static_cast<uint32_t>(it->input.size()) < ControlProtocol::HeaderSize + size) {
+            break;
+        }
+        const QString text = QString::fromUtf8(it->input.constData() + ControlProtocol::HeaderSize,
+                                               static_cast<int>(size));
+        it->input.remove(0, ControlProtocol::HeaderSize + static_cast<int>(size));
+
+        QStringList args = text.split(' ', QString::SkipEmptyParts);
+        if (args.isEmpty()) {
+            reply(clientId, false, "empty command");
+        } else {
+            const QString command = args.takeFirst();
+            emit commandReceived(clientId, command, args);
+        }
+
+        // 处理命令时连接可能已被关闭
+        it = clients.find(clientId);
+        if (it == clients.end()) {
+            return;
+        }
+    }
+}
+
+void ControlServer::reply(int clientId, bool ok, const QByteArray &payload)
+{
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+    const int size = qMin(payload.size(), static_cast<int>(ControlProtocol::MaxReplyBytes));
+    const std::string frame = ControlProtocol::encodeFrame(ok ? ControlProtocol::ReplyOk : ControlProtocol::ReplyError,
+                                                           payload.constData(), static_cast<size_t>(size));
+    it->output.append(frame.data(), static_cast<int>(frame.size()));
+    flushClient(clientId);
+}
+
+void ControlServer::flushClient(int clientId)
+{
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+
+    while (!it->output.isEmpty()) {
+        const ssize_t n = ::send(it->fd, it->output.constData(), static_cast<size_t>(it->output.size()), MSG_NOSIGNAL);
+        if (n > 0) {
+            it->output.remove(0, static_cast<int>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // 客户端读得慢（例如 tail-log 输出较大），等可写时再继续
+            if (!it->writeNotifier) {
+                it->writeNotifier = new QSocketNotifier(it->fd, QSocketNotifier::Write, this);
+                connect(it->writeNotifier, &QSocketNotifier::activated, this, [this, clientId]() {
+                    flushClient(clientId);
+                });
+            }
+            it->writeNotifier->setEnabled(true);
+            return;
+        }
+        closeClient(clientId);
+        return;
+    }
+    if (it->writeNotifier) {
+        it->writeNotifier->setEnabled(false);
+    }
+}
+
+void ControlServer::closeClient(int clientId)
+{
+    auto it = clients.find(clientId);
+    if (it == clients.end()) {
+        return;
+    }
+    // 可能正处于通知器自己的 activated 信号中，延迟删除
+    if (it->readNotifier) {
+        it->readNotifier->setEnabled(false);
+        it->readNotifier->deleteLater();
+    }
+    if (it->writeNotifier) {
+        it->writeNotifier->setEnabled(false);
+        it->writeNotifier->deleteLater();
+    }
+    ::close(it->fd);
+    clients.erase(it);
+}
@@ -0,0 +1,53 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+
+// 本地控制通道的服务端（协议见 controlprotocol.h）
+//
+// 监听抽象 Unix 域套接字，只接受 root 或与本进程同一用户的连接（SO_PEERCRED）。
+// 收到的命令通过 commandReceived 交给监控程序处理，处理完（可以是异步的）调用 reply 应答。
+class ControlServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ControlServer(QObject *parent = nullptr);
+    ~ControlServer();
+
+    // 开始监听；套接字名已被占用（已有实例在运行）或创建失败时返回 false
+    bool listen();
+
+    // 应答一个请求；客户端已断开时忽略
+    void reply(int clientId, bool ok, const QByteArray &payload);
+
+signals:
+    void commandReceived(int clientId, const QString &command, const QStringList &args);
+
+private:
+    struct Client
+    {
+        int fd = -1;
+        QSocketNotifier *readNotifier = nullptr;
+        QSocketNotifier *writeNotifier = nullptr;
+        QByteArray input;
+        QByteArray output;
+    };
+
+    void acceptClients();
+    void readClient(int clientId);
+    void flushClient(int clientId);
+    void closeClient(int clientId);
+
+    int listenFd = -1;
+    QSocketNotifier *listenNotifier = nullptr;
+    QMap<int, Client> clients;
+    int nextClientId = 1;
+};
+
+#endif // CONTROLSERVER_H
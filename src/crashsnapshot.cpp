@@ -0,0 +1,283 @@
+#include "crashsnapshot.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QDebug>
+#include <memory>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// 读取一个 /proc 文件到调用方提供的缓冲区，返回读到的字节数（以 '\0' 结尾），失败返回 -1
+static int readProcFile(const char *path, char *buf, int size)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    const ssize_t n = ::read(fd, buf, static_cast<size_t>(size - 1));
+    ::close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return static_cast<int>(n);
+}
+
+// 信号的默认动作是否会产生 core dump
+static bool signalDumpsCore(int sig)
+{
+    switch (sig) {
+    case SIGQUIT: case SIGILL: case SIGTRAP: case SIGABRT: case SIGBUS:
+    case SIGFPE: case SIGSEGV: case SIGXCPU: case SIGXFSZ: case SIGSYS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+CrashSnapshot::CrashSnapshot(const QString &recordDir, QObject *parent) :
+    QObject(parent), recordDir(recordDir)
+{
+    memset(&state, 0, sizeof(state));
+    sampleTimer.setInterval(SampleIntervalMs);
+    connect(&sampleTimer, &QTimer::timeout, this, &CrashSnapshot::sample);
+}
+
+void CrashSnapshot::attach(qint64 pid, const QString &program)
+{
+    memset(&state, 0, sizeof(state));
+    state.pid = pid;
+    state.startMs = QDateTime::currentMSecsSinceEpoch();
+    this->program = program;
+
+    struct rlimit limit;
+    if (::prlimit(static_cast<pid_t>(pid), RLIMIT_CORE, nullptr, &limit) == 0) {
+        state.coreLimit = limit.rlim_cur == RLIM_INFINITY ? -1 : static_cast<qint64>(limit.rlim_cur);
+    }
+
+    sample();
+    sampleTimer.start();
+}
+
+void CrashSnapshot::recordLine(const char *data, size_t size)
+{
+    OutputLine &line = state.lines[state.lineCount % LineCount];
+    int len = static_cast<int>(qMin<size_t>(size, LineBytes));
+    // 截断时不切断 UTF-8 多字节字符
+    if (static_cast<size_t>(len) < size) {
+        while (len > 0 && (static_cast<unsigned char>(data[len]) & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    line.ms = QDateTime::currentMSecsSinceEpoch();
+    line.size = static_cast<quint16>(len);
+    memcpy(line.text, data, static_cast<size_t>(len));
+    state.lineCount++;
+}
+
+void CrashSnapshot::sample()
+{
+    if (state.pid <= 0) {
+        return;
+    }
+
+    char path[64];
+    char buf[1024];
+    Sample s;
+    memset(&s, 0, sizeof(s));
+    s.ms = QDateTime::currentMSecsSinceEpoch();
+
+    snprintf(path, sizeof(path), "/proc/%lld/stat", static_cast<long long>(state.pid));
+    if (readProcFile(path, buf, sizeof(buf)) <= 0) {
+        return;     // 进程已经退出，保留最后一次有效采样
+    }
+    // comm 字段可能含空格，从最后一个 ')' 之后开始：state(3) ppid(4) ... utime(14) stime(15) ... num_threads(20)
+    const char *p = strrchr(buf, ')');
+    if (!p) {
+        return;
+    }
+    p += 2;
+    quint64 ticks = 0;
+    for (int field = 3; field <= 20 && *p; field++) {
+        char *end = nullptr;
+        if (field == 14 || field == 15) {
+            ticks += strtoull(p, &end, 10);
+        } else if (field == 20) {
+            s.threads = static_cast<quint16>(strtoul(p, &end, 10));
+        }
+        p = strchr(p, ' ');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+    if (state.lastSampleMs > 0 && s.ms > state.lastSampleMs) {
+        static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+        const double cpuMs = (ticks - state.lastTicks) * 1000.0 / ticksPerSecond;
+        s.cpuPercent = static_cast<float>(cpuMs * 100.0 / (s.ms - state.lastSampleMs));
+    }
+    state.lastTicks = ticks;
+    state.lastSampleMs = s.ms;
+
+    snprintf(path, sizeof(path), "/proc/%lld/statm", static_cast<long long>(state.pid));
+    if (readProcFile(path, buf, sizeof(buf)) > 0) {
+        static const long pageKb = sysconf(_SC_PAGESIZE) / 1024;
+        const char *rss = strchr(buf, ' ');
+        if (rss) {
+            s.rssKb = static_cast<quint32>(strtoul(rss + 1, nullptr, 10) * pageKb);
+        }
+    }
+
+    snprintf(path, sizeof(path), "/proc/%lld/fd", static_cast<long long>(state.pid));
+    DIR *dir = ::opendir(path);
+    if (dir) {
+        int count = 0;
+        struct dirent *entry;
+        while ((entry = ::readdir(dir)) != nullptr) {
+            if (entry->d_name[0] != '.') {
+                count++;
+            }
+        }
+        ::closedir(dir);
+        s.fds = static_cast<quint16>(count);
+    }
+
+    state.samples[state.sampleCount % SampleCount] = s;
+    state.sampleCount++;
+}
+
+static QByteArray buildRecord(const CrashSnapshot::State &state, const QString &program, qint64 endMs,
+                              int exitCode, bool crashed)
+{
+    const int sig = crashed ? exitCode : 0;
+
+    QJsonObject obj;
+    obj["program"] = program;
+    obj["pid"] = static_cast<double>(state.pid);
+    obj["startMs"] = static_cast<double>(state.startMs);
+    obj["endMs"] = static_cast<double>(endMs);
+    obj["uptimeMs"] = static_cast<double>(endMs - state.startMs);
+    obj["crashed"] = crashed;
+    obj["exitCode"] = crashed ? 0 : exitCode;
+    obj["signal"] = sig;
+    obj["signalName"] = sig > 0 ? QString::fromLocal8Bit(strsignal(sig)) : QString();
+    obj["coreLimit"] = static_cast<double>(state.coreLimit);
+    obj["coreDumpLikely"] = sig > 0 && signalDumpsCore(sig) && state.coreLimit != 0;
+
+    QJsonArray lines;
+    const quint64 lineBegin = state.lineCount > CrashSnapshot::LineCount
+                                  ? state.lineCount - CrashSnapshot::LineCount : 0;
+    for (quint64 i = lineBegin; i < state.lineCount; i++) {
+        const CrashSnapshot::OutputLine &line = state.lines[i % CrashSnapshot::LineCount];
+        QJsonObject item;
+        item["t"] = static_cast<double>(line.ms);
+        item["text"] = QString::fromUtf8(line.text, line.size);
+        lines.append(item);
+    }
+    obj["lines"] = lines;
+
+    QJsonArray samples;
+    const quint64 sampleBegin = state.sampleCount > CrashSnapshot::SampleCount
+                                    ? state.sampleCount - CrashSnapshot::SampleCount : 0;
+    for (quint64 i = sampleBegin; i < state.sampleCount; i++) {
+        const CrashSnapshot::Sample &s = state.samples[i % CrashSnapshot::SampleCount];
+        QJsonObject item;
+        item["t"] = static_cast<double>(s.ms);
+        item["cpu"] = qRound(s.cpuPercent * 10) / 10.0;
+        item["rssKb"] = static_cast<double>(s.rssKb);
+        item["fds"] = s.fds;
+        item["threads"] = s.threads;
+        samples.append(item);
+    }
+    obj["samples"] = samples;
+
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+QString CrashSnapshot::freeze(int exitCode, QProcess::ExitStatus exitStatus, bool expected)
+{
+    sampleTimer.stop();
+    if (state.pid <= 0) {
+        return QString();
+    }
+
+    // QProcess 在子进程被信号杀死时，exitCode 是信号编号
+    const bool crashed = exitStatus == QProcess::CrashExit;
+    if (expected || (!crashed && exitCode == 0)) {
+        state.pid = 0;
+        return QString();
+    }
+
+    // 崩溃时只拷贝一份快照，格式化和写文件放到后台线程
+    std::shared_ptr<State> copy = std::make_shared<State>(state);
+    state.pid = 0;
+    const qint64 endMs = QDateTime::currentMSecsSinceEpoch();
+    const QString id = "crash-" + QDateTime::fromMSecsSinceEpoch(endMs).toString("yyyyMMdd-hhmmss-zzz");
+    const QString dir = recordDir;
+    const QString programPath = program;
+
+    writers.run([copy, id, dir, programPath, endMs, exitCode, crashed]() {
+        const QByteArray record = buildRecord(*copy, programPath, endMs, exitCode, crashed);
+        QDir().mkpath(dir);
+        QFile file(dir + "/" + id + ".json.tmp");
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(record) != record.size()) {
+            file.remove();
+            return;
+        }
+        file.close();
+        QFile::remove(dir + "/" + id + ".json");
+        file.rename(dir + "/" + id + ".json");
+
+        // 只保留最近的若干份
+        QDir root(dir);
+        const QStringList records = root.entryList(QStringList() << "crash-*.json", QDir::Files, QDir::Name);
+        for (int i = 0; i + RecordsKept < records.size(); i++) {
+            root.remove(records[i]);
+        }
+    });
+
+    return id;
+}
+
+bool CrashSnapshot::latestSample(Sample *sample) const
+{
+    if (state.pid <= 0 || state.sampleCount == 0) {
+        return false;
+    }
+    *sample = state.samples[(state.sampleCount - 1) % SampleCount];
+    return true;
+}
+
+QStringList CrashSnapshot::listRecords() const
+{
+    QStringList ids;
+    const QStringList records = QDir(recordDir).entryList(QStringList() << "crash-*.json", QDir::Files,
+                                                          QDir::Name | QDir::Reversed);
+    foreach (const QString &name, records) {
+        ids << name.left(name.size() - 5);
+    }
+    return ids;
+}
+
+QByteArray CrashSnapshot::readRecord(const QString &id) const
+{
+    static const QRegularExpression validId("^crash-[0-9-]+$");
+    if (!validId.match(id).hasMatch()) {
+        return QByteArray();
+    }
+    QFile file(recordDir + "/" + id + ".json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
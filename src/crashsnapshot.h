@@ -0,0 +1,91 @@
+#ifndef CRASHSNAPSHOT_H
+#define CRASHSNAPSHOT_H
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "backgroundjobs.h"
+
+// QT 端崩溃现场
+//
+// QT 端运行期间持续更新一份预先分配好的快照：最近的输出行、每秒一次的 CPU/RSS/fd/线程数采样。
+// 采样直接读 /proc/<pid>/stat、statm 和 fd 目录，不分配内存。
+// QT 端异常退出（被信号杀死或退出码非 0，且不是监控程序主动结束的）时，把快照拷贝一份，
+// 在后台线程中写成 <recordDir>/crash-<时间>.json，最多保留 RecordsKept 份；析构时等写完。
+//
+// 子进程由 QProcess 回收，拿不到 waitpid 的 core dump 标志，
+// 用“信号默认动作会产生 core 且子进程 RLIMIT_CORE 不为 0”来推断。
+class CrashSnapshot : public QObject
+{
+    Q_OBJECT
+public:
+    enum {
+        LineCount = 64,       // 保留的输出行数
+        LineBytes = 240,      // 每行最多保留的字节数
+        SampleCount = 120,    // 保留的采样数（每秒一次，约两分钟）
+        SampleIntervalMs = 1000,
+        RecordsKept = 20
+    };
+
+    explicit CrashSnapshot(const QString &recordDir, QObject *parent = nullptr);
+
+    // QT 端启动后调用：清空快照并开始采样
+    void attach(qint64 pid, const QString &program);
+    // 记录一行 QT 端输出（不含换行符）
+    void recordLine(const char *data, size_t size);
+    // QT 端结束：异常退出时保存崩溃记录并返回记录 ID，否则返回空字符串。
+    // expected 表示是监控程序主动结束的（重启、更新、退出）
+    QString freeze(int exitCode, QProcess::ExitStatus exitStatus, bool expected);
+
+    // 已保存的崩溃记录 ID，最新的在前
+    QStringList listRecords() const;
+    // 读取一份崩溃记录（JSON），不存在时返回空
+    QByteArray readRecord(const QString &id) const;
+
+    struct OutputLine
+    {
+        qint64 ms;
+        quint16 size;
+        char text[LineBytes];
+    };
+
+    struct Sample
+    {
+        qint64 ms;
+        float cpuPercent;
+        quint32 rssKb;
+        quint16 fds;
+        quint16 threads;
+    };
+
+    struct State
+    {
+        qint64 pid;
+        qint64 startMs;
+        qint64 coreLimit;         // 子进程的 RLIMIT_CORE 软限制，-1 表示不限制
+        quint64 lineCount;        // 累计写入的行数（环形缓冲区的写位置）
+        quint64 sampleCount;
+        quint64 lastTicks;        // 上次采样的 utime + stime
+        qint64 lastSampleMs;
+        OutputLine lines[LineCount];
+        Sample samples[SampleCount];
+    };
+
+    // 最近一次采样，QT 端未运行时返回 false
+    bool latestSample(Sample *sample) const;
+
+private slots:
+    void sample();
+
+private:
+    QString recordDir;
+    QString program;
+    QTimer sampleTimer;
+    State state;
+    BackgroundJobs writers;     // 崩溃记录的写入线程
+};
+
+#endif // CRASHSNAPSHOT_H
@@ -0,0 +1,289 @@
+#include "deltaupdate.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <climits>
+#include <cstring>
+
+const char *DeltaUpdate::VersionMarkerName = ".quarcs_version";
+
+// bsdiff 的 offtin：8 字节小端，最高位为符号位
+static qint64 offtin(const uchar *buf)
+{
+    qint64 y = buf[7] & 0x7F;
+    for (int i = 6; i >= 0; i--) {
+        y = y * 256 + buf[i];
+    }
+    if (buf[7] & 0x80) {
+        y = -y;
+    }
+    return y;
+}
+
+// 清单中的路径必须是树内的相对路径，拒绝绝对路径和 ".."
+static bool isSafeRelativePath(const QString &path)
+{
+    if (path.isEmpty() || path.startsWith('/')) {
+        return false;
+    }
+    const QStringList parts = path.split('/');
+    foreach (const QString &part, parts) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeFileAtomically(const QString &filePath, const QByteArray &data)
+{
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    const QString tmpPath = filePath + ".delta_tmp";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    if (out.write(data) != data.size()) {
+        out.close();
+        QFile::remove(tmpPath);
+        return false;
+    }
+    out.close();
+
+    // 保留原文件权限（例如脚本的可执行位）
+    if (QFile::exists(filePath)) {
+        QFile::setPermissions(tmpPath, QFile::permissions(filePath));
+        QFile::remove(filePath);
+    }
+    return QFile::rename(tmpPath, filePath);
+}
+
+QString DeltaUpdate::findDelta(const QString &packDir, const QString &fromVersion, const QString &toVersion)
+{
+    if (fromVersion.isEmpty() || toVersion.isEmpty()) {
+        return QString();
+    }
+    const QString name = fromVersion + "_" + toVersion + ".qdelta";
+    if (QFileInfo(QDir(packDir).filePath(name)).isFile()) {
+        return name;
+    }
+    return QString();
+}
+
+QString DeltaUpdate::installedVersion(const QString &treeDir)
+{
+    QFile file(QDir(treeDir).filePath(VersionMarkerName));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+bool DeltaUpdate::markInstalledVersion(const QString &treeDir, const QString &version)
+{
+    QFile file(QDir(treeDir).filePath(VersionMarkerName));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    file.write(version.toUtf8() + "\n");
+    return true;
+}
+
+QByteArray DeltaUpdate::fileSha256(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+    return hash.result().toHex();
+}
+
+bool DeltaUpdate::applyPatch(const QByteArray &oldData, const QByteArray &patch, QByteArray &newData)
+{
+    if (patch.size() < 32 || !patch.startsWith("QBSDIFF1")) {
+        return false;
+    }
+
+    const uchar *header = reinterpret_cast<const uchar *>(patch.constData());
+    const qint64 ctrlLen = offtin(header + 8);
+    const qint64 diffLen = offtin(header + 16);
+    const qint64 newSize = offtin(header + 24);
+    // 各长度分别与剩余字节比较，不相加，避免有符号溢出绕过检查；
+    // newSize 超过 QByteArray 的上限时 resize 会截断，之后的边界检查就不再成立
+    const qint64 available = patch.size() - 32;
+    if (ctrlLen < 0 || diffLen < 0 || newSize < 0 || newSize > INT_MAX
+        || ctrlLen > available || diffLen > available - ctrlLen) {
+        return false;
+    }
+
+    const uchar *ctrlBlock = header + 32;
+    const uchar *diffBlock = ctrlBlock + ctrlLen;
+    const uchar *extraBlock = diffBlock + diffLen;
+    const qint64 extraLen = patch.size() - 32 - ctrlLen - diffLen;
+
+    const uchar *oldBytes = reinterpret_cast<const uchar *>(oldData.constData());
+    const qint64 oldSize = oldData.size();
+
+    newData.resize(static_cast<int>(newSize));
+    uchar *out = reinterpret_cast<uchar *>(newData.data());
+
+    qint64 ctrlPos = 0, diffPos = 0, extraPos = 0;
+    qint64 oldPos = 0, newPos = 0;
+    while (newPos < newSize) {
+        if (ctrlPos + 24 > ctrlLen) {
+            return false;
+        }
+        const qint64 addLen = offtin(ctrlBlock + ctrlPos);
+        const qint64 copyLen = offtin(ctrlBlock + ctrlPos + 8);
+        const qint64 seekLen = offtin(ctrlBlock + ctrlPos + 16);
+        ctrlPos += 24;
+
+        // 差分段：新字节 = 差分字节 + 旧字节
+        if (addLen < 0 || addLen > newSize - newPos || addLen > diffLen - diffPos) {
+            return false;
+        }
+        for (qint64 i = 0; i < addLen; i++) {
+            uchar b = diffBlock[diffPos + i];
+            const qint64 o = oldPos + i;
+            if (o >= 0 && o < oldSize) {
+                b = static_cast<uchar>(b + oldBytes[o]);
+            }
+            out[newPos + i] = b;
+        }
+        newPos += addLen;
+        oldPos += addLen;
+        diffPos += addLen;
+
+        // 附加段：直接拷贝
+        if (copyLen < 0 || copyLen > newSize - newPos || copyLen > extraLen - extraPos) {
+            return false;
+        }
+        memcpy(out + newPos, extraBlock + extraPos, static_cast<size_t>(copyLen));
+        newPos += copyLen;
+        extraPos += copyLen;
+
+        // 合法补丁中 oldPos 不会远离 [0, oldSize]，超出 INT_MAX 的跳转只可能是构造出来的
+        if (seekLen > INT_MAX || seekLen < -static_cast<qint64>(INT_MAX)) {
+            return false;
+        }
+        oldPos += seekLen;
+        if (oldPos > static_cast<qint64>(INT_MAX) * 2 || oldPos < -static_cast<qint64>(INT_MAX) * 2) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DeltaUpdate::apply(const QString &deltaDir, const QString &treeDir, QString &errorString)
+{
+    QFile manifestFile(QDir(deltaDir).filePath("manifest.json"));
+    if (!manifestFile.open(QIODevice::ReadOnly)) {
+        errorString = "manifest.json not found";
+        return false;
+    }
+    const QJsonObject manifest = QJsonDocument::fromJson(manifestFile.readAll()).object();
+    manifestFile.close();
+
+    if (manifest.isEmpty() || !manifest["target"].isObject()) {
+        errorString = "invalid manifest.json";
+        return false;
+    }
+
+    QDir tree(treeDir);
+    QDir delta(deltaDir);
+
+    // 1. 先处理补丁：源文件哈希必须与清单一致，否则说明已安装树与预期不符
+    foreach (const QJsonValue &value, manifest["patch"].toArray()) {
+        const QJsonObject entry = value.toObject();
+        const QString path = entry["path"].toString();
+        if (!isSafeRelativePath(path)) {
+            errorString = "unsafe patch path: " + path;
+            return false;
+        }
+
+        const QString oldPath = tree.filePath(path);
+        if (fileSha256(oldPath) != entry["source"].toString().toLatin1()) {
+            errorString = "source hash mismatch: " + path;
+            return false;
+        }
+
+        QFile oldFile(oldPath);
+        QFile patchFile(delta.filePath("patch/" + path));
+        if (!oldFile.open(QIODevice::ReadOnly) || !patchFile.open(QIODevice::ReadOnly)) {
+            errorString = "cannot read patch input: " + path;
+            return false;
+        }
+
+        QByteArray newData;
+        if (!applyPatch(oldFile.readAll(), patchFile.readAll(), newData)) {
+            errorString = "corrupt patch: " + path;
+            return false;
+        }
+        oldFile.close();
+
+        if (!writeFileAtomically(oldPath, newData)) {
+            errorString = "cannot write patched file: " + path;
+            return false;
+        }
+    }
+
+    // 2. 新增/整体替换的文件
+    foreach (const QJsonValue &value, manifest["add"].toArray()) {
+        const QString path = value.toString();
+        if (!isSafeRelativePath(path)) {
+            errorString = "unsafe add path: " + path;
+            return false;
+        }
+
+        QFile src(delta.filePath("add/" + path));
+        if (!src.open(QIODevice::ReadOnly)) {
+            errorString = "missing added file: " + path;
+            return false;
+        }
+        const QString dstPath = tree.filePath(path);
+        if (!writeFileAtomically(dstPath, src.readAll())) {
+            errorString = "cannot write added file: " + path;
+            return false;
+        }
+        QFile::setPermissions(dstPath, src.permissions());
+    }
+
+    // 3. 删除的文件
+    foreach (const QJsonValue &value, manifest["remove"].toArray()) {
+        const QString path = value.toString();
+        if (!isSafeRelativePath(path)) {
+            errorString = "unsafe remove path: " + path;
+            return false;
+        }
+        const QString filePath = tree.filePath(path);
+        if (QFileInfo(filePath).isDir()) {
+            QDir(filePath).removeRecursively();
+        } else {
+            QFile::remove(filePath);
+        }
+    }
+
+    // 4. 按目标哈希逐个校验，确保得到的树与完整包解压结果一致
+    const QJsonObject target = manifest["target"].toObject();
+    for (auto it = target.constBegin(); it != target.constEnd(); ++it) {
+        if (!isSafeRelativePath(it.key())
+            || fileSha256(tree.filePath(it.key())) != it.value().toString().toLatin1()) {
+            errorString = "target hash mismatch: " + it.key();
+            return false;
+        }
+    }
+
+    return true;
+}
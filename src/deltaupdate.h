@@ -0,0 +1,58 @@
+#ifndef DELTAUPDATE_H
+#define DELTAUPDATE_H
+
+#include <QString>
+#include <QByteArray>
+
+// 增量更新包（*.qdelta）
+//
+// 文件名格式：<源版本>_<目标版本>.qdelta，例如 1.0.2_1.0.3.qdelta，
+// 与完整包一起放在 UpdatePackPath 下（扩展名不是 .zip，不会被当成完整包扫描）。
+//
+// 增量包本身是一个 zip 压缩包，解压后的结构：
+//   manifest.json        清单，见下
+//   add/<path>           新增（或整体替换）文件的完整内容
+//   patch/<path>         针对旧文件的二进制补丁（QBSDIFF1 格式，见 applyPatch）
+//
+// manifest.json：
+//   {
+//     "from":   "1.0.2",
+//     "to":     "1.0.3",
+//     "remove": ["path", ...],
+//     "add":    ["path", ...],
+//     "patch":  [{"path": "...", "source": "<sha256>", "target": "<sha256>"}, ...],
+//     "target": {"path": "<sha256>", ...}      // 目标版本完整文件列表的哈希，用于最终校验
+//   }
+// 其中 path 均为相对于已安装更新树（UpdatePackPath/update）的相对路径。
+class DeltaUpdate
+{
+public:
+    // 已安装更新树中记录版本号的标记文件名
+    static const char *VersionMarkerName;
+
+    // 在 packDir 中查找从 fromVersion 到 toVersion 的增量包，找不到返回空字符串
+    static QString findDelta(const QString &packDir, const QString &fromVersion, const QString &toVersion);
+
+    // 读取/写入更新树对应的版本号（记录在树根目录的标记文件中）
+    static QString installedVersion(const QString &treeDir);
+    static bool markInstalledVersion(const QString &treeDir, const QString &version);
+
+    // 将已解压的增量包 deltaDir 应用到 treeDir 上，并用目标哈希校验结果。
+    // 任何一步失败都返回 false，errorString 给出原因；此时 treeDir 内容不可信，
+    // 调用方应回退到完整包。
+    static bool apply(const QString &deltaDir, const QString &treeDir, QString &errorString);
+
+    // 应用单个 QBSDIFF1 补丁。格式与 bsdiff 4.x 相同，只是三个数据块不做 bzip2 压缩
+    // （外层 zip 已经压缩过）：
+    //   0   8  "QBSDIFF1"
+    //   8   8  控制块长度
+    //   16  8  差分块长度
+    //   24  8  新文件长度
+    //   32  ..  控制块（x,y,z 三元组），差分块，附加块
+    // 整数均为 bsdiff 的 offtin 格式（小端，最高位为符号位）。
+    static bool applyPatch(const QByteArray &oldData, const QByteArray &patch, QByteArray &newData);
+
+    static QByteArray fileSha256(const QString &filePath);
+};
+
+#endif // DELTAUPDATE_H
@@ -0,0 +1,92 @@
+#ifndef HELPERPROTOCOL_H
+#define HELPERPROTOCOL_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+// 监控程序（PrivHelper）与常驻特权助手（qmanagehelper）之间的协议，不依赖 Qt。
+//
+// 助手启动时只经过一次 sudo，之后通过 socketpair 接收固定的几种二进制命令，
+// 不再为每次 LED 写入、每个 Update.sh 单独 fork sudo。
+//
+// 帧格式：4 字节负载长度 + 4 字节请求编号（均为网络字节序）+ 1 字节类型 + 负载
+//   请求  'P'：探测，负载为空或 "<更新包目录>\0<影子目录>"（与助手的配置不一致时结果为 EPERM）
+//         'W'：写 sysfs，负载为 "<路径>\0<值>"
+//         'R'：执行 <更新包目录>/update/Update.sh，负载为 1 字节标志（ScriptStagedInstall）
+//         'C'：递归删除目录，负载为路径
+//         'S'：把 A/B 暂存安装的当前安装目录（影子目录去掉 .shadow 后缀）复制到影子目录，负载为空；
+//              影子目录必须已经删除，由助手新建
+//   应答  'o'：脚本输出（stdout 与 stderr 合并），同一请求可以有多帧
+//         'd'：请求完成，负载为 4 字节结果 + 4 字节标志（均为网络字节序）：
+//              探测/写 sysfs/删除目录的结果为 0 或 errno；
+//              脚本与复制影子目录的结果为退出码，标志为 1 时表示被信号杀死、结果为信号编号
+// 请求可以连续发送而不必等待应答（流水线），应答按请求编号对应。
+namespace HelperProtocol
+{
+
+enum {
+    HeaderSize = 9,
+    MaxRequestBytes = 8192,
+    MaxReplyBytes = 64 * 1024
+};
+
+enum Kind {
+    Ping = 'P',
+    WriteSysfs = 'W',
+    RunScript = 'R',
+    CleanDir = 'C',
+    CopyShadow = 'S',
+    ScriptOutput = 'o',
+    Done = 'd'
+};
+
+enum ScriptFlags {
+    ScriptStagedInstall = 1       // 设置 QUARCS_STAGED_INSTALL=1 和 QUARCS_INSTALL_ROOT=<影子目录>
+};
+
+inline void appendUint32(std::string *out, uint32_t value)
+{
+    *out += static_cast<char>((value >> 24) & 0xFF);
+    *out += static_cast<char>((value >> 16) & 0xFF);
+    *out += static_cast<char>((value >> 8) & 0xFF);
+    *out += static_cast<char>(value & 0xFF);
+}
+
+inline uint32_t readUint32(const char *data)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+           | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline std::string encodeFrame(char kind, uint32_t requestId, const char *data, size_t size)
+{
+    std::string frame;
+    frame.reserve(HeaderSize + size);
+    appendUint32(&frame, static_cast<uint32_t>(size));
+    appendUint32(&frame, requestId);
+    frame += kind;
+    frame.append(data, size);
+    return frame;
+}
+
+inline std::string encodeDone(uint32_t requestId, int32_t result, bool signaled)
+{
+    std::string payload;
+    appendUint32(&payload, static_cast<uint32_t>(result));
+    appendUint32(&payload, signaled ? 1 : 0);
+    return encodeFrame(Done, requestId, payload.data(), payload.size());
+}
+
+// 解析帧头，data 至少有 HeaderSize 字节
+inline void decodeHeader(const char *data, char *kind, uint32_t *requestId, uint32_t *size)
+{
+    *size = readUint32(data);
+    *requestId = readUint32(data + 4);
+    *kind = data[8];
+}
+
+} // namespace HelperProtocol
+
+#endif // HELPERPROTOCOL_H
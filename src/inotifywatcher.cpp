@@ -0,0 +1,63 @@
+#include "inotifywatcher.h"
+
+#include <QFile>
+#include <QDebug>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+InotifyWatcher::InotifyWatcher(QObject *parent) : QObject(parent)
+{
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        qDebug() << "inotify_init1 failed, file changes will not be tracked";
+        return;
+    }
+
+    notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &InotifyWatcher::readEvents);
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+}
+
+int InotifyWatcher::addWatch(const QString &path, quint32 mask)
+{
+    if (inotifyFd < 0) {
+        return -1;
+    }
+    return inotify_add_watch(inotifyFd, QFile::encodeName(path).constData(), mask);
+}
+
+void InotifyWatcher::removeWatch(int wd)
+{
+    if (inotifyFd >= 0 && wd >= 0) {
+        inotify_rm_watch(inotifyFd, wd);
+    }
+}
+
+void InotifyWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buf[4096];
+
+    while (true) {
+        const ssize_t len = ::read(inotifyFd, buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            if (event->mask & IN_Q_OVERFLOW) {
+                emit overflowed();
+            } else {
+                const QString name = event->len > 0 ? QFile::decodeName(event->name) : QString();
+                emit fileEvent(event->wd, event->mask, name);
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
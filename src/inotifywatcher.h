@@ -0,0 +1,36 @@
+#ifndef INOTIFYWATCHER_H
+#define INOTIFYWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QSocketNotifier>
+
+// 基于 inotify 的文件系统事件监听，挂在 Qt 事件循环上（QSocketNotifier），
+// 每个事件带上 watch 描述符、事件掩码和文件名，由使用者自行增量处理。
+class InotifyWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InotifyWatcher(QObject *parent = nullptr);
+    ~InotifyWatcher();
+
+    bool isValid() const { return inotifyFd >= 0; }
+
+    // 添加监听，返回 watch 描述符；失败返回 -1
+    int addWatch(const QString &path, quint32 mask);
+    void removeWatch(int wd);
+
+signals:
+    void fileEvent(int wd, quint32 mask, const QString &name);
+    // 内核事件队列溢出，使用者应做一次全量重建
+    void overflowed();
+
+private slots:
+    void readEvents();
+
+private:
+    int inotifyFd = -1;
+    QSocketNotifier *notifier = nullptr;
+};
+
+#endif // INOTIFYWATCHER_H
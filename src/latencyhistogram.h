@@ -0,0 +1,49 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <algorithm>
+
+// 按 2 的幂分桶的微秒延迟直方图（事件循环延迟、消息往返时间）
+//
+// 第 i 个桶收纳 [2^(i-1), 2^i) 微秒，最后一个桶收纳更大的值；百分位取所在桶的上界，
+// 并且不超过实际记录到的最大值。只在一个线程上使用，不加锁。
+class LatencyHistogram
+{
+public:
+    static const int kBuckets = 24;
+
+    void record(qint64 us)
+    {
+        us = std::max<qint64>(0, us);
+        int bucket = 0;
+        while (bucket < kBuckets - 1 && (1LL << bucket) <= us) {
+            bucket++;
+        }
+        buckets[bucket]++;
+        samples++;
+        maxUs = std::max(maxUs, us);
+    }
+
+    qint64 count() const { return samples; }
+    qint64 max() const { return maxUs; }
+
+    qint64 percentile(int percent) const
+    {
+        qint64 cumulative = 0;
+        for (int bucket = 0; bucket < kBuckets; bucket++) {
+            cumulative += buckets[bucket];
+            if (cumulative > 0 && cumulative * 100 >= samples * percent) {
+                return bucket == kBuckets - 1 ? maxUs : std::min(1LL << bucket, maxUs);
+            }
+        }
+        return 0;
+    }
+
+private:
+    qint64 buckets[kBuckets] = {};
+    qint64 samples = 0;
+    qint64 maxUs = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -1,4 +1,6 @@
 #include "led.h"
+#include "tracer.h"
+#include "privhelper.h"
  
  
 #define LED_PATH "/sys/class/leds/"
@@ -48,20 +50,23 @@ void Led::initLed()
 
 void Led::openLed()
 {
-    // 使用 tee 时会在终端打印 1，这里将输出重定向到 /dev/null，避免打印 0/1
-    QString command = "echo 1 | sudo tee "+LedPath+"/brightness > /dev/null";
-    int result = system(command.toStdString().c_str());
-    if (result != 0) {
+    // 没有找到可写的 ACT 灯（例如在普通 PC 上运行）时不做任何事，避免反复调用 sudo
+    if (!LedStatus) {
+        return;
+    }
+
+    if (!writeAttribute("brightness", "1")) {
         qDebug() << "Failed to open LED";
     }
 }
 
 void Led::closeLed()
 {
-    // 同样屏蔽关闭时的 0 输出
-    QString command = "echo 0 | sudo tee "+LedPath+"/brightness > /dev/null";
-    int result = system(command.toStdString().c_str());
-    if (result != 0) {
+    if (!LedStatus) {
+        return;
+    }
+
+    if (!writeAttribute("brightness", "0")) {
         qDebug() << "Failed to close LED";
     }
 }
@@ -84,22 +89,32 @@ void Led::slowFlash()
 
 void Led::triggerLed(bool enable)
 {
-    QString command;
-    if (enable) {
-        // 启用默认触发器
-        command = "echo mmc0 | sudo tee "+LedPath+"/trigger > /dev/null";
-    } else {
-        // 禁用触发器
-        command = "echo none | sudo tee "+LedPath+"/trigger > /dev/null";
-    }
-    int result = system(command.toStdString().c_str());
-    if (result == 0) {
+    // 启用默认触发器 / 禁用触发器
+    if (writeAttribute("trigger", enable ? "mmc0" : "none")) {
         qDebug() << "Command executed successfully.";
     } else {
         qDebug() << "Command execution failed.";
     }
 }
 
+void Led::setPrivHelper(PrivHelper *helper)
+{
+    privHelper = helper;
+}
+
+// 写 LED 的 sysfs 属性。特权助手可用时只发一帧请求、不等待结果（失败时由 PrivHelper 记录日志）；
+// 否则退回 sudo tee，tee 会在终端打印写入的值，这里将输出重定向到 /dev/null
+bool Led::writeAttribute(const char *attribute, const char *value)
+{
+    PrivHelper *helper = privHelper.load();
+    if (helper && helper->isRunning()
+        && helper->writeSysfs((LedPath + "/" + attribute).toLocal8Bit(), QByteArray(value)) != 0) {
+        return true;
+    }
+    QString command = QString("echo %1 | sudo tee %2/%3 > /dev/null").arg(value, LedPath, attribute);
+    return system(command.toStdString().c_str()) == 0;
+}
+
 
 
 // 获取Pi型号
@@ -126,6 +141,9 @@ void Led::getPiModel()
 
 void Led::setLedSpeed(const QString &speed)
 {
+    if (speed != LedSpeed) {
+        Tracer::instant("led_speed", speed);
+    }
     LedSpeed = speed;
 }
 
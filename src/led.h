@@ -8,6 +8,9 @@
 #include <QDebug>
 #include <QThread>
 #include <thread>
+#include <atomic>
+
+class PrivHelper;
 
 class Led {
 public:
@@ -23,14 +26,19 @@ public:
     void getPiModel();
     void setLedSpeed(const QString &speed);
     void flashLed();
+    // 设置后 LED 的 sysfs 写入交给常驻特权助手，不再每次调用 sudo
+    void setPrivHelper(PrivHelper *helper);
 
 private:
+    bool writeAttribute(const char *attribute, const char *value);
+
     std::thread flashThread;
     QString LedPath;
-    bool LedStatus;
+    bool LedStatus = false;
     QString LedSpeed;
     QString currentLedSpeed;
     int PiModel;
+    std::atomic<PrivHelper *> privHelper{nullptr};
 };
 
 #endif // LED_H
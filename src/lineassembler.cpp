@@ -0,0 +1,56 @@
+#include "lineassembler.h"
+
+static bool startsWith(const char *data, size_t size, const char *prefix)
+{
+    const size_t len = strlen(prefix);
+    return size >= len && memcmp(data, prefix, len) == 0;
+}
+
+UpdateScriptLine parseUpdateScriptLine(const char *data, size_t size)
+{
+    UpdateScriptLine line;
+
+    if (startsWith(data, size, "REBOOT:") || startsWith(data, size, "NOREBOOT:")) {
+        line.kind = UpdateScriptLine::Reboot;
+        return line;
+    }
+
+    UpdateScriptLine::Kind kind;
+    if (startsWith(data, size, "PROGRESS:")) {
+        kind = UpdateScriptLine::Progress;
+    } else if (startsWith(data, size, "ERROR:")) {
+        kind = UpdateScriptLine::Error;
+    } else if (startsWith(data, size, "SUCCESS:")) {
+        kind = UpdateScriptLine::Success;
+    } else {
+        return line;
+    }
+
+    // 依次取出前 3 个非空字段
+    const char *fields[3] = {nullptr, nullptr, nullptr};
+    size_t sizes[3] = {0, 0, 0};
+    int found = 0;
+    const char *p = data;
+    const char *end = data + size;
+    while (p < end && found < 3) {
+        const char *colon = static_cast<const char *>(memchr(p, ':', static_cast<size_t>(end - p)));
+        const char *fieldEnd = colon ? colon : end;
+        if (fieldEnd > p) {
+            fields[found] = p;
+            sizes[found] = static_cast<size_t>(fieldEnd - p);
+            found++;
+        }
+        p = colon ? colon + 1 : end;
+    }
+
+    if (found < 3) {
+        return line;
+    }
+
+    line.kind = kind;
+    line.value = fields[1];
+    line.valueSize = sizes[1];
+    line.message = fields[2];
+    line.messageSize = sizes[2];
+    return line;
+}
@@ -0,0 +1,118 @@
+#ifndef LINEASSEMBLER_H
+#define LINEASSEMBLER_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// 子进程输出的增量分行器
+//
+// 子进程的输出按任意边界分块到达，一行可能被拆到两次读取中。分行器保留
+// 上一块末尾不完整的部分，用 memchr 找换行符，每凑齐一行就以 (指针, 长度)
+// 的形式回调，不构造 QString/QStringList。超过 maxLineLength 的行会被截断
+// 输出，超出部分一直丢弃到下一个换行符为止。行尾的 '\r' 会被去掉。
+class LineAssembler
+{
+public:
+    explicit LineAssembler(size_t maxLineLength = 4096) : maxLength(maxLineLength) {}
+
+    // 输入一块数据，onLine(const char *data, size_t size) 对每一个完整的行调用一次
+    template <typename Callback>
+    void feed(const char *data, size_t size, Callback onLine)
+    {
+        const char *p = data;
+        const char *end = data + size;
+        while (p < end) {
+            const char *nl = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char *segmentEnd = nl ? nl : end;
+
+            if (!discarding) {
+                if (carry.empty() && nl && static_cast<size_t>(nl - p) <= maxLength) {
+                    // 快速路径：整行都在本块内，直接回调，不拷贝
+                    emitLine(p, static_cast<size_t>(nl - p), onLine);
+                } else {
+                    appendCarry(p, static_cast<size_t>(segmentEnd - p), onLine);
+                    if (nl && !discarding) {
+                        emitLine(carry.data(), carry.size(), onLine);
+                        carry.clear();
+                    }
+                }
+            }
+
+            if (!nl) {
+                break;
+            }
+            // 换行符结束了当前行（包括被截断、正在丢弃的行）
+            discarding = false;
+            carry.clear();
+            p = nl + 1;
+        }
+    }
+
+    // 子进程结束时调用，把最后一行没有换行符的内容也输出
+    template <typename Callback>
+    void finish(Callback onLine)
+    {
+        if (!discarding && !carry.empty()) {
+            emitLine(carry.data(), carry.size(), onLine);
+        }
+        reset();
+    }
+
+    void reset()
+    {
+        carry.clear();
+        discarding = false;
+    }
+
+    size_t truncatedLineCount() const { return truncatedLines; }
+
+private:
+    template <typename Callback>
+    void appendCarry(const char *data, size_t size, Callback onLine)
+    {
+        if (carry.size() + size <= maxLength) {
+            carry.append(data, size);
+            return;
+        }
+        // 超长行：截断到 maxLength 立即输出，其余部分丢弃到下一个换行符
+        carry.append(data, maxLength - carry.size());
+        emitLine(carry.data(), carry.size(), onLine);
+        carry.clear();
+        discarding = true;
+        truncatedLines++;
+    }
+
+    template <typename Callback>
+    static void emitLine(const char *data, size_t size, Callback onLine)
+    {
+        if (size > 0 && data[size - 1] == '\r') {
+            size--;
+        }
+        onLine(data, size);
+    }
+
+    std::string carry;
+    size_t maxLength;
+    bool discarding = false;
+    size_t truncatedLines = 0;
+};
+
+// Update.sh 输出行的解析结果，value/message 指向原始行内的字节，不拷贝
+struct UpdateScriptLine
+{
+    enum Kind { Other, Progress, Error, Success, Reboot };
+
+    Kind kind = Other;
+    const char *value = nullptr;
+    size_t valueSize = 0;
+    const char *message = nullptr;
+    size_t messageSize = 0;
+};
+
+// 解析 PROGRESS:x:msg / ERROR:x:msg / SUCCESS:x:msg / REBOOT:... / NOREBOOT:...
+// 与原来的 line.split(":", Qt::SkipEmptyParts) 语义一致：空字段被跳过，
+// x 为第 2 个非空字段，msg 为第 3 个非空字段；不足 3 个字段时返回 Other。
+UpdateScriptLine parseUpdateScriptLine(const char *data, size_t size);
+
+#endif // LINEASSEMBLER_H
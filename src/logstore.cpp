@@ -0,0 +1,675 @@
+#include "logstore.h"
+#include "backgroundpriority.h"
+#include "thermalmonitor.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMap>
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// 攒够这么多字节就立即写一次，否则每隔 flushIntervalMs（默认 kFlushIntervalMs）写一次
+static const int kBatchBytes = 64 * 1024;
+static const int kFlushIntervalMs = 2000;
+// 写线程跟不上（SD 卡卡顿）时内存中最多积压的字节数，超过后丢弃新行
+static const int kMaxPendingBytes = 4 * 1024 * 1024;
+// 单行最大长度，保证任何一行都能放进一个段
+static const int kMaxLineBytes = 8 * 1024;
+// 打开新段失败后，等这么久再重试，期间的日志丢弃
+static const qint64 kOpenRetryMs = 60 * 1000;
+
+static std::atomic<LogStore *> messageStore(nullptr);
+static QtMessageHandler previousMessageHandler = nullptr;
+
+static void logStoreMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    LogStore *store = messageStore.load();
+    if (store) {
+        char source = 'D';
+        switch (type) {
+        case QtDebugMsg: source = 'D'; break;
+        case QtInfoMsg: source = 'I'; break;
+        case QtWarningMsg: source = 'W'; break;
+        case QtCriticalMsg: source = 'E'; break;
+        case QtFatalMsg: source = 'F'; break;
+        }
+        const QByteArray utf8 = msg.toUtf8();
+        store->append(source, utf8.constData(), utf8.size());
+    }
+    if (previousMessageHandler) {
+        previousMessageHandler(type, context, msg);
+    }
+}
+
+// 行首的毫秒时间戳，没有时返回 -1
+static qint64 lineTimestamp(const char *p, const char *end)
+{
+    qint64 value = 0;
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return p == start ? -1 : value;
+}
+
+// 数据块中最后一个完整行的时间戳
+static qint64 lastLineTimestamp(const char *data, int size)
+{
+    int end = size;
+    while (end > 0 && data[end - 1] == '\n') {
+        end--;
+    }
+    int start = end;
+    while (start > 0 && data[start - 1] != '\n') {
+        start--;
+    }
+    return lineTimestamp(data + start, data + end);
+}
+
+static QString segmentName(qint64 ms)
+{
+    return QString("seg-%1.log").arg(ms, 13, 10, QChar('0'));
+}
+
+static qint64 segmentNameMs(const QString &fileName)
+{
+    return fileName.mid(4, fileName.indexOf('.') - 4).toLongLong();
+}
+
+static bool writeAll(int fd, const char *data, qint64 size, qint64 offset)
+{
+    while (size > 0) {
+        const ssize_t n = ::pwrite(fd, data, static_cast<size_t>(size), static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool gzipCompress(const QByteArray &input, QByteArray *output)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16：gzip 格式，可以直接用 zcat 查看
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    output->resize(static_cast<int>(deflateBound(&zs, static_cast<uLong>(input.size()))));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.constData()));
+    zs.avail_in = static_cast<uInt>(input.size());
+    zs.next_out = reinterpret_cast<Bytef *>(output->data());
+    zs.avail_out = static_cast<uInt>(output->size());
+    const int ret = deflate(&zs, Z_FINISH);
+    output->resize(static_cast<int>(zs.total_out));
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+LogStore::LogStore(const QString &dir, qint64 segmentBytes, qint64 budgetBytes, QObject *parent) :
+    QObject(parent), dir(dir), segmentBytes(segmentBytes), budgetBytes(budgetBytes),
+    flushIntervalMs(kFlushIntervalMs)
+{
+    QDir().mkpath(dir);
+    pending.reserve(kBatchBytes * 2);
+    loadIndex();
+    writer = std::thread(&LogStore::writerLoop, this);
+    compactor = std::thread(&LogStore::compactorLoop, this);
+}
+
+LogStore::~LogStore()
+{
+    if (messageStore.load() == this) {
+        qInstallMessageHandler(previousMessageHandler);
+        messageStore.store(nullptr);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        stopping = true;
+    }
+    pendingWakeup.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    // 未压缩完的段留到下次启动时再压缩
+    {
+        std::lock_guard<std::mutex> lock(compactMutex);
+        compactStopping = true;
+    }
+    compactWakeup.notify_all();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+}
+
+void LogStore::installMessageHandler()
+{
+    if (messageStore.exchange(this) == nullptr) {
+        previousMessageHandler = qInstallMessageHandler(logStoreMessageHandler);
+    }
+}
+
+void LogStore::append(char source, const char *data, int size)
+{
+    if (size > kMaxLineBytes) {
+        size = kMaxLineBytes;
+    }
+    char prefix[32];
+    const int prefixLen = snprintf(prefix, sizeof(prefix), "%lld %c ",
+                                   static_cast<long long>(QDateTime::currentMSecsSinceEpoch()), source);
+
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (pending.size() + prefixLen + size + 1 > kMaxPendingBytes) {
+            droppedLines++;
+            return;
+        }
+        const int start = pending.size() + prefixLen;
+        pending.append(prefix, prefixLen);
+        pending.append(data, size);
+        // 多行内容合并成一行，保证一条记录占一行
+        char *p = pending.data();
+        for (int i = start; i < pending.size(); i++) {
+            if (p[i] == '\n') {
+                p[i] = ' ';
+            }
+        }
+        pending.append('\n');
+        wake = pending.size() >= kBatchBytes;
+    }
+    if (wake) {
+        pendingWakeup.notify_one();
+    }
+}
+
+void LogStore::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(pendingMutex);
+    for (;;) {
+        pendingWakeup.wait_for(lock, std::chrono::milliseconds(flushIntervalMs.load()), [this]() {
+            return stopping || pending.size() >= kBatchBytes;
+        });
+
+        if (!pending.isEmpty() || droppedLines > 0) {
+            QByteArray batch;
+            batch.swap(pending);
+            pending.reserve(kBatchBytes * 2);
+            const qint64 dropped = droppedLines;
+            droppedLines = 0;
+            lock.unlock();
+
+            if (dropped > 0) {
+                batch += QByteArray::number(QDateTime::currentMSecsSinceEpoch()) + " W 日志写入跟不上，丢弃了 "
+                         + QByteArray::number(dropped) + " 行\n";
+            }
+            writeBatch(batch);
+
+            lock.lock();
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    lock.unlock();
+    closeSegment();
+}
+
+void LogStore::writeBatch(const QByteArray &batch)
+{
+    const char *data = batch.constData();
+    const int total = batch.size();
+    int pos = 0;
+    while (pos < total) {
+        if (activeFd < 0 && !openSegment()) {
+            return;     // 打不开新段，丢弃本批
+        }
+
+        int take = total - pos;
+        const qint64 room = segmentBytes - activeUsed;
+        if (take > room) {
+            // 只写入完整的行，剩下的写到下一段
+            int end = pos + static_cast<int>(room);
+            while (end > pos && data[end - 1] != '\n') {
+                end--;
+            }
+            if (end == pos) {
+                if (activeUsed > 0) {
+                    closeSegment();
+                    continue;
+                }
+                end = pos + static_cast<int>(room);
+            }
+            take = end - pos;
+        }
+
+        if (!writeAll(activeFd, data + pos, take, activeUsed)) {
+            // 磁盘满等错误：结束当前段，本批剩余内容丢弃
+            fprintf(stderr, "LogStore: write failed: %s\n", strerror(errno));
+            closeSegment();
+            return;
+        }
+
+        const qint64 firstMs = lineTimestamp(data + pos, data + pos + take);
+        const qint64 lastMs = lastLineTimestamp(data + pos, take);
+        activeUsed += take;
+        pos += take;
+        {
+            std::lock_guard<std::mutex> lock(indexMutex);
+            if (!segments.isEmpty() && segments.last().active) {
+                Segment &seg = segments.last();
+                if (seg.firstMs <= 0) {
+                    seg.firstMs = firstMs;
+                }
+                seg.lastMs = qMax(seg.lastMs, lastMs);
+                seg.bytes = activeUsed;
+            }
+        }
+
+        if (activeUsed >= segmentBytes) {
+            closeSegment();
+        }
+    }
+}
+
+bool LogStore::openSegment()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (openFailedMs > 0 && now - openFailedMs < kOpenRetryMs) {
+        return false;
+    }
+
+    QString fileName;
+    int fd = -1;
+    qint64 nameMs = now;
+    for (int attempt = 0; attempt < 100 && fd < 0; attempt++, nameMs++) {
+        fileName = segmentName(nameMs);
+        fd = ::open(QFile::encodeName(dir + "/" + fileName).constData(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && errno != EEXIST) {
+            break;
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "LogStore: cannot create segment in %s: %s\n", qPrintable(dir), strerror(errno));
+        openFailedMs = now;
+        return false;
+    }
+    openFailedMs = 0;
+
+    // 一次性预分配整段的磁盘块（不改变文件大小），之后的追加写不再分配块；
+    // 文件系统不支持时忽略
+    ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(segmentBytes));
+
+    activeFd = fd;
+    activeUsed = 0;
+
+    Segment seg;
+    seg.fileName = fileName;
+    seg.active = true;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        segments.append(seg);
+    }
+    saveIndex();
+    return true;
+}
+
+// 段写满（或退出）：落盘、写索引、交给压缩线程
+void LogStore::closeSegment()
+{
+    if (activeFd < 0) {
+        return;
+    }
+    ::fdatasync(activeFd);
+    ::close(activeFd);
+    activeFd = -1;
+
+    QString fileName;
+    bool empty = false;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        for (int i = segments.size() - 1; i >= 0; i--) {
+            if (segments[i].active) {
+                fileName = segments[i].fileName;
+                empty = activeUsed == 0;
+                if (empty) {
+                    segments.removeAt(i);
+                } else {
+                    segments[i].active = false;
+                    segments[i].bytes = activeUsed;
+                }
+                break;
+            }
+        }
+    }
+    activeUsed = 0;
+    saveIndex();
+
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (empty) {
+        QFile::remove(dir + "/" + fileName);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(compactMutex);
+        compactQueue.push_back(fileName);
+    }
+    compactWakeup.notify_one();
+}
+
+void LogStore::compactorLoop()
+{
+    setCurrentThreadIdlePriority();
+    enforceBudget();
+
+    for (;;) {
+        QString fileName;
+        {
+            std::unique_lock<std::mutex> lock(compactMutex);
+            compactWakeup.wait(lock, [this]() { return compactStopping || !compactQueue.empty(); });
+            if (compactStopping) {
+                return;
+            }
+            fileName = compactQueue.front();
+            compactQueue.pop_front();
+        }
+        ThermalMonitor::throttleBackgroundWork([this]() {
+            std::lock_guard<std::mutex> lock(compactMutex);
+            return compactStopping;
+        });
+        compressSegment(fileName);
+        enforceBudget();
+    }
+}
+
+void LogStore::compressSegment(const QString &fileName)
+{
+    const QString rawPath = dir + "/" + fileName;
+    QFile raw(rawPath);
+    if (!raw.open(QIODevice::ReadOnly)) {
+        return;     // 已被预算淘汰
+    }
+    const QByteArray data = raw.readAll();
+    raw.close();
+
+    QByteArray compressed;
+    if (!gzipCompress(data, &compressed)) {
+        fprintf(stderr, "LogStore: failed to compress %s\n", qPrintable(fileName));
+        return;
+    }
+
+    // 先写临时文件并落盘，再改名，中途断电不会留下半个压缩段
+    const QString gzName = fileName + ".gz";
+    const QString tmpPath = dir + "/" + gzName + ".tmp";
+    QFile out(tmpPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate) || out.write(compressed) != compressed.size()) {
+        out.close();
+        QFile::remove(tmpPath);
+        return;
+    }
+    out.flush();
+    ::fdatasync(out.handle());
+    out.close();
+    if (::rename(QFile::encodeName(tmpPath).constData(), QFile::encodeName(dir + "/" + gzName).constData()) != 0) {
+        QFile::remove(tmpPath);
+        return;
+    }
+    QFile::remove(rawPath);
+
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        for (int i = 0; i < segments.size(); i++) {
+            if (segments[i].fileName == fileName) {
+                segments[i].fileName = gzName;
+                segments[i].bytes = compressed.size();
+                break;
+            }
+        }
+    }
+    saveIndex();
+}
+
+// 总占用超过预算时从最旧的段开始删除（正在写入的段除外）
+void LogStore::enforceBudget()
+{
+    QStringList removed;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        qint64 total = 0;
+        foreach (const Segment &seg, segments) {
+            total += seg.bytes;
+        }
+        while (total > budgetBytes && !segments.isEmpty() && !segments.first().active) {
+            total -= segments.first().bytes;
+            removed << segments.first().fileName;
+            segments.removeFirst();
+        }
+    }
+    if (removed.isEmpty()) {
+        return;
+    }
+    foreach (const QString &fileName, removed) {
+        QFile::remove(dir + "/" + fileName);
+    }
+    saveIndex();
+}
+
+// index 每行：<文件名> <首条记录毫秒> <末条记录毫秒> <磁盘字节数>
+// 只是加速查询用的缓存，丢失时可以从段文件重建，因此不 fsync
+void LogStore::saveIndex()
+{
+    std::lock_guard<std::mutex> lock(indexMutex);
+    QByteArray text;
+    foreach (const Segment &seg, segments) {
+        text += QFile::encodeName(seg.fileName) + ' ' + QByteArray::number(seg.firstMs) + ' '
+                + QByteArray::number(seg.lastMs) + ' ' + QByteArray::number(seg.bytes) + '\n';
+    }
+    const QString tmpPath = dir + "/index.tmp";
+    QFile file(tmpPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(text) != text.size()) {
+        return;
+    }
+    file.close();
+    ::rename(QFile::encodeName(tmpPath).constData(), QFile::encodeName(dir + "/index").constData());
+}
+
+// 启动时读取索引并与目录内容核对；上次运行未压缩的段交给压缩线程
+void LogStore::loadIndex()
+{
+    QDir root(dir);
+    foreach (const QString &tmpName, root.entryList(QStringList() << "*.tmp", QDir::Files)) {
+        root.remove(tmpName);
+    }
+
+    QMap<QString, Segment> known;
+    QFile indexFile(root.filePath("index"));
+    if (indexFile.open(QIODevice::ReadOnly)) {
+        foreach (const QByteArray &line, indexFile.readAll().split('\n')) {
+            const QList<QByteArray> fields = line.split(' ');
+            if (fields.size() != 4) {
+                continue;
+            }
+            Segment seg;
+            seg.fileName = QFile::decodeName(fields[0]);
+            seg.firstMs = fields[1].toLongLong();
+            seg.lastMs = fields[2].toLongLong();
+            known.insert(seg.fileName, seg);
+        }
+        indexFile.close();
+    }
+
+    // 文件名中是 13 位毫秒时间戳，按名称排序即按时间排序
+    const QStringList files = root.entryList(QStringList() << "seg-*.log" << "seg-*.log.gz",
+                                             QDir::Files, QDir::Name);
+    foreach (const QString &fileName, files) {
+        const QFileInfo info(root.filePath(fileName));
+        const bool compressed = fileName.endsWith(".gz");
+        if (!compressed && files.contains(fileName + ".gz")) {
+            // 压缩完成后、删除原文件前断电
+            root.remove(fileName);
+            continue;
+        }
+
+        Segment seg = known.value(fileName);
+        seg.fileName = fileName;
+        seg.bytes = info.size();
+        seg.active = false;
+
+        if (!compressed) {
+            // 上次退出时正在写入的段：索引中的范围可能过时，从文件首尾重新读取
+            QFile file(info.filePath());
+            if (seg.bytes == 0 || !file.open(QIODevice::ReadOnly)) {
+                root.remove(fileName);
+                continue;
+            }
+            const QByteArray head = file.read(32);
+            file.seek(qMax<qint64>(0, seg.bytes - (kMaxLineBytes + 64)));
+            const QByteArray tail = file.readAll();
+            file.close();
+            seg.firstMs = lineTimestamp(head.constData(), head.constData() + head.size());
+            seg.lastMs = lastLineTimestamp(tail.constData(), tail.size());
+            compactQueue.push_back(fileName);
+        } else if (!known.contains(fileName)) {
+            // 索引丢失：用创建时间和修改时间估计范围
+            seg.firstMs = segmentNameMs(fileName) - kFlushIntervalMs;
+            seg.lastMs = info.lastModified().toMSecsSinceEpoch();
+        }
+        segments.append(seg);
+    }
+    saveIndex();
+}
+
+bool LogStore::readSegment(const QString &path, QByteArray *data)
+{
+    if (!path.endsWith(".gz")) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        *data = file.readAll();
+        return true;
+    }
+
+    gzFile gz = gzopen(QFile::encodeName(path).constData(), "rb");
+    if (!gz) {
+        return false;
+    }
+    data->clear();
+    char buf[64 * 1024];
+    int n;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) {
+        data->append(buf, n);
+    }
+    gzclose(gz);
+    return n == 0;
+}
+
+QByteArray LogStore::query(qint64 fromMs, qint64 toMs, int maxBytes, bool *truncated) const
+{
+    *truncated = false;
+    QStringList candidates;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        foreach (const Segment &seg, segments) {
+            if (seg.firstMs > 0 && seg.firstMs <= toMs && seg.lastMs >= fromMs) {
+                candidates << seg.fileName;
+            }
+        }
+    }
+
+    QByteArray out;
+    foreach (const QString &fileName, candidates) {
+        QByteArray data;
+        const QString path = dir + "/" + fileName;
+        // 查询期间段可能刚好被压缩
+        if (!readSegment(path, &data) && !(!fileName.endsWith(".gz") && readSegment(path + ".gz", &data))) {
+            continue;
+        }
+
+        // 系统时钟可能在开机同步时跳变，记录不一定严格按时间排列，所以整段扫描
+        const char *p = data.constData();
+        const char *end = p + data.size();
+        while (p < end) {
+            const char *nl = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char *lineEnd = nl ? nl + 1 : end;
+            const qint64 ts = lineTimestamp(p, lineEnd);
+            if (ts >= fromMs && ts <= toMs) {
+                if (out.size() + (lineEnd - p) > maxBytes) {
+                    *truncated = true;
+                    return out;
+                }
+                out.append(p, static_cast<int>(lineEnd - p));
+            }
+            p = lineEnd;
+        }
+    }
+    return out;
+}
+
+QByteArray LogStore::tail(int lineCount) const
+{
+    QByteArray recent;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        recent = pending;
+    }
+    QStringList newestFirst;
+    {
+        std::lock_guard<std::mutex> lock(indexMutex);
+        for (int i = segments.size() - 1; i >= 0; i--) {
+            newestFirst << segments[i].fileName;
+        }
+    }
+
+    // 从最新的段往前读，直到凑够行数
+    QList<QByteArray> chunks;
+    chunks.prepend(recent);
+    int lines = recent.count('\n');
+    foreach (const QString &fileName, newestFirst) {
+        if (lines >= lineCount) {
+            break;
+        }
+        QByteArray data;
+        const QString path = dir + "/" + fileName;
+        if (!readSegment(path, &data) && !(!fileName.endsWith(".gz") && readSegment(path + ".gz", &data))) {
+            continue;
+        }
+        lines += data.count('\n');
+        chunks.prepend(data);
+    }
+
+    QByteArray all;
+    foreach (const QByteArray &chunk, chunks) {
+        all += chunk;
+    }
+    int start = all.size();
+    if (start > 0 && all[start - 1] == '\n') {
+        start--;
+    }
+    for (int found = 0; start > 0; start--) {
+        if (all[start - 1] == '\n' && ++found == lineCount) {
+            break;
+        }
+    }
+    return all.mid(start);
+}
@@ -0,0 +1,105 @@
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+// SD 卡友好的分段日志存储
+//
+// 监控程序自身的日志（qDebug 等）和 QT 端的输出都追加到内存缓冲区，由后台线程
+// 攒够一批（或每隔几秒）后一次 pwrite 写入当前段。段文件创建时用 fallocate 预分配
+// 固定大小，写入过程中不再分配块；只在段写满切换时 fdatasync 一次。
+// 写满的段由另一个空闲优先级线程压缩成 gzip（可以直接 zcat 查看），
+// 总占用超过预算时删除最旧的段。
+//
+// 每条记录一行：<毫秒时间戳> <来源> <内容>
+//   来源：D/I/W/E/F 为监控程序的 debug/info/warning/critical/fatal，Q 为 QT 端输出
+//
+// 目录中的 index 文件记录每个段的时间范围，按时间查询时只读取相关的段。
+class LogStore : public QObject
+{
+    Q_OBJECT
+public:
+    LogStore(const QString &dir, qint64 segmentBytes, qint64 budgetBytes, QObject *parent = nullptr);
+    ~LogStore();
+
+    // 追加一行（不含换行符），可在任意线程调用
+    void append(char source, const char *data, int size);
+
+    // 攒批刷盘的最长间隔，运行中可以修改
+    void setFlushInterval(int ms) { flushIntervalMs.store(ms); }
+
+    // 把 qDebug 等输出同时写入本存储，原有的输出方式保持不变
+    void installMessageHandler();
+
+    // 读取时间范围 [fromMs, toMs] 内的记录，结果超过 maxBytes 时截断并置 *truncated。
+    // 只包含已经写到磁盘的内容（最多落后一个刷新周期）。会读取/解压文件，不要在事件循环中调用。
+    QByteArray query(qint64 fromMs, qint64 toMs, int maxBytes, bool *truncated) const;
+
+    // 最近的 lineCount 行，包括还在内存中未写盘的部分
+    QByteArray tail(int lineCount) const;
+
+    QString directory() const { return dir; }
+
+private:
+    struct Segment
+    {
+        QString fileName;       // seg-<创建时间毫秒>.log，压缩后加 .gz
+        qint64 firstMs = 0;
+        qint64 lastMs = 0;
+        qint64 bytes = 0;       // 磁盘占用（压缩后为压缩大小）
+        bool active = false;    // 正在写入
+    };
+
+    void writerLoop();
+    void writeBatch(const QByteArray &batch);
+    bool openSegment();
+    void closeSegment();
+
+    void compactorLoop();
+    void compressSegment(const QString &fileName);
+    void enforceBudget();
+
+    void loadIndex();
+    void saveIndex();
+    static bool readSegment(const QString &path, QByteArray *data);
+
+    QString dir;
+    const qint64 segmentBytes;
+    const qint64 budgetBytes;
+
+    // 写入缓冲区（append 与写线程之间）
+    mutable std::mutex pendingMutex;
+    std::condition_variable pendingWakeup;
+    QByteArray pending;
+    qint64 droppedLines = 0;    // 写线程跟不上时丢弃的行数
+    std::atomic<int> flushIntervalMs;
+    bool stopping = false;
+
+    // 当前段（只在写线程中访问）
+    int activeFd = -1;
+    qint64 activeUsed = 0;
+    qint64 openFailedMs = 0;    // 上次创建段失败的时间，之后一段时间内不再重试
+
+    // 段列表，按时间升序（写线程、压缩线程和查询共用）
+    mutable std::mutex indexMutex;
+    QList<Segment> segments;
+
+    // 待压缩的段
+    std::mutex compactMutex;
+    std::condition_variable compactWakeup;
+    std::deque<QString> compactQueue;
+    bool compactStopping = false;
+
+    std::thread writer;
+    std::thread compactor;
+};
+
+#endif // LOGSTORE_H
@@ -0,0 +1,121 @@
+#include "looplagprobe.h"
+#include "tracer.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+
+static const int kTickIntervalMs = 100;
+static const int kMaxStalls = 16;
+
+LoopLagProbe::LoopLagProbe(QObject *parent) :
+    QObject(parent), expectedNs(0), thresholdNs(200 * 1000000LL)
+{
+    Tracer::markLoopThread();
+
+    timer.setSingleShot(true);
+    timer.setTimerType(Qt::PreciseTimer);
+    connect(&timer, &QTimer::timeout, this, &LoopLagProbe::tick);
+    arm();
+
+    watchdog = std::thread(&LoopLagProbe::watchdogLoop, this);
+}
+
+LoopLagProbe::~LoopLagProbe()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (watchdog.joinable()) {
+        watchdog.join();
+    }
+}
+
+void LoopLagProbe::setStallThreshold(int milliseconds)
+{
+    thresholdNs = static_cast<qint64>(milliseconds) * 1000000LL;
+    wakeup.notify_all();
+}
+
+void LoopLagProbe::arm()
+{
+    expectedNs = Tracer::nowNs() + kTickIntervalMs * 1000000LL;
+    timer.start(kTickIntervalMs);
+}
+
+void LoopLagProbe::tick()
+{
+    const qint64 expected = expectedNs.load();
+    const qint64 lagUs = std::max<qint64>(0, (Tracer::nowNs() - expected) / 1000);
+    const char *handler = nullptr;
+    {
+        // 看门狗可能在读到上一次的预定时间之后、本次触发处理完之后才写入，这样的记录不属于本次，丢弃
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stallHandlerExpectedNs == expected) {
+            handler = stallHandler;
+        }
+        stallHandler = nullptr;
+        stallHandlerExpectedNs = 0;
+    }
+    arm();
+
+    histogram.record(lagUs);
+
+    if (lagUs < thresholdNs.load() / 1000) {
+        return;
+    }
+    Stall stall;
+    stall.timeMs = QDateTime::currentMSecsSinceEpoch();
+    stall.lagUs = lagUs;
+    stall.handler = handler ? QString::fromLatin1(handler) : QString("unknown");
+    stalls.prepend(stall);
+    if (stalls.size() > kMaxStalls) {
+        stalls.removeLast();
+    }
+    stallCount++;
+
+    Tracer::instant("loop_stall", stall.handler);
+    qDebug() << "事件循环卡顿：" << lagUs / 1000 << "ms，处理函数" << stall.handler;
+    emit stallDetected(lagUs, stall.handler);
+}
+
+LoopLagProbe::Stats LoopLagProbe::stats() const
+{
+    Stats result;
+    result.samples = histogram.count();
+    result.p50Us = histogram.percentile(50);
+    result.p90Us = histogram.percentile(90);
+    result.p99Us = histogram.percentile(99);
+    result.maxUs = histogram.max();
+    result.stalls = stallCount;
+    return result;
+}
+
+// 事件循环迟迟不触发时，趁处理函数还在运行记下它的名称
+void LoopLagProbe::watchdogLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        const qint64 threshold = thresholdNs.load();
+        wakeup.wait_for(lock, std::chrono::nanoseconds(threshold / 2));
+        if (stopping) {
+            return;
+        }
+        const qint64 expected = expectedNs.load();
+        if (expected == 0 || Tracer::nowNs() - expected < threshold) {
+            continue;
+        }
+        // 每次触发只记第一次看到的处理函数
+        if (stallHandlerExpectedNs == expected) {
+            continue;
+        }
+        const char *scope = Tracer::currentLoopScope();
+        if (scope) {
+            stallHandler = scope;
+            stallHandlerExpectedNs = expected;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef LOOPLAGPROBE_H
+#define LOOPLAGPROBE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "latencyhistogram.h"
+
+// 事件循环延迟探针
+//
+// 监控程序的所有处理函数都跑在主线程的事件循环里，其中任何一个阻塞（同步等待进程、大文件读写）
+// 都会让 QT 端状态检查、WebSocket 消息和控制通道一起卡住。这里用一个 PreciseTimer 每 100 ms
+// 触发一次，比较预定时间和实际触发时间，差值即事件循环延迟，计入 LatencyHistogram。
+//
+// 卡顿归因：另有一个看门狗线程每半个阈值检查一次，若预定时间已过去超过阈值仍未触发，
+// 读取 Tracer::currentLoopScope()（主线程上最内层的 TraceSpan）作为正在运行的处理函数，
+// 并记下它属于哪一次触发（预定时间），触发时只认属于本次的记录。
+// 本次触发的延迟超过阈值时记为一次卡顿，保留最近 16 次，并写一个 loop_stall 追踪事件。
+class LoopLagProbe : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stall
+    {
+        qint64 timeMs = 0;            // 发生时间（毫秒时间戳）
+        qint64 lagUs = 0;
+        QString handler;              // 看门狗看到的处理函数，未能归因时为 "unknown"
+    };
+
+    struct Stats
+    {
+        qint64 samples = 0;
+        qint64 p50Us = 0;             // 百分位取所在桶的上界
+        qint64 p90Us = 0;
+        qint64 p99Us = 0;
+        qint64 maxUs = 0;
+        qint64 stalls = 0;
+    };
+
+    // 必须在事件循环线程上构造
+    explicit LoopLagProbe(QObject *parent = nullptr);
+    ~LoopLagProbe();
+
+    void setStallThreshold(int milliseconds);
+
+    Stats stats() const;
+    // 最近的卡顿，从新到旧
+    QVector<Stall> recentStalls() const { return stalls; }
+
+signals:
+    void stallDetected(qint64 lagUs, const QString &handler);
+
+private:
+    void tick();
+    void arm();
+    void watchdogLoop();
+
+    QTimer timer;
+    LatencyHistogram histogram;
+    qint64 stallCount = 0;
+    QVector<Stall> stalls;
+
+    std::atomic<qint64> expectedNs;            // 下一次触发的预定时间，0 表示未布置
+    std::atomic<qint64> thresholdNs;
+
+    std::thread watchdog;
+    std::mutex mutex;
+    // 看门狗记下的处理函数，连同它所属那次触发的预定时间，由 mutex 保护
+    const char *stallHandler = nullptr;
+    qint64 stallHandlerExpectedNs = 0;
+    std::condition_variable wakeup;
+    bool stopping = false;
+};
+
+#endif // LOOPLAGPROBE_H
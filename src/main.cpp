@@ -1,52 +1,185 @@
 #include <QCoreApplication>
 #include <QCommandLineParser>
 #include <QCommandLineOption>
+#include <QDebug>
 #include <sys/prctl.h>
 #include "quarcsmonitor.h"
+#include "startuptrace.h"
+#include "controlprotocol.h"
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <vector>
+
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+
+// 抽象套接字任何用户都可以占用：只有对端是 root 或同一用户时才认为已有实例在运行，
+// 与 ControlServer::acceptClients 的检查一致
+static bool controlSocketHeldByInstance()
+{
+    const int fd = ControlProtocol::connectToDaemon();
+    if (fd < 0) {
+        return false;
+    }
+    struct ucred cred = {};
+    socklen_t credLen = sizeof(cred);
+    const bool trusted = ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == 0
+                         && (cred.uid == 0 || cred.uid == ::getuid());
+    if (!trusted) {
+        qDebug() << "控制套接字被其他用户的进程占用（uid" << cred.uid << "），不视为已有实例";
+    }
+    ::close(fd);
+    return trusted;
+}
 
 // 使用简单的锁文件机制，保证同一时间只有一个管理进程实例在运行。
 // 如果已有实例持有锁文件，本次启动会直接退出。
 // 锁文件放在 /tmp 下，避免权限问题。
+// 使用 flock 而不是 fcntl 记录锁：flock 锁属于打开的文件描述，fork 后由子进程继续持有，
+// 因此可以在守护进程化之前加锁。
 static int createSingleInstanceLock()
 {
     const char *lockPath = "/tmp/QUARCS_QMANAGE.lock";
-    int fd = ::open(lockPath, O_RDWR | O_CREAT, 0644);
+    int fd = ::open(lockPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
     if (fd < 0) {
         // 打不开锁文件时，不强行退出，允许继续运行（以免因权限问题完全起不来）
         return -1;
     }
 
-    struct flock fl;
-    fl.l_type   = F_WRLCK;
-    fl.l_whence = SEEK_SET;
-    fl.l_start  = 0;
-    fl.l_len    = 0;
-    fl.l_pid    = getpid();
-
-    if (fcntl(fd, F_SETLK, &fl) < 0) {
+    if (::flock(fd, LOCK_EX | LOCK_NB) < 0) {
         // 上锁失败，说明已有其他进程持有锁 -> 视为已有实例在运行
         ::close(fd);
         return -1;
     }
 
-    // 写入当前 PID（仅用于调试/查看）
-    ::ftruncate(fd, 0);
+    // 注意：不要关闭 fd，进程退出时由内核自动关闭并释放文件锁
+    return fd;
+}
+
+// 写入当前 PID（仅用于调试/查看），守护进程化之后 PID 会变化，需要在最后写
+static void writeLockPid(int lockFd)
+{
+    ::ftruncate(lockFd, 0);
     char buf[32];
     int len = ::snprintf(buf, sizeof(buf), "%d\n", getpid());
     if (len > 0) {
-        ::write(fd, buf, static_cast<size_t>(len));
+        ::pwrite(lockFd, buf, static_cast<size_t>(len), 0);
     }
+}
 
-    // 注意：不要关闭 fd，进程退出时由内核自动关闭并释放文件锁
-    return fd;
+// 关闭所有 >= first 的描述符（keepFd 除外）。
+// 优先使用 close_range()，内核不支持时遍历 /proc/self/fd，
+// 避免从 sysconf(_SC_OPEN_MAX) 逐个 close 造成上百万次系统调用。
+static void closeFdRange(int first, int keepFd)
+{
+    bool ok = true;
+    if (keepFd < first) {
+        ok = ::syscall(SYS_close_range, first, ~0U, 0) == 0;
+    } else {
+        if (keepFd > first) {
+            ok = ::syscall(SYS_close_range, first, keepFd - 1, 0) == 0;
+        }
+        ok = ok && ::syscall(SYS_close_range, keepFd + 1, ~0U, 0) == 0;
+    }
+    if (ok) {
+        return;
+    }
+
+    DIR *dir = ::opendir("/proc/self/fd");
+    if (!dir) {
+        return;
+    }
+    std::vector<int> fds;
+    const int dirFd = ::dirfd(dir);
+    struct dirent *entry;
+    while ((entry = ::readdir(dir)) != nullptr) {
+        const int fd = ::atoi(entry->d_name);
+        if (entry->d_name[0] != '.' && fd >= first && fd != keepFd && fd != dirFd) {
+            fds.push_back(fd);
+        }
+    }
+    ::closedir(dir);
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+// 守护进程化，在创建任何 Qt 对象之前完成
+static void daemonize(int lockFd)
+{
+    // 创建子进程
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        // fork失败
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid > 0) {
+        // 父进程退出
+        _exit(EXIT_SUCCESS);
+    }
+
+    // 创建新会话，成为会话首进程
+    setsid();
+
+    // 忽略某些信号
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+
+    // 再次fork，确保进程不能获取终端
+    pid = fork();
+
+    if (pid < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid > 0) {
+        _exit(EXIT_SUCCESS);
+    }
+
+    // 更改工作目录
+    chdir("/");
+
+    // 重定向标准输入输出到/dev/null
+    int nullFd = ::open("/dev/null", O_RDWR);
+    if (nullFd >= 0) {
+        ::dup2(nullFd, STDIN_FILENO);
+        ::dup2(nullFd, STDOUT_FILENO);
+        ::dup2(nullFd, STDERR_FILENO);
+    }
+
+    // 关闭其余所有文件描述符（保留单实例锁）
+    closeFdRange(STDERR_FILENO + 1, lockFd);
 }
 
 int main(int argc, char *argv[])
 {
+    StartupTrace::begin();
+
+    // 在创建任何 Qt 对象之前确定是否需要守护进程化：
+    // --normal/--foreground 以及 --help/--version（需要把输出打印到终端）都不做 fork。
+    // 由 systemd 以 Type=notify 启动时（设置了 NOTIFY_SOCKET）同样保持前台运行，
+    // 否则 systemd 跟踪的主进程会在 fork 后立即退出。
+    bool normalMode = !qgetenv("NOTIFY_SOCKET").isEmpty();
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "-n") || !strcmp(arg, "--normal")
+            || !strcmp(arg, "-f") || !strcmp(arg, "--foreground")
+            || !strcmp(arg, "-h") || !strcmp(arg, "--help") || !strcmp(arg, "-?")
+            || !strcmp(arg, "-v") || !strcmp(arg, "--version")) {
+            normalMode = true;
+        }
+    }
+
     // 单实例保护：如果已有管理进程在运行，则本次直接退出
     int lockFd = createSingleInstanceLock();
     if (lockFd < 0) {
@@ -54,6 +187,18 @@ int main(int argc, char *argv[])
         // 但在 daemon 模式下一般是静默退出。
         return 0;
     }
+    // 锁文件可能被 /tmp 清理删掉：再确认一次控制套接字上没有正在运行的实例
+    if (controlSocketHeldByInstance()) {
+        return 0;
+    }
+    StartupTrace::mark(StartupTrace::Lock);
+
+    if (!normalMode) {
+        // 守护进程模式 - 默认模式
+        daemonize(lockFd);
+    }
+    writeLockPid(lockFd);
+    StartupTrace::mark(StartupTrace::Fork);
 
     QCoreApplication a(argc, argv);
     a.setApplicationName("QMANAGE");
@@ -63,78 +208,24 @@ int main(int argc, char *argv[])
     parser.setApplicationDescription("QUARCS process monitor");
     parser.addHelpOption();
     parser.addVersionOption();
-    
+
     // Add normal mode option
-    QCommandLineOption normalOption(QStringList() << "n" << "normal", 
+    QCommandLineOption normalOption(QStringList() << "n" << "normal",
                                    "Run in normal mode (not as daemon)");
     parser.addOption(normalOption);
-    
+
+    // Foreground mode for service managers (same as normal mode)
+    QCommandLineOption foregroundOption(QStringList() << "f" << "foreground",
+                                       "Run in foreground under a service manager (no self-fork)");
+    parser.addOption(foregroundOption);
+
     // Process the command line arguments
     parser.process(a);
-    
-    // Check if normal mode is requested (default is daemon mode)
-    bool normalMode = parser.isSet(normalOption);
-    
-    if (!normalMode) {
-        // 守护进程模式 - 默认模式
-        
-        // 创建子进程
-        pid_t pid = fork();
-        
-        if (pid < 0) {
-            // fork失败
-            exit(EXIT_FAILURE);
-        }
-        
-        if (pid > 0) {
-            // 父进程退出
-            exit(EXIT_SUCCESS);
-        }
-        
-        // 创建新会话，成为会话首进程
-        setsid();
-        
-        // 忽略某些信号
-        signal(SIGCHLD, SIG_IGN);
-        signal(SIGHUP, SIG_IGN);
-        
-        // 再次fork，确保进程不能获取终端
-        pid = fork();
-        
-        if (pid < 0) {
-            exit(EXIT_FAILURE);
-        }
-        
-        if (pid > 0) {
-            exit(EXIT_SUCCESS);
-        }
-        
-        // 更改工作目录
-        chdir("/");
-        
-        // 关闭所有文件描述符
-        for (int i = sysconf(_SC_OPEN_MAX); i >= 0; i--) {
-            close(i);
-        }
-        
-        // 重定向标准输入输出到/dev/null
-        open("/dev/null", O_RDWR);
-        dup(0);
-        dup(0);
-        
-        // 设置进程名
-        prctl(PR_SET_NAME, "QMANAGE");
-        
-        // 重新初始化Qt应用（因为在daemon流程中可能已经关闭了文件描述符）
-        int dummy_argc = 1;
-        char *dummy_argv[] = {(char*)"QMANAGE", nullptr};
-        QCoreApplication b(dummy_argc, dummy_argv);
-        QuarcsMonitor monitor;
-        return b.exec();
-    } else {
-        // 普通模式 - 需要使用--normal参数
-        prctl(PR_SET_NAME, "QMANAGE");
-        QuarcsMonitor monitor;
-        return a.exec();
-    }
-}
\ No newline at end of file
+
+    // 设置进程名
+    prctl(PR_SET_NAME, "QMANAGE");
+    StartupTrace::mark(StartupTrace::QtInit);
+
+    QuarcsMonitor monitor;
+    return a.exec();
+}
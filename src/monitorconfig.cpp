@@ -0,0 +1,231 @@
+#include "monitorconfig.h"
+#include "inotifywatcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QDebug>
+#include <cmath>
+#include <sys/inotify.h>
+
+bool MonitorConfig::parse(const QByteArray &json, const MonitorConfig &defaults, MonitorConfig *out, QString *error)
+{
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(json, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        *error = QString("JSON 格式错误（偏移 %1）：%2").arg(parseError.offset).arg(parseError.errorString());
+        return false;
+    }
+    if (!doc.isObject()) {
+        *error = "顶层必须是 JSON 对象";
+        return false;
+    }
+
+    const QJsonObject obj = doc.object();
+    MonitorConfig cfg = defaults;
+    QStringList errors;
+    QStringList known;
+
+    auto readString = [&](const char *key, bool absolutePath, QString *value) {
+        known << key;
+        if (!obj.contains(key)) {
+            return;
+        }
+        const QJsonValue v = obj.value(key);
+        if (!v.isString()) {
+            errors << QString("%1 必须是字符串").arg(key);
+        } else if (absolutePath && !v.toString().isEmpty() && !QDir::isAbsolutePath(v.toString())) {
+            errors << QString("%1 必须是绝对路径").arg(key);
+        } else {
+            *value = v.toString();
+        }
+    };
+    auto readInt64 = [&](const char *key, qint64 min, qint64 max, qint64 *value) {
+        known << key;
+        if (!obj.contains(key)) {
+            return;
+        }
+        const QJsonValue v = obj.value(key);
+        const double d = v.toDouble();
+        if (!v.isDouble() || d != std::floor(d)) {
+            errors << QString("%1 必须是整数").arg(key);
+        } else if (d < min || d > max) {
+            errors << QString("%1 超出范围 [%2, %3]").arg(key).arg(min).arg(max);
+        } else {
+            *value = static_cast<qint64>(d);
+        }
+    };
+    auto readInt = [&](const char *key, int min, int max, int *value) {
+        qint64 v = *value;
+        readInt64(key, min, max, &v);
+        *value = static_cast<int>(v);
+    };
+    auto readBool = [&](const char *key, bool *value) {
+        known << key;
+        if (!obj.contains(key)) {
+            return;
+        }
+        if (!obj.value(key).isBool()) {
+            errors << QString("%1 必须是 true 或 false").arg(key);
+        } else {
+            *value = obj.value(key).toBool();
+        }
+    };
+
+    const qint64 mb = 1024LL * 1024;
+    readString("clientPath", true, &cfg.clientPath);
+    readString("clientWorkDir", true, &cfg.clientWorkDir);
+    readString("updatePackPath", true, &cfg.updatePackPath);
+    readString("qtServerInstallDir", true, &cfg.qtServerInstallDir);
+    readString("websocketUrl", false, &cfg.websocketUrl);
+    readInt("websocketPort", 1, 65535, &cfg.websocketPort);
+    readString("logDir", true, &cfg.logDir);
+    readString("crashDir", true, &cfg.crashDir);
+    readString("packageStoreDir", true, &cfg.packageStoreDir);
+    readString("stateJournalPath", true, &cfg.stateJournalPath);
+    readInt64("logSegmentBytes", 64 * 1024, 256 * mb, &cfg.logSegmentBytes);
+    readInt64("logBudgetBytes", mb, 64 * 1024 * mb, &cfg.logBudgetBytes);
+    readInt64("preStageBudgetBytes", 0, 1024 * 1024 * mb, &cfg.preStageBudgetBytes);
+    readBool("stagedInstall", &cfg.stagedInstall);
+    readBool("privilegedHelper", &cfg.privilegedHelper);
+    readString("thermalSysfsRoot", true, &cfg.thermalSysfsRoot);
+
+    readInt("restartTimeoutSecs", 5, 600, &cfg.restartTimeoutSecs);
+    readInt("restartDelayMs", 0, 60000, &cfg.restartDelayMs);
+    readInt("monitorIntervalMs", 100, 10000, &cfg.monitorIntervalMs);
+    readInt("testSignalThrottleSecs", 0, 3600, &cfg.testSignalThrottleSecs);
+    readInt("networkMaxRetries", 1, 1000, &cfg.networkMaxRetries);
+    readInt("networkRetryIntervalMs", 100, 600000, &cfg.networkRetryIntervalMs);
+    readBool("squashSequentialUpdates", &cfg.squashSequentialUpdates);
+    readBool("pruneStoredPackages", &cfg.pruneStoredPackages);
+    readString("logLevel", false, &cfg.logLevel);
+    readInt("logFlushIntervalMs", 100, 60000, &cfg.logFlushIntervalMs);
+    readInt("logQueryMaxBytes", 4096, 4 * 1024 * 1024, &cfg.logQueryMaxBytes);
+    readInt("thermalWarmCelsius", 40, 110, &cfg.thermalWarmCelsius);
+    readInt("thermalHotCelsius", 40, 110, &cfg.thermalHotCelsius);
+    readInt("loopStallThresholdMs", 20, 10000, &cfg.loopStallThresholdMs);
+    readBool("reliableMessages", &cfg.reliableMessages);
+    readInt("messageAckTimeoutMs", 100, 60000, &cfg.messageAckTimeoutMs);
+    readInt("messageMaxRetransmits", 0, 20, &cfg.messageMaxRetransmits);
+
+    if (cfg.clientPath.isEmpty()) {
+        errors << "clientPath 不能为空";
+    }
+    if (cfg.updatePackPath.isEmpty()) {
+        errors << "updatePackPath 不能为空";
+    }
+    if (cfg.logLevel != "debug" && cfg.logLevel != "info" && cfg.logLevel != "warning") {
+        errors << "logLevel 必须是 debug、info 或 warning";
+    }
+    if (cfg.thermalHotCelsius <= cfg.thermalWarmCelsius) {
+        errors << "thermalHotCelsius 必须大于 thermalWarmCelsius";
+    }
+    if (!errors.isEmpty()) {
+        *error = errors.join("；");
+        return false;
+    }
+
+    // 未知的项只提示，方便新旧版本共用一份配置文件
+    foreach (const QString &key, obj.keys()) {
+        if (!known.contains(key)) {
+            qDebug() << "配置文件：忽略未知项" << key;
+        }
+    }
+
+    if (!cfg.updatePackPath.endsWith('/')) {
+        cfg.updatePackPath += '/';
+    }
+    *out = cfg;
+    return true;
+}
+
+QStringList MonitorConfig::restartRequiredChanges(const MonitorConfig &other) const
+{
+    QStringList changed;
+    if (clientPath != other.clientPath) changed << "clientPath";
+    if (clientWorkDir != other.clientWorkDir) changed << "clientWorkDir";
+    if (updatePackPath != other.updatePackPath) changed << "updatePackPath";
+    if (qtServerInstallDir != other.qtServerInstallDir) changed << "qtServerInstallDir";
+    if (websocketUrl != other.websocketUrl) changed << "websocketUrl";
+    if (websocketPort != other.websocketPort) changed << "websocketPort";
+    if (logDir != other.logDir) changed << "logDir";
+    if (crashDir != other.crashDir) changed << "crashDir";
+    if (packageStoreDir != other.packageStoreDir) changed << "packageStoreDir";
+    if (stateJournalPath != other.stateJournalPath) changed << "stateJournalPath";
+    if (logSegmentBytes != other.logSegmentBytes) changed << "logSegmentBytes";
+    if (logBudgetBytes != other.logBudgetBytes) changed << "logBudgetBytes";
+    if (preStageBudgetBytes != other.preStageBudgetBytes) changed << "preStageBudgetBytes";
+    if (stagedInstall != other.stagedInstall) changed << "stagedInstall";
+    if (privilegedHelper != other.privilegedHelper) changed << "privilegedHelper";
+    if (thermalSysfsRoot != other.thermalSysfsRoot) changed << "thermalSysfsRoot";
+    return changed;
+}
+
+ConfigStore::ConfigStore(const QString &path, QObject *parent) :
+    QObject(parent), filePath(path), snapshot(std::make_shared<MonitorConfig>())
+{
+    reload();   // 首次加载失败时使用默认值
+
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(200);
+    connect(&reloadTimer, &QTimer::timeout, this, [this]() {
+        const std::shared_ptr<const MonitorConfig> previous = current();
+        if (reload()) {
+            emit changed(previous);
+        }
+    });
+
+    // 监听目录而不是文件：文件被删除、改名替换后仍然能收到事件
+    const QFileInfo info(filePath);
+    QDir().mkpath(info.absolutePath());
+    watcher = new InotifyWatcher(this);
+    if (watcher->addWatch(info.absolutePath(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        qDebug() << "配置文件：无法监听" << info.absolutePath() << "，修改后需重启 QMANAGE";
+    }
+    const QString fileName = info.fileName();
+    connect(watcher, &InotifyWatcher::fileEvent, this, [this, fileName](int, quint32, const QString &name) {
+        if (name == fileName) {
+            reloadTimer.start();
+        }
+    });
+    connect(watcher, &InotifyWatcher::overflowed, &reloadTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+}
+
+std::shared_ptr<const MonitorConfig> ConfigStore::current() const
+{
+    return std::atomic_load(&snapshot);
+}
+
+QString ConfigStore::defaultPath()
+{
+    const QByteArray env = qgetenv("QUARCS_CONFIG");
+    if (!env.isEmpty()) {
+        return QString::fromLocal8Bit(env);
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation) + "/qmanage.json";
+}
+
+bool ConfigStore::reload()
+{
+    // 每次都从默认值开始解析：从文件中删掉的项恢复为默认值
+    MonitorConfig cfg;
+    QFile file(filePath);
+    if (file.exists()) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            qDebug() << "配置文件：无法读取" << filePath << "，保留当前配置";
+            return false;
+        }
+        QString error;
+        if (!MonitorConfig::parse(file.readAll(), MonitorConfig(), &cfg, &error)) {
+            qDebug() << "配置文件无效，保留当前配置:" << filePath << error;
+            return false;
+        }
+        qDebug() << "配置文件已加载:" << filePath;
+    }
+
+    std::atomic_store(&snapshot, std::shared_ptr<const MonitorConfig>(new MonitorConfig(cfg)));
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef MONITORCONFIG_H
+#define MONITORCONFIG_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+class InotifyWatcher;
+
+// 监控程序配置
+//
+// 从 JSON 文件解析一次，得到只读的快照；文件修改后重新解析，校验通过才整体替换，
+// 任何一项不合法都保留原来的快照。文件不存在时使用默认值。
+//
+// 分两类：
+//   启动项：与 QT 端进程、目录、连接绑定，修改后要重启 QMANAGE 才生效（会同时重启 QT 端）
+//   运行项：超时、重试、节流、日志级别、刷盘间隔等，修改后立即生效，不影响正在运行的 QT 端
+struct MonitorConfig
+{
+    // ---- 启动项 ----
+    QString clientPath = "/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram/src/BUILD/client";
+    QString clientWorkDir;                  // 为空时为 clientPath 所在目录
+    QString updatePackPath = "/var/www/update_pack/";
+    QString qtServerInstallDir = "/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram";
+    QString websocketUrl;                   // 为空时自动探测本机 IP
+    int websocketPort = 8600;               // 自动探测时使用的端口
+    QString logDir;                         // 为空时使用 ~/.local/share/QMANAGE/logs
+    QString crashDir;                       // 为空时使用 ~/.local/share/QMANAGE/crashes
+    QString packageStoreDir;                // 更新包去重存储，为空时使用 ~/.local/share/QMANAGE/package-store（不放在 Web 目录下）
+    QString stateJournalPath;               // 顺序更新状态日志，为空时使用 ~/.local/share/QMANAGE/state.journal
+    qint64 logSegmentBytes = 4LL * 1024 * 1024;
+    qint64 logBudgetBytes = 64LL * 1024 * 1024;
+    qint64 preStageBudgetBytes = 1024LL * 1024 * 1024;
+    bool stagedInstall = false;             // A/B 暂存安装，需要 Update.sh 支持 QUARCS_INSTALL_ROOT
+    bool privilegedHelper = true;           // 启动时通过一次 sudo 拉起常驻特权助手，代替每次操作的 sudo
+    QString thermalSysfsRoot = "/sys";      // 读取温度与降频状态的 sysfs 根目录，测试时可指向假文件；为空时不做温控
+
+    // ---- 运行项 ----
+    int restartTimeoutSecs = 30;            // 重启后等待 QT 端起来的超时
+    int restartDelayMs = 3000;              // 结束旧进程到启动新进程之间的等待
+    int monitorIntervalMs = 1000;           // 进程状态检查间隔
+    int testSignalThrottleSecs = 30;        // testQtServerProcess 检测信号的节流间隔
+    int networkMaxRetries = 20;             // 探测本机 IP 的最大重试次数
+    int networkRetryIntervalMs = 5000;
+    bool squashSequentialUpdates = true;    // 多个待更新包时只解压一次最终文件树
+    bool pruneStoredPackages = false;       // 已安装过的旧版本 zip 入库后删除，需要时从去重存储中取（删除后存储是唯一副本）
+    QString logLevel = "debug";             // debug / info / warning
+    int logFlushIntervalMs = 2000;          // 日志存储的攒批刷盘间隔
+    int logQueryMaxBytes = 512 * 1024;      // getLogs 单次返回的最大字节数
+    int thermalWarmCelsius = 70;            // 达到后放慢后台工作（预解压、入库、回收、日志压缩）
+    int thermalHotCelsius = 80;             // 达到后暂停后台工作，降温后继续
+    int loopStallThresholdMs = 200;         // 事件循环延迟超过这个值记为一次卡顿并归因到处理函数
+    bool reliableMessages = true;           // 发往前端的消息带 msgid，对端确认后统计往返时间、超时重发关键消息
+    int messageAckTimeoutMs = 2000;         // 等待确认的时间，之后每次重发间隔翻倍
+    int messageMaxRetransmits = 5;          // 关键消息的最多重发次数
+
+    // 解析 JSON，未出现的项保持 defaults 中的值；失败时返回 false 并给出原因
+    static bool parse(const QByteArray &json, const MonitorConfig &defaults, MonitorConfig *out, QString *error);
+
+    // 与 other 相比有变化、但需要重启才能生效的项名称
+    QStringList restartRequiredChanges(const MonitorConfig &other) const;
+};
+
+// 配置文件的加载与热更新
+//
+// 监听配置文件所在目录（编辑器通常写临时文件再改名），文件变化后稍等片刻再重新加载，
+// 新快照通过 std::atomic_store 替换，其它线程随时可以用 current() 拿到完整一致的一份。
+class ConfigStore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConfigStore(const QString &path, QObject *parent = nullptr);
+
+    std::shared_ptr<const MonitorConfig> current() const;
+    QString path() const { return filePath; }
+
+    // 默认配置文件路径：QUARCS_CONFIG 环境变量，否则 ~/.config/QMANAGE/qmanage.json
+    static QString defaultPath();
+
+signals:
+    // 新快照已生效；previous 为替换前的快照
+    void changed(std::shared_ptr<const MonitorConfig> previous);
+
+private:
+    bool reload();
+
+    QString filePath;
+    std::shared_ptr<const MonitorConfig> snapshot;
+    InotifyWatcher *watcher = nullptr;
+    QTimer reloadTimer;         // 合并一次保存产生的多个事件
+};
+
+#endif // MONITORCONFIG_H
@@ -0,0 +1,256 @@
+#include "packageindex.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+#include <QDebug>
+#include <sys/inotify.h>
+
+static const quint64 kComponentLimit = (1ULL << 21);
+static const quint64 kMajorLimit = (1ULL << 22);
+
+static quint64 makeVersionKey(quint64 major, quint64 minor, quint64 patch)
+{
+    return (major << 42) | (minor << 21) | patch;
+}
+
+PackageIndex::PackageIndex(const QString &packDir, QObject *parent) :
+    QObject(parent), dirPath(packDir)
+{
+    watcher = new InotifyWatcher(this);
+    connect(watcher, &InotifyWatcher::fileEvent, this, &PackageIndex::onFileEvent);
+    connect(watcher, &InotifyWatcher::overflowed, this, &PackageIndex::rescan);
+
+    watchDirectory();
+    rescan();
+}
+
+quint64 PackageIndex::parseVersionKey(const QString &versionStr, bool &ok)
+{
+    ok = false;
+
+    const QString v = versionStr.trimmed();
+    if (v.isEmpty())
+        return 0;
+
+    // 优先解析 x.y.z 语义化版本
+    const QStringList parts = v.split('.');
+    if (parts.size() == 3)
+    {
+        bool ok1 = false, ok2 = false, ok3 = false;
+        const qulonglong major = parts[0].toULongLong(&ok1);
+        const qulonglong minor = parts[1].toULongLong(&ok2);
+        const qulonglong patch = parts[2].toULongLong(&ok3);
+
+        if (ok1 && ok2 && ok3
+            && major < kMajorLimit && minor < kComponentLimit && patch < kComponentLimit)
+        {
+            ok = true;
+            return makeVersionKey(major, minor, patch);
+        }
+        return 0;
+    }
+
+    // 回退到纯数字版本（兼容老版本）
+    bool okInt = false;
+    const qulonglong val = v.toULongLong(&okInt);
+    if (okInt && val / 1000000 < kMajorLimit)
+    {
+        ok = true;
+        return makeVersionKey(val / 1000000, (val / 1000) % 1000, val % 1000);
+    }
+
+    return 0;
+}
+
+QString PackageIndex::versionFromFileName(const QString &fileName)
+{
+    // 从最后一个 '.' 之前截取，得到完整的 "1.0.2" 部分，再去掉 "-" 之后的附加信息
+    QString baseName = fileName;
+    const int lastDotIndex = baseName.lastIndexOf('.');
+    if (lastDotIndex > 0) {
+        baseName = baseName.left(lastDotIndex);
+    }
+    return baseName.split("-").at(0);
+}
+
+PackageIndex::PackageInfo PackageIndex::find(const QString &version) const
+{
+    bool ok = false;
+    const quint64 key = parseVersionKey(version, ok);
+    if (!ok) {
+        return PackageInfo();
+    }
+    return packages.value(key);
+}
+
+PackageIndex::PackageInfo PackageIndex::highest() const
+{
+    if (packages.isEmpty()) {
+        return PackageInfo();
+    }
+    return packages.last();
+}
+
+QList<PackageIndex::PackageInfo> PackageIndex::newerThan(quint64 key) const
+{
+    QList<PackageInfo> result;
+    for (auto it = packages.upperBound(key); it != packages.constEnd(); ++it) {
+        result.append(it.value());
+    }
+    return result;
+}
+
+QList<PackageIndex::PackageInfo> PackageIndex::all() const
+{
+    return packages.values();
+}
+
+void PackageIndex::addStored(const PackageInfo &info)
+{
+    PackageInfo stored = info;
+    stored.inStore = true;
+    storedFiles.insert(stored.fileName, stored);
+
+    // zip 仍在目录中时继续以 zip 为准
+    if (!fileKeys.contains(stored.fileName) && !packages.contains(stored.key)) {
+        packages.insert(stored.key, stored);
+    }
+}
+
+void PackageIndex::watchDirectory()
+{
+    QDir dir(dirPath);
+    if (!dir.exists() && !dir.mkpath(dirPath)) {
+        qDebug() << "【错误】无法创建更新包目录：" << dirPath;
+    }
+
+    watchDescriptor = watcher->addWatch(dirPath,
+                                        IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM
+                                        | IN_DELETE_SELF | IN_MOVE_SELF);
+    if (watchDescriptor < 0) {
+        qDebug() << "无法监听更新包目录，5 秒后重试：" << dirPath;
+        QTimer::singleShot(5000, this, [this]() {
+            watchDirectory();
+            rescan();
+        });
+    }
+}
+
+void PackageIndex::rescan()
+{
+    packages.clear();
+    fileKeys.clear();
+
+    QDir dir(dirPath);
+    dir.setNameFilters(QStringList() << "*.zip");
+    foreach (const QString &file, dir.entryList(QDir::Files, QDir::Name)) {
+        addFile(file);
+    }
+    foreach (const PackageInfo &info, storedFiles) {
+        if (!packages.contains(info.key)) {
+            packages.insert(info.key, info);
+        }
+    }
+    qDebug() << "更新包索引重建完成，共" << packages.size() << "个版本";
+}
+
+void PackageIndex::addFile(const QString &fileName)
+{
+    if (!fileName.endsWith(".zip")) {
+        return;
+    }
+
+    const QString version = versionFromFileName(fileName);
+    bool ok = false;
+    const quint64 key = parseVersionKey(version, ok);
+    if (!ok) {
+        qDebug() << "更新包索引：无法解析版本号，忽略文件" << fileName;
+        return;
+    }
+    fileKeys.insert(fileName, key);
+
+    // 同一版本存在多个文件时，保留文件名排序靠前的那一个
+    auto existing = packages.constFind(key);
+    if (existing != packages.constEnd() && existing.value().fileName != fileName
+        && existing.value().fileName < fileName && !existing.value().inStore) {
+        return;
+    }
+
+    const QFileInfo fileInfo(QDir(dirPath).filePath(fileName));
+    PackageInfo info;
+    info.key = key;
+    info.version = version;
+    info.fileName = fileName;
+    info.size = fileInfo.size();
+    info.modified = fileInfo.lastModified();
+    packages.insert(key, info);
+
+    emit packageAdded(info);
+}
+
+void PackageIndex::removeFile(const QString &fileName)
+{
+    auto keyIt = fileKeys.find(fileName);
+    if (keyIt == fileKeys.end()) {
+        return;
+    }
+    const quint64 key = keyIt.value();
+    fileKeys.erase(keyIt);
+
+    auto it = packages.find(key);
+    if (it == packages.end() || it.value().fileName != fileName) {
+        return;
+    }
+    packages.erase(it);
+
+    // 如果还有同版本的其它文件，让它补位
+    QString replacement;
+    for (auto f = fileKeys.constBegin(); f != fileKeys.constEnd(); ++f) {
+        if (f.value() == key && (replacement.isEmpty() || f.key() < replacement)) {
+            replacement = f.key();
+        }
+    }
+    if (!replacement.isEmpty()) {
+        emit packageRemoved(fileName);
+        addFile(replacement);
+        return;
+    }
+
+    // zip 被删除但内容仍在去重存储中：版本保持可用，只是改为从存储中取
+    auto stored = storedFiles.constFind(fileName);
+    if (stored != storedFiles.constEnd()) {
+        packages.insert(key, stored.value());
+        return;
+    }
+    emit packageRemoved(fileName);
+}
+
+void PackageIndex::onFileEvent(int wd, quint32 mask, const QString &name)
+{
+    if (wd != watchDescriptor) {
+        return;
+    }
+
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        // 目录本身被删除或替换，重新建立监听并全量扫描
+        qDebug() << "更新包目录被删除或移动，重新建立索引";
+        watcher->removeWatch(watchDescriptor);
+        watchDescriptor = -1;
+        packages.clear();
+        fileKeys.clear();
+        QTimer::singleShot(1000, this, [this]() {
+            watchDirectory();
+            rescan();
+        });
+        return;
+    }
+
+    if (mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        // 文件写入完成或移入：先移除旧记录再重新加入，刷新大小和时间
+        removeFile(name);
+        addFile(name);
+    } else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+        removeFile(name);
+    }
+}
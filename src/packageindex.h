@@ -0,0 +1,81 @@
+#ifndef PACKAGEINDEX_H
+#define PACKAGEINDEX_H
+
+#include <QObject>
+#include <QMap>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QDateTime>
+
+#include "inotifywatcher.h"
+
+// 更新包目录（UpdatePackPath）的常驻索引
+//
+// 启动时扫描一次目录，之后只根据 inotify 事件增量维护，版本检查等热路径
+// 上不再访问文件系统。版本号统一转换为 64 位可比较的键（见 parseVersionKey），
+// 按键有序保存，查找为 O(log n)。
+class PackageIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct PackageInfo
+    {
+        quint64 key = 0;          // 可比较的版本键
+        QString version;          // 文件名中的版本号字符串，例如 1.0.2
+        QString fileName;         // 例如 1.0.2.zip 或 1.0.2-beta.zip
+        qint64 size = 0;
+        QDateTime modified;
+        bool inStore = false;     // 原 zip 已删除，只能从去重存储（ChunkStore）中取回
+
+        bool isValid() const { return !fileName.isEmpty(); }
+    };
+
+    explicit PackageIndex(const QString &packDir, QObject *parent = nullptr);
+
+    // 将版本号字符串转换为可比较的 64 位键：
+    //  - x.y.z：(x << 42) | (y << 21) | z，每段最大 2^21-1，x 最大 2^22-1
+    //  - 纯数字（兼容旧版本号，如 20251127）：按旧规则拆成 N/1e6、N/1e3%1e3、N%1e3
+    //    三段后同样编码，保持与旧整数版本号之间原有的比较顺序
+    static quint64 parseVersionKey(const QString &versionStr, bool &ok);
+
+    // 从文件名中提取版本号：1.0.2.zip、1.0.2-suffix.zip -> 1.0.2
+    static QString versionFromFileName(const QString &fileName);
+
+    PackageInfo find(const QString &version) const;
+    PackageInfo highest() const;
+    // 按版本升序返回所有版本键大于 key 的更新包
+    QList<PackageInfo> newerThan(quint64 key) const;
+    QList<PackageInfo> all() const;
+    int count() const { return packages.size(); }
+
+    QString directory() const { return dirPath; }
+
+    // 登记一个已经完整保存在去重存储中的更新包：对应的 zip 被删除后该版本仍保留在索引中，
+    // 此时 find() 等返回的 PackageInfo::inStore 为 true
+    void addStored(const PackageInfo &info);
+
+    // 丢弃当前索引并重新扫描目录（inotify 队列溢出或目录被替换时使用）
+    void rescan();
+
+signals:
+    void packageAdded(const PackageIndex::PackageInfo &info);
+    void packageRemoved(const QString &fileName);
+
+private slots:
+    void onFileEvent(int wd, quint32 mask, const QString &name);
+
+private:
+    void addFile(const QString &fileName);
+    void removeFile(const QString &fileName);
+    void watchDirectory();
+
+    QString dirPath;
+    QMap<quint64, PackageInfo> packages;   // 版本键 -> 更新包
+    QHash<QString, quint64> fileKeys;      // 目录中所有可解析的 zip 文件 -> 版本键（含同版本重复文件）
+    QHash<QString, PackageInfo> storedFiles;   // 去重存储中的更新包（文件名 -> 信息）
+    InotifyWatcher *watcher = nullptr;
+    int watchDescriptor = -1;
+};
+
+#endif // PACKAGEINDEX_H
@@ -0,0 +1,280 @@
+#include "prestager.h"
+#include "zipreader.h"
+#include "backgroundpriority.h"
+#include "thermalmonitor.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QCryptographicHash>
+#include <QDebug>
+
+PreStager::PreStager(const QString &packDir, const QString &stageRoot, qint64 budgetBytes,
+                     QObject *parent) :
+    QObject(parent), packDir(packDir), stageRoot(stageRoot), budgetBytes(budgetBytes)
+{
+    QDir().mkpath(stageRoot);
+    loadExisting();
+    worker = std::thread(&PreStager::workerLoop, this);
+}
+
+PreStager::~PreStager()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+// 读取上一次运行留下的暂存树信息，清理未完成的临时目录
+void PreStager::loadExisting()
+{
+    QDir root(stageRoot);
+    foreach (const QString &tmpDir, root.entryList(QStringList() << "*.tmp", QDir::Dirs)) {
+        QDir(root.filePath(tmpDir)).removeRecursively();
+    }
+
+    foreach (const QString &infoName, root.entryList(QStringList() << "*.json", QDir::Files)) {
+        QFile infoFile(root.filePath(infoName));
+        if (!infoFile.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QJsonObject obj = QJsonDocument::fromJson(infoFile.readAll()).object();
+        infoFile.close();
+
+        StagedTree tree;
+        tree.dirName = infoName.left(infoName.size() - 5);
+        tree.fileName = obj["file"].toString();
+        tree.zipSize = static_cast<qint64>(obj["zipSize"].toDouble());
+        tree.zipModified = static_cast<qint64>(obj["zipModified"].toDouble());
+        tree.treeBytes = static_cast<qint64>(obj["treeBytes"].toDouble());
+        tree.lastUsed = static_cast<qint64>(obj["lastUsed"].toDouble());
+
+        const QString version = obj["version"].toString();
+        if (version.isEmpty() || !QDir(root.filePath(tree.dirName)).exists()) {
+            QFile::remove(root.filePath(infoName));
+            continue;
+        }
+        staged.insert(version, tree);
+    }
+
+    if (!staged.isEmpty()) {
+        qDebug() << "预解压：复用已有暂存树" << staged.keys();
+    }
+}
+
+void PreStager::enqueue(const PackageIndex::PackageInfo &info)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = staged.constFind(info.version);
+        if (it != staged.constEnd() && it.value().fileName == info.fileName
+            && it.value().zipSize == info.size
+            && it.value().zipModified == info.modified.toMSecsSinceEpoch()) {
+            return;
+        }
+        for (const PackageIndex::PackageInfo &queued : queue) {
+            if (queued.fileName == info.fileName) {
+                return;
+            }
+        }
+        queue.push_back(info);
+    }
+    wakeup.notify_one();
+}
+
+QString PreStager::discard(const QString &fileName)
+{
+    QString removeDir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = staged.begin(); it != staged.end(); ++it) {
+            if (it.value().fileName == fileName) {
+                removeDir = it.value().dirName;
+                staged.erase(it);
+                break;
+            }
+        }
+    }
+    if (removeDir.isEmpty()) {
+        return QString();
+    }
+    QFile::remove(QDir(stageRoot).filePath(removeDir + ".json"));
+    return QDir(stageRoot).filePath(removeDir);
+}
+
+bool PreStager::hasStaged(const PackageIndex::PackageInfo &info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = staged.constFind(info.version);
+    return it != staged.constEnd() && it.value().fileName == info.fileName
+           && it.value().zipSize == info.size
+           && it.value().zipModified == info.modified.toMSecsSinceEpoch();
+}
+
+QString PreStager::takeStaged(const PackageIndex::PackageInfo &info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = staged.find(info.version);
+    if (it == staged.end()) {
+        return QString();
+    }
+
+    // 只比较大小和修改时间：内容哈希已经体现在目录名中，文件没变就无需重算
+    const StagedTree tree = it.value();
+    if (tree.fileName != info.fileName || tree.zipSize != info.size
+        || tree.zipModified != info.modified.toMSecsSinceEpoch()) {
+        return QString();
+    }
+
+    staged.erase(it);
+    QFile::remove(QDir(stageRoot).filePath(tree.dirName + ".json"));
+    return QDir(stageRoot).filePath(tree.dirName);
+}
+
+void PreStager::workerLoop()
+{
+    setCurrentThreadIdlePriority();
+
+    while (true) {
+        PackageIndex::PackageInfo info;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            info = queue.front();
+            queue.pop_front();
+        }
+        ThermalMonitor::throttleBackgroundWork([this]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stopping;
+        });
+        stagePackage(info);
+    }
+}
+
+void PreStager::stagePackage(const PackageIndex::PackageInfo &info)
+{
+    const QString zipPath = QDir(packDir).filePath(info.fileName);
+
+    // 1. 计算内容哈希，作为暂存树名称的一部分
+    QFile zipFile(zipPath);
+    if (!zipFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(&zipFile);
+    zipFile.close();
+    const QString contentHash = QString::fromLatin1(hash.result().toHex());
+    const QString dirName = info.version + "-" + contentHash.left(16);
+
+    QDir root(stageRoot);
+    const QString finalDir = root.filePath(dirName);
+    const QString tmpDir = finalDir + ".tmp";
+    QDir(tmpDir).removeRecursively();
+
+    // 2. 解压（逐条目校验 CRC32），写到临时目录，完成后再改名，保证暂存树总是完整的
+    ZipReader reader(zipPath);
+    if (!reader.open() || !reader.extractAll(tmpDir)) {
+        qDebug() << "预解压失败:" << info.fileName << reader.errorString();
+        QDir(tmpDir).removeRecursively();
+        return;
+    }
+    qint64 treeBytes = 0;
+    foreach (const ZipEntry &entry, reader.entries()) {
+        treeBytes += static_cast<qint64>(entry.uncompressedSize);
+    }
+    reader.close();
+
+    QDir(finalDir).removeRecursively();
+    if (!QDir().rename(tmpDir, finalDir)) {
+        QDir(tmpDir).removeRecursively();
+        return;
+    }
+
+    StagedTree tree;
+    tree.dirName = dirName;
+    tree.fileName = info.fileName;
+    tree.zipSize = info.size;
+    tree.zipModified = info.modified.toMSecsSinceEpoch();
+    tree.treeBytes = treeBytes;
+    tree.lastUsed = QDateTime::currentMSecsSinceEpoch();
+
+    QJsonObject obj;
+    obj["version"] = info.version;
+    obj["file"] = tree.fileName;
+    obj["sha256"] = contentHash;
+    obj["zipSize"] = static_cast<double>(tree.zipSize);
+    obj["zipModified"] = static_cast<double>(tree.zipModified);
+    obj["treeBytes"] = static_cast<double>(tree.treeBytes);
+    obj["lastUsed"] = static_cast<double>(tree.lastUsed);
+    QFile infoFile(root.filePath(dirName + ".json"));
+    if (infoFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        infoFile.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+        infoFile.close();
+    }
+
+    QString replacedDir;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto old = staged.constFind(info.version);
+        if (old != staged.constEnd() && old.value().dirName != dirName) {
+            replacedDir = old.value().dirName;
+        }
+        staged.insert(info.version, tree);
+    }
+    if (!replacedDir.isEmpty()) {
+        QFile::remove(root.filePath(replacedDir + ".json"));
+        QDir(root.filePath(replacedDir)).removeRecursively();
+    }
+
+    qDebug() << "预解压完成:" << info.fileName << "->" << dirName << "，" << treeBytes << "字节";
+
+    evictOverBudget(dirName);
+}
+
+// 暂存树总大小超过预算时，按最近使用时间从旧到新淘汰
+void PreStager::evictOverBudget(const QString &keepDirName)
+{
+    QStringList evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        qint64 total = 0;
+        for (auto it = staged.constBegin(); it != staged.constEnd(); ++it) {
+            total += it.value().treeBytes;
+        }
+
+        while (total > budgetBytes && !staged.isEmpty()) {
+            auto victim = staged.end();
+            for (auto it = staged.begin(); it != staged.end(); ++it) {
+                if (it.value().dirName == keepDirName && staged.size() > 1) {
+                    continue;
+                }
+                if (victim == staged.end() || it.value().lastUsed < victim.value().lastUsed) {
+                    victim = it;
+                }
+            }
+            if (victim == staged.end()) {
+                break;
+            }
+            total -= victim.value().treeBytes;
+            evicted.append(victim.value().dirName);
+            staged.erase(victim);
+        }
+    }
+
+    QDir root(stageRoot);
+    foreach (const QString &dirName, evicted) {
+        qDebug() << "预解压：超出磁盘预算，淘汰暂存树" << dirName;
+        QFile::remove(root.filePath(dirName + ".json"));
+        QDir(root.filePath(dirName)).removeRecursively();
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef PRESTAGER_H
+#define PRESTAGER_H
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QDateTime>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include "packageindex.h"
+
+// 更新包后台预解压
+//
+// 新更新包到达时在后台线程（空闲 CPU/IO 优先级）中校验并解压到
+// <stageRoot>/<版本号>-<内容哈希前 16 位>/，用户点击更新时直接把暂存树移到
+// update/ 目录，完全跳过解压。暂存树总大小超过预算时按最近使用时间淘汰。
+//
+// 暂存树旁边的 <名称>.json 记录来源 zip 的大小、修改时间和哈希，
+// 监控程序重启后可以继续复用；查找时只比较大小和修改时间，不重新计算哈希。
+class PreStager : public QObject
+{
+    Q_OBJECT
+public:
+    PreStager(const QString &packDir, const QString &stageRoot, qint64 budgetBytes,
+              QObject *parent = nullptr);
+    ~PreStager();
+
+    // 把更新包加入后台预解压队列（已暂存或已在队列中的会被忽略）
+    void enqueue(const PackageIndex::PackageInfo &info);
+    // 更新包被删除或替换时丢弃对应的暂存树：移出缓存并返回树的路径，由调用方删除
+    // （交给回收线程，不在主线程上同步删除）；没有对应的暂存树时返回空字符串
+    QString discard(const QString &fileName);
+
+    // 如果 info 对应的更新包已经暂存且内容未变，返回暂存树路径并将其移出缓存
+    // （调用方负责把其中的内容移走）；否则返回空字符串
+    QString takeStaged(const PackageIndex::PackageInfo &info);
+    // 与 takeStaged 的判断相同，但不取走
+    bool hasStaged(const PackageIndex::PackageInfo &info);
+
+private:
+    struct StagedTree
+    {
+        QString dirName;          // <版本号>-<哈希>
+        QString fileName;         // 来源 zip 文件名
+        qint64 zipSize = 0;
+        qint64 zipModified = 0;   // 毫秒时间戳
+        qint64 treeBytes = 0;     // 解压后的总字节数
+        qint64 lastUsed = 0;
+    };
+
+    void workerLoop();
+    void stagePackage(const PackageIndex::PackageInfo &info);
+    void loadExisting();
+    void evictOverBudget(const QString &keepDirName);
+
+    QString packDir;
+    QString stageRoot;
+    const qint64 budgetBytes;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<PackageIndex::PackageInfo> queue;
+    QMap<QString, StagedTree> staged;     // 版本号 -> 暂存树
+    bool stopping = false;
+    std::thread worker;
+};
+
+#endif // PRESTAGER_H
@@ -0,0 +1,363 @@
+#include "privhelper.h"
+#include "helperprotocol.h"
+#include "tracer.h"
+
+#include <QSocketNotifier>
+#include <QMetaObject>
+#include <QDebug>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <vector>
+
+extern char **environ;
+
+static const int kShutdownWaitMs = 500;
+
+PrivHelper::PrivHelper(QObject *parent) : QObject(parent)
+{
+}
+
+PrivHelper::~PrivHelper()
+{
+    // 关闭套接字后助手会等正在运行的脚本结束再退出
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool PrivHelper::start(const QString &helperPath, const QString &packDir, const QString &shadowDir)
+{
+    TraceSpan span("privhelper_start");
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+        qDebug() << "特权助手：无法创建 socketpair:" << strerror(errno);
+        return false;
+    }
+
+    QList<QByteArray> args;
+    if (::geteuid() != 0) {
+        args << "sudo" << "-n";     // 不能交互输入密码，没有免密 sudo 时直接失败
+    }
+    args << helperPath.toLocal8Bit();
+    std::vector<char *> argv;
+    for (QByteArray &arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    pid_t child = 0;
+    const int rc = posix_spawnp(&child, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(fds[1]);
+    if (rc != 0) {
+        qDebug() << "特权助手：无法启动" << helperPath << ":" << strerror(rc);
+        ::close(fds[0]);
+        return false;
+    }
+
+    fd = fds[0];
+    pid = child;
+    running = true;
+
+    // sudo 拒绝或助手启动失败时套接字会被关闭，探测请求得不到应答。
+    // 助手的白名单目录由 root 配置，探测请求带上本进程使用的目录，不一致时不使用助手
+    int code = -1;
+    QByteArray roots = packDir.toLocal8Bit();
+    roots += '\0';
+    roots += shadowDir.toLocal8Bit();
+    const quint32 ping = send(HelperProtocol::Ping, roots);
+    if (ping && waitForReply(ping, 5000, &code) && code == EPERM) {
+        qDebug() << "特权助手：" << helperPath << "配置的目录与" << packDir << shadowDir
+                 << "不一致（见 /etc/qmanage/helper.conf），继续使用 sudo 执行特权操作";
+        shutdown();
+        return false;
+    }
+    if (code != 0) {
+        qDebug() << "特权助手：" << helperPath << "没有应答（需要免密 sudo），继续使用 sudo 执行特权操作";
+        shutdown();
+        return false;
+    }
+
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &PrivHelper::onReadable);
+    qDebug() << "特权助手：已启动，pid" << pid;
+    return true;
+}
+
+quint32 PrivHelper::writeSysfs(const QByteArray &path, const QByteArray &value)
+{
+    QByteArray payload = path;
+    payload += '\0';
+    payload += value;
+    return send(HelperProtocol::WriteSysfs, payload);
+}
+
+quint32 PrivHelper::runScript(bool stagedInstall)
+{
+    const char flags = stagedInstall ? HelperProtocol::ScriptStagedInstall : 0;
+    return send(HelperProtocol::RunScript, QByteArray(1, flags));
+}
+
+quint32 PrivHelper::cleanDir(const QString &path, std::function<void(int code)> done)
+{
+    const quint32 requestId = send(HelperProtocol::CleanDir, path.toLocal8Bit());
+    if (requestId && done) {
+        cleanCallbacks.insert(requestId, done);
+    }
+    return requestId;
+}
+
+quint32 PrivHelper::copyShadow()
+{
+    return send(HelperProtocol::CopyShadow, QByteArray());
+}
+
+double PrivHelper::averageRoundTripUs() const
+{
+    return completedCount ? totalRoundTripNs / 1000.0 / completedCount : 0.0;
+}
+
+quint32 PrivHelper::send(char kind, const QByteArray &payload)
+{
+    if (!running.load()) {
+        return 0;
+    }
+    const quint32 requestId = nextRequestId++;
+    const std::string frame = HelperProtocol::encodeFrame(kind, requestId, payload.constData(),
+                                                          static_cast<size_t>(payload.size()));
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        Pending &entry = pending[requestId];
+        entry.kind = kind;
+        entry.sentNs = Tracer::nowNs();
+    }
+
+    // 请求帧很小，阻塞写入；加锁保证 LED 线程与主线程的帧不会交错
+    std::lock_guard<std::mutex> lock(sendMutex);
+    const char *p = frame.data();
+    size_t size = frame.size();
+    while (size > 0) {
+        const ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // 助手已退出；未完成的请求由读端发现 EOF 后统一结束
+            std::lock_guard<std::mutex> pendingLock(pendingMutex);
+            pending.remove(requestId);
+            return 0;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return requestId;
+}
+
+// 读取当前可读的数据；返回 false 表示助手已关闭连接
+bool PrivHelper::readAvailable()
+{
+    char buf[16384];
+    for (;;) {
+        const ssize_t n = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0) {
+            input.append(buf, static_cast<int>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+void PrivHelper::takeReplies(QList<Reply> *replies)
+{
+    while (input.size() >= HelperProtocol::HeaderSize) {
+        Reply reply;
+        uint32_t requestId;
+        uint32_t size;
+        HelperProtocol::decodeHeader(input.constData(), &reply.kind, &requestId, &size);
+        if (size > HelperProtocol::MaxReplyBytes) {
+            qDebug() << "特权助手：应答格式错误，断开连接";
+            input.clear();
+            ::shutdown(fd, SHUT_RDWR);
+            return;
+        }
+        if (static_cast<uint32_t>(input.size()) < HelperProtocol::HeaderSize + size) {
+            return;
+        }
+        reply.requestId = requestId;
+        reply.payload = input.mid(HelperProtocol::HeaderSize, static_cast<int>(size));
+        input.remove(0, HelperProtocol::HeaderSize + static_cast<int>(size));
+        replies->append(reply);
+    }
+}
+
+// 同步等待某个请求完成；期间收到的其它应答暂存，回到事件循环后按顺序发出，避免在调用方内部重入
+bool PrivHelper::waitForReply(quint32 requestId, int timeoutMs, int *code)
+{
+    const qint64 deadlineNs = Tracer::nowNs() + static_cast<qint64>(timeoutMs) * 1000000;
+    bool found = false;
+    bool open = true;
+    while (!found && open) {
+        const qint64 remainingMs = (deadlineNs - Tracer::nowNs()) / 1000000;
+        if (remainingMs <= 0) {
+            break;
+        }
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (::poll(&pfd, 1, static_cast<int>(remainingMs)) <= 0) {
+            continue;
+        }
+        open = readAvailable();
+
+        QList<Reply> replies;
+        takeReplies(&replies);
+        foreach (const Reply &reply, replies) {
+            if (!found && reply.requestId == requestId && reply.kind == HelperProtocol::Done
+                && reply.payload.size() >= 8) {
+                *code = static_cast<qint32>(HelperProtocol::readUint32(reply.payload.constData()));
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                pending.remove(requestId);
+                found = true;
+            } else {
+                deferred.append(reply);
+            }
+        }
+    }
+
+    if (!deferred.isEmpty() && notifier) {
+        QMetaObject::invokeMethod(this, [this]() { deliverDeferred(); }, Qt::QueuedConnection);
+    }
+    if (!open) {
+        if (notifier) {
+            QMetaObject::invokeMethod(this, [this]() { onReadable(); }, Qt::QueuedConnection);
+        }
+    }
+    return found;
+}
+
+void PrivHelper::deliver(const Reply &reply)
+{
+    if (reply.kind == HelperProtocol::ScriptOutput) {
+        emit scriptOutput(reply.requestId, reply.payload);
+        return;
+    }
+    if (reply.kind != HelperProtocol::Done || reply.payload.size() < 8) {
+        return;
+    }
+
+    Pending entry;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        entry = pending.take(reply.requestId);
+    }
+    const int code = static_cast<qint32>(HelperProtocol::readUint32(reply.payload.constData()));
+    const bool crashed = HelperProtocol::readUint32(reply.payload.constData() + 4) != 0;
+
+    if (entry.kind != HelperProtocol::RunScript && entry.kind != HelperProtocol::CopyShadow && entry.sentNs) {
+        completedCount++;
+        totalRoundTripNs += Tracer::nowNs() - entry.sentNs;
+    }
+    if (code != 0 && (entry.kind == HelperProtocol::WriteSysfs || entry.kind == HelperProtocol::CleanDir)) {
+        qDebug() << "特权助手：请求" << reply.requestId << "失败:" << strerror(code);
+    }
+    const std::function<void(int)> done = cleanCallbacks.take(reply.requestId);
+    emit finished(reply.requestId, code, crashed);
+    if (done) {
+        done(code);
+    }
+}
+
+void PrivHelper::deliverDeferred()
+{
+    while (!deferred.isEmpty()) {
+        deliver(deferred.takeFirst());
+    }
+}
+
+void PrivHelper::onReadable()
+{
+    if (fd < 0) {
+        return;
+    }
+    // 先发出同步等待期间暂存的应答，保持顺序
+    deliverDeferred();
+
+    const bool open = readAvailable();
+    QList<Reply> replies;
+    takeReplies(&replies);
+    foreach (const Reply &reply, replies) {
+        deliver(reply);
+    }
+    if (open) {
+        return;
+    }
+
+    qDebug() << "特权助手：已退出，之后的特权操作改用 sudo";
+    QList<quint32> unfinished;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        unfinished = pending.keys();
+    }
+    shutdown();
+    foreach (quint32 requestId, unfinished) {
+        const std::function<void(int)> done = cleanCallbacks.take(requestId);
+        emit finished(requestId, -1, true);
+        if (done) {
+            done(-1);
+        }
+    }
+}
+
+void PrivHelper::shutdown()
+{
+    running = false;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        if (notifier) {
+            notifier->setEnabled(false);
+            notifier->deleteLater();
+            notifier = nullptr;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.clear();
+    }
+    if (pid > 0) {
+        // 助手已经关闭了连接，通常已经退出；仍在运行（例如 sudo 卡住）时结束它。
+        // 在主线程上执行，SIGTERM 后最多等 kShutdownWaitMs，仍不退出时 SIGKILL
+        const pid_t child = static_cast<pid_t>(pid);
+        if (::waitpid(child, nullptr, WNOHANG) == 0) {
+            ::kill(child, SIGTERM);
+            bool exited = false;
+            for (int waitedMs = 0; !exited && waitedMs < kShutdownWaitMs; waitedMs += 10) {
+                ::usleep(10000);
+                exited = ::waitpid(child, nullptr, WNOHANG) != 0;
+            }
+            if (!exited) {
+                qDebug() << "特权助手：pid" << pid << "没有响应 SIGTERM，强制结束";
+                if (::kill(child, SIGKILL) == 0) {
+                    ::waitpid(child, nullptr, 0);
+                }
+            }
+        }
+        pid = 0;
+    }
+}
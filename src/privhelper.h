@@ -0,0 +1,96 @@
+#ifndef PRIVHELPER_H
+#define PRIVHELPER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+class QSocketNotifier;
+
+// 常驻特权助手（qmanagehelper，协议见 helperprotocol.h）的客户端
+//
+// 启动时通过一次 `sudo -n` 拉起助手（本进程已是 root 时直接启动），之后 LED 写入、
+// Update.sh、目录清理和影子目录复制都变成 socketpair 上的一帧请求，不再每次 fork sudo
+// （sudo 每次都要读 sudoers、查 PAM、写审计日志，在树莓派上要几十毫秒）。
+// 助手起不来（没有免密 sudo、程序不存在）时 isRunning() 为 false，调用方继续使用原来的 sudo 方式。
+//
+// 请求只写入套接字、不等待结果，可以连续发送；结果在主线程通过 finished 发出。
+// 只有启动时的探测请求同步等待应答。writeSysfs 可以在任意线程调用，其余函数只在主线程调用。
+class PrivHelper : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PrivHelper(QObject *parent = nullptr);
+    ~PrivHelper();
+
+    // 启动助手并等待它应答探测请求；packDir / shadowDir 必须与助手由 root 配置的目录一致，
+    // 否则返回 false
+    bool start(const QString &helperPath, const QString &packDir, const QString &shadowDir);
+    bool isRunning() const { return running.load(); }
+
+    // 以下函数返回请求编号，助手不可用时返回 0
+    quint32 writeSysfs(const QByteArray &path, const QByteArray &value);
+    quint32 runScript(bool stagedInstall);
+    // done 不为空时在 finished 之后以同一个 code 调用；助手不可用（返回 0）时不调用
+    quint32 cleanDir(const QString &path, std::function<void(int code)> done = nullptr);
+    // 以 root 把安装目录复制到（已删除的）影子目录，结果与脚本一样是退出码
+    quint32 copyShadow();
+
+    // 除脚本和影子目录复制外已完成请求的次数与平均往返时间（微秒）
+    quint64 completedRequests() const { return completedCount; }
+    double averageRoundTripUs() const;
+
+signals:
+    // 脚本输出（stdout 与 stderr 合并）
+    void scriptOutput(quint32 requestId, const QByteArray &data);
+    // 请求完成：code 为 0/errno；脚本为退出码，crashed 为 true 时为信号编号。
+    // 助手意外退出时，所有未完成的请求以 code = -1、crashed = true 结束
+    void finished(quint32 requestId, int code, bool crashed);
+
+private:
+    struct Pending
+    {
+        char kind = 0;
+        qint64 sentNs = 0;
+    };
+
+    struct Reply
+    {
+        char kind = 0;
+        quint32 requestId = 0;
+        QByteArray payload;
+    };
+
+    quint32 send(char kind, const QByteArray &payload);
+    bool readAvailable();
+    void takeReplies(QList<Reply> *replies);
+    bool waitForReply(quint32 requestId, int timeoutMs, int *code);
+    void deliver(const Reply &reply);
+    void deliverDeferred();
+    void onReadable();
+    void shutdown();
+
+    int fd = -1;
+    qint64 pid = 0;
+    std::atomic<bool> running{false};
+    std::atomic<quint32> nextRequestId{1};
+
+    std::mutex sendMutex;
+    std::mutex pendingMutex;
+    QHash<quint32, Pending> pending;
+
+    QByteArray input;
+    QList<Reply> deferred;              // 同步等待期间收到的其它应答，回到事件循环后再发出
+    QHash<quint32, std::function<void(int)>> cleanCallbacks;   // 主线程访问
+    QSocketNotifier *notifier = nullptr;
+
+    quint64 completedCount = 0;
+    qint64 totalRoundTripNs = 0;
+};
+
+#endif // PRIVHELPER_H
@@ -0,0 +1,132 @@
+// qmanagectl：通过本地控制通道操作正在运行的 QMANAGE
+//
+// 不依赖 Qt，启动快；网络或 WebSocket 转发服务器不可用时同样可以使用。
+
+#include "controlprotocol.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+static const int kTimeoutMs = 15000;
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s <command> [args]\n"
+            "\n"
+            "Commands:\n"
+            "  status          QT server and update state\n"
+            "  restart         restart the QT server\n"
+            "  stop            stop the QT server\n"
+            "  update-check    rescan for newer update packages\n"
+            "  tail-log [N]    print the last N log lines (default 50)\n"
+            "  dump-metrics    print supervisor metrics\n",
+            argv0);
+}
+
+static bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool readExact(int fd, char *data, size_t size)
+{
+    while (size > 0) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        const int ready = ::poll(&pfd, 1, kTimeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            fprintf(stderr, "qmanagectl: timed out waiting for QMANAGE\n");
+            return false;
+        }
+        const ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf(stderr, "qmanagectl: connection closed by QMANAGE\n");
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        usage(argv[0]);
+        return argc < 2 ? 2 : 0;
+    }
+
+    std::string request = argv[1];
+    for (int i = 2; i < argc; i++) {
+        request += ' ';
+        request += argv[i];
+    }
+    if (request.size() > ControlProtocol::MaxRequestBytes) {
+        fprintf(stderr, "qmanagectl: command too long\n");
+        return 2;
+    }
+
+    const int fd = ControlProtocol::connectToDaemon();
+    if (fd < 0) {
+        fprintf(stderr, "qmanagectl: QMANAGE is not running\n");
+        return 3;
+    }
+
+    const std::string frame = ControlProtocol::encodeFrame(ControlProtocol::Request, request.data(), request.size());
+    if (!writeAll(fd, frame.data(), frame.size())) {
+        fprintf(stderr, "qmanagectl: send failed: %s\n", strerror(errno));
+        ::close(fd);
+        return 3;
+    }
+
+    char header[ControlProtocol::HeaderSize];
+    if (!readExact(fd, header, sizeof(header))) {
+        ::close(fd);
+        return 3;
+    }
+    char kind;
+    uint32_t size;
+    ControlProtocol::decodeHeader(header, &kind, &size);
+    if (size > ControlProtocol::MaxReplyBytes) {
+        fprintf(stderr, "qmanagectl: malformed reply\n");
+        ::close(fd);
+        return 3;
+    }
+    std::string payload(size, '\0');
+    if (size > 0 && !readExact(fd, &payload[0], size)) {
+        ::close(fd);
+        return 3;
+    }
+    ::close(fd);
+
+    FILE *out = kind == ControlProtocol::ReplyOk ? stdout : stderr;
+    fwrite(payload.data(), 1, payload.size(), out);
+    if (!payload.empty() && payload[payload.size() - 1] != '\n') {
+        fputc('\n', out);
+    }
+    return kind == ControlProtocol::ReplyOk ? 0 : 1;
+}
@@ -0,0 +1,562 @@
+// qmanagehelper：QMANAGE 的常驻特权助手
+//
+// 由监控程序在启动时通过一次 `sudo -n` 拉起（监控程序本身是 root 时直接启动），
+// 标准输入和标准输出都是与监控程序之间的 socketpair 的一端。只执行 helperprotocol.h 中
+// 固定的几种命令，并对参数做白名单检查：
+//   写 sysfs：只允许 /sys/class/leds/<名称>/brightness 或 trigger
+//   执行脚本：只允许 <更新包目录>/update/Update.sh，工作目录固定，环境与 `sudo bash Update.sh` 相同
+//   删除目录：只允许更新包目录下的暂存目录、回收目录中的项和 A/B 暂存安装的影子目录，
+//             从更新包目录起逐级 openat 且不跟随符号链接
+//   复制影子目录：只从影子目录对应的安装目录复制到影子目录，两者都由配置决定
+// 监控程序退出（套接字关闭）后，等正在运行的脚本结束再退出。
+//
+// 白名单的根（更新包目录、影子目录）不从命令行读取——命令行由非特权的调用者决定。
+// 它们在编译时确定（QMANAGE_HELPER_PACK_DIR / QMANAGE_HELPER_SHADOW_DIR），
+// 可以由 root 所有、组和其他用户不可写的配置文件 QMANAGE_HELPER_CONFIG 覆盖：
+//   pack-dir=/var/www/update_pack/
+//   shadow-dir=/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram.shadow
+// 监控程序在探测请求中带上自己使用的目录，与这里不一致时探测失败，监控程序退回逐次 sudo。
+//
+// 不依赖 Qt，启动快。
+
+#include "helperprotocol.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#ifndef QMANAGE_HELPER_CONFIG
+#define QMANAGE_HELPER_CONFIG "/etc/qmanage/helper.conf"
+#endif
+#ifndef QMANAGE_HELPER_PACK_DIR
+#define QMANAGE_HELPER_PACK_DIR "/var/www/update_pack/"
+#endif
+#ifndef QMANAGE_HELPER_SHADOW_DIR
+#define QMANAGE_HELPER_SHADOW_DIR ""
+#endif
+
+struct Script
+{
+    uint32_t requestId;
+    pid_t pid;
+    int outFd;          // 读端，脚本退出并读完后关闭
+};
+
+static std::string packDir;     // 以 '/' 结尾
+static std::string shadowDir;   // 可能为空
+
+static void sendFrame(const std::string &frame)
+{
+    const char *p = frame.data();
+    size_t size = frame.size();
+    while (size > 0) {
+        const ssize_t n = ::write(STDOUT_FILENO, p, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;     // 监控程序已经退出，丢弃应答
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+static bool isSafeName(const std::string &name)
+{
+    if (name.empty() || name == "." || name == ".." || name.size() > 255) {
+        return false;
+    }
+    for (char c : name) {
+        const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                        || c == '_' || c == '-' || c == '.' || c == ':';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isAllowedSysfsPath(const std::string &path)
+{
+    static const std::string prefix = "/sys/class/leds/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    const std::string rest = path.substr(prefix.size());
+    const size_t slash = rest.find('/');
+    if (slash == std::string::npos || !isSafeName(rest.substr(0, slash))) {
+        return false;
+    }
+    const std::string attribute = rest.substr(slash + 1);
+    return attribute == "brightness" || attribute == "trigger";
+}
+
+static bool isAllowedValue(const std::string &value)
+{
+    if (value.empty() || value.size() > 32) {
+        return false;
+    }
+    for (char c : value) {
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool isAllowedCleanPath(std::string path)
+{
+    while (path.size() > 1 && path[path.size() - 1] == '/') {
+        path.erase(path.size() - 1);
+    }
+    if (!shadowDir.empty() && path == shadowDir) {
+        return true;
+    }
+    if (path.compare(0, packDir.size(), packDir) != 0) {
+        return false;
+    }
+    const std::string rest = path.substr(packDir.size());
+    static const char *const fixed[] = { "update", "delta", "update_scripts", ".pipeline", ".store-extract" };
+    for (const char *name : fixed) {
+        if (rest == name) {
+            return true;
+        }
+    }
+    static const char *const parents[] = { ".staged/", ".trash/" };
+    for (const char *parent : parents) {
+        const size_t size = strlen(parent);
+        if (rest.compare(0, size, parent) == 0 && isSafeName(rest.substr(size))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int writeSysfs(const std::string &path, const std::string &value)
+{
+    if (!isAllowedSysfsPath(path) || !isAllowedValue(value)) {
+        return EPERM;
+    }
+    const int fd = ::open(path.c_str(), O_WRONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    const ssize_t n = ::write(fd, value.data(), value.size());
+    const int result = n == static_cast<ssize_t>(value.size()) ? 0 : (n < 0 ? errno : EIO);
+    ::close(fd);
+    return result;
+}
+
+// 删除 parentFd 下的 name；目录逐级用 openat(O_NOFOLLOW) 打开，
+// 即使目录在删除过程中被换成符号链接，也不会删到目录树之外
+static int removeTreeAt(int parentFd, const char *name)
+{
+    const int fd = ::openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOTDIR || errno == ELOOP) {
+            return ::unlinkat(parentFd, name, 0) == 0 ? 0 : errno;
+        }
+        return errno == ENOENT ? 0 : errno;
+    }
+    DIR *dir = ::fdopendir(fd);
+    if (!dir) {
+        const int error = errno;
+        ::close(fd);
+        return error;
+    }
+
+    std::vector<std::string> names;
+    struct dirent *entry;
+    while ((entry = ::readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            names.push_back(entry->d_name);
+        }
+    }
+
+    int result = 0;
+    for (const std::string &child : names) {
+        struct stat st;
+        int error;
+        if (::fstatat(fd, child.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode)) {
+            error = removeTreeAt(fd, child.c_str());
+        } else {
+            error = ::unlinkat(fd, child.c_str(), 0) == 0 || errno == ENOENT ? 0 : errno;
+        }
+        if (error && !result) {
+            result = error;
+        }
+    }
+    ::closedir(dir);
+
+    if (::unlinkat(parentFd, name, AT_REMOVEDIR) != 0 && errno != ENOENT && !result) {
+        result = errno;
+    }
+    return result;
+}
+
+static std::string trimSlashes(std::string path)
+{
+    while (path.size() > 1 && path[path.size() - 1] == '/') {
+        path.erase(path.size() - 1);
+    }
+    return path;
+}
+
+static int cleanDir(const std::string &path)
+{
+    if (!isAllowedCleanPath(path)) {
+        return EPERM;
+    }
+    const std::string trimmed = trimSlashes(path);
+
+    // 根目录来自 root 的配置，直接打开；根以下的各级目录（.staged、.trash 等）非特权用户可写，
+    // 逐级 openat(O_NOFOLLOW)，其中任何一级被换成符号链接都会失败，不会删到白名单之外
+    std::string root;
+    std::string rest;
+    if (!shadowDir.empty() && trimmed == shadowDir) {
+        const size_t slash = trimmed.rfind('/');
+        root = slash == 0 ? "/" : trimmed.substr(0, slash);
+        rest = trimmed.substr(slash + 1);
+    } else {
+        root = packDir;
+        rest = trimmed.substr(packDir.size());
+    }
+    int parentFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parentFd < 0) {
+        return errno == ENOENT ? 0 : errno;
+    }
+    size_t slash;
+    while ((slash = rest.find('/')) != std::string::npos) {
+        const int fd = ::openat(parentFd, rest.substr(0, slash).c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        const int error = errno;
+        ::close(parentFd);
+        if (fd < 0) {
+            return error == ENOENT ? 0 : error;
+        }
+        parentFd = fd;
+        rest.erase(0, slash + 1);
+    }
+    const int result = removeTreeAt(parentFd, rest.c_str());
+    ::close(parentFd);
+    return result;
+}
+
+// 读取 root 配置文件中的白名单根；文件不存在时保留编译时的默认值
+static bool loadConfig(const char *path)
+{
+    const int fd = ::open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != 0 || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        fprintf(stderr, "qmanagehelper: %s must be a regular file owned by root and not group/world-writable\n", path);
+        ::close(fd);
+        return false;
+    }
+    std::string text;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0 && text.size() < 65536) {
+        text.append(buf, static_cast<size_t>(n));
+    }
+    ::close(fd);
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string line = text.substr(start, end - start);
+        start = end + 1;
+        const size_t eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == std::string::npos) {
+            continue;
+        }
+        const std::string key = line.substr(0, eq);
+        if (key == "pack-dir") {
+            packDir = line.substr(eq + 1);
+        } else if (key == "shadow-dir") {
+            shadowDir = line.substr(eq + 1);
+        }
+    }
+    return true;
+}
+
+// 探测请求可以带上监控程序使用的 "<更新包目录>\0<影子目录>"，与本进程的白名单根比较
+static int checkRoots(const std::string &payload)
+{
+    if (payload.empty()) {
+        return 0;
+    }
+    const size_t sep = payload.find('\0');
+    const std::string pack = trimSlashes(payload.substr(0, sep)) + "/";
+    const std::string shadow = sep == std::string::npos ? std::string() : trimSlashes(payload.substr(sep + 1));
+    return pack == packDir && shadow == shadowDir ? 0 : EPERM;
+}
+
+// fork 一个子进程：独立进程组，输出合并到管道，标准输入为 /dev/null；
+// 子进程中调用 exec，它返回即表示失败。退出状态由主循环轮询，结束时发送 'd'
+template <typename Exec>
+static bool spawnTracked(uint32_t requestId, std::vector<Script> *scripts, Exec exec)
+{
+    int pipeFds[2];
+    if (::pipe2(pipeFds, O_CLOEXEC) != 0) {
+        return false;
+    }
+
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+        ::close(pipeFds[0]);
+        ::close(pipeFds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        ::setsid();
+        ::signal(SIGPIPE, SIG_DFL);
+        const int nullFd = ::open("/dev/null", O_RDONLY);
+        if (nullFd >= 0) {
+            ::dup2(nullFd, STDIN_FILENO);
+        }
+        ::dup2(pipeFds[1], STDOUT_FILENO);
+        ::dup2(pipeFds[1], STDERR_FILENO);
+        exec();
+        _exit(127);
+    }
+
+    ::close(pipeFds[1]);
+    ::fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+    Script script;
+    script.requestId = requestId;
+    script.pid = pid;
+    script.outFd = pipeFds[0];
+    scripts->push_back(script);
+    return true;
+}
+
+static bool startScript(uint32_t requestId, uint8_t flags, std::vector<Script> *scripts)
+{
+    const std::string workDir = packDir + "update";
+    return spawnTracked(requestId, scripts, [&]() {
+        if (::chdir(workDir.c_str()) != 0) {
+            return;
+        }
+        if ((flags & HelperProtocol::ScriptStagedInstall) && !shadowDir.empty()) {
+            ::setenv("QUARCS_STAGED_INSTALL", "1", 1);
+            ::setenv("QUARCS_INSTALL_ROOT", shadowDir.c_str(), 1);
+        }
+        ::execlp("bash", "bash", "Update.sh", static_cast<char *>(nullptr));
+    });
+}
+
+// 以 root 执行 cp -a，保留 Update.sh 留下的 root 所有的文件。影子目录的上级目录非特权用户可写：
+// 影子目录由这里新建（已存在则失败），打开后确认仍是 root 所有的目录，子进程 fchdir 进去再复制到 "."；
+// 安装目录用 O_NOFOLLOW 打开，经 /proc/self/fd 传给 cp，中途换成符号链接也不会复制到别处
+static bool startShadowCopy(uint32_t requestId, std::vector<Script> *scripts)
+{
+    static const std::string suffix = ".shadow";
+    if (shadowDir.size() <= suffix.size()
+        || shadowDir.compare(shadowDir.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    const std::string liveDir = shadowDir.substr(0, shadowDir.size() - suffix.size());
+    if (::mkdir(shadowDir.c_str(), 0700) != 0) {
+        return false;
+    }
+    const int destFd = ::open(shadowDir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    const int srcFd = ::open(liveDir.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    struct stat st;
+    bool ok = destFd >= 0 && srcFd >= 0 && ::fstat(destFd, &st) == 0 && st.st_uid == 0;
+    if (ok) {
+        const std::string source = "/proc/self/fd/" + std::to_string(srcFd) + "/.";
+        ok = spawnTracked(requestId, scripts, [&]() {
+            if (::fchdir(destFd) != 0 || ::fcntl(srcFd, F_SETFD, 0) != 0) {
+                return;
+            }
+            ::execlp("cp", "cp", "-a", "--reflink=auto", source.c_str(), ".", static_cast<char *>(nullptr));
+        });
+    }
+    if (destFd >= 0) {
+        ::close(destFd);
+    }
+    if (srcFd >= 0) {
+        ::close(srcFd);
+    }
+    return ok;
+}
+
+// 读取脚本输出并转发；返回 false 表示读到文件末尾
+static bool forwardOutput(Script *script)
+{
+    char buf[16384];
+    for (;;) {
+        const ssize_t n = ::read(script->outFd, buf, sizeof(buf));
+        if (n > 0) {
+            sendFrame(HelperProtocol::encodeFrame(HelperProtocol::ScriptOutput, script->requestId,
+                                                  buf, static_cast<size_t>(n)));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+static void handleRequest(char kind, uint32_t requestId, const std::string &payload, std::vector<Script> *scripts)
+{
+    switch (kind) {
+    case HelperProtocol::Ping:
+        sendFrame(HelperProtocol::encodeDone(requestId, checkRoots(payload), false));
+        break;
+    case HelperProtocol::WriteSysfs: {
+        const size_t sep = payload.find('\0');
+        const int result = sep == std::string::npos
+                               ? EINVAL : writeSysfs(payload.substr(0, sep), payload.substr(sep + 1));
+        sendFrame(HelperProtocol::encodeDone(requestId, result, false));
+        break;
+    }
+    case HelperProtocol::RunScript: {
+        const uint8_t flags = payload.empty() ? 0 : static_cast<uint8_t>(payload[0]);
+        if (!startScript(requestId, flags, scripts)) {
+            sendFrame(HelperProtocol::encodeDone(requestId, 127, false));
+        }
+        break;
+    }
+    case HelperProtocol::CleanDir:
+        sendFrame(HelperProtocol::encodeDone(requestId, cleanDir(payload), false));
+        break;
+    case HelperProtocol::CopyShadow:
+        if (!startShadowCopy(requestId, scripts)) {
+            sendFrame(HelperProtocol::encodeDone(requestId, 127, false));
+        }
+        break;
+    default:
+        sendFrame(HelperProtocol::encodeDone(requestId, EINVAL, false));
+        break;
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s\n"
+                    "Started by QMANAGE; talks to it over standard input/output.\n"
+                    "Allowed directories come from %s (default pack dir %s).\n",
+            argv0, QMANAGE_HELPER_CONFIG, QMANAGE_HELPER_PACK_DIR);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    packDir = QMANAGE_HELPER_PACK_DIR;
+    shadowDir = QMANAGE_HELPER_SHADOW_DIR;
+    if (!loadConfig(QMANAGE_HELPER_CONFIG)) {
+        return 2;
+    }
+    if (packDir.empty() || packDir[0] != '/' || (!shadowDir.empty() && shadowDir[0] != '/')) {
+        fprintf(stderr, "qmanagehelper: pack-dir and shadow-dir must be absolute paths\n");
+        return 2;
+    }
+    if (packDir[packDir.size() - 1] != '/') {
+        packDir += '/';
+    }
+    while (shadowDir.size() > 1 && shadowDir[shadowDir.size() - 1] == '/') {
+        shadowDir.erase(shadowDir.size() - 1);
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Script> scripts;
+    std::string input;
+    bool inputOpen = true;
+    char buf[8192];
+
+    while (inputOpen || !scripts.empty()) {
+        std::vector<struct pollfd> fds;
+        if (inputOpen) {
+            struct pollfd pfd;
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+        for (const Script &script : scripts) {
+            if (script.outFd >= 0) {
+                struct pollfd pfd;
+                pfd.fd = script.outFd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                fds.push_back(pfd);
+            }
+        }
+        // 脚本可能把输出描述符留给后台子进程，因此退出状态用 waitpid 轮询，而不是等管道关闭
+        const int ready = ::poll(fds.data(), fds.size(), scripts.empty() ? -1 : 100);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (inputOpen && ready > 0 && fds[0].revents) {
+            const ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+            if (n > 0) {
+                input.append(buf, static_cast<size_t>(n));
+            } else if (n == 0 || errno != EINTR) {
+                inputOpen = false;      // 监控程序已经退出
+            }
+            while (input.size() >= HelperProtocol::HeaderSize) {
+                char kind;
+                uint32_t requestId;
+                uint32_t size;
+                HelperProtocol::decodeHeader(input.data(), &kind, &requestId, &size);
+                if (size > HelperProtocol::MaxRequestBytes) {
+                    inputOpen = false;      // 协议错误，不再接受请求
+                    break;
+                }
+                if (input.size() < HelperProtocol::HeaderSize + size) {
+                    break;
+                }
+                const std::string payload = input.substr(HelperProtocol::HeaderSize, size);
+                input.erase(0, HelperProtocol::HeaderSize + size);
+                handleRequest(kind, requestId, payload, &scripts);
+            }
+        }
+
+        for (size_t i = 0; i < scripts.size();) {
+            Script &script = scripts[i];
+            if (script.outFd >= 0 && !forwardOutput(&script)) {
+                ::close(script.outFd);
+                script.outFd = -1;
+            }
+            int status = 0;
+            if (::waitpid(script.pid, &status, WNOHANG) != script.pid) {
+                i++;
+                continue;
+            }
+            if (script.outFd >= 0) {
+                forwardOutput(&script);
+                ::close(script.outFd);
+            }
+            if (WIFSIGNALED(status)) {
+                sendFrame(HelperProtocol::encodeDone(script.requestId, WTERMSIG(status), true));
+            } else {
+                sendFrame(HelperProtocol::encodeDone(script.requestId, WEXITSTATUS(status), false));
+            }
+            scripts.erase(scripts.begin() + static_cast<long>(i));
+        }
+    }
+    return 0;
+}
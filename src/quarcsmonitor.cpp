@@ -1,61 +1,147 @@
 #include "quarcsmonitor.h"
+#include "deltaupdate.h"
+#include "updateplanner.h"
+#include "stagedinstall.h"
+#include "startuptrace.h"
+#include "sdnotify.h"
+#include "tracer.h"
+#include "trafficrecorder.h"
+#include "zipreader.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
 #include <algorithm>
 #include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QLoggingCategory>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <cstdio>
 
-// 辅助函数：将版本号字符串转换为可比较的整数
-// 支持格式：
-//  - x.y.z  （语义化版本号）
-//  - 纯数字（兼容旧版本号，如 20251127）
-static int parseVersionToInt(const QString &versionStr, bool &ok)
+QuarcsMonitor::QuarcsMonitor(QObject *parent) : QObject(parent)
 {
-    ok = false;
-
-    QString v = versionStr.trimmed();
-    if (v.isEmpty())
-        return 0;
-
-    // 优先解析 x.y.z 语义化版本
-    const QStringList parts = v.split('.');
-    if (parts.size() == 3)
-    {
-        bool ok1 = false, ok2 = false, ok3 = false;
-        int major = parts[0].toInt(&ok1);
-        int minor = parts[1].toInt(&ok2);
-        int patch = parts[2].toInt(&ok3);
+    // 在这里初始化你需要监控的进程或者状态变量
 
-        if (ok1 && ok2 && ok3 && major >= 0 && minor >= 0 && patch >= 0)
-        {
-            ok = true;
-            // 按权重组合，保证可比较性
-            return major * 1000000 + minor * 1000 + patch;
-        }
+    // 配置文件（默认 ~/.config/QMANAGE/qmanage.json）：启动项在这里复制一次，运行项修改后立即生效
+    configStore = new ConfigStore(ConfigStore::defaultPath(), this);
+    config = configStore->current();
+    connect(configStore, &ConfigStore::changed, this, &QuarcsMonitor::onConfigChanged);
+    qtServerProgram = config->clientPath;
+    UpdatePackPath = config->updatePackPath;
+    websocketUrl = QUrl(config->websocketUrl);
+    websocketPort = config->websocketPort;
+    logDir = config->logDir;
+    crashDir = config->crashDir;
+    packageStoreDir = config->packageStoreDir;
+    stateJournalPath = config->stateJournalPath;
+    logSegmentBytes = config->logSegmentBytes;
+    logBudgetBytes = config->logBudgetBytes;
+    preStageBudgetBytes = config->preStageBudgetBytes;
+    stagedInstallEnabled = config->stagedInstall;
+    qtServerInstallDir = config->qtServerInstallDir;
+
+    applyEnvironmentOverrides();
+    qtServerWorkDir = config->clientWorkDir.isEmpty() ? QFileInfo(qtServerProgram).absolutePath()
+                                                       : config->clientWorkDir;
+
+    // 监控程序日志和 QT 端输出写入分段日志存储（守护进程的 stdout 指向 /dev/null），前端可按时间范围取回
+    if (logDir.isEmpty()) {
+        logDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/logs";
+    }
+    logStore = new LogStore(logDir, logSegmentBytes, logBudgetBytes, this);
+    logStore->installMessageHandler();
+    thermalMonitor = new ThermalMonitor(config->thermalSysfsRoot, this);
+    loopLagProbe = new LoopLagProbe(this);
+    applyLiveConfig();
+
+    // QT 端异常退出时保存崩溃现场，前端可通过 listCrashRecords / getCrashRecord 取回
+    if (crashDir.isEmpty()) {
+        crashDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/crashes";
     }
+    crashSnapshot = new CrashSnapshot(crashDir, this);
 
-    // 回退到纯数字版本（兼容老版本）
-    bool okInt = false;
-    int val = v.toInt(&okInt);
-    if (okInt)
-    {
-        ok = true;
-        return val;
+    // 顺序更新进度与重启状态：QMANAGE 在更新途中退出后，重新启动时从这里继续
+    if (stateJournalPath.isEmpty()) {
+        stateJournalPath = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/state.journal";
     }
+    stateJournal.reset(new StateJournal(stateJournalPath));
 
-    return 0;
-}
+    // 本地控制通道（qmanagectl），网络或 WebSocket 服务器不可用时也能查看状态、重启 QT 端
+    controlServer = new ControlServer(this);
+    connect(controlServer, &ControlServer::commandReceived, this, &QuarcsMonitor::handleControlCommand);
+    controlServer->listen();
 
-QuarcsMonitor::QuarcsMonitor(QObject *parent) : QObject(parent)
-{
-    // 在这里初始化你需要监控的进程或者状态变量
-    getHostAddress(); // 获取主机地址
+    if (websocketUrl.isEmpty()) {
+        getHostAddress(); // 获取主机地址
+    }
     websocketClient = new WebSocketClient(websocketUrl); // 初始化WebSocketClient
+    websocketClient->setReliableDelivery(config->reliableMessages, config->messageAckTimeoutMs,
+                                         config->messageMaxRetransmits);
     bool ok = connect(websocketClient, &WebSocketClient::messageReceived, this, &QuarcsMonitor::receivedMessage);
     if (!ok) {
         qDebug() << "Failed to connect messageReceived signal";
     }
+    connect(websocketClient, &WebSocketClient::connected, this, [this]() {
+        const QStringList messages = pendingConnectMessages;
+        pendingConnectMessages.clear();
+        foreach (const QString &message, messages) {
+            websocketClient->messageSend(message, true);
+        }
+    });
+    connect(thermalMonitor, &ThermalMonitor::levelChanged, this, [this]() {
+        websocketClient->messageSend("thermalState:" + thermalMonitor->stateText());
+    });
     
+    // 更新包目录索引：启动时扫描一次，之后由 inotify 增量维护
+    packageIndex = new PackageIndex(UpdatePackPath, this);
+
+    // 常驻特权助手：只在启动时经过一次 sudo，之后 LED 写入、Update.sh 和目录清理都不再逐次 fork sudo
+    privHelper = new PrivHelper(this);
+    if (config->privilegedHelper) {
+        privHelper->start(QCoreApplication::applicationDirPath() + "/qmanagehelper", UpdatePackPath,
+                          StagedInstall::shadowPath(qtServerInstallDir));
+    }
+    connect(privHelper, &PrivHelper::scriptOutput, this, [this](quint32 requestId, const QByteArray &data) {
+        if (requestId == helperScriptRequest) {
+            updateScriptOutput.feed(data.constData(), static_cast<size_t>(data.size()),
+                                    [this](const char *line, size_t size) {
+                                        handleUpdateScriptLine(line, size);
+                                    });
+        } else if (requestId == shadowCopyRequest) {
+            qDebug() << "暂存安装：cp 输出:" << QString::fromLocal8Bit(data).trimmed();
+        }
+    });
+    connect(privHelper, &PrivHelper::finished, this, [this](quint32 requestId, int code, bool crashed) {
+        if (requestId == helperScriptRequest) {
+            helperScriptRequest = 0;
+            onUpdateProcessFinished(code, crashed ? QProcess::CrashExit : QProcess::NormalExit);
+        } else if (requestId == shadowCopyRequest) {
+            shadowCopyRequest = 0;
+            if (code != 0) {
+                qDebug() << "暂存安装：特权助手复制影子目录失败，结果:" << code << (crashed ? "（信号）" : "");
+            }
+            onShadowCopyFinished(code == 0 && !crashed);
+        }
+    });
+
+    // 旧的暂存目录整体移入回收目录，由后台线程删除；更新进行中暂停，不与解压、脚本争抢磁盘
+    trashCollector = new TrashCollector(UpdatePackPath + ".trash", this);
+    connect(trashCollector, &TrashCollector::treeReclaimed,
+            this, [](const QString &name, qint64 entries, qint64 bytes) {
+                qDebug() << "回收目录：已删除" << name << entries << "项，释放" << bytes / 1024 << "KiB";
+            });
+    connect(trashCollector, &TrashCollector::reclaimBlocked, this, [this](const QString &path) {
+        if (privHelper->isRunning()) {
+            privHelper->cleanDir(path);
+        }
+    });
+
     led = new Led();
+    led->setPrivHelper(privHelper);
     led->initLed();
     led->setLedSpeed("fast");
 
@@ -73,6 +159,47 @@ QuarcsMonitor::QuarcsMonitor(QObject *parent) : QObject(parent)
     }
     qDebug() << "QuarcsMonitor 当前全局总版本号:" << totalVersion;
 
+    // 高于当前版本的更新包一到达就在后台预解压，用户点击更新时可跳过解压
+    preStager = new PreStager(UpdatePackPath, UpdatePackPath + ".staged", preStageBudgetBytes, this);
+    connect(packageIndex, &PackageIndex::packageAdded,
+            this, [this](const PackageIndex::PackageInfo &info) {
+                bool okCurrent = false;
+                if (info.key > PackageIndex::parseVersionKey(totalVersion, okCurrent)) {
+                    preStager->enqueue(info);
+                }
+            });
+    connect(packageIndex, &PackageIndex::packageRemoved, this, [this](const QString &fileName) {
+        const QString treeDir = preStager->discard(fileName);
+        if (!treeDir.isEmpty()) {
+            removeDirTree(treeDir);
+        }
+    });
+    bool okCurrent = false;
+    foreach (const PackageIndex::PackageInfo &info,
+             packageIndex->newerThan(PackageIndex::parseVersionKey(totalVersion, okCurrent))) {
+        preStager->enqueue(info);
+    }
+
+    // 更新包去重存储：所有 zip 在后台分块入库；开启 pruneStoredPackages 时已安装过的旧版本
+    // 入库后删除原 zip，再次需要时从存储中直接解压或重建
+    chunkStore = new ChunkStore(packageStorePath(), UpdatePackPath, this);
+    foreach (const PackageIndex::PackageInfo &info, chunkStore->storedPackages()) {
+        packageIndex->addStored(info);
+    }
+    connect(packageIndex, &PackageIndex::packageAdded, chunkStore, &ChunkStore::enqueue);
+    connect(chunkStore, &ChunkStore::packageStored,
+            this, [this](const PackageIndex::PackageInfo &info) {
+                packageIndex->addStored(info);
+                pruneStoredPackages();
+            });
+    foreach (const PackageIndex::PackageInfo &info, packageIndex->all()) {
+        chunkStore->enqueue(info);
+    }
+    pruneStoredPackages();
+
+    // SIGUSR2 导出时间线
+    setupTraceSignal();
+
     // 绑定应用结束信号，在父进程退出时主动关闭并清理 QT 端进程
     if (QCoreApplication::instance())
     {
@@ -81,16 +208,371 @@ QuarcsMonitor::QuarcsMonitor(QObject *parent) : QObject(parent)
     }
 
     // 程序启动时，默认检测并必要时拉起 QT 端
-    // 使用 singleShot 避免在构造函数中直接启动外部进程
-    QTimer::singleShot(1500, this, [this]() {
+    // 使用 singleShot(0) 避免在构造函数中直接启动外部进程：进入事件循环后立即执行，
+    // 单实例锁已经拿到，无需再额外等待
+    QTimer::singleShot(0, this, [this]() {
         autoStartQtIfNotRunning();
+        monitorProcess();
+        resumeFromJournal();
+        // 监控流程已经运行起来，通知 systemd 就绪
+        setupServiceNotify();
+    });
+}
+
+// SIGUSR2 -> 管道 -> 事件循环中导出时间线；信号处理函数里只做异步信号安全的 write
+static int traceSignalPipe[2] = {-1, -1};
+
+static void onTraceSignal(int)
+{
+    const char c = 1;
+    ssize_t ignored = ::write(traceSignalPipe[1], &c, 1);
+    (void)ignored;
+}
+
+void QuarcsMonitor::setupTraceSignal()
+{
+    if (::pipe2(traceSignalPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        qDebug() << "无法创建时间线导出信号管道:" << strerror(errno);
+        return;
+    }
+
+    QSocketNotifier *notifier = new QSocketNotifier(traceSignalPipe[0], QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, [this]() {
+        char buf[16];
+        while (::read(traceSignalPipe[0], buf, sizeof(buf)) > 0) {
+        }
+        dumpTrace();
     });
 
-    QTimer::singleShot(1000, this, &QuarcsMonitor::monitorProcess);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onTraceSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR2, &sa, nullptr);
+}
+
+QString QuarcsMonitor::dumpTrace()
+{
+    const QString path = QString("/tmp/QUARCS_QMANAGE_trace_%1.json")
+                             .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+    const int count = Tracer::dumpJson(path);
+    if (count < 0) {
+        qDebug() << "时间线导出失败:" << path;
+        return QString();
+    }
+    qDebug() << "时间线已导出:" << path << "，事件数" << count
+             << (Tracer::isEnabled() ? "" : "（追踪未启用）");
+    return path;
+}
+
+void QuarcsMonitor::onConfigChanged(std::shared_ptr<const MonitorConfig> previous)
+{
+    config = configStore->current();
+    applyLiveConfig();
+    const QStringList pending = config->restartRequiredChanges(*previous);
+    if (!pending.isEmpty()) {
+        qDebug() << "配置已更新，以下项需要重启 QMANAGE 才生效:" << pending;
+    } else {
+        qDebug() << "配置已更新并生效";
+    }
+}
+
+// 运行项中需要主动下发的部分；其余运行项在每次使用时直接读取 config
+void QuarcsMonitor::applyLiveConfig()
+{
+    // debug 全部输出；info 关闭 qDebug；warning 再关闭 qInfo
+    QString rules;
+    if (config->logLevel == "info") {
+        rules = "*.debug=false";
+    } else if (config->logLevel == "warning") {
+        rules = "*.debug=false\n*.info=false";
+    }
+    QLoggingCategory::setFilterRules(rules);
+    logStore->setFlushInterval(config->logFlushIntervalMs);
+    thermalMonitor->setLimits(config->thermalWarmCelsius, config->thermalHotCelsius);
+    loopLagProbe->setStallThreshold(config->loopStallThresholdMs);
+    if (websocketClient) {
+        websocketClient->setReliableDelivery(config->reliableMessages, config->messageAckTimeoutMs,
+                                             config->messageMaxRetransmits);
+    }
+}
+
+void QuarcsMonitor::applyEnvironmentOverrides()
+{
+    // 正常部署时不设置这些变量；基准测试用假的 client 和本地 WebSocket 服务器替换真实环境
+    const QByteArray clientPath = qgetenv("QUARCS_CLIENT_PATH");
+    if (!clientPath.isEmpty()) {
+        qtServerProgram = QString::fromLocal8Bit(clientPath);
+        qDebug() << "QT 端可执行文件（QUARCS_CLIENT_PATH）:" << qtServerProgram;
+    }
+
+    const QByteArray wsUrl = qgetenv("QUARCS_WS_URL");
+    if (!wsUrl.isEmpty()) {
+        websocketUrl = QUrl(QString::fromUtf8(wsUrl));
+        qDebug() << "WebSocket URL（QUARCS_WS_URL）:" << websocketUrl.toString();
+    }
+
+    const QByteArray packPath = qgetenv("QUARCS_UPDATE_PACK_PATH");
+    if (!packPath.isEmpty()) {
+        UpdatePackPath = QString::fromLocal8Bit(packPath);
+        if (!UpdatePackPath.endsWith('/')) {
+            UpdatePackPath += '/';
+        }
+        qDebug() << "更新包目录（QUARCS_UPDATE_PACK_PATH）:" << UpdatePackPath;
+    }
+
+    const QByteArray logPath = qgetenv("QUARCS_LOG_DIR");
+    if (!logPath.isEmpty()) {
+        logDir = QString::fromLocal8Bit(logPath);
+        qDebug() << "日志目录（QUARCS_LOG_DIR）:" << logDir;
+    }
+
+    const QByteArray crashPath = qgetenv("QUARCS_CRASH_DIR");
+    if (!crashPath.isEmpty()) {
+        crashDir = QString::fromLocal8Bit(crashPath);
+        qDebug() << "崩溃记录目录（QUARCS_CRASH_DIR）:" << crashDir;
+    }
+
+    const QByteArray storePath = qgetenv("QUARCS_PACKAGE_STORE_DIR");
+    if (!storePath.isEmpty()) {
+        packageStoreDir = QString::fromLocal8Bit(storePath);
+        qDebug() << "去重存储目录（QUARCS_PACKAGE_STORE_DIR）:" << packageStoreDir;
+    }
+
+    const QByteArray journalPath = qgetenv("QUARCS_STATE_JOURNAL");
+    if (!journalPath.isEmpty()) {
+        stateJournalPath = QString::fromLocal8Bit(journalPath);
+        qDebug() << "状态日志（QUARCS_STATE_JOURNAL）:" << stateJournalPath;
+    }
+
+    // 录制收发的帧与子进程、定时器事件，用 bench/replaybench 回放
+    const QByteArray recordPath = qgetenv("QUARCS_RECORD");
+    if (!recordPath.isEmpty()) {
+        TrafficRecorder::start(QString::fromLocal8Bit(recordPath));
+    }
+}
+
+void QuarcsMonitor::setupServiceNotify()
+{
+    if (!SdNotify::isAvailable()) {
+        return;
+    }
+
+    SdNotify::notify("READY=1\nMAINPID=" + QByteArray::number(static_cast<qint64>(getpid())));
+    updateServiceStatus();
+
+    // 看门狗心跳只由主事件循环上的定时器发出：事件循环一旦被阻塞，
+    // systemd 收不到心跳就会重启本进程
+    const quint64 usec = SdNotify::watchdogUsec();
+    if (usec > 0) {
+        watchdogTimer = new QTimer(this);
+        connect(watchdogTimer, &QTimer::timeout, this, []() {
+            SdNotify::notify("WATCHDOG=1");
+        });
+        watchdogTimer->start(static_cast<int>(qMax<quint64>(usec / 2000, 100)));
+        qDebug() << "systemd watchdog enabled, interval" << watchdogTimer->interval() << "ms";
+    }
+}
+
+// 把 QT 服务器状态和更新状态通过 STATUS= 报告给 systemd，只在内容变化时发送
+void QuarcsMonitor::updateServiceStatus()
+{
+    if (!SdNotify::isAvailable()) {
+        return;
+    }
+
+    const QString status = serviceStatusText();
+    if (status != lastServiceStatus) {
+        lastServiceStatus = status;
+        SdNotify::notify("STATUS=" + status.toUtf8());
+    }
+}
+
+QString QuarcsMonitor::serviceStatusText() const
+{
+    QString server;
+    if (isRestarting) {
+        server = "restarting";
+    } else if (qtServerProcess && qtServerProcess->state() != QProcess::NotRunning) {
+        server = qtServerInitSuccess ? "running" : "starting";
+    } else {
+        server = "stopped";
+    }
+
+    QString update = "idle";
+    if (isSequentialUpdate) {
+        update = QString("step %1/%2 %3").arg(currentUpdateIndex + 1)
+                                         .arg(pendingUpdateVersions.size())
+                                         .arg(currentUpdateVersion);
+    }
+
+    return "QT server " + server + ", update " + update;
+}
+
+void QuarcsMonitor::handleControlCommand(int clientId, const QString &command, const QStringList &args)
+{
+    TraceSpan span("controlCommand", command);
+    qDebug() << "控制通道命令:" << command << args;
+    if (command == "status") {
+        controlServer->reply(clientId, true, statusReport());
+    } else if (command == "restart") {
+        if (isSequentialUpdate) {
+            controlServer->reply(clientId, false, "update in progress, not restarting QT server");
+            return;
+        }
+        if (!isRestarting) {
+            reRunQTServer();
+            controlServer->reply(clientId, true, "restarting QT server");
+        } else {
+            controlServer->reply(clientId, true, "restart already in progress");
+        }
+    } else if (command == "stop") {
+        if (isSequentialUpdate) {
+            controlServer->reply(clientId, false, "update in progress, not stopping QT server");
+            return;
+        }
+        killQTServer();
+        controlServer->reply(clientId, true, "QT server stopped");
+    } else if (command == "update-check") {
+        if (isSequentialUpdate) {
+            controlServer->reply(clientId, true, serviceStatusText().toUtf8());
+            return;
+        }
+        checkVueClientVersion();
+        bool okCurrent = false;
+        QStringList newer;
+        foreach (const PackageIndex::PackageInfo &info,
+                 packageIndex->newerThan(PackageIndex::parseVersionKey(totalVersion, okCurrent))) {
+            newer << info.version;
+        }
+        controlServer->reply(clientId, true,
+                             ("current: " + totalVersion + "\nnewer: "
+                              + (newer.isEmpty() ? QString("none") : newer.join(" "))).toUtf8());
+    } else if (command == "tail-log") {
+        const int lines = qBound(1, args.isEmpty() ? 50 : args[0].toInt(), 10000);
+        // 可能要解压日志段，放到后台线程
+        LogStore *store = logStore;
+        backgroundJobs.run([this, store, clientId, lines]() {
+            const QByteArray text = store->tail(lines);
+            QMetaObject::invokeMethod(this, [=]() {
+                controlServer->reply(clientId, true, text);
+            }, Qt::QueuedConnection);
+        });
+    } else if (command == "dump-metrics") {
+        controlServer->reply(clientId, true, metricsReport());
+    } else {
+        controlServer->reply(clientId, false, ("unknown command: " + command).toUtf8());
+    }
+}
+
+QByteArray QuarcsMonitor::statusReport() const
+{
+    const bool running = qtServerProcess && qtServerProcess->state() != QProcess::NotRunning;
+    QByteArray out;
+    out += "state: " + serviceStatusText().toUtf8() + "\n";
+    out += "monitor_pid: " + QByteArray::number(static_cast<qint64>(getpid())) + "\n";
+    out += "qt_server_pid: " + QByteArray::number(running ? qtServerProcess->processId() : 0) + "\n";
+    out += "qt_server_init: " + QByteArray(qtServerInitSuccess ? "yes" : "no") + "\n";
+    out += "websocket: " + QByteArray(websocketClient->isConnected() ? "connected " : "disconnected ")
+           + websocketUrl.toString().toUtf8() + "\n";
+    out += "total_version: " + totalVersion.toUtf8() + "\n";
+    out += "update_packages: " + QByteArray::number(packageIndex->count()) + "\n";
+    out += "thermal: " + (thermalMonitor->isAvailable() ? thermalMonitor->stateText().toUtf8() : QByteArray("unavailable")) + "\n";
+    const QStringList crashes = crashSnapshot->listRecords();
+    out += "last_crash: " + (crashes.isEmpty() ? QByteArray("none") : crashes.first().toUtf8()) + "\n";
+    out += "qt_server_restarts: " + QByteArray::number(qtServerRestartCount) + "\n";
+    if (isSequentialUpdate) {
+        out += "update_sequence: " + QByteArray::number(currentUpdateIndex + 1) + "/"
+               + QByteArray::number(pendingUpdateVersions.size()) + " " + currentUpdateVersion.toUtf8()
+               + " " + updateStep.toUtf8() + "\n";
+    }
+    return out;
+}
+
+QByteArray QuarcsMonitor::metricsReport() const
+{
+    QByteArray out;
+    CrashSnapshot::Sample sample;
+    if (crashSnapshot->latestSample(&sample)) {
+        out += "qt_server_cpu_percent " + QByteArray::number(sample.cpuPercent, 'f', 1) + "\n";
+        out += "qt_server_rss_kb " + QByteArray::number(sample.rssKb) + "\n";
+        out += "qt_server_fds " + QByteArray::number(sample.fds) + "\n";
+        out += "qt_server_threads " + QByteArray::number(sample.threads) + "\n";
+    }
+
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            out += "monitor_rss_kb " + QByteArray::number(fields[1].toLongLong() * (sysconf(_SC_PAGESIZE) / 1024)) + "\n";
+        }
+    }
+
+    out += "last_full_extract_ms " + QByteArray::number(lastFullExtractMs) + "\n";
+    out += "last_delta_apply_ms " + QByteArray::number(lastDeltaApplyMs) + "\n";
+    out += "last_swap_downtime_ms " + QByteArray::number(lastSwapDowntimeMs) + "\n";
+    out += "last_sequence_ms " + QByteArray::number(lastSequenceMs) + "\n";
+    out += "last_sequence_serial_ms " + QByteArray::number(lastSequenceSerialMs) + "\n";
+    out += "crash_records " + QByteArray::number(crashSnapshot->listRecords().size()) + "\n";
+    out += "tracing " + QByteArray(Tracer::isEnabled() ? "1" : "0") + "\n";
+    out += "log_dir " + logStore->directory().toUtf8() + "\n";
+    const ChunkStore::Stats storeStats = chunkStore->stats();
+    out += "package_store_packages " + QByteArray::number(storeStats.packages) + "\n";
+    out += "package_store_chunks " + QByteArray::number(storeStats.chunks) + "\n";
+    out += "package_store_logical_bytes " + QByteArray::number(storeStats.logicalBytes) + "\n";
+    out += "package_store_stored_bytes " + QByteArray::number(storeStats.storedBytes) + "\n";
+    out += "package_store_dedup_ratio " + QByteArray::number(storeStats.ratio(), 'f', 2) + "\n";
+    const TrashCollector::Stats trashStats = trashCollector->stats();
+    const ThermalMonitor::Sample thermal = thermalMonitor->lastSample();
+    if (thermal.hasTemperature) {
+        out += "soc_temp_millicelsius " + QByteArray::number(thermal.milliCelsius) + "\n";
+    }
+    if (thermal.hasThrottled) {
+        out += "soc_throttled " + QByteArray::number(thermal.throttled) + "\n";
+    }
+    out += "thermal_level " + QByteArray::number(thermalMonitor->level()) + "\n";
+    out += "trash_pending_trees " + QByteArray::number(trashStats.pendingTrees) + "\n";
+    out += "trash_reclaimed_entries " + QByteArray::number(trashStats.reclaimedEntries) + "\n";
+    out += "trash_reclaimed_bytes " + QByteArray::number(trashStats.reclaimedBytes) + "\n";
+    out += "trash_paused " + QByteArray(trashStats.paused ? "1" : "0") + "\n";
+    out += "privileged_helper " + QByteArray(privHelper->isRunning() ? "1" : "0") + "\n";
+    out += "privileged_helper_requests " + QByteArray::number(privHelper->completedRequests()) + "\n";
+    out += "privileged_helper_avg_rtt_us " + QByteArray::number(privHelper->averageRoundTripUs(), 'f', 1) + "\n";
+    const LoopLagProbe::Stats lag = loopLagProbe->stats();
+    out += "loop_lag_samples " + QByteArray::number(lag.samples) + "\n";
+    out += "loop_lag_p50_us " + QByteArray::number(lag.p50Us) + "\n";
+    out += "loop_lag_p90_us " + QByteArray::number(lag.p90Us) + "\n";
+    out += "loop_lag_p99_us " + QByteArray::number(lag.p99Us) + "\n";
+    out += "loop_lag_max_us " + QByteArray::number(lag.maxUs) + "\n";
+    out += "loop_stalls " + QByteArray::number(lag.stalls) + "\n";
+    const QVector<LoopLagProbe::Stall> stalls = loopLagProbe->recentStalls();
+    if (!stalls.isEmpty()) {
+        out += "loop_last_stall_ms " + QByteArray::number(stalls.first().lagUs / 1000) + "\n";
+        out += "loop_last_stall_handler " + stalls.first().handler.toUtf8() + "\n";
+    }
+    const WebSocketClient::DeliveryStats delivery = websocketClient->deliveryStats();
+    out += "ws_msg_sent " + QByteArray::number(delivery.sent) + "\n";
+    out += "ws_msg_acked " + QByteArray::number(delivery.acked) + "\n";
+    out += "ws_msg_retransmits " + QByteArray::number(delivery.retransmits) + "\n";
+    out += "ws_msg_unacked " + QByteArray::number(delivery.unacked) + "\n";
+    out += "ws_msg_in_flight " + QByteArray::number(delivery.inFlight) + "\n";
+    out += "ws_peer_acks " + QByteArray(delivery.peerAcknowledges ? "1" : "0") + "\n";
+    out += "ws_rtt_samples " + QByteArray::number(delivery.rttSamples) + "\n";
+    out += "ws_rtt_p50_us " + QByteArray::number(delivery.rttP50Us) + "\n";
+    out += "ws_rtt_p90_us " + QByteArray::number(delivery.rttP90Us) + "\n";
+    out += "ws_rtt_p99_us " + QByteArray::number(delivery.rttP99Us) + "\n";
+    out += "ws_rtt_max_us " + QByteArray::number(delivery.rttMaxUs) + "\n";
+    return out;
 }
 
 void QuarcsMonitor::monitorProcess()
 {
+    QMANAGE_TRACE_SCOPE("monitorProcess");
+    TrafficRecorder::record(TrafficRecorder::Timer, QByteArrayLiteral("monitorProcess"));
+    updateServiceStatus();
+    trashCollector->setPaused(updateInProgress());
+
     // 只依据当前进程管理的 qtServerProcess 状态来判断 QT 端是否在运行，
     // 不再通过 pgrep 等手段检测系统中其它同名进程，做到“只认自己这份 QProcess”。
     bool processRunning = false;
@@ -108,7 +590,7 @@ void QuarcsMonitor::monitorProcess()
         {
             qDebug() << "QT server is not running, but update sequence is in progress. "
                      << "Skip qtServerIsOver notifications during update.";
-            QTimer::singleShot(1000, this, &QuarcsMonitor::monitorProcess);
+            QTimer::singleShot(config->monitorIntervalMs, this, &QuarcsMonitor::monitorProcess);
             return;
         }
 
@@ -131,11 +613,13 @@ void QuarcsMonitor::monitorProcess()
             QDateTime currentTime = QDateTime::currentDateTime();
             int elapsedSecs = restartStartTime.secsTo(currentTime);
             
-            if (elapsedSecs > restartTimeout) {
+            if (elapsedSecs > config->restartTimeoutSecs) {
                 // 重启超时，发送信息并重置状态
                 qDebug() << "QT Server restart timed out after" << elapsedSecs << "seconds";
+                Tracer::instant("qtServerIsOver", "restart timeout", 15);
                 websocketClient->messageSend("qtServerIsOver");
                 isRestarting = false;
+                saveState();
             } else {
                 qDebug() << "Still waiting for QT Server to start, elapsed:" << elapsedSecs << "seconds";
             }
@@ -143,18 +627,19 @@ void QuarcsMonitor::monitorProcess()
         // 仅当不处于重启过程中，且 QT 端曾经成功运行/初始化过时，才发送 qtServerIsOver。
         // 避免在程序刚启动、QT 端尚未拉起之前就向前端发“已结束”信号。
         else if (!isRestarting && (lastQtServerRunning || qtServerInitSuccess)) {
+            Tracer::instant("qtServerIsOver");
             websocketClient->messageSend("qtServerIsOver");
             qtServerInitSuccess = false;
         }
         
-        QTimer::singleShot(1000, this, &QuarcsMonitor::monitorProcess);
+        QTimer::singleShot(config->monitorIntervalMs, this, &QuarcsMonitor::monitorProcess);
     } else {
         // 检测到进程存在
         qtServerInitSuccess = false;
         lastQtServerRunning = true;
         
-        // 发送检测 / 重启相关信号时做 30 秒节流控制：
-        // 一次发送后，30 秒内不再重复发送，避免过于频繁。
+        // 发送检测 / 重启相关信号时做节流控制（testSignalThrottleSecs，默认 30 秒）：
+        // 一次发送后，节流间隔内不再重复发送，避免过于频繁。
         QDateTime now = QDateTime::currentDateTime();
         bool canSendTestSignal = false;
         if (!lastTestQtServerProcessTime.isValid())
@@ -165,7 +650,7 @@ void QuarcsMonitor::monitorProcess()
         else
         {
             int secsDiff = lastTestQtServerProcessTime.secsTo(now);
-            if (secsDiff >= 30)
+            if (secsDiff >= config->testSignalThrottleSecs)
             {
                 canSendTestSignal = true;
             }
@@ -183,11 +668,12 @@ void QuarcsMonitor::monitorProcess()
             // qDebug() << "发送 testQtServerProcess 检测信号";
         }
 
-        QTimer::singleShot(1000, this, SLOT(checkQtServerInitSuccess()));
+        QTimer::singleShot(config->monitorIntervalMs, this, SLOT(checkQtServerInitSuccess()));
         
         // 如果检测到进程且正在重启中，重置重启标志
         if (isRestarting) {
             isRestarting = false;
+            saveState();
             qDebug() << "QT Server restart completed successfully";
         }
     }
@@ -195,8 +681,9 @@ void QuarcsMonitor::monitorProcess()
 
 void QuarcsMonitor::checkQtServerInitSuccess()
 {
+    TrafficRecorder::record(TrafficRecorder::Timer, QByteArrayLiteral("checkQtServerInitSuccess"));
     // 去掉 QT 端“卡死”判断：直接跳过原有计数逻辑，仅周期性回到进程监控。
-    QTimer::singleShot(1000, this, &QuarcsMonitor::monitorProcess);
+    QTimer::singleShot(config->monitorIntervalMs, this, &QuarcsMonitor::monitorProcess);
     return;
 
     // 在顺序更新过程中，不再向前端重复推送 QT 服务器未启动/阻塞的告警，
@@ -214,7 +701,7 @@ void QuarcsMonitor::checkQtServerInitSuccess()
         qDebug() << "Resetting lost count during restart process";
     }
 
-    QTimer::singleShot(1000, this, &QuarcsMonitor::monitorProcess);
+    QTimer::singleShot(config->monitorIntervalMs, this, &QuarcsMonitor::monitorProcess);
 }
 
 void QuarcsMonitor::getHostAddress()
@@ -225,6 +712,7 @@ void QuarcsMonitor::getHostAddress()
 
 void QuarcsMonitor::tryGetHostAddress()
 {
+    TrafficRecorder::record(TrafficRecorder::Timer, QByteArrayLiteral("tryGetHostAddress"));
     QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
     bool found = false;
 
@@ -239,7 +727,7 @@ void QuarcsMonitor::tryGetHostAddress()
                 qDebug() << "Local IP Address:" << localIpAddress;
 
                 if (!localIpAddress.isEmpty()) {
-                    QUrl getUrl(QStringLiteral("ws://%1:8600").arg(localIpAddress));
+                    QUrl getUrl(QStringLiteral("ws://%1:%2").arg(localIpAddress).arg(websocketPort));
                     qDebug() << "WebSocket URL:" << getUrl.toString();
                     websocketUrl = getUrl;
                     found = true;
@@ -255,16 +743,16 @@ void QuarcsMonitor::tryGetHostAddress()
     }
 
     retryCount++;
-    if (retryCount < maxRetries) {
+    if (retryCount < config->networkMaxRetries) {
         // 使用QTimer替代QThread::sleep
         if (!networkRetryTimer) {
             networkRetryTimer = new QTimer(this);
             networkRetryTimer->setSingleShot(true);
             connect(networkRetryTimer, &QTimer::timeout, this, &QuarcsMonitor::tryGetHostAddress);
         }
-        networkRetryTimer->start(5000); // 5秒后重试
+        networkRetryTimer->start(config->networkRetryIntervalMs);
     } else {
-        qCritical() << "Failed to detect any network interfaces after" << maxRetries << "attempts.";
+        qCritical() << "Failed to detect any network interfaces after" << config->networkMaxRetries << "attempts.";
     }
 }
 
@@ -286,10 +774,21 @@ void QuarcsMonitor::autoStartQtIfNotRunning()
 void QuarcsMonitor::receivedMessage(const QString &message)
 {
     QStringList messageList = message.split(":");
+    TraceSpan span("dispatch", messageList[0]);
     // qDebug() << "Received message:" << message;
     if (messageList[0] == "ServerInitSuccess") {
         qtServerInitSuccess = true;
         isRestarting = false; // 收到服务器初始化成功消息，重置重启标志
+        saveState();
+        StartupTrace::mark(StartupTrace::ServerInitSuccess);
+        StartupTrace::report();
+        Tracer::complete("restart_to_init", traceRestartStartNs);
+        traceRestartStartNs = 0;
+        if (swapDowntimeTimer.isValid()) {
+            lastSwapDowntimeMs = swapDowntimeTimer.elapsed();
+            swapDowntimeTimer.invalidate();
+            qDebug() << "暂存安装：目录交换后 QT 服务器初始化完成，总停机时间" << lastSwapDowntimeMs << "ms";
+        }
     }else if (messageList[0] == "restartQtServer") {
         if (!isRestarting || !qtServerInitSuccess) {
             reRunQTServer();
@@ -309,13 +808,92 @@ void QuarcsMonitor::receivedMessage(const QString &message)
         qDebug() << "ForceUpdate";
         // 强制更新
         forceUpdate();
+    }else if (messageList[0] == "rollbackInstall") {
+        rollbackStagedInstall();
+    }else if (messageList[0] == "traceStart") {
+        Tracer::setEnabled(true);
+        websocketClient->messageSend("traceStart:ok");
+    }else if (messageList[0] == "traceStop") {
+        Tracer::setEnabled(false);
+        websocketClient->messageSend("traceStop:ok");
+    }else if (messageList[0] == "dumpTrace") {
+        const QString path = dumpTrace();
+        websocketClient->messageSend(path.isEmpty() ? QString("dumpTrace:failed") : "dumpTrace:" + path);
+    }else if (messageList[0] == "getLogs" && messageList.size() >= 2) {
+        // getLogs:<起始毫秒>[:<结束毫秒>]，时间为 Unix 毫秒时间戳，省略结束时间表示到现在
+        const qint64 fromMs = messageList[1].toLongLong();
+        const qint64 toMs = messageList.size() >= 3 ? messageList[2].toLongLong()
+                                                    : QDateTime::currentMSecsSinceEpoch();
+        sendLogs(fromMs, toMs);
+    }else if (messageList[0] == "getThermalState") {
+        websocketClient->messageSend("thermalState:" + thermalMonitor->stateText());
+    }else if (messageList[0] == "packageStoreStats") {
+        const ChunkStore::Stats stats = chunkStore->stats();
+        websocketClient->messageSend("packageStoreStats:" + QString::number(stats.packages) + ":"
+                                     + QString::number(stats.logicalBytes) + ":"
+                                     + QString::number(stats.storedBytes) + ":"
+                                     + QString::number(stats.ratio(), 'f', 2));
+    }else if (messageList[0] == "restorePackage" && messageList.size() >= 2) {
+        restorePackage(messageList[1]);
+    }else if (messageList[0] == "listCrashRecords") {
+        websocketClient->messageSend("crashRecords:" + crashSnapshot->listRecords().join(","));
+    }else if (messageList[0] == "getCrashRecord" && messageList.size() >= 2) {
+        const QByteArray record = crashSnapshot->readRecord(messageList[1]);
+        websocketClient->messageSend("crashRecord:" + messageList[1] + ":"
+                                     + (record.isEmpty() ? QString("notFound") : QString::fromUtf8(record)));
+    }
+}
+
+// 从去重存储重建某个版本的原 zip，放回更新包目录：
+// packageRestored:<版本号>:<ok|failed|exists|notFound>
+void QuarcsMonitor::restorePackage(const QString &version)
+{
+    const PackageIndex::PackageInfo info = packageIndex->find(version);
+    if (!info.isValid() || !info.inStore) {
+        websocketClient->messageSend("packageRestored:" + version + ":"
+                                     + (info.isValid() ? "exists" : "notFound"));
+        return;
     }
+
+    ChunkStore *store = chunkStore;
+    const QString fileName = info.fileName;
+    const QString destPath = UpdatePackPath + fileName;
+    backgroundJobs.run([this, store, version, fileName, destPath]() {
+        QString error;
+        const bool ok = store->rebuildArchive(fileName, destPath, &error);
+        QMetaObject::invokeMethod(this, [=]() {
+            if (!ok) {
+                qDebug() << "从去重存储重建更新包失败:" << error;
+            }
+            websocketClient->messageSend("packageRestored:" + version + ":" + (ok ? "ok" : "failed"));
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuarcsMonitor::sendLogs(qint64 fromMs, qint64 toMs)
+{
+    // 读取和解压日志段放到后台线程，结果回到主线程发送：
+    // logData:<起始毫秒>:<结束毫秒>:<是否截断 0/1>:<日志行>
+    LogStore *store = logStore;
+    const int maxBytes = config->logQueryMaxBytes;
+    backgroundJobs.run([this, store, fromMs, toMs, maxBytes]() {
+        bool truncated = false;
+        const QByteArray lines = store->query(fromMs, toMs, maxBytes, &truncated);
+        QMetaObject::invokeMethod(this, [=]() {
+            websocketClient->messageSend(QString("logData:%1:%2:%3:").arg(fromMs).arg(toMs).arg(truncated ? 1 : 0)
+                                         + QString::fromUtf8(lines));
+        }, Qt::QueuedConnection);
+    });
 }
 
 void QuarcsMonitor::reRunQTServer()
 {
+    QMANAGE_TRACE_SCOPE("reRunQTServer");
+    traceRestartStartNs = Tracer::isEnabled() ? Tracer::nowNs() : 0;
     isRestarting = true;
     restartStartTime = QDateTime::currentDateTime();
+    qtServerRestartCount++;
+    saveState();
     checkQtServerLostCount = 0;
 
     killQTServer();
@@ -327,11 +905,16 @@ void QuarcsMonitor::reRunQTServer()
         connect(restartTimer, &QTimer::timeout, this, &QuarcsMonitor::startQTServer);
     }
     
-    restartTimer->start(3000); // 3秒后启动
+    restartTimer->start(config->restartDelayMs);
+    traceRestartDelayStartNs = Tracer::isEnabled() ? Tracer::nowNs() : 0;
 }
 
 void QuarcsMonitor::startQTServer()
 {
+    QMANAGE_TRACE_SCOPE("startQTServer");
+    TrafficRecorder::record(TrafficRecorder::Timer, QByteArrayLiteral("startQTServer"));
+    Tracer::complete("restart_delay", traceRestartDelayStartNs);
+    traceRestartDelayStartNs = 0;
     qDebug() << "Re-running QT Server via QProcess";
 
     // 如果之前已经有一个 QProcess 在管理 QT 端，先清理掉
@@ -340,11 +923,15 @@ void QuarcsMonitor::startQTServer()
         if (qtServerProcess->state() != QProcess::NotRunning)
         {
             qDebug() << "Previous QT Server process still running, killing it first";
+            qtServerStopRequested = true;
             qtServerProcess->kill();
             qtServerProcess->waitForFinished(3000);
         }
-        qtServerProcess->deleteLater();
-        qtServerProcess = nullptr;
+        // finished 回调可能已在 waitForFinished 中清理了指针
+        if (qtServerProcess) {
+            qtServerProcess->deleteLater();
+            qtServerProcess = nullptr;
+        }
     }
 
     // 启动前，先尝试清理掉系统中可能残留的旧 QT 端进程（包括孤儿进程），
@@ -352,22 +939,31 @@ void QuarcsMonitor::startQTServer()
     killAllQtServerProcesses();
 
     qtServerProcess = new QProcess(this);
+    qtServerStopRequested = false;
 
     // 直接由 QProcess 启动 QT 端可执行文件，使用绝对路径，方便后续用 pkill -f 精确匹配并清理所有同名进程。
-    qtServerProcess->setWorkingDirectory("/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram/src/BUILD");
-    qtServerProcess->setProgram("/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram/src/BUILD/client");
+    qtServerProcess->setWorkingDirectory(qtServerWorkDir);
+    qtServerProcess->setProgram(qtServerProgram);
     qtServerProcess->setProcessChannelMode(QProcess::MergedChannels);
 
-    // 直接透传 QT 端标准输出到当前进程的 stdout，保持原始格式（不加前缀、不转义换行/中文）
+    // 直接透传 QT 端标准输出到当前进程的 stdout，保持原始格式（不加前缀、不转义换行/中文）。
+    // 按整行写出，避免与本进程自己的日志在行中间交错。
+    qtServerOutput.reset();
     connect(qtServerProcess, &QProcess::readyReadStandardOutput,
             this, [this]() {
                 if (!qtServerProcess) return;
-                const QByteArray data = qtServerProcess->readAllStandardOutput();
-                if (!data.isEmpty()) {
-                    // 使用 C 标准库直接写出原始字节，避免 QString 转码导致中文乱码或转义 \n
-                    std::fwrite(data.constData(), 1, static_cast<size_t>(data.size()), stdout);
-                    std::fflush(stdout);
+                char buf[4096];
+                qint64 n;
+                while ((n = qtServerProcess->read(buf, sizeof(buf))) > 0) {
+                    qtServerOutput.feed(buf, static_cast<size_t>(n), [this](const char *line, size_t size) {
+                        logStore->append('Q', line, static_cast<int>(size));
+                        crashSnapshot->recordLine(line, size);
+                        // 使用 C 标准库直接写出原始字节，避免 QString 转码导致中文乱码或转义 \n
+                        std::fwrite(line, 1, size, stdout);
+                        std::fputc('\n', stdout);
+                    });
                 }
+                std::fflush(stdout);
             });
 
     connect(qtServerProcess,
@@ -376,6 +972,29 @@ void QuarcsMonitor::startQTServer()
             [this](int exitCode, QProcess::ExitStatus exitStatus) {
                 qDebug() << "QT Server process finished, exitCode =" << exitCode
                          << ", exitStatus =" << exitStatus;
+                Tracer::instant("qtServerFinished", QString("exitCode=%1 crashed=%2")
+                                                        .arg(exitCode).arg(exitStatus == QProcess::CrashExit));
+                // 回放时只复现非本进程要求的退出
+                TrafficRecorder::record(TrafficRecorder::Child, QString("qtServer:finished:%1:%2:%3")
+                                                                    .arg(exitCode)
+                                                                    .arg(exitStatus == QProcess::CrashExit ? 1 : 0)
+                                                                    .arg(qtServerStopRequested ? 1 : 0));
+
+                // 输出最后一行没有换行符的内容
+                qtServerOutput.finish([this](const char *line, size_t size) {
+                    logStore->append('Q', line, static_cast<int>(size));
+                    crashSnapshot->recordLine(line, size);
+                    std::fwrite(line, 1, size, stdout);
+                    std::fputc('\n', stdout);
+                });
+                std::fflush(stdout);
+
+                // 非主动结束的异常退出：保存崩溃现场并通知前端
+                const QString crashId = crashSnapshot->freeze(exitCode, exitStatus, qtServerStopRequested);
+                if (!crashId.isEmpty()) {
+                    qDebug() << "QT 端异常退出，已保存崩溃记录:" << crashId;
+                    websocketClient->messageSend("qtServerCrashed:" + crashId);
+                }
 
                 if (qtServerProcess) {
                     qtServerProcess->deleteLater();
@@ -385,6 +1004,7 @@ void QuarcsMonitor::startQTServer()
                 // 如果是在重启流程中结束的，也认为重启流程到此结束
                 if (isRestarting) {
                     isRestarting = false;
+                    saveState();
                 }
             });
 
@@ -398,14 +1018,21 @@ void QuarcsMonitor::startQTServer()
     if (!qtServerProcess->waitForStarted(5000)) {
         qDebug() << "Failed to start QT Server via QProcess, error:"
                  << qtServerProcess->errorString();
+        TrafficRecorder::record(TrafficRecorder::Child, QByteArrayLiteral("qtServer:failedToStart"));
         isRestarting = false;
+        saveState();
         qtServerProcess->deleteLater();
         qtServerProcess = nullptr;
+        return;
     }
+    StartupTrace::mark(StartupTrace::ChildSpawn);
+    TrafficRecorder::record(TrafficRecorder::Child, "qtServer:started:" + QByteArray::number(qtServerProcess->processId()));
+    crashSnapshot->attach(qtServerProcess->processId(), qtServerProgram);
 }
 
 void QuarcsMonitor::killQTServer()
 {
+    QMANAGE_TRACE_SCOPE("killQTServer");
     // 使用 QProcess 管理 QT 端，只杀掉由当前监控程序启动的这一份，
     // 不再通过 pkill 之类的命令去模糊匹配进程名，避免误杀自身和其它服务。
     if (!qtServerProcess) {
@@ -418,6 +1045,7 @@ void QuarcsMonitor::killQTServer()
     if (qtServerProcess->state() != QProcess::NotRunning)
     {
         // 优先尝试优雅结束
+        qtServerStopRequested = true;
         qtServerProcess->terminate();
         if (!qtServerProcess->waitForFinished(5000)) {
             qDebug() << "QT Server did not terminate gracefully, forcing kill";
@@ -426,8 +1054,11 @@ void QuarcsMonitor::killQTServer()
         }
     }
 
-    qtServerProcess->deleteLater();
-    qtServerProcess = nullptr;
+    // finished 回调可能已在 waitForFinished 中清理了指针
+    if (qtServerProcess) {
+        qtServerProcess->deleteLater();
+        qtServerProcess = nullptr;
+    }
 }
 
 // 杀掉当前机器上所有与 QT 端可执行文件路径匹配的旧进程（包括孤儿进程）
@@ -435,7 +1066,7 @@ void QuarcsMonitor::killAllQtServerProcesses()
 {
     // 这里使用较为精确的匹配：仅匹配包含 client 可执行文件完整路径的进程命令行，
     // 避免误杀其它无关进程。
-    const QString targetPath = "/home/quarcs/workspace/QUARCS/QUARCS_QT-SeverProgram/src/BUILD/client";
+    const QString targetPath = qtServerProgram;
 
     qDebug() << "killAllQtServerProcesses: try to kill any existing QT server processes with path:" << targetPath;
 
@@ -464,152 +1095,49 @@ void QuarcsMonitor::checkVueClientVersion(bool isForceUpdate)
     // 使用全局总版本号而不是 VueClientVersion
     qDebug() << "当前全局总版本号（字符串）：" << totalVersion;
     bool okCurrent = false;
-    int currentVersion = parseVersionToInt(totalVersion, okCurrent);
+    quint64 currentVersion = PackageIndex::parseVersionKey(totalVersion, okCurrent);
     if (!okCurrent)
     {
         qDebug() << "【警告】无法解析当前全局总版本号：" << totalVersion
                  << "，将按 0.0.0 处理";
         currentVersion = 0;
     }
-    qDebug() << "当前全局总版本号（整数）：" << currentVersion;
 
-    qDebug() << "更新包路径：" << UpdatePackPath;
-    
-    // 检查UpdatePackPath文件夹下是否存在更新包文件
-    QDir dir(UpdatePackPath);
-    if (dir.exists()) {
-        qDebug() << "更新包目录存在，开始检索文件...";
-        
-        QStringList nameFilters;
-        nameFilters << "*.zip";  // 只检查zip文件
-        dir.setNameFilters(nameFilters);
-        
-        QStringList fileList = dir.entryList(QDir::Files, QDir::Name);
-        qDebug() << "找到" << fileList.size() << "个zip文件：" << fileList.join(", ");
-        
-        if (fileList.isEmpty()) {
-            qDebug() << "【警告】更新包目录中没有找到任何zip文件，无法检查更新";
-            return;
-        }
-        
-        // 清空顺序更新队列
-        pendingUpdateVersions.clear();
-        int highestVersion = currentVersion;
-        QString highestVersionFile;
-        
-        // 查找所有高于当前版本的更新包，并按版本号排序
-        foreach (const QString &file, fileList) {
-            qDebug() << "正在分析文件：" << file;
-            
-            // 提取版本号，允许文件名格式为：版本号.zip 或 版本号-其他信息.zip
-            // 之前使用 file.split(\".\").at(0) 会把 \"1.0.2.zip\" 错误解析为 \"1\"
-            // 这里改为从最后一个 '.' 之前截取，得到完整的 \"1.0.2\" 部分
-            QString baseName = file;
-            int lastDotIndex = baseName.lastIndexOf('.');
-            if (lastDotIndex > 0) {
-                baseName = baseName.left(lastDotIndex);
-            }
-            qDebug() << "  基本名称（去除扩展名）：" << baseName;
-            
-            QString versionStr = baseName.split("-").at(0);
-            qDebug() << "  提取的版本号字符串：" << versionStr;
-
-            bool okFile = false;
-            int fileVersion = parseVersionToInt(versionStr, okFile);
-            if (!okFile) {
-                qDebug() << "  【错误】无法将'" << versionStr << "'解析为有效的版本号，跳过此文件";
-                continue;
-            }
-            
-            qDebug() << "  文件版本号（整数）：" << fileVersion;
-
-            // 普通检查模式：只收集「高于当前版本」的包
-            // ForceUpdate 模式：不管当前认为是多少版本，把所有合法包都纳入顺序更新队列
-            bool shouldCollect = false;
-            if (isForceUpdate)
-            {
-                shouldCollect = true;
-            }
-            else
-            {
-                shouldCollect = (fileVersion > currentVersion);
-            }
-
-            if (shouldCollect) {
-                if (!isForceUpdate && fileVersion > currentVersion) {
-                    qDebug() << "  发现高于当前版本的更新包：" << fileVersion << ">" << currentVersion;
-                } else if (isForceUpdate) {
-                    qDebug() << "  ForceUpdate 模式下收集更新包，版本号：" << fileVersion;
-                }
-
-                // 收集到候选列表中，后续统一排序
-                pendingUpdateVersions.append(versionStr);
-                if (fileVersion > highestVersion) {
-                    highestVersion = fileVersion;
-                    highestVersionFile = versionStr;
-                }
-            } else {
-                qDebug() << "  版本号不高于当前版本，且当前非 ForceUpdate 模式：" << fileVersion << "<=" << currentVersion;
-            }
-        }
-        
-        // 去重并按版本号排序（升序）
-        if (!pendingUpdateVersions.isEmpty())
-        {
-            // 使用临时列表对 (versionInt, versionStr) 排序
-            QList<QPair<int, QString>> versionPairs;
-            for (const QString &vStr : pendingUpdateVersions)
-            {
-                bool okVal = false;
-                int vInt = parseVersionToInt(vStr, okVal);
-                if (okVal)
-                {
-                    versionPairs.append(qMakePair(vInt, vStr));
-                }
-            }
+    // 直接查询常驻索引，不再访问文件系统
+    if (packageIndex->count() == 0) {
+        qDebug() << "【警告】更新包目录中没有找到任何zip文件，无法检查更新，路径：" << UpdatePackPath;
+        return;
+    }
 
-            std::sort(versionPairs.begin(), versionPairs.end(),
-                      [](const QPair<int, QString> &a, const QPair<int, QString> &b) {
-                          return a.first < b.first;
-                      });
+    // 普通检查模式：只收集「高于当前版本」的包
+    // ForceUpdate 模式：不管当前认为是多少版本，把所有合法包都纳入顺序更新队列
+    // 索引本身按版本键升序排列且每个版本只有一项，无需再排序去重
+    const QList<PackageIndex::PackageInfo> candidates =
+        isForceUpdate ? packageIndex->all() : packageIndex->newerThan(currentVersion);
 
-            pendingUpdateVersions.clear();
-            for (const auto &pair : versionPairs)
-            {
-                if (!pendingUpdateVersions.contains(pair.second))
-                {
-                    pendingUpdateVersions.append(pair.second);
-                }
-            }
-        }
+    pendingUpdateVersions.clear();
+    foreach (const PackageIndex::PackageInfo &info, candidates) {
+        pendingUpdateVersions.append(info.version);
+    }
 
-        qDebug() << "扫描完成，高于当前版本的更新包数量：" << pendingUpdateVersions.size()
-                 << "，当前版本号：" << currentVersion;
+    qDebug() << "扫描完成，待更新包数量：" << pendingUpdateVersions.size()
+             << "，当前版本号：" << totalVersion;
 
-        if (!pendingUpdateVersions.isEmpty()) {
-            highestVersionFile = pendingUpdateVersions.last();
-            currentMaxClientVersion = highestVersionFile;
+    if (!pendingUpdateVersions.isEmpty()) {
+        const QString highestVersionFile = pendingUpdateVersions.last();
+        currentMaxClientVersion = highestVersionFile;
 
-            qDebug() << "【发现更新】最高版本更新包：" << highestVersionFile;
-            if (!isForceUpdate) {
-                // 通知前端有新的最高版本可用
-                websocketClient->messageSend("checkHasNewUpdatePack:" + highestVersionFile);
-                qDebug() << "已发送更新通知：checkHasNewUpdatePack:" + highestVersionFile;
-            } else {
-                // 强制更新模式下，仅更新内部队列，不重复提示
-                qDebug() << "强制更新模式下，仅更新内部顺序更新队列";
-            }
+        qDebug() << "【发现更新】最高版本更新包：" << highestVersionFile;
+        if (!isForceUpdate) {
+            // 通知前端有新的最高版本可用
+            websocketClient->messageSend("checkHasNewUpdatePack:" + highestVersionFile);
+            qDebug() << "已发送更新通知：checkHasNewUpdatePack:" + highestVersionFile;
         } else {
-            qDebug() << "【无更新】没有找到比当前版本" << currentVersion << "更高的版本，无需更新";
+            // 强制更新模式下，仅更新内部队列，不重复提示
+            qDebug() << "强制更新模式下，仅更新内部顺序更新队列";
         }
     } else {
-        qDebug() << "【错误】更新包目录不存在，路径：" << UpdatePackPath;
-        // 可选：创建目录
-        if (dir.mkpath(UpdatePackPath)) {
-            qDebug() << "【提示】已创建更新包目录：" << UpdatePackPath;
-        } else {
-            qDebug() << "【错误】无法创建更新包目录：" << UpdatePackPath;
-        }
+        qDebug() << "【无更新】没有找到比当前版本" << totalVersion << "更高的版本，无需更新";
     }
     qDebug() << "版本检查完成";
 }
@@ -617,105 +1145,379 @@ void QuarcsMonitor::checkVueClientVersion(bool isForceUpdate)
 void QuarcsMonitor::updateCurrentClient(const QString &newFileVersion)
 {
     qDebug() << "updateCurrentClient:" << newFileVersion;
+    // 更新结束后由 monitorProcess 恢复后台回收
+    trashCollector->setPaused(true);
     
     QDir dir(UpdatePackPath);
     if (!dir.exists()) {
         qDebug() << "UpdatePackPath does not exist";
-        websocketClient->messageSend("update_error:0:Update package path does not exist");
+        websocketClient->messageSend("update_error:0:Update package path does not exist", true);
         return;
     }
-    
-    // 查找匹配的更新包文件
-    QString targetFile;
-    foreach (const QString &file, dir.entryList(QDir::Files)) {
-        // 与 checkVueClientVersion 中保持一致的版本号提取逻辑：
-        // 支持：1.0.2.zip、1.0.2-suffix.zip 等文件名格式
-        QString baseName = file;
-        int lastDotIndex = baseName.lastIndexOf('.');
-        if (lastDotIndex > 0) {
-            baseName = baseName.left(lastDotIndex);   // 去掉扩展名 -> 1.0.2 或 1.0.2-suffix
+
+    currentUpdateVersion = newFileVersion;
+    extractTimer.start();
+
+    // 合并模式下最终文件树已经解压好，只需换上本版本自己的 Update.sh
+    if (isSequentialUpdate && isSquashedSequence)
+    {
+        const QString script = UpdatePackPath + "update_scripts/" + newFileVersion + "/Update.sh";
+        const QString target = UpdatePackPath + "update/Update.sh";
+        QFile::remove(target);
+        if (!QFile::copy(script, target))
+        {
+            qDebug() << "合并模式下未找到版本" << newFileVersion << "的更新脚本:" << script;
+        }
+        runUpdateScript();
+        return;
+    }
+
+    // 已在后台预解压过的版本：直接把暂存树移到位，完全跳过解压
+    const QString stagedDir = preStager->takeStaged(packageIndex->find(newFileVersion));
+    if (stagedDir.isEmpty())
+    {
+        updateFromPipeline(newFileVersion);
+        return;
+    }
+    installStagedTree(stagedDir, [this, stagedDir, newFileVersion](bool ok) {
+        if (ok)
+        {
+            lastFullExtractMs = extractTimer.elapsed();
+            qDebug() << "使用预解压的暂存树，跳过解压，耗时" << lastFullExtractMs << "ms";
+            isDeltaUpdate = false;
+            DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", currentUpdateVersion);
+            runUpdateScript();
+            return;
         }
-        QString fileVersion = baseName.split("-").at(0); // 取前缀部分 -> 1.0.2
+        qDebug() << "【警告】暂存树移动失败，改为正常解压:" << stagedDir;
+        removeDirTree(stagedDir);
+        updateFromPipeline(newFileVersion);
+    });
+}
 
-        qDebug() << "检查更新包文件是否匹配版本:" << file
-                 << "解析得到版本号:" << fileVersion
-                 << "目标版本:" << newFileVersion;
+// 顺序更新流水线中，上一个 Update.sh 运行期间已经（或正在）后台解压的版本
+void QuarcsMonitor::updateFromPipeline(const QString &newFileVersion)
+{
+    if (!isSequentialUpdate || pipelineVersion != newFileVersion)
+    {
+        extractUpdatePackage(newFileVersion);
+        return;
+    }
+    if (pipelineBusy)
+    {
+        qDebug() << "流水线：等待版本" << newFileVersion << "的后台解压完成";
+        pipelineWaiting = true;
+        return;
+    }
+    const bool ready = pipelineReady;
+    pipelineVersion.clear();
+    pipelineReady = false;
+    if (!ready)
+    {
+        removeDirTree(pipelineDir());
+        extractUpdatePackage(newFileVersion);
+        return;
+    }
+    installStagedTree(pipelineDir(), [this, newFileVersion](bool ok) {
+        if (ok)
+        {
+            lastFullExtractMs = pipelineExtractMs;
+            sequenceSerialMs += pipelineExtractMs;
+            qDebug() << "流水线：使用后台解压好的暂存树，后台解压耗时" << pipelineExtractMs << "ms";
+            isDeltaUpdate = false;
+            DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", currentUpdateVersion);
+            runUpdateScript();
+            return;
+        }
+        qDebug() << "【警告】流水线暂存树移动失败，改为正常解压";
+        removeDirTree(pipelineDir());
+        extractUpdatePackage(newFileVersion);
+    });
+}
 
-        if (fileVersion == newFileVersion) {
-            targetFile = file;
-            break;
+// 没有现成的暂存树：使用增量包，或解压完整包
+void QuarcsMonitor::extractUpdatePackage(const QString &newFileVersion)
+{
+    // 优先使用增量包：仅当已安装更新树（上一次解压/应用的结果）的版本
+    // 正好是增量包的源版本时才可用；应用失败时会回退到这里走完整包。
+    if (deltaFallbackVersion != newFileVersion)
+    {
+        const QString installedVersion = DeltaUpdate::installedVersion(UpdatePackPath + "update");
+        const QString deltaFile = DeltaUpdate::findDelta(UpdatePackPath, installedVersion, newFileVersion);
+        if (!deltaFile.isEmpty())
+        {
+            qDebug() << "找到增量更新包:" << deltaFile << "，已安装版本:" << installedVersion;
+            startDeltaUpdate(deltaFile);
+            return;
         }
     }
+    deltaFallbackVersion.clear();
+    isDeltaUpdate = false;
+    
+    // 查找匹配的更新包文件
+    const QString targetFile = findPackageFile(newFileVersion);
 
     if (targetFile.isEmpty()) {
         qDebug() << "未找到匹配版本" << newFileVersion << "的更新包";
-        websocketClient->messageSend("update_error:0:No matching version update package found");
+        websocketClient->messageSend("update_error:0:No matching version update package found", true);
         return;
     }
 
+    auto extract = [this, newFileVersion, targetFile]() {
+        // 原 zip 已删除、只保存在去重存储中：不落地 zip，直接从存储流式解压
+        if (packageIndex->find(newFileVersion).inStore) {
+            startStoreExtract(targetFile);
+            return;
+        }
+
+        startUnzip(UpdatePackPath + targetFile, UpdatePackPath);
+        qDebug() << "开始异步解压更新包:" << targetFile;
+    };
+
     // 为了避免上一次解压残留的 /update 目录内容导致本次 unzip 出现
     // “cannot delete old ... No such file or directory” 并返回非 0 退出码，
-    // 在每次解压前主动清理 UpdatePackPath/update 目录。
-    QDir updateTempDir(UpdatePackPath + "update");
-    if (updateTempDir.exists())
+    // 在每次解压前主动清理 UpdatePackPath/update 目录（需要特权助手时删完再解压）。
+    const QString updateTempDir = UpdatePackPath + "update";
+    if (!QDir(updateTempDir).exists())
     {
-        qDebug() << "在解压前清理上一次残留的 update 目录:" << updateTempDir.absolutePath();
-        if (!updateTempDir.removeRecursively())
+        extract();
+        return;
+    }
+    qDebug() << "在解压前清理上一次残留的 update 目录:" << updateTempDir;
+    removeDirTree(updateTempDir, [extract](bool removed) {
+        if (!removed)
         {
             qDebug() << "【警告】无法递归删除 update 临时目录，可能会导致 unzip 报错";
         }
-    }
+        extract();
+    });
+}
 
-    // 异步解压文件
-    unzipProcess = new QProcess(this);
-    connect(unzipProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &QuarcsMonitor::onUnzipFinished);
-    connect(unzipProcess, &QProcess::errorOccurred,
+QString QuarcsMonitor::findPackageFile(const QString &version) const
+{
+    const PackageIndex::PackageInfo info = packageIndex->find(version);
+    qDebug() << "查找版本" << version << "的更新包:" << info.fileName;
+    return info.fileName;
+}
+
+// 把预解压的暂存树中的内容（通常只有 update/ 目录）移到 UpdatePackPath 下，
+// 与 unzip -d UpdatePackPath 的结果一致；暂存树与更新包目录在同一文件系统，只需 rename。
+// 旧的同名目录要交给特权助手删除时，删完再继续，结果通过 done 返回
+void QuarcsMonitor::installStagedTree(const QString &stagedDir, std::function<void(bool ok)> done)
+{
+    const QStringList names = QDir(stagedDir).entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+    installStagedEntries(stagedDir, names, done);
+}
+
+void QuarcsMonitor::installStagedEntries(const QString &stagedDir, QStringList names, std::function<void(bool ok)> done)
+{
+    while (!names.isEmpty()) {
+        const QString name = names.takeFirst();
+        const QString target = UpdatePackPath + name;
+        const QFileInfo targetInfo(target);
+        if (targetInfo.isDir() && !targetInfo.isSymLink()) {
+            removeDirTree(target, [this, stagedDir, name, names, done](bool) {
+                if (!QDir(stagedDir).rename(name, UpdatePackPath + name)) {
+                    done(false);
+                    return;
+                }
+                installStagedEntries(stagedDir, names, done);
+            });
+            return;
+        }
+        if (targetInfo.exists() || targetInfo.isSymLink()) {
+            QFile::remove(target);
+        }
+        if (!QDir(stagedDir).rename(name, target)) {
+            done(false);
+            return;
+        }
+    }
+    QDir().rmdir(stagedDir);
+    done(true);
+}
+
+// 在后台线程中把去重存储里的更新包解压到临时目录，完成后与预解压暂存树一样移到位
+void QuarcsMonitor::startStoreExtract(const QString &fileName)
+{
+    qDebug() << "从去重存储解压更新包:" << fileName;
+    const QString treeDir = UpdatePackPath + ".store-extract";
+    ChunkStore *store = chunkStore;
+    backgroundJobs.run([this, store, fileName, treeDir]() {
+        QDir(treeDir).removeRecursively();
+        QString error;
+        bool ok;
+        {
+            TraceSpan span("store_extract", fileName);
+            ok = store->extractTree(fileName, treeDir, &error);
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onStoreExtractFinished(ok, error, treeDir);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuarcsMonitor::onStoreExtractFinished(bool ok, const QString &error, const QString &treeDir)
+{
+    auto fail = [this, error, treeDir]() {
+        qDebug() << "从去重存储解压失败:" << error;
+        removeDirTree(treeDir);
+        websocketClient->messageSend("update_error:0:Failed to extract update package", true);
+        if (isSequentialUpdate)
+        {
+            qDebug() << "顺序更新在索引" << currentUpdateIndex << "处解压失败，终止后续更新";
+            failUpdateSequence();
+        }
+    };
+    if (!ok) {
+        fail();
+        return;
+    }
+
+    installStagedTree(treeDir, [this, fail](bool installed) {
+        if (!installed) {
+            fail();
+            return;
+        }
+        lastFullExtractMs = extractTimer.elapsed();
+        qDebug() << "从去重存储解压完成，耗时" << lastFullExtractMs << "ms";
+        isDeltaUpdate = false;
+        DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", currentUpdateVersion);
+        runUpdateScript();
+    });
+}
+
+// 去重存储放在 Web 服务目录之外，为空时使用 ~/.local/share/QMANAGE/package-store
+QString QuarcsMonitor::packageStorePath() const
+{
+    return packageStoreDir.isEmpty()
+               ? QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/package-store"
+               : packageStoreDir;
+}
+
+// 删除已完整入库、且低于当前版本的旧 zip。待更新的新包仍保留 zip，
+// 供预解压、合并解压使用；更新进行中不删除
+void QuarcsMonitor::pruneStoredPackages()
+{
+    if (!config->pruneStoredPackages || updateInProgress()) {
+        return;
+    }
+    bool okCurrent = false;
+    const quint64 currentKey = PackageIndex::parseVersionKey(totalVersion, okCurrent);
+    if (!okCurrent) {
+        return;
+    }
+
+    qint64 freedBytes = 0;
+    foreach (const PackageIndex::PackageInfo &info, packageIndex->all()) {
+        if (info.inStore || info.key >= currentKey || !chunkStore->contains(info)) {
+            continue;
+        }
+        if (QFile::remove(UpdatePackPath + info.fileName)) {
+            qDebug() << "旧更新包已保存到去重存储，删除原 zip:" << info.fileName;
+            freedBytes += info.size;
+        }
+    }
+    if (freedBytes > 0) {
+        const ChunkStore::Stats stats = chunkStore->stats();
+        qDebug() << "释放" << freedBytes << "字节；去重存储共" << stats.packages << "个包，原始"
+                 << stats.logicalBytes << "字节，实际占用" << stats.storedBytes << "字节，去重比"
+                 << QString::number(stats.ratio(), 'f', 2);
+    }
+}
+
+// 增量更新：先把增量包解压到 UpdatePackPath/delta，解压完成后在 onUnzipFinished 中应用
+void QuarcsMonitor::startDeltaUpdate(const QString &deltaFile)
+{
+    isDeltaUpdate = true;
+
+    removeDirTree(UpdatePackPath + "delta");
+
+    startUnzip(UpdatePackPath + deltaFile, UpdatePackPath + "delta");
+    qDebug() << "开始异步解压增量包:" << deltaFile;
+}
+
+// 增量包不可用（解压失败、源文件不匹配、校验失败）时，改用完整包重新执行本次更新
+void QuarcsMonitor::fallbackToFullPackage()
+{
+    qDebug() << "增量更新失败，回退到完整更新包，版本:" << currentUpdateVersion;
+    isDeltaUpdate = false;
+    deltaFallbackVersion = currentUpdateVersion;
+    updateCurrentClient(currentUpdateVersion);
+}
+
+void QuarcsMonitor::startUnzip(const QString &archivePath, const QString &destDir)
+{
+    // 异步解压文件
+    unzipProcess = new QProcess(this);
+    connect(unzipProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &QuarcsMonitor::onUnzipFinished);
+    connect(unzipProcess, &QProcess::errorOccurred,
             this, &QuarcsMonitor::onUnzipError);
     
     // 只监听错误输出（stderr），避免打印大量正常的 inflating 日志
     unzipProcess->setProcessChannelMode(QProcess::SeparateChannels);
+    unzipErrorOutput.reset();
     connect(unzipProcess, &QProcess::readyReadStandardError,
             this, [this]() {
                 if (!unzipProcess) {
                     return;
                 }
-                const QString err = QString::fromLocal8Bit(unzipProcess->readAllStandardError());
-                if (!err.trimmed().isEmpty()) {
-                    qDebug() << "unzip 错误/警告输出:" << err;
-                }
+                const QByteArray err = unzipProcess->readAllStandardError();
+                unzipErrorOutput.feed(err.constData(), static_cast<size_t>(err.size()),
+                                      [](const char *line, size_t size) {
+                                          if (size > 0) {
+                                              qDebug() << "unzip 错误/警告输出:"
+                                                       << QString::fromLocal8Bit(line, static_cast<int>(size));
+                                          }
+                                      });
             });
     
-    QString command = "unzip -o " + UpdatePackPath + targetFile + " -d " + UpdatePackPath;
+    QString command = "unzip -o " + archivePath + " -d " + destDir;
     unzipProcess->start(command);
-    
-    qDebug() << "开始异步解压更新包:" << targetFile;
+    TrafficRecorder::record(TrafficRecorder::Child, QByteArrayLiteral("unzip:started"));
+    traceUnzipStartNs = Tracer::isEnabled() ? Tracer::nowNs() : 0;
 }
 
 void QuarcsMonitor::onUnzipFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
     qDebug() << "unzip 进程结束, exitCode =" << exitCode
              << ", exitStatus =" << exitStatus;
+    TrafficRecorder::record(TrafficRecorder::Child, QString("unzip:finished:%1:%2")
+                                                        .arg(exitCode).arg(exitStatus == QProcess::CrashExit ? 1 : 0));
+    Tracer::complete(isDeltaUpdate ? "unzip_delta" : "unzip", traceUnzipStartNs, currentUpdateVersion);
+    traceUnzipStartNs = 0;
 
     // 进程结束后再读一次错误缓冲区，避免遗漏最后一小段错误信息
     if (unzipProcess) {
-        const QString remaining = QString::fromLocal8Bit(unzipProcess->readAllStandardError());
-        if (!remaining.isEmpty()) {
-            qDebug() << "unzip 结束时剩余错误/警告输出:" << remaining;
-        }
+        const QByteArray remaining = unzipProcess->readAllStandardError();
+        auto printLine = [](const char *line, size_t size) {
+            if (size > 0) {
+                qDebug() << "unzip 结束时剩余错误/警告输出:"
+                         << QString::fromLocal8Bit(line, static_cast<int>(size));
+            }
+        };
+        unzipErrorOutput.feed(remaining.constData(), static_cast<size_t>(remaining.size()), printLine);
+        unzipErrorOutput.finish(printLine);
     }
 
     if (exitCode != 0 || exitStatus != QProcess::NormalExit) {
+        if (isDeltaUpdate) {
+            qDebug() << "增量包解压失败，退出代码:" << exitCode;
+            unzipProcess->deleteLater();
+            unzipProcess = nullptr;
+            fallbackToFullPackage();
+            return;
+        }
+
         qDebug() << "解压失败，退出代码:" << exitCode;
-        websocketClient->messageSend("update_error:0:Failed to extract update package");
+        websocketClient->messageSend("update_error:0:Failed to extract update package", true);
 
         // 如果当前处于顺序更新模式，解压失败也要视为该步骤失败，终止顺序更新流程
         if (isSequentialUpdate)
         {
             qDebug() << "顺序更新在索引" << currentUpdateIndex << "处解压失败，终止后续更新";
-            isSequentialUpdate = false;
-            pendingUpdateVersions.clear();
-            websocketClient->messageSend("update_sequence_failed:" + QString::number(currentUpdateIndex));
+            failUpdateSequence();
         }
 
         unzipProcess->deleteLater();
@@ -723,6 +1525,78 @@ void QuarcsMonitor::onUnzipFinished(int exitCode, QProcess::ExitStatus exitStatu
         return;
     }
     
+    if (isDeltaUpdate) {
+        // 应用与校验要读写整棵更新树，放到后台线程；unzipProcess 保留到完成，期间仍视为更新进行中
+        startDeltaApply();
+        return;
+    }
+
+    lastFullExtractMs = extractTimer.elapsed();
+    qDebug() << "完整包解压完成，耗时" << lastFullExtractMs << "ms"
+             << "（最近一次增量包应用耗时" << lastDeltaApplyMs << "ms）";
+    isDeltaUpdate = false;
+
+    // 记录更新树当前对应的版本，下一次可据此选择增量包
+    DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", currentUpdateVersion);
+
+    unzipProcess->deleteLater();
+    unzipProcess = nullptr;
+
+    runUpdateScript();
+}
+
+// 在后台线程中把解压出的增量包应用到更新树，完成后回到主线程继续
+void QuarcsMonitor::startDeltaApply()
+{
+    const QString deltaDir = UpdatePackPath + "delta";
+    const QString updateDir = UpdatePackPath + "update";
+    const QString version = currentUpdateVersion;
+    backgroundJobs.run([this, deltaDir, updateDir, version]() {
+        QString error;
+        bool applied;
+        {
+            TraceSpan span("delta_apply", version);
+            applied = DeltaUpdate::apply(deltaDir, updateDir, error);
+        }
+        QMetaObject::invokeMethod(this, [=]() {
+            onDeltaApplyFinished(applied, error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuarcsMonitor::onDeltaApplyFinished(bool applied, const QString &error)
+{
+    removeDirTree(UpdatePackPath + "delta");
+    if (unzipProcess) {
+        unzipProcess->deleteLater();
+        unzipProcess = nullptr;
+    }
+
+    if (!applied) {
+        qDebug() << "增量包应用失败:" << error;
+        fallbackToFullPackage();
+        return;
+    }
+
+    lastDeltaApplyMs = extractTimer.elapsed();
+    qDebug() << "增量包应用并校验完成，耗时" << lastDeltaApplyMs << "ms"
+             << "（最近一次完整包解压耗时" << lastFullExtractMs << "ms）";
+    isDeltaUpdate = false;
+
+    // 记录更新树当前对应的版本，下一次可据此选择增量包
+    DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", currentUpdateVersion);
+
+    runUpdateScript();
+}
+
+void QuarcsMonitor::runUpdateScript()
+{
+    // 暂存安装模式：第一次执行脚本前先准备影子目录，复制完成后会再次进入这里
+    if (stagedInstallEnabled && isSequentialUpdate && !stagedShadowReady) {
+        prepareStagedShadow();
+        return;
+    }
+
     qDebug() << "解压完成，开始执行更新脚本";
     
     // 检查更新脚本是否存在
@@ -730,12 +1604,68 @@ void QuarcsMonitor::onUnzipFinished(int exitCode, QProcess::ExitStatus exitStatu
     QFile updateScript(updateScriptPath);
     if (!updateScript.exists()) {
         qDebug() << "更新脚本不存在，路径:" << updateScriptPath;
-        websocketClient->messageSend("update_error:0:Update script does not exist");
-        unzipProcess->deleteLater();
+        websocketClient->messageSend("update_error:0:Update script does not exist", true);
         return;
     }
     
     // 异步执行更新脚本
+    updateScriptOutput.reset();
+    if (privHelper->isRunning()) {
+        // 特权助手以与 sudo 相同的环境在 update/ 目录下执行 bash Update.sh，输出逐帧转发回来
+        helperScriptRequest = privHelper->runScript(stagedInstallEnabled && stagedShadowReady);
+    }
+    if (!helperScriptRequest) {
+        startUpdateProcess();
+    }
+    TrafficRecorder::record(TrafficRecorder::Child, QByteArrayLiteral("update:started"));
+    if (isSequentialUpdate) {
+        updateStep = "script";
+        saveState();
+    }
+    traceScriptStartNs = Tracer::isEnabled() ? Tracer::nowNs() : 0;
+    scriptTimer.start();
+
+    // 本步骤在前台的解压/移动耗时计入串行基线；脚本运行期间后台解压下一个版本
+    if (isSequentialUpdate) {
+        sequenceSerialMs += extractTimer.elapsed();
+        startPipelineExtract();
+    }
+}
+
+// 删除目录：先整体移入回收目录，由后台线程删除，事件循环不等待；无法移入（跨文件系统）时同步删除。
+// Update.sh 以 root 运行，留下的文件当前用户可能删不掉，这时交给特权助手异步删除。
+// done 的参数为是否已删除：同步删除时在返回前调用，交给特权助手时在删完后的事件循环中调用
+void QuarcsMonitor::removeDirTree(const QString &path, std::function<void(bool removed)> done)
+{
+    QDir dir(path);
+    if (trashCollector->discard(path) || !dir.exists() || dir.removeRecursively()) {
+        if (done) {
+            done(true);
+        }
+        return;
+    }
+    const quint32 requestId = privHelper->isRunning()
+                                  ? privHelper->cleanDir(path, [done](int code) {
+                                        if (done) {
+                                            done(code == 0);
+                                        }
+                                    })
+                                  : 0;
+    if (!requestId && done) {
+        done(false);
+    }
+}
+
+// 正在解压或执行更新脚本：期间不删除旧 zip，后台回收也暂停
+bool QuarcsMonitor::updateInProgress() const
+{
+    return isSequentialUpdate || unzipProcess || updateProcess || helperScriptRequest || shadowCopyProcess
+           || shadowCopyRequest;
+}
+
+// 特权助手不可用时，每次通过 sudo 执行更新脚本
+void QuarcsMonitor::startUpdateProcess()
+{
     updateProcess = new QProcess(this);
     updateProcess->setWorkingDirectory(UpdatePackPath + "update/");
     updateProcess->setProcessChannelMode(QProcess::MergedChannels);
@@ -748,24 +1678,168 @@ void QuarcsMonitor::onUnzipFinished(int exitCode, QProcess::ExitStatus exitStatu
     connect(updateProcess, &QProcess::errorOccurred,
             this, &QuarcsMonitor::onUpdateProcessError);
     
-    updateProcess->start("sudo", QStringList() << "bash" << "Update.sh");
-    
-    unzipProcess->deleteLater();
-    unzipProcess = nullptr;
+    if (stagedInstallEnabled && stagedShadowReady) {
+        // sudo 默认会清空环境变量，这里通过 env 显式传给脚本
+        updateProcess->start("sudo", QStringList() << "env"
+                             << "QUARCS_STAGED_INSTALL=1"
+                             << "QUARCS_INSTALL_ROOT=" + StagedInstall::shadowPath(qtServerInstallDir)
+                             << "bash" << "Update.sh");
+    } else {
+        updateProcess->start("sudo", QStringList() << "bash" << "Update.sh");
+    }
+}
+
+// 把当前安装目录完整复制到影子目录，QT 服务器在此期间继续运行
+void QuarcsMonitor::prepareStagedShadow()
+{
+    const QString shadowDir = StagedInstall::shadowPath(qtServerInstallDir);
+    qDebug() << "暂存安装：复制当前安装目录到影子目录" << shadowDir;
+
+    // 影子目录中是上一次交换留下的旧版本，开始新的更新后不再保留
+    shadowHoldsPrevious = false;
+    saveState();
+    removeDirTree(shadowDir, [this, shadowDir](bool removed) {
+        if (!isSequentialUpdate) {
+            return;
+        }
+        if (!removed) {
+            qDebug() << "暂存安装：无法清理旧的影子目录:" << shadowDir;
+            websocketClient->messageSend("update_error:0:Failed to prepare staged install directory", true);
+            failUpdateSequence();
+            return;
+        }
+        startShadowCopy(shadowDir);
+    });
+}
+
+// Update.sh 以 root 运行，安装目录中可能有 root 所有的文件，非特权的 cp -a 会失败或把属主改成当前用户，
+// 因此以 root 复制：优先交给特权助手，不可用时与 Update.sh 一样经 sudo
+void QuarcsMonitor::startShadowCopy(const QString &shadowDir)
+{
+    if (privHelper->isRunning()) {
+        shadowCopyRequest = privHelper->copyShadow();
+        if (shadowCopyRequest) {
+            return;
+        }
+    }
+
+    shadowCopyProcess = new QProcess(this);
+    connect(shadowCopyProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+                shadowCopyProcess->deleteLater();
+                shadowCopyProcess = nullptr;
+                if (exitCode != 0 || exitStatus != QProcess::NormalExit) {
+                    qDebug() << "暂存安装：复制影子目录失败，退出代码:" << exitCode;
+                }
+                onShadowCopyFinished(exitCode == 0 && exitStatus == QProcess::NormalExit);
+            });
+
+    shadowCopyProcess->start("sudo", QStringList() << "cp" << "-a" << "--reflink=auto"
+                                                   << qtServerInstallDir + "/." << shadowDir);
+}
+
+void QuarcsMonitor::onShadowCopyFinished(bool ok)
+{
+    if (!isSequentialUpdate) {
+        // 复制期间顺序更新已经结束，复制出的目录不再使用
+        discardStagedShadow();
+        return;
+    }
+    if (!ok) {
+        websocketClient->messageSend("update_error:0:Failed to prepare staged install directory", true);
+        failUpdateSequence();
+        return;
+    }
+    stagedShadowReady = true;
+    runUpdateScript();
+}
+
+// 顺序更新失败或中断：影子目录中是复制了一半的目录，或已被部分 Update.sh 修改过的目录，
+// 既不能交换上线，也不能用于回滚，直接删除。还没开始准备影子目录就失败的，上一个版本仍可回滚，保留
+void QuarcsMonitor::discardStagedShadow()
+{
+    stagedShadowReady = false;
+    if (shadowHoldsPrevious) {
+        return;
+    }
+    saveState();
+    if (shadowCopyProcess || shadowCopyRequest) {
+        return;     // 复制结束后 onShadowCopyFinished 再删除
+    }
+    const QString shadowDir = StagedInstall::shadowPath(qtServerInstallDir);
+    removeDirTree(shadowDir, [shadowDir](bool removed) {
+        if (!removed) {
+            qDebug() << "【警告】无法删除失败更新留下的影子目录:" << shadowDir;
+        }
+    });
+}
+
+// 停止服务器 -> 交换目录 -> 重新启动，停机时间从这里开始计算
+bool QuarcsMonitor::swapStagedInstall()
+{
+    QMANAGE_TRACE_SCOPE("staged_swap");
+    const QString shadowDir = StagedInstall::shadowPath(qtServerInstallDir);
+
+    swapDowntimeTimer.start();
+    isRestarting = true;
+    restartStartTime = QDateTime::currentDateTime();
+    qtServerRestartCount++;
+    saveState();
+
+    killQTServer();
+
+    QString error;
+    const bool swapped = StagedInstall::exchange(qtServerInstallDir, shadowDir, error);
+    if (!swapped) {
+        qDebug() << "暂存安装：目录交换失败:" << error;
+    }
+    // 交换成功后影子目录中是刚刚下线的版本，可以再交换回来；失败时不确定其中是什么，不再用于回滚
+    shadowHoldsPrevious = swapped;
+    saveState();
+
+    startQTServer();
+    qDebug() << "暂存安装：目录交换" << (swapped ? "成功" : "失败")
+             << "，停止到重新启动耗时" << swapDowntimeTimer.elapsed() << "ms";
+    return swapped;
+}
+
+// 回滚：只有上一次交换成功后，影子目录中才是上一个可用版本，再交换一次即可
+void QuarcsMonitor::rollbackStagedInstall()
+{
+    if (isSequentialUpdate) {
+        qDebug() << "顺序更新进行中，拒绝回滚";
+        websocketClient->messageSend("rollbackInstall:failed:update in progress");
+        return;
+    }
+    if (!shadowHoldsPrevious || !QDir(StagedInstall::shadowPath(qtServerInstallDir)).exists()) {
+        qDebug() << "没有可用于回滚的影子目录";
+        websocketClient->messageSend("rollbackInstall:failed:no previous slot");
+        return;
+    }
+
+    qDebug() << "回滚到上一个安装目录";
+    websocketClient->messageSend(swapStagedInstall() ? "rollbackInstall:success"
+                                                     : "rollbackInstall:failed:swap failed");
 }
 
 void QuarcsMonitor::onUnzipError(QProcess::ProcessError error)
 {
     qDebug() << "解压过程出错:" << error;
-    websocketClient->messageSend("update_error:0:Error during extraction process");
+
+    if (isDeltaUpdate) {
+        unzipProcess->deleteLater();
+        unzipProcess = nullptr;
+        fallbackToFullPackage();
+        return;
+    }
+
+    websocketClient->messageSend("update_error:0:Error during extraction process", true);
 
     // 顺序更新模式下，解压过程报错同样要中止整个顺序更新队列
     if (isSequentialUpdate)
     {
         qDebug() << "顺序更新在索引" << currentUpdateIndex << "处解压进程错误，终止后续更新";
-        isSequentialUpdate = false;
-        pendingUpdateVersions.clear();
-        websocketClient->messageSend("update_sequence_failed:" + QString::number(currentUpdateIndex));
+        failUpdateSequence();
     }
 
     unzipProcess->deleteLater();
@@ -774,61 +1848,86 @@ void QuarcsMonitor::onUnzipError(QProcess::ProcessError error)
 
 void QuarcsMonitor::onUpdateProcessOutput()
 {
-    QString output = updateProcess->readAllStandardOutput();
-    qDebug() << "完整标准输出:" << output;
-    
-    // 处理进度输出（保持原有逻辑）
-    QStringList lines = output.split("\n", Qt::SkipEmptyParts);
-    foreach (const QString &line, lines) {
-        qDebug() << "Update.sh output:" << line;
-        
-        if (line.startsWith("PROGRESS:")) {
-            QStringList parts = line.split(":", Qt::SkipEmptyParts);
-            if (parts.size() >= 3) {
-                QString progressValue = parts[1];
-                QString progressMessage = parts[2];
-                qDebug() << "更新进度:" << progressValue << "% -" << progressMessage;
-                websocketClient->messageSend("update_progress:" + progressValue + ":" + progressMessage);
-            }
-        }
-        else if (line.startsWith("ERROR:")) {
-            QStringList parts = line.split(":", Qt::SkipEmptyParts);
-            if (parts.size() >= 3) {
-                QString progressValue = parts[1];
-                QString errorMessage = parts[2];
-                qDebug() << "更新错误:" << progressValue << "% -" << errorMessage;
-                websocketClient->messageSend("update_error:" + progressValue + ":" + errorMessage);
-            }
-        }
-        else if (line.startsWith("SUCCESS:")) {
-            QStringList parts = line.split(":", Qt::SkipEmptyParts);
-            if (parts.size() >= 3) {
-                QString progressValue = parts[1];
-                QString successMessage = parts[2];
-                qDebug() << "更新成功:" << progressValue << "% -" << successMessage;
-                websocketClient->messageSend("update_success:" + progressValue + ":" + successMessage);
-            }
-        }
-        else if (line.startsWith("REBOOT:") || line.startsWith("NOREBOOT:")) {
-            qDebug() << line;
-            websocketClient->messageSend(line);
+    if (!updateProcess) {
+        return;
+    }
+
+    // 增量分行：跨两次读取的 PROGRESS/ERROR/SUCCESS 行不会被截断丢失
+    char buf[4096];
+    qint64 n;
+    while ((n = updateProcess->read(buf, sizeof(buf))) > 0) {
+        updateScriptOutput.feed(buf, static_cast<size_t>(n), [this](const char *line, size_t size) {
+            handleUpdateScriptLine(line, size);
+        });
+    }
+}
+
+void QuarcsMonitor::handleUpdateScriptLine(const char *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    const UpdateScriptLine parsed = parseUpdateScriptLine(data, size);
+    if (parsed.kind == UpdateScriptLine::Other) {
+        qDebug() << "Update.sh output:" << QString::fromUtf8(data, static_cast<int>(size));
+        return;
+    }
+
+    if (parsed.kind == UpdateScriptLine::Reboot) {
+        const QString line = QString::fromUtf8(data, static_cast<int>(size));
+        qDebug() << line;
+        websocketClient->messageSend(line);
+        return;
+    }
+
+    const QString progressValue = QString::fromUtf8(parsed.value, static_cast<int>(parsed.valueSize));
+    const QString message = QString::fromUtf8(parsed.message, static_cast<int>(parsed.messageSize));
+    if (parsed.kind == UpdateScriptLine::Progress) {
+        qDebug() << "更新进度:" << progressValue << "% -" << message;
+        websocketClient->messageSend("update_progress:" + progressValue + ":" + message);
+    } else if (parsed.kind == UpdateScriptLine::Error) {
+        qDebug() << "更新错误:" << progressValue << "% -" << message;
+        websocketClient->messageSend("update_error:" + progressValue + ":" + message, true);
+    } else if (parsed.kind == UpdateScriptLine::Success) {
+        qDebug() << "更新成功:" << progressValue << "% -" << message;
+        websocketClient->messageSend("update_success:" + progressValue + ":" + message, true);
+        // 脚本报告成功后即使 QMANAGE 随即被重启，恢复时也不会重复执行这一步
+        if (isSequentialUpdate) {
+            updateStep = "scriptSucceeded";
+            saveState();
         }
     }
 }
 
 void QuarcsMonitor::onUpdateProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
 {
+    TrafficRecorder::record(TrafficRecorder::Child, QString("update:finished:%1:%2")
+                                                        .arg(exitCode).arg(exitStatus == QProcess::CrashExit ? 1 : 0));
+    // 先处理缓冲区中剩余的输出，以及最后一行没有换行符的内容
+    onUpdateProcessOutput();
+    updateScriptOutput.finish([this](const char *line, size_t size) {
+        handleUpdateScriptLine(line, size);
+    });
+
     bool success = (exitCode == 0 && exitStatus == QProcess::NormalExit);
+    if (isSequentialUpdate) {
+        sequenceSerialMs += scriptTimer.elapsed();
+    }
+    Tracer::complete("Update.sh", traceScriptStartNs, currentUpdateVersion + (success ? "" : " failed"));
+    traceScriptStartNs = 0;
 
     if (!success) {
         qDebug() << "更新失败，退出代码:" << exitCode;
-        websocketClient->messageSend("update_failed:" + QString::number(exitCode));
+        websocketClient->messageSend("update_failed:" + QString::number(exitCode), true);
     } else {
         qDebug() << "更新脚本执行完成";
     }
 
-    updateProcess->deleteLater();
-    updateProcess = nullptr;
+    if (updateProcess) {
+        updateProcess->deleteLater();
+        updateProcess = nullptr;
+    }
 
     // 如果处于顺序更新模式，则根据结果决定是否继续后续更新包
     if (isSequentialUpdate)
@@ -842,9 +1941,7 @@ void QuarcsMonitor::onUpdateProcessFinished(int exitCode, QProcess::ExitStatus e
         {
             // 当前步骤失败，终止后续更新
             qDebug() << "顺序更新在索引" << currentUpdateIndex << "处失败，终止后续更新";
-            isSequentialUpdate = false;
-            pendingUpdateVersions.clear();
-            websocketClient->messageSend("update_sequence_failed:" + QString::number(currentUpdateIndex));
+            failUpdateSequence();
         }
     }
 }
@@ -852,7 +1949,7 @@ void QuarcsMonitor::onUpdateProcessFinished(int exitCode, QProcess::ExitStatus e
 void QuarcsMonitor::onUpdateProcessError(QProcess::ProcessError error)
 {
     qDebug() << "更新脚本执行出错:" << error;
-    websocketClient->messageSend("update_error:0:Error during update script execution");
+    websocketClient->messageSend("update_error:0:Error during update script execution", true);
     updateProcess->deleteLater();
     updateProcess = nullptr;
 }
@@ -885,14 +1982,323 @@ void QuarcsMonitor::startSequentialUpdate()
     }
 
     isSequentialUpdate = true;
+    isSquashedSequence = false;
+    stagedShadowReady = false;
     currentUpdateIndex = -1;
+    sequenceTimer.start();
+    sequenceSerialMs = 0;
+    discardPipeline();
+    traceSequenceStartNs = Tracer::isEnabled() ? Tracer::nowNs() : 0;
+    updateStep.clear();
+    saveState();
 
     // 通知前端顺序更新开始，总步骤数
     websocketClient->messageSend("update_sequence_start:" + QString::number(pendingUpdateVersions.size()));
 
+    // 多个待更新包时，先合并解压出最终文件树，避免同一文件被反复解压覆盖
+    if (config->squashSequentialUpdates && pendingUpdateVersions.size() > 1)
+    {
+        startSquashedSequence();
+        return;
+    }
+
+    startNextUpdateInQueue();
+}
+
+// 合并模式：读取所有待更新包的中央目录，在后台线程中把每个文件只从
+// 最新包含它的包里解压一次；完成后再按顺序逐个执行各版本的 Update.sh。
+void QuarcsMonitor::startSquashedSequence()
+{
+    QStringList packages;
+    foreach (const QString &version, pendingUpdateVersions) {
+        const QString file = findPackageFile(version);
+        if (file.isEmpty() || packageIndex->find(version).inStore) {
+            qDebug() << "合并模式下找不到版本" << version << "的更新包 zip，改为逐个顺序更新";
+            startNextUpdateInQueue();
+            return;
+        }
+        packages.append(UpdatePackPath + file);
+    }
+
+    // 旧的文件树要交给特权助手删除时，删完再开始解压
+    removeDirTree(UpdatePackPath + "update", [this, packages](bool) {
+        removeDirTree(UpdatePackPath + "update_scripts", [this, packages](bool) {
+            if (isSequentialUpdate) {
+                startSquashExtract(packages);
+            }
+        });
+    });
+}
+
+void QuarcsMonitor::startSquashExtract(const QStringList &packages)
+{
+    qDebug() << "开始合并解压" << packages.size() << "个更新包";
+
+    const QStringList versions = pendingUpdateVersions;
+    const QString destDir = UpdatePackPath;
+    const QString scriptRoot = UpdatePackPath + "update_scripts";
+    backgroundJobs.run([this, packages, versions, destDir, scriptRoot]() {
+        QMANAGE_TRACE_SCOPE("squash_extract");
+        QElapsedTimer timer;
+        timer.start();
+
+        UpdatePlanner planner;
+        const bool ok = planner.build(packages, versions) && planner.extract(destDir, scriptRoot);
+        const QString error = planner.errorString();
+        const quint64 sequentialBytes = planner.sequentialBytes();
+        const quint64 plannedBytes = planner.plannedBytes();
+        const qint64 elapsedMs = timer.elapsed();
+
+        QMetaObject::invokeMethod(this, [=]() {
+            onSquashExtractFinished(ok, error, sequentialBytes, plannedBytes, elapsedMs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuarcsMonitor::onSquashExtractFinished(bool ok, const QString &error, quint64 sequentialBytes,
+                                            quint64 plannedBytes, qint64 elapsedMs)
+{
+    if (!isSequentialUpdate) {
+        return;
+    }
+
+    if (!ok) {
+        qDebug() << "合并解压失败:" << error << "，改为逐个顺序更新";
+        isSquashedSequence = false;
+        startNextUpdateInQueue();
+        return;
+    }
+
+    // 按本次实际吞吐量估算逐个解压所需时间，便于与合并模式对比
+    const qint64 estimatedSequentialMs = plannedBytes > 0
+        ? static_cast<qint64>(static_cast<double>(elapsedMs) * sequentialBytes / plannedBytes)
+        : elapsedMs;
+    qDebug() << "合并解压完成：写入" << plannedBytes << "字节，逐个解压需写入" << sequentialBytes
+             << "字节，节省" << (sequentialBytes - plannedBytes) << "字节；耗时" << elapsedMs
+             << "ms，逐个解压预计耗时" << estimatedSequentialMs << "ms";
+
+    sequenceSerialMs += estimatedSequentialMs;
+    isSquashedSequence = true;
     startNextUpdateInQueue();
 }
 
+// 顺序更新中任一步骤失败：终止后续更新，丢弃流水线中已经预备的下一个版本
+void QuarcsMonitor::failUpdateSequence()
+{
+    isSequentialUpdate = false;
+    pendingUpdateVersions.clear();
+    if (stagedInstallEnabled) {
+        discardStagedShadow();
+    }
+    saveState();
+    discardPipeline();
+    websocketClient->messageSend("update_sequence_failed:" + QString::number(currentUpdateIndex), true);
+}
+
+// 在每个状态转换点把顺序更新进度和 QT 端重启状态写入状态日志（每次一次 msync，几毫秒）
+void QuarcsMonitor::saveState()
+{
+    QJsonObject obj;
+    obj["packPath"] = UpdatePackPath;
+    obj["sequence"] = isSequentialUpdate;
+    if (isSequentialUpdate) {
+        obj["versions"] = QJsonArray::fromStringList(pendingUpdateVersions);
+        obj["index"] = currentUpdateIndex;
+        obj["version"] = currentUpdateVersion;
+        obj["step"] = updateStep;
+        obj["squashed"] = isSquashedSequence;
+        obj["stagedShadowReady"] = stagedShadowReady;
+    }
+    obj["shadowHoldsPrevious"] = shadowHoldsPrevious;
+    obj["restarting"] = isRestarting;
+    obj["restartCount"] = qtServerRestartCount;
+    obj["savedAt"] = static_cast<double>(QDateTime::currentMSecsSinceEpoch());
+    stateJournal->commit(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+}
+
+// 启动时读取状态日志。上次退出时顺序更新还没结束的：
+//   当前步骤还没开始执行 Update.sh，或脚本已报告成功：从下一个未完成的步骤继续，已完成的不重复
+//   Update.sh 执行途中退出且没有报告成功：无法确定结果，不重复执行，报告给前端后结束
+// 因此 Update.sh 如果要重启 QMANAGE，必须先输出 SUCCESS:x:msg，否则后续版本不会继续更新；
+// 前端从 update_sequence_interrupted 的原因字段 script_unconfirmed 可以看出是这种情况。
+// 这里在构造后的第一轮事件循环中执行，WebSocket 还没连上，通知等首次连上后再发
+void QuarcsMonitor::resumeFromJournal()
+{
+    const QJsonObject obj = QJsonDocument::fromJson(stateJournal->load()).object();
+    if (obj.isEmpty()) {
+        return;
+    }
+    // 状态日志属于另一个更新包目录（例如基准测试没有隔离状态日志），其中的进度对本次无效
+    const QString packPath = obj.value("packPath").toString();
+    if (!packPath.isEmpty() && packPath != UpdatePackPath) {
+        qDebug() << "状态日志：记录的更新包目录" << packPath << "与当前" << UpdatePackPath << "不一致，忽略";
+        return;
+    }
+    qtServerRestartCount = obj.value("restartCount").toInt();
+    shadowHoldsPrevious = stagedInstallEnabled && obj.value("shadowHoldsPrevious").toBool();
+    if (obj.value("restarting").toBool()) {
+        qDebug() << "状态日志：上次退出时 QT 端正在重启";
+    }
+    if (!obj.value("sequence").toBool()) {
+        return;
+    }
+
+    QStringList versions;
+    foreach (const QJsonValue &value, obj.value("versions").toArray()) {
+        versions << value.toString();
+    }
+    const int index = obj.value("index").toInt(-1);
+    const QString step = obj.value("step").toString();
+    const QString version = obj.value("version").toString();
+    qDebug() << "状态日志：上次退出时顺序更新进行到第" << (index + 1) << "/" << versions.size()
+             << "个版本" << version << "，阶段" << step;
+
+    if (versions.isEmpty() || index >= versions.size() || (index >= 0 && step == "script")) {
+        // update_sequence_interrupted:<第几个>:<版本>:<原因>
+        //   script_unconfirmed  Update.sh 运行中 QMANAGE 退出（包括脚本自己重启 QMANAGE）且之前没有输出 SUCCESS
+        //   invalid_state       状态日志中的进度不完整
+        const QString reason = step == "script" ? "script_unconfirmed" : "invalid_state";
+        sendWhenConnected("update_sequence_interrupted:" + QString::number(index + 1) + ":" + version + ":" + reason);
+        isSequentialUpdate = false;
+        if (stagedInstallEnabled) {
+            discardStagedShadow();
+        }
+        saveState();
+        return;
+    }
+
+    // 合并解压还没完成时从头开始；否则从解压中断的步骤或下一个步骤继续
+    pendingUpdateVersions = versions;
+    if (index < 0) {
+        startSequentialUpdate();
+        return;
+    }
+    const int next = step == "scriptSucceeded" ? index + 1 : index;
+
+    isSequentialUpdate = true;
+    currentUpdateIndex = next - 1;
+    // 合并模式需要最终文件树和剩余版本的脚本都还在，否则改为逐个解压
+    isSquashedSequence = obj.value("squashed").toBool() && QDir(UpdatePackPath + "update").exists()
+                         && (next >= versions.size()
+                             || QFile::exists(UpdatePackPath + "update_scripts/" + versions.at(next) + "/Update.sh"));
+    stagedShadowReady = stagedInstallEnabled && obj.value("stagedShadowReady").toBool();
+    sequenceTimer.start();
+    sequenceSerialMs = 0;
+    discardPipeline();
+    sendWhenConnected("update_sequence_resumed:" + QString::number(next + 1) + ":" + QString::number(versions.size()));
+    startNextUpdateInQueue();
+}
+
+// 发送关键消息；WebSocket 还没连上时先排队，连上后按顺序发出
+void QuarcsMonitor::sendWhenConnected(const QString &message)
+{
+    if (websocketClient->isConnected()) {
+        websocketClient->messageSend(message, true);
+    } else {
+        pendingConnectMessages << message;
+    }
+}
+
+QString QuarcsMonitor::pipelineDir() const
+{
+    return UpdatePackPath + ".pipeline";
+}
+
+// 当前 Update.sh 运行期间，在后台线程中校验并解压队列中的下一个版本到 .pipeline，
+// 轮到它时只需把暂存树移到位。脚本仍然严格按顺序逐个执行
+void QuarcsMonitor::startPipelineExtract()
+{
+    if (isSquashedSequence || pipelineBusy) {
+        return;
+    }
+    if (!pipelineVersion.isEmpty()) {
+        discardPipeline();
+    }
+    const int next = currentUpdateIndex + 1;
+    if (next >= pendingUpdateVersions.size()) {
+        return;
+    }
+
+    // 已经预解压过的版本无需再解压；有对应增量包时走增量更新，也无需解压完整包
+    const QString version = pendingUpdateVersions.at(next);
+    const PackageIndex::PackageInfo info = packageIndex->find(version);
+    if (!info.isValid() || preStager->hasStaged(info)
+        || !DeltaUpdate::findDelta(UpdatePackPath, currentUpdateVersion, version).isEmpty()) {
+        return;
+    }
+
+    pipelineVersion = version;
+    pipelineBusy = true;
+    pipelineReady = false;
+    qDebug() << "流水线：Update.sh 运行期间后台解压下一个版本" << version;
+
+    const int generation = pipelineGeneration;
+    const QString treeDir = pipelineDir();
+    const QString fileName = info.fileName;
+    const QString zipPath = UpdatePackPath + info.fileName;
+    const bool inStore = info.inStore;
+    ChunkStore *store = chunkStore;
+    backgroundJobs.run([this, generation, treeDir, fileName, zipPath, inStore, store]() {
+        QElapsedTimer timer;
+        timer.start();
+        QDir(treeDir).removeRecursively();
+
+        QString error;
+        bool ok;
+        {
+            TraceSpan span("pipeline_extract", fileName);
+            if (inStore) {
+                ok = store->extractTree(fileName, treeDir, &error);
+            } else {
+                ZipReader reader(zipPath);
+                ok = reader.open() && reader.extractAll(treeDir);
+                error = reader.errorString();
+            }
+        }
+        const qint64 elapsedMs = timer.elapsed();
+
+        QMetaObject::invokeMethod(this, [=]() {
+            onPipelineExtractFinished(generation, ok, error, elapsedMs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuarcsMonitor::onPipelineExtractFinished(int generation, bool ok, const QString &error, qint64 elapsedMs)
+{
+    pipelineBusy = false;
+    if (generation != pipelineGeneration) {
+        removeDirTree(pipelineDir());
+        return;
+    }
+
+    pipelineReady = ok;
+    pipelineExtractMs = elapsedMs;
+    if (ok) {
+        qDebug() << "流水线：版本" << pipelineVersion << "后台解压完成，耗时" << elapsedMs << "ms";
+    } else {
+        // 不影响当前步骤；轮到该版本时按原流程重新解压，失败时照常终止顺序更新
+        qDebug() << "流水线：版本" << pipelineVersion << "后台解压失败:" << error;
+        removeDirTree(pipelineDir());
+    }
+
+    if (pipelineWaiting) {
+        pipelineWaiting = false;
+        updateCurrentClient(pipelineVersion);
+    }
+}
+
+// 丢弃流水线中预备的版本；后台解压仍在进行时，由完成回调负责删除
+void QuarcsMonitor::discardPipeline()
+{
+    pipelineGeneration++;
+    pipelineVersion.clear();
+    pipelineReady = false;
+    pipelineWaiting = false;
+    if (!pipelineBusy) {
+        removeDirTree(pipelineDir());
+    }
+}
+
 // 执行队列中的下一个更新包
 void QuarcsMonitor::startNextUpdateInQueue()
 {
@@ -906,10 +2312,29 @@ void QuarcsMonitor::startNextUpdateInQueue()
 
     if (currentUpdateIndex >= pendingUpdateVersions.size())
     {
-        qDebug() << "所有更新包已顺序执行完成";
+        lastSequenceMs = sequenceTimer.elapsed();
+        lastSequenceSerialMs = sequenceSerialMs;
+        qDebug() << "所有更新包已顺序执行完成，总耗时" << lastSequenceMs << "ms，串行基线" << lastSequenceSerialMs
+                 << "ms" << (isSquashedSequence ? "（合并模式）" : "（逐个模式，流水线解压）");
+        discardPipeline();
+        if (isSquashedSequence) {
+            // 合并模式下更新树最终对应最后一个版本
+            DeltaUpdate::markInstalledVersion(UpdatePackPath + "update", pendingUpdateVersions.last());
+            removeDirTree(UpdatePackPath + "update_scripts");
+            isSquashedSequence = false;
+        }
+        if (stagedInstallEnabled && stagedShadowReady) {
+            // 所有脚本都已作用在影子目录上，此时才停机交换
+            swapStagedInstall();
+            stagedShadowReady = false;
+        }
         isSequentialUpdate = false;
-        websocketClient->messageSend("update_sequence_finished");
+        Tracer::complete("update_sequence", traceSequenceStartNs,
+                         QString::number(pendingUpdateVersions.size()) + " packages");
+        traceSequenceStartNs = 0;
+        websocketClient->messageSend("update_sequence_finished", true);
         pendingUpdateVersions.clear();
+        saveState();
         return;
     }
 
@@ -918,6 +2343,11 @@ void QuarcsMonitor::startNextUpdateInQueue()
              << "个版本：" << version
              << "，总共：" << pendingUpdateVersions.size();
 
+    currentUpdateVersion = version;
+    updateStep = "extract";
+    saveState();
+    updateServiceStatus();
+
     // 通知前端当前执行到第几个版本
     websocketClient->messageSend("update_sequence_step:"
                                  + QString::number(currentUpdateIndex + 1) + ":"
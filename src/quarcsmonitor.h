@@ -10,9 +10,26 @@
 #include <QDateTime>
 #include <QTimer>
 #include <QStringList>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
 
 #include "websocketclient.h"
 #include "led.h"
+#include "packageindex.h"
+#include "prestager.h"
+#include "chunkstore.h"
+#include "lineassembler.h"
+#include "logstore.h"
+#include "crashsnapshot.h"
+#include "controlserver.h"
+#include "privhelper.h"
+#include "trashcollector.h"
+#include "thermalmonitor.h"
+#include "statejournal.h"
+#include "looplagprobe.h"
+#include "monitorconfig.h"
+#include "backgroundjobs.h"
 
 class QuarcsMonitor : public QObject
 {
@@ -47,37 +64,139 @@ public slots:
     void onUpdateProcessError(QProcess::ProcessError error);
     void startQTServer();
     void tryGetHostAddress();
+    void rollbackStagedInstall();
 
 private:
-    WebSocketClient *websocketClient;
+    // 配置：启动项在构造时复制到下面的成员中，运行项每次使用时从 config 读取
+    ConfigStore *configStore = nullptr;
+    std::shared_ptr<const MonitorConfig> config;
+    void onConfigChanged(std::shared_ptr<const MonitorConfig> previous);
+    void applyLiveConfig();
+
+    WebSocketClient *websocketClient = nullptr;
     QUrl websocketUrl;
     bool isRestarting = false; // 标记是否正在重启QT服务器
+    int qtServerRestartCount = 0; // QT 端累计重启次数（跨 QMANAGE 重启保留在状态日志中）
     QDateTime restartStartTime; // 重启开始时间
-    const int restartTimeout = 30; // 重启超时时间(秒)
     QDateTime lastTestQtServerProcessTime; // 上次发送 testQtServerProcess 的时间，用于限流
-    QString UpdatePackPath = "/var/www/update_pack/";
+    QString UpdatePackPath;
+    QString qtServerProgram;              // QT 端可执行文件
+    QString qtServerWorkDir;              // QT 端工作目录
+    int websocketPort = 8600;             // 自动探测本机 IP 时使用的端口
+    PackageIndex *packageIndex = nullptr; // 更新包目录的常驻索引
+    PreStager *preStager = nullptr;       // 新更新包的后台预解压
+    qint64 preStageBudgetBytes = 0;       // 预解压暂存树的磁盘预算
+    ChunkStore *chunkStore = nullptr;     // 更新包的去重存储
+    LogStore *logStore = nullptr;         // 监控程序日志和 QT 端输出的分段存储
+    QString logDir;                       // 为空时使用 ~/.local/share/QMANAGE/logs
+    qint64 logSegmentBytes = 0;           // 单个日志段大小
+    qint64 logBudgetBytes = 0;            // 日志总磁盘预算
+    CrashSnapshot *crashSnapshot = nullptr; // QT 端崩溃现场（最近输出、资源采样）
+    QString crashDir;                     // 为空时使用 ~/.local/share/QMANAGE/crashes
+    QString packageStoreDir;              // 为空时使用 ~/.local/share/QMANAGE/package-store
+    QString stateJournalPath;             // 为空时使用 ~/.local/share/QMANAGE/state.journal
+    ControlServer *controlServer = nullptr; // 本地控制通道（qmanagectl）
+    PrivHelper *privHelper = nullptr;     // 常驻特权助手，不可用时退回逐次 sudo
+    TrashCollector *trashCollector = nullptr; // 暂存目录的后台回收
+    ThermalMonitor *thermalMonitor = nullptr; // SoC 温度与降频状态，过热时放慢/暂停后台工作
+    LoopLagProbe *loopLagProbe = nullptr; // 事件循环延迟直方图与卡顿归因
     QString vueClientVersion = "";
     QString currentMaxClientVersion = "";
     
     // 异步处理相关的成员变量
     QProcess *unzipProcess = nullptr;
     QProcess *updateProcess = nullptr;
+    quint32 helperScriptRequest = 0;      // 通过特权助手运行的 Update.sh 的请求编号
     QTimer *restartTimer = nullptr;
     QTimer *networkRetryTimer = nullptr;
     int retryCount = 0;
-    const int maxRetries = 20;
 
     // 全局版本与顺序更新相关
     QString totalVersion;                 // 当前全局总版本号（从环境变量读取）
     QStringList pendingUpdateVersions;    // 待顺序执行的更新版本列表（升序）
     bool isSequentialUpdate = false;      // 是否处于顺序更新流程中
     int currentUpdateIndex = -1;          // 当前正在执行的更新索引
+    QString updateStep;                   // 当前步骤的阶段：extract / script / scriptSucceeded
+    std::unique_ptr<StateJournal> stateJournal; // 顺序更新进度与重启状态的崩溃安全日志
+    QStringList pendingConnectMessages;   // 启动时产生、要等 WebSocket 首次连上才能发出的关键消息
+
+    // 增量更新相关
+    QString currentUpdateVersion;         // 当前单次更新的目标版本
+    bool isDeltaUpdate = false;           // 当前单次更新是否使用增量包
+    QString deltaFallbackVersion;         // 增量包应用失败、需改用完整包的版本
+    QElapsedTimer extractTimer;           // 解压/增量应用耗时
+    qint64 lastFullExtractMs = -1;        // 最近一次完整包解压耗时（毫秒）
+    qint64 lastDeltaApplyMs = -1;         // 最近一次增量包应用耗时（毫秒）
+
+    // 一次性后台任务（合并解压、日志查询等）。作为成员，在 ~QObject 删除日志存储、去重存储等
+    // 子对象之前析构，等待任务结束，后台线程不会用到已删除的对象
+    BackgroundJobs backgroundJobs;
+
+    // 顺序更新合并（squash）相关：多个待更新包时只解压一次最终文件树
+    bool isSquashedSequence = false;      // 当前顺序更新是否使用合并后的暂存树
+    QElapsedTimer sequenceTimer;          // 整个顺序更新流程耗时
+
+    // 顺序更新流水线：第 N 个版本的 Update.sh 运行期间，后台解压第 N+1 个版本
+    QString pipelineVersion;              // 后台解压中或已解压好的版本
+    bool pipelineBusy = false;            // 后台解压尚未结束
+    bool pipelineReady = false;           // 后台解压成功，暂存树可用
+    bool pipelineWaiting = false;         // 已轮到该版本，正在等后台解压结束
+    int pipelineGeneration = 0;           // 丢弃流水线时递增，过期的解压结果直接删除
+    qint64 pipelineExtractMs = 0;         // 后台解压耗时
+    QElapsedTimer scriptTimer;            // 当前 Update.sh 耗时
+    qint64 sequenceSerialMs = 0;          // 串行基线：各步骤解压耗时与脚本耗时之和
+    qint64 lastSequenceMs = -1;           // 最近一次顺序更新实际总耗时（毫秒）
+    qint64 lastSequenceSerialMs = -1;     // 同一次顺序更新的串行基线（毫秒）
+
+    // A/B 暂存安装相关：需要 Update.sh 按 QUARCS_INSTALL_ROOT 修改目标目录，默认关闭
+    bool stagedInstallEnabled = false;
+    QString qtServerInstallDir;
+    bool stagedShadowReady = false;       // 本次顺序更新的影子目录是否已准备好
+    bool shadowHoldsPrevious = false;     // 影子目录中是交换下来的上一个可用版本，只有这时才能回滚
+    QProcess *shadowCopyProcess = nullptr; // 特权助手不可用时经 sudo 复制
+    quint32 shadowCopyRequest = 0;        // 通过特权助手复制影子目录的请求编号
+    QElapsedTimer swapDowntimeTimer;      // 从停止服务器开始计时，直到 ServerInitSuccess
+    qint64 lastSwapDowntimeMs = -1;       // 最近一次交换的停机时间（毫秒）
+
+    // 子进程输出分行器：QT 端透传、unzip 错误输出、Update.sh 输出
+    LineAssembler qtServerOutput;
+    LineAssembler unzipErrorOutput;
+    LineAssembler updateScriptOutput;
 
     // Qt 服务器运行状态，用于只在状态变化（特别是“由运行变为停止”）时打印/上报
     bool lastQtServerRunning = false;
 
     // 通过 QProcess 管理的 QT 端进程，只杀掉由当前监控程序启动的这一份
     QProcess *qtServerProcess = nullptr;
+    bool qtServerStopRequested = false;   // QT 端是由监控程序主动结束的，退出时不记为崩溃
+
+    // systemd 就绪/状态/看门狗通知
+    QTimer *watchdogTimer = nullptr;
+    QString lastServiceStatus;
+    void setupServiceNotify();
+    void updateServiceStatus();
+    QString serviceStatusText() const;
+
+    // 本地控制通道命令：status / restart / stop / update-check / tail-log / dump-metrics
+    void handleControlCommand(int clientId, const QString &command, const QStringList &args);
+    QByteArray statusReport() const;
+    QByteArray metricsReport() const;
+
+    // 时间线追踪：跨事件循环的阶段（重启、解压、Update.sh、顺序更新）在结束时补记区间
+    qint64 traceRestartStartNs = 0;
+    qint64 traceRestartDelayStartNs = 0;
+    qint64 traceUnzipStartNs = 0;
+    qint64 traceScriptStartNs = 0;
+    qint64 traceSequenceStartNs = 0;
+    void setupTraceSignal();
+    QString dumpTrace();
+
+    // 按时间范围取回日志并发送给前端
+    void sendLogs(qint64 fromMs, qint64 toMs);
+    void restorePackage(const QString &version);
+
+    // 读取环境变量覆盖（QT 端路径、WebSocket 地址、更新包目录、日志/崩溃记录目录、状态日志），优先于配置文件，供基准测试/调试使用
+    void applyEnvironmentOverrides();
 
     // 程序启动时，检测 QT 端是否已经在运行，如果没有则默认拉起一份
     void autoStartQtIfNotRunning();
@@ -88,6 +207,50 @@ private:
     // 启动/推进顺序更新流程
     void startSequentialUpdate();
     void startNextUpdateInQueue();
+    void failUpdateSequence();
+    void saveState();
+    void resumeFromJournal();
+    void sendWhenConnected(const QString &message);
+
+    // 顺序更新流水线
+    void startPipelineExtract();
+    void onPipelineExtractFinished(int generation, bool ok, const QString &error, qint64 elapsedMs);
+    QString pipelineDir() const;
+    void discardPipeline();
+
+    // 解压更新包/增量包
+    void startUnzip(const QString &archivePath, const QString &destDir);
+    void startDeltaUpdate(const QString &deltaFile);
+    void startDeltaApply();
+    void onDeltaApplyFinished(bool applied, const QString &error);
+    void fallbackToFullPackage();
+    QString findPackageFile(const QString &version) const;
+    void installStagedTree(const QString &stagedDir, std::function<void(bool ok)> done);
+    void installStagedEntries(const QString &stagedDir, QStringList names, std::function<void(bool ok)> done);
+    void updateFromPipeline(const QString &fileVersion);
+    void extractUpdatePackage(const QString &fileVersion);
+    void startStoreExtract(const QString &fileName);
+    void onStoreExtractFinished(bool ok, const QString &error, const QString &treeDir);
+    void pruneStoredPackages();
+    QString packageStorePath() const;
+    void runUpdateScript();
+    void startUpdateProcess();
+    void removeDirTree(const QString &path, std::function<void(bool removed)> done = nullptr);
+    bool updateInProgress() const;
+    void handleUpdateScriptLine(const char *data, size_t size);
+
+    // 顺序更新合并
+    void startSquashedSequence();
+    void startSquashExtract(const QStringList &packages);
+    void onSquashExtractFinished(bool ok, const QString &error, quint64 sequentialBytes,
+                                 quint64 plannedBytes, qint64 elapsedMs);
+
+    // A/B 暂存安装
+    void prepareStagedShadow();
+    void startShadowCopy(const QString &shadowDir);
+    void onShadowCopyFinished(bool ok);
+    void discardStagedShadow();
+    bool swapStagedInstall();
 };
 
 #endif // QUARCSMONITOR_H
\ No newline at end of file
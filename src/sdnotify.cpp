@@ -0,0 +1,61 @@
+#include "sdnotify.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#include <stddef.h>
+
+static int notifyFd = -1;
+
+bool SdNotify::isAvailable()
+{
+    return !qgetenv("NOTIFY_SOCKET").isEmpty();
+}
+
+bool SdNotify::notify(const QByteArray &state)
+{
+    const QByteArray socketPath = qgetenv("NOTIFY_SOCKET");
+    if (socketPath.isEmpty()) {
+        return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (static_cast<size_t>(socketPath.size()) >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.constData(), static_cast<size_t>(socketPath.size()));
+    if (addr.sun_path[0] == '@') {
+        addr.sun_path[0] = '\0';
+    }
+    const socklen_t addrLen = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + socketPath.size());
+
+    // 套接字只创建一次，之后的看门狗心跳直接复用
+    if (notifyFd < 0) {
+        notifyFd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (notifyFd < 0) {
+            return false;
+        }
+    }
+
+    const ssize_t sent = ::sendto(notifyFd, state.constData(), static_cast<size_t>(state.size()),
+                                  MSG_NOSIGNAL, reinterpret_cast<struct sockaddr *>(&addr), addrLen);
+    return sent == state.size();
+}
+
+quint64 SdNotify::watchdogUsec()
+{
+    bool ok = false;
+    const quint64 usec = qgetenv("WATCHDOG_USEC").toULongLong(&ok);
+    if (!ok || usec == 0) {
+        return 0;
+    }
+
+    const QByteArray watchdogPid = qgetenv("WATCHDOG_PID");
+    if (!watchdogPid.isEmpty() && watchdogPid.toLongLong() != static_cast<qint64>(getpid())) {
+        return 0;
+    }
+    return usec;
+}
@@ -0,0 +1,23 @@
+#ifndef SDNOTIFY_H
+#define SDNOTIFY_H
+
+#include <QByteArray>
+
+// systemd 通知协议（sd_notify）的最小实现，不依赖 libsystemd
+//
+// 向环境变量 NOTIFY_SOCKET 指定的 AF_UNIX 数据报套接字发送 "KEY=VALUE\n..." 文本。
+// 以 '@' 开头的地址表示抽象命名空间。未设置 NOTIFY_SOCKET 时所有调用都是空操作，
+// 因此测试时只需自己绑定一个数据报套接字并设置 NOTIFY_SOCKET 即可代替 systemd。
+class SdNotify
+{
+public:
+    static bool isAvailable();
+
+    // 发送一条通知，例如 "READY=1" 或 "STATUS=..."
+    static bool notify(const QByteArray &state);
+
+    // 看门狗超时时间（微秒），来自 WATCHDOG_USEC；未启用或 WATCHDOG_PID 不是本进程时返回 0
+    static quint64 watchdogUsec();
+};
+
+#endif // SDNOTIFY_H
@@ -0,0 +1,57 @@
+#include "stagedinstall.h"
+
+#include <QFile>
+#include <QDebug>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+QString StagedInstall::shadowPath(const QString &liveDir)
+{
+    QString path = liveDir;
+    while (path.endsWith('/')) {
+        path.chop(1);
+    }
+    return path + ".shadow";
+}
+
+bool StagedInstall::exchange(const QString &liveDir, const QString &shadowDir, QString &errorString)
+{
+    const QByteArray live = QFile::encodeName(liveDir);
+    const QByteArray shadow = QFile::encodeName(shadowDir);
+
+#ifdef SYS_renameat2
+    if (::syscall(SYS_renameat2, AT_FDCWD, live.constData(), AT_FDCWD, shadow.constData(),
+                  RENAME_EXCHANGE) == 0) {
+        return true;
+    }
+    if (errno != ENOSYS && errno != EINVAL) {
+        errorString = QString("renameat2 failed: %1").arg(strerror(errno));
+        return false;
+    }
+    qDebug() << "RENAME_EXCHANGE not supported, falling back to three renames";
+#endif
+
+    const QByteArray tmp = live + ".swap";
+    if (::rename(live.constData(), tmp.constData()) != 0) {
+        errorString = QString("rename live -> tmp failed: %1").arg(strerror(errno));
+        return false;
+    }
+    if (::rename(shadow.constData(), live.constData()) != 0) {
+        errorString = QString("rename shadow -> live failed: %1").arg(strerror(errno));
+        ::rename(tmp.constData(), live.constData());
+        return false;
+    }
+    if (::rename(tmp.constData(), shadow.constData()) != 0) {
+        errorString = QString("rename tmp -> shadow failed: %1").arg(strerror(errno));
+        return false;
+    }
+    return true;
+}
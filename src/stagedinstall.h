@@ -0,0 +1,23 @@
+#ifndef STAGEDINSTALL_H
+#define STAGEDINSTALL_H
+
+#include <QString>
+
+// A/B 暂存安装
+//
+// 正在运行的安装目录（live）旁边保留一个影子目录（<live>.shadow）。
+// 更新时先把 live 复制到影子目录，Update.sh 通过环境变量 QUARCS_INSTALL_ROOT
+// 得知应当修改影子目录，此时 QT 服务器仍在运行；全部脚本执行完后才停止服务器、
+// 原子交换两个目录并重新启动，停机时间只包含交换和启动。
+// 交换后影子目录里就是上一个版本，可以随时再交换一次回滚。
+class StagedInstall
+{
+public:
+    static QString shadowPath(const QString &liveDir);
+
+    // 原子交换两个目录（renameat2 RENAME_EXCHANGE）；内核或文件系统不支持时
+    // 退化为经由临时名称的三次 rename（非原子，但仍只涉及目录项操作）
+    static bool exchange(const QString &liveDir, const QString &shadowDir, QString &errorString);
+};
+
+#endif // STAGEDINSTALL_H
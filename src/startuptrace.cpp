@@ -0,0 +1,70 @@
+#include "startuptrace.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <time.h>
+
+static const char *kPhaseNames[StartupTrace::PhaseCount] = {
+    "lock", "fork", "qt_init", "ws_connect", "child_spawn", "server_init"
+};
+
+static qint64 startNs = 0;
+static qint64 phaseNs[StartupTrace::PhaseCount] = {0};
+static bool reported = false;
+
+static qint64 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void StartupTrace::begin()
+{
+    startNs = monotonicNs();
+}
+
+void StartupTrace::mark(Phase phase)
+{
+    if (phaseNs[phase] == 0) {
+        phaseNs[phase] = monotonicNs();
+    }
+}
+
+double StartupTrace::elapsedMs()
+{
+    return (monotonicNs() - startNs) / 1e6;
+}
+
+void StartupTrace::report()
+{
+    if (reported) {
+        return;
+    }
+    reported = true;
+
+    QString line;
+    for (int i = 0; i < PhaseCount; i++) {
+        if (!line.isEmpty()) {
+            line += ' ';
+        }
+        if (phaseNs[i] == 0) {
+            line += QString("%1=-").arg(kPhaseNames[i]);
+        } else {
+            line += QString("%1=%2ms").arg(kPhaseNames[i]).arg((phaseNs[i] - startNs) / 1e6, 0, 'f', 1);
+        }
+    }
+
+    qDebug() << "Startup phases:" << line;
+
+    QFile file("/tmp/QUARCS_QMANAGE_startup.log");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        QTextStream out(&file);
+        out << QDateTime::currentDateTime().toString(Qt::ISODate)
+            << " version=" << QCoreApplication::applicationVersion()
+            << ' ' << line << '\n';
+    }
+}
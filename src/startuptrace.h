@@ -0,0 +1,31 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+// 启动阶段计时
+//
+// main() 最开始调用 begin() 记下起点（CLOCK_MONOTONIC，fork 后仍然有效），
+// 之后各阶段第一次到达时调用 mark()。收到 ServerInitSuccess 后调用 report()，
+// 把各阶段相对起点的耗时打印出来，并追加一行到 /tmp/QUARCS_QMANAGE_startup.log，
+// 方便跨版本比较启动时间。
+class StartupTrace
+{
+public:
+    enum Phase {
+        Lock = 0,           // 拿到单实例锁
+        Fork,               // 守护进程化完成
+        QtInit,             // QCoreApplication 创建完成
+        WebSocketConnect,   // 第一次连上 WebSocket 服务器
+        ChildSpawn,         // QT 服务器进程启动成功
+        ServerInitSuccess,  // 收到 QT 服务器的 ServerInitSuccess
+        PhaseCount
+    };
+
+    static void begin();
+    static void mark(Phase phase);
+    static void report();
+
+    // 距离 begin() 的毫秒数
+    static double elapsedMs();
+};
+
+#endif // STARTUPTRACE_H
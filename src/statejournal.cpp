@@ -0,0 +1,154 @@
+#include "statejournal.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static const quint32 kMagic = 0x4A534D51;     // "QMSJ"
+static const quint32 kFormatVersion = 1;
+static const int kSlotBytes = 8192;
+static const int kHeaderBytes = 24;
+static const int kFileBytes = 2 * kSlotBytes;
+
+// 槽头字段偏移
+static const int kOffMagic = 0;
+static const int kOffVersion = 4;
+static const int kOffSequence = 8;
+static const int kOffLength = 16;
+static const int kOffCrc = 20;
+
+template <typename T>
+static T readField(const uchar *slot, int offset)
+{
+    T value;
+    memcpy(&value, slot + offset, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void writeField(uchar *slot, int offset, T value)
+{
+    memcpy(slot + offset, &value, sizeof(value));
+}
+
+static quint32 slotCrc(const uchar *slot, quint32 length)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, slot + kOffSequence, 8 + 4);
+    crc = crc32(crc, slot + kHeaderBytes, length);
+    return static_cast<quint32>(crc);
+}
+
+StateJournal::StateJournal(const QString &path) : filePath(path)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        qDebug() << "状态日志：无法打开" << path << ":" << strerror(errno);
+        return;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (st.st_size != kFileBytes && (::ftruncate(fd, kFileBytes) != 0 || ::fsync(fd) != 0))) {
+        qDebug() << "状态日志：无法设置文件大小" << path << ":" << strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    void *mapped = ::mmap(nullptr, kFileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        qDebug() << "状态日志：mmap 失败" << path << ":" << strerror(errno);
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+    base = static_cast<uchar *>(mapped);
+
+    for (int slot = 0; slot < 2; slot++) {
+        quint64 sequence = 0;
+        if (slotValid(slot, &sequence) && sequence > currentSequence) {
+            currentSequence = sequence;
+            currentSlot = slot;
+        }
+    }
+}
+
+StateJournal::~StateJournal()
+{
+    if (base) {
+        ::munmap(base, kFileBytes);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool StateJournal::slotValid(int slot, quint64 *sequence) const
+{
+    const uchar *p = base + slot * kSlotBytes;
+    const quint32 length = readField<quint32>(p, kOffLength);
+    if (readField<quint32>(p, kOffMagic) != kMagic || readField<quint32>(p, kOffVersion) != kFormatVersion
+        || length > static_cast<quint32>(kSlotBytes - kHeaderBytes)
+        || readField<quint32>(p, kOffCrc) != slotCrc(p, length)) {
+        return false;
+    }
+    *sequence = readField<quint64>(p, kOffSequence);
+    return true;
+}
+
+QByteArray StateJournal::load() const
+{
+    if (!base || currentSlot < 0) {
+        return QByteArray();
+    }
+    const uchar *p = base + currentSlot * kSlotBytes;
+    return QByteArray(reinterpret_cast<const char *>(p + kHeaderBytes),
+                      static_cast<int>(readField<quint32>(p, kOffLength)));
+}
+
+bool StateJournal::commit(const QByteArray &payload)
+{
+    if (!base) {
+        return false;
+    }
+    if (payload.size() > kSlotBytes - kHeaderBytes) {
+        qDebug() << "状态日志：内容过大，未写入:" << payload.size() << "字节";
+        return false;
+    }
+
+    // 总是覆盖较旧的槽，最新的一份在本次落盘前保持不动
+    const int slot = currentSlot == 0 ? 1 : 0;
+    uchar *p = base + slot * kSlotBytes;
+    const quint64 sequence = currentSequence + 1;
+    const quint32 length = static_cast<quint32>(payload.size());
+
+    // 先让旧内容失效，再写内容和头，最后写 CRC；整个槽一次 msync
+    writeField<quint32>(p, kOffMagic, 0);
+    memcpy(p + kHeaderBytes, payload.constData(), length);
+    writeField<quint32>(p, kOffVersion, kFormatVersion);
+    writeField<quint64>(p, kOffSequence, sequence);
+    writeField<quint32>(p, kOffLength, length);
+    writeField<quint32>(p, kOffCrc, slotCrc(p, length));
+    writeField<quint32>(p, kOffMagic, kMagic);
+    // msync 的起始地址必须按页对齐（16 KiB 页的内核上一个槽不是整页）
+    const long pageSize = ::sysconf(_SC_PAGESIZE);
+    const long offset = (static_cast<long>(slot) * kSlotBytes / pageSize) * pageSize;
+    const long end = static_cast<long>(slot + 1) * kSlotBytes;
+    if (::msync(base + offset, static_cast<size_t>(end - offset), MS_SYNC) != 0) {
+        qDebug() << "状态日志：msync 失败:" << strerror(errno);
+        return false;
+    }
+
+    currentSlot = slot;
+    currentSequence = sequence;
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef STATEJOURNAL_H
+#define STATEJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+
+// 崩溃安全的小型状态日志
+//
+// 顺序更新的进度、QT 端重启状态等只在内存里，QMANAGE 在更新途中退出（例如 Update.sh 重启了它）
+// 后就丢失了。这里把一份很小的状态（JSON，最大约 8 KiB）写进固定大小的内存映射文件：
+//
+//   文件 = 两个 8 KiB 的槽，轮流写入（双缓冲）
+//   槽   = 魔数 "QMSJ" + 格式版本 + 序号(8) + 长度(4) + CRC32(4) + 内容
+//          CRC32 覆盖序号、长度和内容
+//
+// commit() 总是写入较旧的那个槽，写完后 msync(MS_SYNC) 再返回，因此下一次写入另一个槽之前
+// 这一份已经落盘（写入有序）。写到一半断电时该槽校验失败，load() 取另一个槽中的上一份。
+class StateJournal
+{
+public:
+    explicit StateJournal(const QString &path);
+    ~StateJournal();
+
+    bool isOpen() const { return base != nullptr; }
+    QString path() const { return filePath; }
+
+    // 最近一次完整写入的内容；没有有效记录时返回空
+    QByteArray load() const;
+    // 写入并落盘；内容过大或写入失败时返回 false（之前的记录不受影响）
+    bool commit(const QByteArray &payload);
+    // 已提交的记录序号，从未写入时为 0
+    quint64 sequence() const { return currentSequence; }
+
+private:
+    bool slotValid(int slot, quint64 *sequence) const;
+
+    const QString filePath;
+    int fd = -1;
+    uchar *base = nullptr;
+    int currentSlot = -1;
+    quint64 currentSequence = 0;
+};
+
+#endif // STATEJOURNAL_H
@@ -0,0 +1,164 @@
+#include "thermalmonitor.h"
+
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const int kPollIntervalMs = 2000;
+static const int kHysteresisMilliC = 3000;
+static const quint32 kThrottledNowMask = 0xE;   // 当前限频 / 降频 / 软温度限制
+static const int kWarmSleepMs = 100;             // Warm 时每个工作单元之后让出的时间
+static const int kHotPollMs = 500;               // Hot 时检查是否降温的间隔
+
+std::atomic<int> ThermalMonitor::backgroundLevel(ThermalMonitor::Normal);
+
+ThermalMonitor::ThermalMonitor(const QString &sysfsRoot, QObject *parent) : QObject(parent)
+{
+    // 温度：优先 cpu/soc 类型的 thermal zone，否则取第一个
+    const QDir thermalDir(sysfsRoot + "/class/thermal");
+    QString zone;
+    foreach (const QString &name, thermalDir.entryList(QStringList() << "thermal_zone*", QDir::Dirs)) {
+        QFile typeFile(thermalDir.filePath(name + "/type"));
+        const QByteArray type = typeFile.open(QIODevice::ReadOnly) ? typeFile.readAll().trimmed().toLower() : QByteArray();
+        if (zone.isEmpty() || type.contains("cpu") || type.contains("soc")) {
+            zone = name;
+            if (type.contains("cpu") || type.contains("soc")) {
+                break;
+            }
+        }
+    }
+    if (!zone.isEmpty()) {
+        tempFd = ::open(QFile::encodeName(thermalDir.filePath(zone + "/temp")).constData(), O_RDONLY | O_CLOEXEC);
+    }
+    throttledFd = ::open(QFile::encodeName(sysfsRoot + "/devices/platform/soc/soc:firmware/get_throttled").constData(),
+                         O_RDONLY | O_CLOEXEC);
+
+    if (!isAvailable()) {
+        qDebug() << "温度监测：" << sysfsRoot << "下没有可用的温度/降频信息，不做温控";
+        return;
+    }
+    qDebug() << "温度监测：" << (tempFd >= 0 ? zone : QString("无温度")) << (throttledFd >= 0 ? "+ get_throttled" : "");
+
+    poll();
+    timer.setInterval(kPollIntervalMs);
+    connect(&timer, &QTimer::timeout, this, &ThermalMonitor::poll);
+    timer.start();
+}
+
+ThermalMonitor::~ThermalMonitor()
+{
+    backgroundLevel = Normal;
+    if (tempFd >= 0) {
+        ::close(tempFd);
+    }
+    if (throttledFd >= 0) {
+        ::close(throttledFd);
+    }
+}
+
+void ThermalMonitor::setLimits(int warmCelsius, int hotCelsius)
+{
+    warmMilliC = warmCelsius * 1000;
+    hotMilliC = hotCelsius * 1000;
+    if (isAvailable()) {
+        poll();
+    }
+}
+
+const char *ThermalMonitor::levelName(Level level)
+{
+    switch (level) {
+    case Warm:
+        return "warm";
+    case Hot:
+        return "hot";
+    default:
+        return "normal";
+    }
+}
+
+QString ThermalMonitor::stateText() const
+{
+    return QString(levelName(currentLevel)) + ":"
+           + (sample.hasTemperature ? QString::number(sample.milliCelsius / 1000.0, 'f', 1) : QString("unknown")) + ":"
+           + (sample.hasThrottled ? QString::number(sample.throttled, 16) : QString("unknown"));
+}
+
+void ThermalMonitor::throttleBackgroundWork(const std::function<bool()> &stopRequested)
+{
+    int level = backgroundLevel.load(std::memory_order_relaxed);
+    while (level == Hot && !stopRequested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kHotPollMs));
+        level = backgroundLevel.load(std::memory_order_relaxed);
+    }
+    if (level == Warm) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kWarmSleepMs));
+    }
+}
+
+// sysfs 属性每次从偏移 0 读取都会重新生成内容，文件只需打开一次
+bool ThermalMonitor::readValue(int fd, int base, qint64 *value)
+{
+    if (fd < 0) {
+        return false;
+    }
+    char buf[32];
+    const ssize_t n = ::pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+    char *end = nullptr;
+    errno = 0;
+    const long long parsed = strtoll(buf, &end, base);
+    if (errno != 0 || end == buf) {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+void ThermalMonitor::poll()
+{
+    qint64 value = 0;
+    sample.hasTemperature = readValue(tempFd, 10, &value);
+    sample.milliCelsius = sample.hasTemperature ? static_cast<int>(value) : 0;
+    sample.hasThrottled = readValue(throttledFd, 16, &value);
+    sample.throttled = sample.hasThrottled ? static_cast<quint32>(value) : 0;
+
+    const int temp = sample.milliCelsius;
+    const bool throttledNow = sample.hasThrottled && (sample.throttled & kThrottledNowMask);
+
+    // 升级立即生效，降级要低于阈值一个回差
+    Level next = currentLevel;
+    if (tempFd < 0) {
+        // 没有温度传感器，只看降频状态
+        next = throttledNow ? Warm : Normal;
+    } else if (!sample.hasTemperature) {
+        // 这一次没读到温度：不据此降级，降频状态仍可以升级
+        if (throttledNow && currentLevel == Normal) {
+            next = Warm;
+        }
+    } else if (temp >= hotMilliC) {
+        next = Hot;
+    } else if (temp >= warmMilliC || throttledNow) {
+        next = (currentLevel == Hot && temp >= hotMilliC - kHysteresisMilliC) ? Hot : Warm;
+    } else if (currentLevel == Hot) {
+        next = temp >= hotMilliC - kHysteresisMilliC ? Hot : (temp >= warmMilliC - kHysteresisMilliC ? Warm : Normal);
+    } else if (currentLevel == Warm) {
+        next = temp >= warmMilliC - kHysteresisMilliC ? Warm : Normal;
+    }
+
+    if (next != currentLevel) {
+        currentLevel = next;
+        backgroundLevel = next;
+        qDebug() << "温度监测：" << levelName(next) << stateText();
+        emit levelChanged(next);
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef THERMALMONITOR_H
+#define THERMALMONITOR_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <atomic>
+#include <functional>
+
+// SoC 温度与降频状态
+//
+// 封闭的望远镜机箱里树莓派很容易降频，这时再做预解压、入库、回收、日志压缩只会雪上加霜。
+// 启动时打开 <sysfs>/class/thermal/thermal_zone*/temp（优先 cpu/soc 类型）和
+// <sysfs>/devices/platform/soc/soc:firmware/get_throttled，之后每 2 秒用 pread 重读，
+// 不再重复打开文件。sysfs 根目录可配置，测试时可以指向一组假文件（bench/thermalbench）。
+//
+// 等级（带 3°C 回差）：
+//   Normal  正常
+//   Warm    温度达到下限，或固件报告正在降频/限频：后台工作每个单元之后让出一段时间
+//   Hot     温度达到上限：后台工作暂停，降温后继续
+// 某次读不到温度时保持当前等级（降频状态仍可升级）；没有温度传感器时只按降频状态判断。
+// 后台线程在工作单元之间调用 throttleBackgroundWork()；前台的更新流程不受影响。
+class ThermalMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    enum Level { Normal = 0, Warm = 1, Hot = 2 };
+
+    struct Sample
+    {
+        bool hasTemperature = false;
+        int milliCelsius = 0;
+        bool hasThrottled = false;
+        quint32 throttled = 0;        // get_throttled 位图：bit0 欠压，bit1 限频，bit2 降频，bit3 软温度限制
+    };
+
+    explicit ThermalMonitor(const QString &sysfsRoot, QObject *parent = nullptr);
+    ~ThermalMonitor();
+
+    void setLimits(int warmCelsius, int hotCelsius);
+
+    Level level() const { return currentLevel; }
+    Sample lastSample() const { return sample; }
+    bool isAvailable() const { return tempFd >= 0 || throttledFd >= 0; }
+    static const char *levelName(Level level);
+    // 前端与状态报告使用的文本：<等级>:<温度°C>:<get_throttled 十六进制>
+    QString stateText() const;
+
+    // 后台线程在两个工作单元之间调用：Warm 时睡眠一小段，Hot 时等到降温；
+    // stopRequested 返回 true 时立即返回，避免退出时卡在等待中
+    static void throttleBackgroundWork(const std::function<bool()> &stopRequested);
+
+signals:
+    void levelChanged(int level);
+
+private:
+    static bool readValue(int fd, int base, qint64 *value);
+    void poll();
+
+    int tempFd = -1;
+    int throttledFd = -1;
+    int warmMilliC = 70000;
+    int hotMilliC = 80000;
+    Sample sample;
+    Level currentLevel = Normal;
+    QTimer timer;
+
+    static std::atomic<int> backgroundLevel;
+};
+
+#endif // THERMALMONITOR_H
@@ -0,0 +1,218 @@
+#include "tracer.h"
+
+#include <QFile>
+#include <QByteArray>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <vector>
+
+// 环形缓冲区容量（必须是 2 的幂），约 1.3MB
+static const quint64 kCapacity = 16384;
+
+struct TraceEvent
+{
+    std::atomic<quint64> seq;   // 写入完成后为 序号 + 1，写入过程中为 0
+    const char *name;
+    qint64 tsNs;
+    qint64 durNs;               // < 0 表示瞬时事件
+    quint32 tid;
+    quint8 detailLen;
+    char detail[Tracer::DetailSize];
+};
+
+static TraceEvent ring[kCapacity];
+static std::atomic<quint64> writeIndex(0);
+
+std::atomic<bool> Tracer::enabledFlag(!qgetenv("QUARCS_TRACE").isEmpty() && qgetenv("QUARCS_TRACE") != "0");
+std::atomic<const char *> Tracer::loopScope(nullptr);
+thread_local bool Tracer::loopThreadFlag = false;
+
+// 截断到不超过 max 字节，且不切断 UTF-8 多字节字符
+static int utf8Prefix(const char *data, int size, int max)
+{
+    if (size <= max) {
+        return size;
+    }
+    int len = max;
+    while (len > 0 && (static_cast<unsigned char>(data[len]) & 0xC0) == 0x80) {
+        len--;
+    }
+    return len;
+}
+
+static quint32 currentTid()
+{
+    static thread_local quint32 tid = static_cast<quint32>(::syscall(SYS_gettid));
+    return tid;
+}
+
+void Tracer::setEnabled(bool enabled)
+{
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+qint64 Tracer::nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void Tracer::record(const char *name, qint64 tsNs, qint64 durNs, const char *detail, int detailLen)
+{
+    const quint64 index = writeIndex.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &event = ring[index & (kCapacity - 1)];
+
+    // 类似 seqlock：先置 0 使读者跳过，写完字段后再发布序号
+    event.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name = name;
+    event.tsNs = tsNs;
+    event.durNs = durNs;
+    event.tid = currentTid();
+    if (detail && detailLen > 0) {
+        detailLen = utf8Prefix(detail, detailLen, DetailSize);
+        memcpy(event.detail, detail, static_cast<size_t>(detailLen));
+        event.detailLen = static_cast<quint8>(detailLen);
+    } else {
+        event.detailLen = 0;
+    }
+    event.seq.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::complete(const char *name, qint64 startNs, const char *detail, int detailLen)
+{
+    if (!isEnabled() || startNs <= 0) {
+        return;
+    }
+    record(name, startNs, nowNs() - startNs, detail, detailLen);
+}
+
+void Tracer::complete(const char *name, qint64 startNs, const QString &detail)
+{
+    if (!isEnabled() || startNs <= 0) {
+        return;
+    }
+    const QByteArray utf8 = detail.left(DetailSize).toUtf8();
+    record(name, startNs, nowNs() - startNs, utf8.constData(), utf8.size());
+}
+
+void Tracer::instant(const char *name, const char *detail, int detailLen)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    record(name, nowNs(), -1, detail, detailLen);
+}
+
+void Tracer::instant(const char *name, const QString &detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    const QByteArray utf8 = detail.left(DetailSize).toUtf8();
+    record(name, nowNs(), -1, utf8.constData(), utf8.size());
+}
+
+void TraceSpan::setDetail(const QString &detail)
+{
+    if (!startNs) {
+        return;
+    }
+    const QByteArray utf8 = detail.left(Tracer::DetailSize).toUtf8();
+    detailLength = utf8Prefix(utf8.constData(), utf8.size(), Tracer::DetailSize);
+    memcpy(detailText, utf8.constData(), static_cast<size_t>(detailLength));
+}
+
+static void appendJsonString(QByteArray &out, const char *data, int size)
+{
+    out += '"';
+    for (int i = 0; i < size; i++) {
+        const unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+int Tracer::dumpJson(const QString &path)
+{
+    // 先把环形缓冲区中完整的事件拷贝出来，写文件期间不影响埋点继续写入
+    struct Copy
+    {
+        const char *name;
+        qint64 tsNs;
+        qint64 durNs;
+        quint32 tid;
+        quint8 detailLen;
+        char detail[DetailSize];
+    };
+    std::vector<Copy> events;
+    const quint64 end = writeIndex.load(std::memory_order_acquire);
+    const quint64 begin = end > kCapacity ? end - kCapacity : 0;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (quint64 index = begin; index < end; index++) {
+        const TraceEvent &event = ring[index & (kCapacity - 1)];
+        if (event.seq.load(std::memory_order_acquire) != index + 1) {
+            continue;   // 正在写入或已被覆盖
+        }
+        Copy copy;
+        copy.name = event.name;
+        copy.tsNs = event.tsNs;
+        copy.durNs = event.durNs;
+        copy.tid = event.tid;
+        copy.detailLen = event.detailLen;
+        memcpy(copy.detail, event.detail, sizeof(copy.detail));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.seq.load(std::memory_order_relaxed) != index + 1) {
+            continue;
+        }
+        events.push_back(copy);
+    }
+
+    const qint64 pid = getpid();
+    QByteArray out;
+    out.reserve(static_cast<int>(events.size()) * 128 + 256);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" + QByteArray::number(pid)
+           + ",\"args\":{\"name\":\"QMANAGE\"}}";
+    char num[64];
+    for (size_t i = 0; i < events.size(); i++) {
+        const Copy &e = events[i];
+        out += ",\n{\"name\":";
+        appendJsonString(out, e.name, static_cast<int>(strlen(e.name)));
+        out += ",\"cat\":\"qmanage\",\"pid\":" + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(e.tid);
+        snprintf(num, sizeof(num), ",\"ts\":%.3f", e.tsNs / 1000.0);
+        out += num;
+        if (e.durNs >= 0) {
+            snprintf(num, sizeof(num), ",\"ph\":\"X\",\"dur\":%.3f", e.durNs / 1000.0);
+            out += num;
+        } else {
+            out += ",\"ph\":\"i\",\"s\":\"t\"";
+        }
+        if (e.detailLen > 0) {
+            out += ",\"args\":{\"detail\":";
+            appendJsonString(out, e.detail, e.detailLen);
+            out += '}';
+        }
+        out += '}';
+    }
+    out += "\n]}\n";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(out) != out.size()) {
+        return -1;
+    }
+    return static_cast<int>(events.size());
+}
@@ -0,0 +1,96 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QString>
+#include <atomic>
+
+// 轻量时间线追踪，导出为 Chrome trace-event JSON（Perfetto / chrome://tracing 可直接打开）
+//
+// 事件是固定大小的结构，写入预先分配的无锁环形缓冲区（多线程写入，满了覆盖最旧的事件）。
+// 未启用时每个埋点只有一次 relaxed 原子读。事件名必须是字符串字面量（只保存指针），
+// detail 截断后拷贝进事件本身。
+//
+// 启用：环境变量 QUARCS_TRACE=1，或前端命令 traceStart / traceStop。
+// 导出：前端命令 dumpTrace，或向进程发送 SIGUSR2。
+class Tracer
+{
+public:
+    enum { DetailSize = 48 };
+
+    static bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // CLOCK_MONOTONIC 纳秒
+    static qint64 nowNs();
+
+    // 区间事件（ph = "X"），从 startNs 到现在
+    static void complete(const char *name, qint64 startNs, const char *detail = nullptr, int detailLen = 0);
+    static void complete(const char *name, qint64 startNs, const QString &detail);
+
+    // 瞬时事件（ph = "i"）
+    static void instant(const char *name, const char *detail = nullptr, int detailLen = 0);
+    static void instant(const char *name, const QString &detail);
+
+    // 把缓冲区中现有的事件写成 JSON，返回写出的事件数，失败返回 -1
+    static int dumpJson(const QString &path);
+
+    // 事件循环线程上最内层的 TraceSpan 名称（不论追踪是否启用都会维护），
+    // 事件循环卡顿时由其它线程读取，用来判断是哪个处理函数占住了事件循环
+    static void markLoopThread() { loopThreadFlag = true; }
+    static bool isLoopThread() { return loopThreadFlag; }
+    static const char *currentLoopScope() { return loopScope.load(std::memory_order_relaxed); }
+    static const char *swapLoopScope(const char *name) { return loopScope.exchange(name, std::memory_order_relaxed); }
+
+private:
+    static void record(const char *name, qint64 tsNs, qint64 durNs, const char *detail, int detailLen);
+    static std::atomic<bool> enabledFlag;
+    static std::atomic<const char *> loopScope;
+    static thread_local bool loopThreadFlag;
+};
+
+// 作用域区间：构造时记下开始时间，析构时写入一条区间事件
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : spanName(name), startNs(Tracer::isEnabled() ? Tracer::nowNs() : 0),
+          loopScoped(Tracer::isLoopThread()), previousScope(loopScoped ? Tracer::swapLoopScope(name) : nullptr) {}
+
+    TraceSpan(const char *name, const QString &detail)
+        : spanName(name), startNs(Tracer::isEnabled() ? Tracer::nowNs() : 0),
+          loopScoped(Tracer::isLoopThread()), previousScope(loopScoped ? Tracer::swapLoopScope(name) : nullptr)
+    {
+        if (startNs) {
+            setDetail(detail);
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (loopScoped) {
+            Tracer::swapLoopScope(previousScope);
+        }
+        if (startNs) {
+            Tracer::complete(spanName, startNs, detailText, detailLength);
+        }
+    }
+
+    void setDetail(const QString &detail);
+
+private:
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    const char *spanName;
+    qint64 startNs;
+    bool loopScoped;
+    const char *previousScope;
+    char detailText[Tracer::DetailSize];
+    int detailLength = 0;
+};
+
+#define QMANAGE_TRACE_CONCAT2(a, b) a##b
+#define QMANAGE_TRACE_CONCAT(a, b) QMANAGE_TRACE_CONCAT2(a, b)
+#define QMANAGE_TRACE_SCOPE(...) TraceSpan QMANAGE_TRACE_CONCAT(traceSpan_, __LINE__)(__VA_ARGS__)
+
+#endif // TRACER_H
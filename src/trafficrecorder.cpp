@@ -0,0 +1,162 @@
+#include "trafficrecorder.h"
+
+#include <QFile>
+#include <QDebug>
+#include <mutex>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char kMagic[4] = {'Q', 'M', 'R', 'R'};
+static const quint8 kFormatVersion = 1;
+static const int kHeaderBytes = 16;
+
+std::atomic<bool> TrafficRecorder::enabledFlag(false);
+
+static std::mutex recordMutex;
+static int recordFd = -1;
+static qint64 lastNs = 0;
+
+static qint64 monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<qint64>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static void appendVarint(QByteArray *out, quint64 value)
+{
+    while (value >= 0x80) {
+        out->append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out->append(static_cast<char>(value));
+}
+
+static bool readVarint(const QByteArray &data, int *pos, quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && *pos < data.size(); shift += 7) {
+        const quint8 byte = static_cast<quint8>(data.at((*pos)++));
+        result |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool TrafficRecorder::start(const QString &path)
+{
+    std::lock_guard<std::mutex> lock(recordMutex);
+    if (recordFd >= 0) {
+        return true;
+    }
+    const int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        qDebug() << "流量录制：无法创建" << path << ":" << strerror(errno);
+        return false;
+    }
+
+    lastNs = monotonicNs();
+    QByteArray header(kMagic, sizeof(kMagic));
+    header.append(static_cast<char>(kFormatVersion));
+    header.append(3, '\0');
+    for (int i = 0; i < 8; i++) {
+        header.append(static_cast<char>((static_cast<quint64>(lastNs) >> (8 * i)) & 0xFF));
+    }
+    if (!writeAll(fd, header.constData(), static_cast<size_t>(header.size()))) {
+        qDebug() << "流量录制：写入失败" << path << ":" << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    recordFd = fd;
+    enabledFlag = true;
+    qDebug() << "流量录制：写入" << path;
+    return true;
+}
+
+void TrafficRecorder::record(Kind kind, const QByteArray &payload)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(recordMutex);
+    if (recordFd < 0) {
+        return;
+    }
+    const qint64 now = monotonicNs();
+    QByteArray buffer;
+    buffer.reserve(payload.size() + 16);
+    buffer.append(static_cast<char>(kind));
+    appendVarint(&buffer, static_cast<quint64>(qMax<qint64>(0, now - lastNs)));
+    appendVarint(&buffer, static_cast<quint64>(payload.size()));
+    buffer.append(payload);
+    lastNs = qMax(lastNs, now);
+    if (!writeAll(recordFd, buffer.constData(), static_cast<size_t>(buffer.size()))) {
+        // 磁盘满等情况下停止录制，不影响监控本身
+        qDebug() << "流量录制：写入失败，停止录制:" << strerror(errno);
+        ::close(recordFd);
+        recordFd = -1;
+        enabledFlag = false;
+    }
+}
+
+bool TrafficRecorder::load(const QString &path, QVector<Record> *records, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *error = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    if (data.size() < kHeaderBytes || memcmp(data.constData(), kMagic, sizeof(kMagic)) != 0) {
+        *error = "not a traffic recording";
+        return false;
+    }
+    if (static_cast<quint8>(data.at(4)) != kFormatVersion) {
+        *error = QString("unsupported recording version %1").arg(static_cast<quint8>(data.at(4)));
+        return false;
+    }
+
+    records->clear();
+    qint64 ns = 0;
+    int pos = kHeaderBytes;
+    while (pos < data.size()) {
+        const Kind kind = static_cast<Kind>(static_cast<quint8>(data.at(pos++)));
+        quint64 delta = 0;
+        quint64 length = 0;
+        if (!readVarint(data, &pos, &delta) || !readVarint(data, &pos, &length)
+            || length > static_cast<quint64>(data.size() - pos)) {
+            break;
+        }
+        ns += static_cast<qint64>(delta);
+        Record record;
+        record.kind = kind;
+        record.ns = ns;
+        record.payload = data.mid(pos, static_cast<int>(length));
+        records->append(record);
+        pos += static_cast<int>(length);
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef TRAFFICRECORDER_H
+#define TRAFFICRECORDER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// WebSocket 收发与子进程、定时器事件的录制，供 bench/replaybench 回放
+//
+// 重启与更新交织、顺序更新期间压制 qtServerIsOver 之类的问题依赖时序，很难复现。
+// 设置环境变量 QUARCS_RECORD=<文件> 后，每个收到的帧、发出的帧、子进程启动/退出和定时器
+// 触发的处理函数都按发生顺序追加到一个二进制文件中：
+//
+//   文件头 = "QMRR" + 格式版本(1) + 3 字节保留 + 录制开始时间(8, CLOCK_MONOTONIC 纳秒)
+//   记录   = 类型(1) + 距上一条记录的纳秒数(varint) + 内容长度(varint) + 内容
+//
+// 每条记录一次 write()，进程崩溃时已写出的部分完整可读。未启用时每个埋点只有一次 relaxed 原子读。
+class TrafficRecorder
+{
+public:
+    enum Kind : quint8 {
+        Inbound = 'I',    // 收到的原始帧
+        Outbound = 'O',   // 发出的原始帧
+        Child = 'C',      // 子进程事件：<名称>:<事件>[:参数...]
+        Timer = 'T'       // 定时器触发的处理函数名称
+    };
+
+    struct Record
+    {
+        Kind kind;
+        qint64 ns;        // 相对录制开始
+        QByteArray payload;
+    };
+
+    static bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+    // 创建（覆盖）录制文件并开始录制
+    static bool start(const QString &path);
+    static void record(Kind kind, const QByteArray &payload);
+    static void record(Kind kind, const QString &payload)
+    {
+        if (isEnabled()) {
+            record(kind, payload.toUtf8());
+        }
+    }
+
+    // 读取录制文件；结尾不完整的记录（录制进程被杀）直接忽略
+    static bool load(const QString &path, QVector<Record> *records, QString *error);
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+#endif // TRAFFICRECORDER_H
@@ -0,0 +1,245 @@
+#include "trashcollector.h"
+#include "backgroundpriority.h"
+#include "tracer.h"
+#include "thermalmonitor.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+static const int kBatchEntries = 256;   // 每删除这么多项检查一次暂停/退出并汇总进度
+
+TrashCollector::TrashCollector(const QString &trashDir, QObject *parent) :
+    QObject(parent), trashDir(trashDir)
+{
+    QDir().mkpath(trashDir);
+
+    // 上次运行没删完的内容
+    foreach (const QString &name, QDir(trashDir).entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden)) {
+        queue.push_back(name);
+    }
+    currentStats.pendingTrees = static_cast<int>(queue.size());
+    if (!queue.empty()) {
+        qDebug() << "回收目录：继续回收上次留下的" << queue.size() << "项";
+    }
+
+    worker = std::thread(&TrashCollector::workerLoop, this);
+}
+
+TrashCollector::~TrashCollector()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool TrashCollector::discard(const QString &path)
+{
+    const QFileInfo info(path);
+    if (!info.exists() && !info.isSymLink()) {
+        return true;
+    }
+
+    // 回收目录中的名称：原名（只保留安全字符）+ 时间 + 序号，助手清理时也按这个规则校验
+    QString base = info.fileName();
+    for (int i = 0; i < base.size(); i++) {
+        const QChar c = base.at(i);
+        if (!(c.isLetterOrNumber() && c.unicode() < 128) && c != '_' && c != '-' && c != '.') {
+            base[i] = '_';
+        }
+    }
+    QString name;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        name = QString("%1.%2.%3").arg(base).arg(QDateTime::currentMSecsSinceEpoch()).arg(++discardCount);
+    }
+
+    const QByteArray from = QFile::encodeName(info.absoluteFilePath());
+    const QByteArray to = QFile::encodeName(trashDir + "/" + name);
+    if (::rename(from.constData(), to.constData()) != 0) {
+        qDebug() << "回收目录：无法移入" << path << ":" << strerror(errno);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(name);
+        currentStats.pendingTrees++;
+    }
+    wakeup.notify_all();
+    return true;
+}
+
+void TrashCollector::setPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (currentStats.paused == paused) {
+            return;
+        }
+        currentStats.paused = paused;
+    }
+    wakeup.notify_all();
+}
+
+TrashCollector::Stats TrashCollector::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return currentStats;
+}
+
+void TrashCollector::workerLoop()
+{
+    setCurrentThreadIdlePriority();
+
+    const QByteArray dirPath = QFile::encodeName(trashDir);
+    while (true) {
+        QString name;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeup.wait(lock, [this]() { return stopping || (!queue.empty() && !currentStats.paused); });
+            if (stopping) {
+                return;
+            }
+            name = queue.front();
+            queue.pop_front();
+        }
+
+        qint64 entries = 0;
+        qint64 bytes = 0;
+        int result;
+        {
+            TraceSpan span("trash_reclaim", name);
+            const int dirFd = ::open(dirPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            result = dirFd < 0 ? errno : removeAt(dirFd, QFile::encodeName(name).constData(), &entries, &bytes);
+            if (dirFd >= 0) {
+                ::close(dirFd);
+            }
+        }
+
+        bool stopped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentStats.reclaimedEntries += unpublishedEntries;
+            currentStats.reclaimedBytes += unpublishedBytes;
+            unpublishedEntries = 0;
+            unpublishedBytes = 0;
+            stopped = stopping;
+            if (!stopped) {
+                currentStats.pendingTrees--;
+            }
+        }
+        if (stopped) {
+            return;     // 剩下的内容下次启动时继续回收
+        }
+
+        if (result == 0) {
+            QMetaObject::invokeMethod(this, [this, name, entries, bytes]() {
+                emit treeReclaimed(name, entries, bytes);
+            }, Qt::QueuedConnection);
+        } else {
+            const QString path = trashDir + "/" + name;
+            qDebug() << "回收目录：无法完全删除" << path << ":" << strerror(result);
+            QMetaObject::invokeMethod(this, [this, path]() {
+                emit reclaimBlocked(path);
+            }, Qt::QueuedConnection);
+        }
+    }
+}
+
+// 删除了一批之后汇总进度，在暂停期间等待，并按温控放慢；返回 false 表示需要退出
+bool TrashCollector::throttle()
+{
+    if (++sinceCheck < kBatchEntries) {
+        return true;
+    }
+    sinceCheck = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        currentStats.reclaimedEntries += unpublishedEntries;
+        currentStats.reclaimedBytes += unpublishedBytes;
+        unpublishedEntries = 0;
+        unpublishedBytes = 0;
+        wakeup.wait(lock, [this]() { return stopping || !currentStats.paused; });
+        if (stopping) {
+            return false;
+        }
+    }
+    ThermalMonitor::throttleBackgroundWork([this]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopping;
+    });
+    return true;
+}
+
+// 删除 parentFd 下的 name；目录用 openat(O_NOFOLLOW) 逐级打开。返回 0 或第一个错误码
+int TrashCollector::removeAt(int parentFd, const char *name, qint64 *entries, qint64 *bytes)
+{
+    struct stat st;
+    if (::fstatat(parentFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        return errno == ENOENT ? 0 : errno;
+    }
+
+    int result = 0;
+    if (S_ISDIR(st.st_mode)) {
+        const int fd = ::openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            return errno;
+        }
+        DIR *dir = ::fdopendir(fd);
+        if (!dir) {
+            const int error = errno;
+            ::close(fd);
+            return error;
+        }
+        std::vector<std::string> names;
+        struct dirent *entry;
+        while ((entry = ::readdir(dir)) != nullptr) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                names.push_back(entry->d_name);
+            }
+        }
+        for (const std::string &child : names) {
+            const int error = removeAt(fd, child.c_str(), entries, bytes);
+            if (error == ECANCELED) {
+                ::closedir(dir);
+                return error;
+            }
+            if (error && !result) {
+                result = error;
+            }
+        }
+        ::closedir(dir);
+        if (::unlinkat(parentFd, name, AT_REMOVEDIR) != 0 && errno != ENOENT && !result) {
+            result = errno;
+        }
+    } else if (::unlinkat(parentFd, name, 0) != 0 && errno != ENOENT) {
+        result = errno;
+    }
+
+    if (result == 0) {
+        const qint64 size = static_cast<qint64>(st.st_blocks) * 512;
+        (*entries)++;
+        *bytes += size;
+        unpublishedEntries++;
+        unpublishedBytes += size;
+    }
+    return throttle() ? result : ECANCELED;
+}
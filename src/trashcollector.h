@@ -0,0 +1,71 @@
+#ifndef TRASHCOLLECTOR_H
+#define TRASHCOLLECTOR_H
+
+#include <QObject>
+#include <QString>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// 更新暂存目录的后台回收
+//
+// 旧的 update 树有上万个文件，在 SD 卡上同步 removeRecursively 要几秒，期间事件循环
+// （WebSocket、LED、QT 端监控）全部停顿。discard() 只做一次 rename，把目录移到回收目录
+// （与更新包目录在同一文件系统，耗时与目录大小无关），之后由后台线程（空闲 CPU/IO 优先级）
+// 用 openat/unlinkat 逐项删除，不跟随符号链接。
+//
+// 更新进行中时 setPaused(true)：后台线程删完当前一批后暂停，不与解压、Update.sh 争抢磁盘。
+// 上次运行没删完的内容在启动时继续回收。
+class TrashCollector : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats
+    {
+        int pendingTrees = 0;         // 等待回收的目录数（含正在删除的）
+        qint64 reclaimedEntries = 0;  // 本次运行已删除的文件和目录数
+        qint64 reclaimedBytes = 0;    // 已释放的磁盘空间（按实际占用的块计）
+        bool paused = false;
+    };
+
+    explicit TrashCollector(const QString &trashDir, QObject *parent = nullptr);
+    ~TrashCollector();
+
+    // 把 path 移入回收目录；path 不存在时也返回 true。
+    // 无法 rename（例如跨文件系统）时返回 false，由调用方同步删除
+    bool discard(const QString &path);
+
+    void setPaused(bool paused);
+    Stats stats() const;
+    QString directory() const { return trashDir; }
+
+signals:
+    // 回收目录下的 name 已删除（在主线程发出）
+    void treeReclaimed(const QString &name, qint64 entries, qint64 bytes);
+    // path 中有当前用户删不掉的内容（例如 Update.sh 以 root 留下的文件），不再重试（在主线程发出）
+    void reclaimBlocked(const QString &path);
+
+private:
+    void workerLoop();
+    int removeAt(int parentFd, const char *name, qint64 *entries, qint64 *bytes);
+    bool throttle();
+
+    const QString trashDir;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<QString> queue;
+    Stats currentStats;
+    quint64 discardCount = 0;
+    bool stopping = false;
+
+    // 以下仅工作线程访问：尚未计入 currentStats 的删除量，每删一批汇总一次
+    int sinceCheck = 0;
+    qint64 unpublishedEntries = 0;
+    qint64 unpublishedBytes = 0;
+
+    std::thread worker;
+};
+
+#endif // TRASHCOLLECTOR_H
@@ -0,0 +1,99 @@
+#include "updateplanner.h"
+
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+
+const char *UpdatePlanner::ScriptEntryName = "update/Update.sh";
+
+bool UpdatePlanner::build(const QStringList &packages, const QStringList &versions)
+{
+    packagePaths = packages;
+    packageVersions = versions;
+    finalEntries.clear();
+    scriptEntries.clear();
+    totalSequentialBytes = 0;
+    totalPlannedBytes = 0;
+    lastError.clear();
+
+    if (packages.size() != versions.size() || packages.isEmpty()) {
+        lastError = "package list and version list do not match";
+        return false;
+    }
+
+    // 从旧到新遍历，后出现的包覆盖先出现的，得到每个路径最终的来源
+    for (int i = 0; i < packages.size(); i++) {
+        ZipReader reader(packages[i]);
+        if (!reader.open()) {
+            lastError = reader.errorString();
+            return false;
+        }
+
+        foreach (const ZipEntry &entry, reader.entries()) {
+            totalSequentialBytes += entry.uncompressedSize;
+
+            Source source;
+            source.packageIndex = i;
+            source.entry = entry;
+
+            if (entry.name == ScriptEntryName) {
+                scriptEntries.append(source);
+            } else {
+                finalEntries.insert(entry.name, source);
+            }
+        }
+    }
+
+    for (auto it = finalEntries.constBegin(); it != finalEntries.constEnd(); ++it) {
+        totalPlannedBytes += it.value().entry.uncompressedSize;
+    }
+    foreach (const Source &script, scriptEntries) {
+        totalPlannedBytes += script.entry.uncompressedSize;
+    }
+
+    return true;
+}
+
+bool UpdatePlanner::extract(const QString &destDir, const QString &scriptRoot)
+{
+    // 按包分组，每个包只打开一次，并按本地头偏移顺序读取，保证顺序 I/O
+    QVector<QVector<Source>> byPackage(packagePaths.size());
+    for (auto it = finalEntries.constBegin(); it != finalEntries.constEnd(); ++it) {
+        byPackage[it.value().packageIndex].append(it.value());
+    }
+    foreach (const Source &script, scriptEntries) {
+        byPackage[script.packageIndex].append(script);
+    }
+
+    QDir dest(destDir);
+    for (int i = 0; i < byPackage.size(); i++) {
+        QVector<Source> &sources = byPackage[i];
+        if (sources.isEmpty()) {
+            continue;
+        }
+        std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) {
+            return a.entry.localHeaderOffset < b.entry.localHeaderOffset;
+        });
+
+        ZipReader reader(packagePaths[i]);
+        if (!reader.open()) {
+            lastError = reader.errorString();
+            return false;
+        }
+
+        foreach (const Source &source, sources) {
+            QString destPath;
+            if (source.entry.name == ScriptEntryName) {
+                destPath = QDir(scriptRoot).filePath(packageVersions[i] + "/Update.sh");
+            } else {
+                destPath = dest.filePath(source.entry.name);
+            }
+            if (!reader.extractEntry(source.entry, destPath)) {
+                lastError = reader.errorString();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef UPDATEPLANNER_H
+#define UPDATEPLANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QVector>
+
+#include "zipreader.h"
+
+// 顺序更新合并（squash）规划器
+//
+// 从旧到新依次读取所有待更新包的中央目录，计算每个路径最终由哪个包写入，
+// 然后只从「最新包含该路径的包」中解压一次，得到最终的暂存树。
+// 每个版本自己的 Update.sh 不参与合并，而是分别保存到
+// <scriptRoot>/<版本号>/Update.sh，顺序执行时再逐个放回更新树中运行。
+class UpdatePlanner
+{
+public:
+    // 每个版本单独保留、不参与合并的脚本条目
+    static const char *ScriptEntryName;
+
+    struct Source
+    {
+        int packageIndex = -1;
+        ZipEntry entry;
+    };
+
+    // packages 与 versions 一一对应，按版本升序排列
+    bool build(const QStringList &packages, const QStringList &versions);
+
+    // 把合并后的最终树解压到 destDir，各版本脚本保存到 scriptRoot
+    bool extract(const QString &destDir, const QString &scriptRoot);
+
+    QString errorString() const { return lastError; }
+
+    // 所有包中全部条目解压后的总字节数（即逐个顺序解压要写入的量）
+    quint64 sequentialBytes() const { return totalSequentialBytes; }
+    // 合并后实际需要写入的字节数
+    quint64 plannedBytes() const { return totalPlannedBytes; }
+    int plannedEntryCount() const { return finalEntries.size(); }
+
+private:
+    QStringList packagePaths;
+    QStringList packageVersions;
+    QMap<QString, Source> finalEntries;      // 路径 -> 最终写入它的包
+    QVector<Source> scriptEntries;           // 各版本的 Update.sh
+    quint64 totalSequentialBytes = 0;
+    quint64 totalPlannedBytes = 0;
+    QString lastError;
+};
+
+#endif // UPDATEPLANNER_H
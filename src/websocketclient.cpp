@@ -1,6 +1,14 @@
 #include "websocketclient.h"
+#include "startuptrace.h"
+#include "tracer.h"
+#include "trafficrecorder.h"
+#include <QDateTime>
 #include <QDebug>
 
+static const QLatin1String kMsgIdTag("qmanage.");
+static const int kMaxInFlight = 256;
+static const int kMaxBackoffShift = 4;     // 重发间隔最多翻到 16 倍
+
 WebSocketClient::WebSocketClient(const QUrl &url, QObject *parent) :
     QObject(parent), url(url)
 {
@@ -14,11 +22,41 @@ WebSocketClient::WebSocketClient(const QUrl &url, QObject *parent) :
 
     // 连接网络状态变化信号槽
     connect(&networkManager, &QNetworkConfigurationManager::onlineStateChanged, this, &WebSocketClient::onNetworkStateChanged);
+
+    msgIdPrefix = QString(kMsgIdTag) + QString::number(QDateTime::currentMSecsSinceEpoch(), 36) + ".";
+    connect(&ackTimer, &QTimer::timeout, this, &WebSocketClient::checkInFlight);
+}
+
+void WebSocketClient::setReliableDelivery(bool enabled, int ackTimeoutMs, int maxRetransmits)
+{
+    reliableDelivery = enabled;
+    this->ackTimeoutMs = ackTimeoutMs;
+    this->maxRetransmits = maxRetransmits;
+    ackTimer.setInterval(qMax(50, ackTimeoutMs / 4));
+    if (!enabled) {
+        inFlight.clear();
+        ackTimer.stop();
+    }
+}
+
+WebSocketClient::DeliveryStats WebSocketClient::deliveryStats() const
+{
+    DeliveryStats stats = delivery;
+    stats.inFlight = inFlight.size();
+    stats.peerAcknowledges = peerAcknowledges;
+    stats.rttSamples = rtt.count();
+    stats.rttP50Us = rtt.percentile(50);
+    stats.rttP90Us = rtt.percentile(90);
+    stats.rttP99Us = rtt.percentile(99);
+    stats.rttMaxUs = rtt.max();
+    return stats;
 }
 
 void WebSocketClient::onConnected()
 {
     qInfo() << "WebSocket connected";
+    Tracer::instant("ws_connected");
+    StartupTrace::mark(StartupTrace::WebSocketConnect);
     connect(&webSocket, &QWebSocket::textMessageReceived,
             this, &WebSocketClient::onTextMessageReceived);
 
@@ -27,11 +65,20 @@ void WebSocketClient::onConnected()
 
     // 连接建立时停止自动重连定时器
     reconnectTimer.stop();
+
+    // 断线期间没能发出的关键消息
+    for (auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+        if (it->transmissions == 0) {
+            transmit(it.key(), it.value());
+        }
+    }
+    emit connected();
 }
 
 void WebSocketClient::onDisconnected()
 {
     qWarning() << "WebSocket disconnected";
+    Tracer::instant("ws_disconnected");
 
     // 断开接收消息的信号与槽
     disconnect(&webSocket, &QWebSocket::textMessageReceived,
@@ -52,6 +99,7 @@ void WebSocketClient::onDisconnected()
 void WebSocketClient::reconnect()
 {
     qInfo() << "Reconnecting to WebSocket server...";
+    Tracer::instant("ws_reconnect");
     webSocket.close(); // 关闭当前连接
     webSocket.open(url);
 }
@@ -72,20 +120,56 @@ void WebSocketClient::onNetworkStateChanged(bool isOnline)
     }
 }
 
+WebSocketClient::IncomingKind WebSocketClient::classifyMessage(const QString &text, QString *message, QString *msgid)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(text.toUtf8());
+    QJsonObject messageObj = doc.object();
+    const QString type = messageObj["type"].toString();
+    if (type == QLatin1String("QT_Confirm")) {
+        // QT 端与前端之间的确认也会广播过来，只认本进程格式的 msgid
+        const QString id = messageObj["msgid"].toString();
+        if (!id.startsWith(kMsgIdTag)) {
+            return IncomingIgnored;
+        }
+        *message = id;
+        return IncomingAcknowledgment;
+    }else if (type == QLatin1String("Vue_Command")
+        || type == QLatin1String("QT_Return") || type == QLatin1String("Server_msg"))
+    {
+        return IncomingIgnored;
+    }else if (type == QLatin1String("Process_Command_Return")){
+        *message = messageObj["message"].toString();
+        if (msgid) {
+            *msgid = messageObj["msgid"].toString();
+        }
+        return IncomingProcessCommandReturn;
+    }
+    return IncomingOther;
+}
+
 void WebSocketClient::onTextMessageReceived(QString message)
 {
     // qDebug() << "Message received:" << message;
-    QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
-    QJsonObject messageObj = doc.object();
-    if (messageObj["type"].toString() == "Vue_Command" || messageObj["type"].toString() == "QT_Confirm" || messageObj["type"].toString() == "QT_Return" || messageObj["type"].toString() == "Server_msg")
+    QMANAGE_TRACE_SCOPE("ws_receive");
+    TrafficRecorder::record(TrafficRecorder::Inbound, message);
+    QString command;
+    QString msgid;
+    IncomingKind kind = classifyMessage(message, &command, &msgid);
+    if (kind == IncomingIgnored)
     {
         return;
-    }else if (messageObj["type"].toString() == "Process_Command_Return"){
-        emit messageReceived(messageObj["message"].toString());
+    }else if (kind == IncomingAcknowledgment){
+        acknowledged(command);
+        return;
+    }else if (kind == IncomingProcessCommandReturn){
+        if (!msgid.isEmpty()) {
+            sendAcknowledgment(msgid);
+        }
+        emit messageReceived(command);
     }
     else
     {
-        // qDebug() << "Message received is undefined type:" << messageObj["type"].toString() << " " << messageObj["message"].toString();
+        // qDebug() << "Message received is undefined type:" << message;
     }
 
     emit closed();
@@ -101,19 +185,142 @@ void WebSocketClient::sendAcknowledgment(QString messageID)
     messageObj["msgid"] = utf8Message;
 
     // 然后使用WebSocket发送消息
-    webSocket.sendTextMessage(QJsonDocument(messageObj).toJson());
+    sendFrame(QString::fromUtf8(QJsonDocument(messageObj).toJson()));
 }
 
-void WebSocketClient::messageSend(QString message)
+void WebSocketClient::sendFrame(const QString &frame)
 {
-    QString utf8Message = message.toUtf8(); // 将QString转换为UTF-8编码的QString
+    TrafficRecorder::record(TrafficRecorder::Outbound, frame);
+    webSocket.sendTextMessage(frame);
+}
 
+QByteArray WebSocketClient::buildProcessCommand(const QString &message, const QString &msgid)
+{
     QJsonObject messageObj;
 
-    messageObj["message"] = utf8Message;
+    messageObj["message"] = message;
     messageObj["type"] = "Process_Command";
+    if (!msgid.isEmpty()) {
+        messageObj["msgid"] = msgid;
+    }
 
+    return QJsonDocument(messageObj).toJson();
+}
 
-    // 然后使用WebSocket发送消息
-    webSocket.sendTextMessage(QJsonDocument(messageObj).toJson());
+void WebSocketClient::messageSend(QString message, bool critical)
+{
+    QMANAGE_TRACE_SCOPE("ws_send", message);
+    if (!reliableDelivery) {
+        // 然后使用WebSocket发送消息
+        sendFrame(QString::fromUtf8(buildProcessCommand(message)));
+        return;
+    }
+
+    if (!isConnected() && !(critical && peerAcknowledges)) {
+        return;     // 与原来一样直接丢弃；只有对端确认过时，关键消息才留到重连后补发
+    }
+    const quint64 id = ++nextMsgId;
+    if (!critical && !peerAcknowledges) {
+        // 对端确认过之前，非关键消息只带上 msgid 发出、不进在途表，从不确认的对端不会让在途表和定时器空转
+        delivery.sent++;
+        sendFrame(QString::fromUtf8(buildProcessCommand(message, msgIdPrefix + QString::number(id))));
+        return;
+    }
+
+    // 在途表满时挤掉最早的非关键消息；全是关键消息时挤掉最早的一条
+    if (inFlight.size() >= kMaxInFlight) {
+        auto victim = inFlight.begin();
+        for (auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+            if (!it->critical) {
+                victim = it;
+                break;
+            }
+        }
+        if (peerAcknowledges) {
+            delivery.unacked++;
+        }
+        inFlight.erase(victim);
+    }
+
+    InFlight &entry = inFlight[id];
+    entry.message = message;
+    entry.critical = critical;
+    if (isConnected()) {
+        transmit(id, entry);
+    }
+    if (!ackTimer.isActive()) {
+        ackTimer.start();
+    }
+}
+
+void WebSocketClient::transmit(quint64 id, InFlight &entry)
+{
+    const qint64 now = Tracer::nowNs();
+    if (entry.transmissions == 0) {
+        entry.firstSentNs = now;
+        delivery.sent++;
+    }
+    entry.lastSentNs = now;
+    entry.transmissions++;
+    sendFrame(QString::fromUtf8(buildProcessCommand(entry.message, msgIdPrefix + QString::number(id))));
+}
+
+void WebSocketClient::acknowledged(const QString &msgid)
+{
+    if (!msgid.startsWith(msgIdPrefix)) {
+        return;     // 上一次运行发出的消息
+    }
+    bool ok = false;
+    const quint64 id = msgid.mid(msgIdPrefix.size()).toULongLong(&ok);
+    peerAcknowledges = true;
+    auto it = ok ? inFlight.find(id) : inFlight.end();
+    if (it == inFlight.end()) {
+        return;     // 重复确认，或已被挤出在途表
+    }
+    delivery.acked++;
+    if (it->transmissions == 1) {
+        rtt.record((Tracer::nowNs() - it->firstSentNs) / 1000);
+    }
+    inFlight.erase(it);
+    if (inFlight.isEmpty()) {
+        ackTimer.stop();
+    }
+}
+
+// 超时处理：对端支持确认时重发关键消息（间隔逐次翻倍），其余到期后移除
+void WebSocketClient::checkInFlight()
+{
+    const qint64 now = Tracer::nowNs();
+    const qint64 timeoutNs = static_cast<qint64>(ackTimeoutMs) * 1000000LL;
+    for (auto it = inFlight.begin(); it != inFlight.end();) {
+        InFlight &entry = it.value();
+        if (entry.transmissions == 0) {
+            ++it;   // 等待重连
+            continue;
+        }
+        const int shift = qMin(entry.transmissions - 1, kMaxBackoffShift);
+        if (now - entry.lastSentNs < (timeoutNs << shift)) {
+            ++it;
+            continue;
+        }
+        if (entry.critical && peerAcknowledges && entry.transmissions <= maxRetransmits) {
+            if (isConnected()) {
+                Tracer::instant("ws_retransmit", entry.message);
+                delivery.retransmits++;
+                transmit(it.key(), entry);
+            }
+            ++it;
+            continue;
+        }
+        if (peerAcknowledges) {
+            delivery.unacked++;
+            if (entry.critical) {
+                qWarning() << "消息未被确认，放弃重发:" << entry.message;
+            }
+        }
+        it = inFlight.erase(it);
+    }
+    if (inFlight.isEmpty()) {
+        ackTimer.stop();
+    }
 }
@@ -6,20 +6,60 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QTimer>
+#include <QMap>
 #include <QNetworkConfigurationManager>
 
+#include "latencyhistogram.h"
+
 class WebSocketClient : public QObject
 {
     Q_OBJECT
 public:
     explicit WebSocketClient(const QUrl &url, QObject *parent = nullptr);
-    void messageSend(QString message);
+    // critical 为 true 的消息（更新结果等）在对端确认过消息的前提下超时重发
+    void messageSend(QString message, bool critical = false);
     void sendAcknowledgment(QString  messageObj);
     void reconnect();
     void onNetworkStateChanged(bool isOnline);
+    bool isConnected() const { return webSocket.state() == QAbstractSocket::ConnectedState; }
+
+    // 可靠投递：每条 Process_Command 带递增的 msgid，对端回 QT_Confirm 后从在途表中移除并记录往返时间。
+    // 只有对端确认过至少一条消息后才会重发（重发沿用原 msgid，对端可据此去重）、断线期间缓存关键消息，
+    // 非关键消息也才进在途表；从不确认的旧版前端收到的帧只是多了一个 msgid 字段，行为不变。
+    void setReliableDelivery(bool enabled, int ackTimeoutMs, int maxRetransmits);
+
+    struct DeliveryStats
+    {
+        qint64 sent = 0;              // 带 msgid 发出的消息
+        qint64 acked = 0;
+        qint64 retransmits = 0;
+        qint64 unacked = 0;           // 对端支持确认、但重发用尽或被挤出在途表仍未确认的消息
+        int inFlight = 0;
+        bool peerAcknowledges = false;
+        qint64 rttSamples = 0;        // 只统计未重发过的消息（重发后的确认无法判断对应哪一次发送）
+        qint64 rttP50Us = 0;
+        qint64 rttP90Us = 0;
+        qint64 rttP99Us = 0;
+        qint64 rttMaxUs = 0;
+    };
+    DeliveryStats deliveryStats() const;
+
+    // 收到的一帧文本消息的分类
+    enum IncomingKind {
+        IncomingIgnored,               // Vue_Command / QT_Confirm / QT_Return / Server_msg，直接丢弃
+        IncomingProcessCommandReturn,  // 发给本进程的命令，message 中是命令内容
+        IncomingAcknowledgment,        // 对本进程所发消息的 QT_Confirm，message 中是 msgid
+        IncomingOther                  // 未定义的类型
+    };
+    // msgid 不为空时取出 Process_Command_Return 携带的 msgid（没有时为空）
+    static IncomingKind classifyMessage(const QString &text, QString *message, QString *msgid = nullptr);
+
+    // 构造发往服务器的 Process_Command 帧；msgid 为空时不带 msgid 字段
+    static QByteArray buildProcessCommand(const QString &message, const QString &msgid = QString());
 
 signals:
     void closed();
+    void connected();           // 每次连上服务器（包括重连）后，补发完断线期间的消息之后发出
     void messageReceived(const QString &message);
 
 private slots:
@@ -28,6 +68,20 @@ private slots:
     void onTextMessageReceived(QString message);
 
 private:
+    struct InFlight
+    {
+        QString message;
+        qint64 firstSentNs = 0;
+        qint64 lastSentNs = 0;
+        int transmissions = 0;        // 0 表示发送时未连接，连接后补发
+        bool critical = false;
+    };
+
+    void sendFrame(const QString &frame);
+    void transmit(quint64 id, InFlight &entry);
+    void acknowledged(const QString &msgid);
+    void checkInFlight();
+
     QWebSocket webSocket;
     QUrl url;
 
@@ -36,6 +90,17 @@ private:
     bool isNetworkConnected = true; // 记录网络连接状态
 
     bool isReconnecting = false; // 添加一个标志来表示是否正在重连
+
+    bool reliableDelivery = true;
+    int ackTimeoutMs = 2000;
+    int maxRetransmits = 5;
+    bool peerAcknowledges = false;        // 对端确认过本进程的消息
+    QString msgIdPrefix;                  // 每次启动不同，避免对端把重启后的 msgid 当成重复
+    quint64 nextMsgId = 0;
+    QMap<quint64, InFlight> inFlight;     // 按 msgid 升序
+    QTimer ackTimer;
+    DeliveryStats delivery;
+    LatencyHistogram rtt;
 };
 
 #endif // WEBSOCKETCLIENT_H
@@ -0,0 +1,295 @@
+#include "zipreader.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <zlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const quint32 kLocalHeaderSignature = 0x04034b50;
+static const quint32 kCentralHeaderSignature = 0x02014b50;
+static const quint32 kEndOfCentralDirSignature = 0x06054b50;
+static const int kChunkSize = 64 * 1024;
+
+static quint16 readLE16(const uchar *p)
+{
+    return static_cast<quint16>(p[0] | (p[1] << 8));
+}
+
+static quint32 readLE32(const uchar *p)
+{
+    return static_cast<quint32>(p[0]) | (static_cast<quint32>(p[1]) << 8)
+         | (static_cast<quint32>(p[2]) << 16) | (static_cast<quint32>(p[3]) << 24);
+}
+
+// 拒绝绝对路径和 ".."，防止条目写到目标目录之外
+static bool isSafeEntryName(const QString &name)
+{
+    if (name.isEmpty() || name.startsWith('/')) {
+        return false;
+    }
+    foreach (const QString &part, name.split('/')) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+ZipReader::ZipReader(const QString &archivePath) :
+    path(archivePath), file(archivePath), device(&file)
+{
+}
+
+ZipReader::ZipReader(QIODevice *device, const QString &name) :
+    path(name), device(device)
+{
+}
+
+bool ZipReader::open()
+{
+    entryList.clear();
+    if (!device->isOpen() && !device->open(QIODevice::ReadOnly)) {
+        lastError = "cannot open " + path + ": " + device->errorString();
+        return false;
+    }
+    return readCentralDirectory();
+}
+
+void ZipReader::close()
+{
+    device->close();
+}
+
+bool ZipReader::readCentralDirectory()
+{
+    // 中央目录结束记录位于文件末尾，后面最多跟 65535 字节的注释
+    const qint64 fileSize = device->size();
+    const qint64 tailSize = qMin<qint64>(fileSize, 22 + 65535);
+    if (tailSize < 22 || !device->seek(fileSize - tailSize)) {
+        lastError = "archive too small: " + path;
+        return false;
+    }
+    const QByteArray tail = device->read(tailSize);
+    const uchar *tailData = reinterpret_cast<const uchar *>(tail.constData());
+
+    int eocd = -1;
+    for (int i = tail.size() - 22; i >= 0; i--) {
+        if (readLE32(tailData + i) == kEndOfCentralDirSignature) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        lastError = "end of central directory not found: " + path;
+        return false;
+    }
+
+    const quint16 entryCount = readLE16(tailData + eocd + 10);
+    const quint32 cdSize = readLE32(tailData + eocd + 12);
+    const quint32 cdOffset = readLE32(tailData + eocd + 16);
+    if (cdOffset == 0xFFFFFFFF || entryCount == 0xFFFF) {
+        lastError = "zip64 archives are not supported: " + path;
+        return false;
+    }
+    if (static_cast<qint64>(cdOffset) + cdSize > fileSize || !device->seek(cdOffset)) {
+        lastError = "corrupt central directory: " + path;
+        return false;
+    }
+
+    const QByteArray cd = device->read(cdSize);
+    if (cd.size() != static_cast<int>(cdSize)) {
+        lastError = "short read of central directory: " + path;
+        return false;
+    }
+
+    const uchar *p = reinterpret_cast<const uchar *>(cd.constData());
+    const uchar *end = p + cd.size();
+    entryList.reserve(entryCount);
+    for (int i = 0; i < entryCount; i++) {
+        if (end - p < 46 || readLE32(p) != kCentralHeaderSignature) {
+            lastError = "corrupt central directory entry: " + path;
+            return false;
+        }
+
+        const quint16 nameLen = readLE16(p + 28);
+        const quint16 extraLen = readLE16(p + 30);
+        const quint16 commentLen = readLE16(p + 32);
+        if (end - p < 46 + nameLen + extraLen + commentLen) {
+            lastError = "truncated central directory entry: " + path;
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.method = readLE16(p + 10);
+        entry.crc32 = readLE32(p + 16);
+        entry.compressedSize = readLE32(p + 20);
+        entry.uncompressedSize = readLE32(p + 24);
+        entry.unixMode = readLE32(p + 38) >> 16;
+        entry.localHeaderOffset = readLE32(p + 42);
+        entry.name = QString::fromUtf8(reinterpret_cast<const char *>(p + 46), nameLen);
+        entryList.append(entry);
+
+        p += 46 + nameLen + extraLen + commentLen;
+    }
+
+    return true;
+}
+
+qint64 ZipReader::entryDataOffset(const ZipEntry &entry)
+{
+    uchar header[30];
+    if (!device->seek(static_cast<qint64>(entry.localHeaderOffset))
+        || device->read(reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header)
+        || readLE32(header) != kLocalHeaderSignature) {
+        return -1;
+    }
+    // 本地文件头中的扩展字段长度可能与中央目录不同，必须以本地头为准
+    return static_cast<qint64>(entry.localHeaderOffset) + 30
+         + readLE16(header + 26) + readLE16(header + 28);
+}
+
+bool ZipReader::extractEntry(const ZipEntry &entry, const QString &destPath)
+{
+    if (!isSafeEntryName(entry.name)) {
+        lastError = "unsafe entry name: " + entry.name;
+        return false;
+    }
+
+    if (entry.isDir()) {
+        return QDir().mkpath(destPath);
+    }
+
+    if (entry.method != 0 && entry.method != 8) {
+        lastError = QString("unsupported compression method %1: %2").arg(entry.method).arg(entry.name);
+        return false;
+    }
+
+    const qint64 dataOffset = entryDataOffset(entry);
+    if (dataOffset < 0 || !device->seek(dataOffset)) {
+        lastError = "bad local header: " + entry.name;
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(destPath).absolutePath());
+
+    // 符号链接：条目内容即链接目标
+    if (entry.isSymLink()) {
+        const QByteArray target = device->read(static_cast<qint64>(entry.compressedSize));
+        QByteArray linkTarget = target;
+        if (entry.method == 8) {
+            linkTarget.resize(static_cast<int>(entry.uncompressedSize));
+            z_stream zs = z_stream();
+            inflateInit2(&zs, -MAX_WBITS);
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(target.constData()));
+            zs.avail_in = static_cast<uInt>(target.size());
+            zs.next_out = reinterpret_cast<Bytef *>(linkTarget.data());
+            zs.avail_out = static_cast<uInt>(linkTarget.size());
+            inflate(&zs, Z_FINISH);
+            inflateEnd(&zs);
+        }
+        QFile::remove(destPath);
+        if (::symlink(linkTarget.constData(), QFile::encodeName(destPath).constData()) != 0) {
+            lastError = "cannot create symlink: " + destPath;
+            return false;
+        }
+        return true;
+    }
+
+    QFile out(destPath);
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        lastError = "cannot write " + destPath + ": " + out.errorString();
+        return false;
+    }
+
+    QByteArray inBuf(kChunkSize, Qt::Uninitialized);
+    QByteArray outBuf(kChunkSize, Qt::Uninitialized);
+    quint64 remaining = entry.compressedSize;
+    quint64 written = 0;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    bool ok = true;
+
+    z_stream zs = z_stream();
+    if (entry.method == 8 && inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        lastError = "inflateInit failed";
+        return false;
+    }
+
+    int zret = Z_OK;
+    while (ok && remaining > 0) {
+        const qint64 want = static_cast<qint64>(qMin<quint64>(remaining, kChunkSize));
+        const qint64 got = device->read(inBuf.data(), want);
+        if (got <= 0) {
+            lastError = "unexpected end of archive: " + entry.name;
+            ok = false;
+            break;
+        }
+        remaining -= static_cast<quint64>(got);
+
+        if (entry.method == 0) {
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(inBuf.constData()), static_cast<uInt>(got));
+            ok = out.write(inBuf.constData(), got) == got;
+            written += static_cast<quint64>(got);
+            continue;
+        }
+
+        zs.next_in = reinterpret_cast<Bytef *>(inBuf.data());
+        zs.avail_in = static_cast<uInt>(got);
+        do {
+            zs.next_out = reinterpret_cast<Bytef *>(outBuf.data());
+            zs.avail_out = kChunkSize;
+            zret = inflate(&zs, Z_NO_FLUSH);
+            if (zret == Z_BUF_ERROR) {
+                // 输出缓冲区恰好在上一轮写满，本块输入已经全部消费
+                zret = Z_OK;
+                break;
+            }
+            if (zret != Z_OK && zret != Z_STREAM_END) {
+                lastError = "inflate failed: " + entry.name;
+                ok = false;
+                break;
+            }
+            const int produced = kChunkSize - static_cast<int>(zs.avail_out);
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(outBuf.constData()), static_cast<uInt>(produced));
+            if (out.write(outBuf.constData(), produced) != produced) {
+                ok = false;
+                break;
+            }
+            written += static_cast<quint64>(produced);
+        } while (zs.avail_out == 0 && zret != Z_STREAM_END);
+    }
+
+    if (entry.method == 8) {
+        inflateEnd(&zs);
+    }
+    out.close();
+
+    if (ok && (written != entry.uncompressedSize || crc != entry.crc32)) {
+        lastError = "CRC mismatch: " + entry.name;
+        ok = false;
+    }
+    if (!ok) {
+        if (lastError.isEmpty()) {
+            lastError = "write failed: " + destPath;
+        }
+        QFile::remove(destPath);
+        return false;
+    }
+
+    if (entry.unixMode & 0777) {
+        ::chmod(QFile::encodeName(destPath).constData(), entry.unixMode & 07777);
+    }
+    return true;
+}
+
+bool ZipReader::extractAll(const QString &destDir)
+{
+    QDir dir(destDir);
+    foreach (const ZipEntry &entry, entryList) {
+        if (!extractEntry(entry, dir.filePath(entry.name))) {
+            return false;
+        }
+    }
+    return true;
+}
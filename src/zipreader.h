@@ -0,0 +1,58 @@
+#ifndef ZIPREADER_H
+#define ZIPREADER_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+
+// zip 中央目录中的一条记录
+struct ZipEntry
+{
+    QString name;                 // 压缩包内路径，例如 update/Update.sh
+    quint16 method = 0;           // 0 = stored，8 = deflate
+    quint32 crc32 = 0;
+    quint64 compressedSize = 0;
+    quint64 uncompressedSize = 0;
+    quint64 localHeaderOffset = 0;
+    quint32 unixMode = 0;         // 外部属性中的 Unix 权限位（高 16 位），可能为 0
+
+    bool isDir() const { return name.endsWith('/'); }
+    bool isSymLink() const { return (unixMode & 0170000) == 0120000; }
+};
+
+// 轻量 zip 读取器：只读取中央目录，并按需把单个条目解压到指定路径。
+// 不支持 zip64 与加密条目（更新包均小于 4GB 且不加密）。
+class ZipReader
+{
+public:
+    explicit ZipReader(const QString &archivePath);
+    // 从任意可随机访问的设备读取（例如去重存储中重建出的压缩包），不接管 device 的所有权；
+    // name 只用于错误信息
+    ZipReader(QIODevice *device, const QString &name);
+
+    // 打开压缩包并解析中央目录
+    bool open();
+    void close();
+
+    const QVector<ZipEntry> &entries() const { return entryList; }
+    QString archivePath() const { return path; }
+    QString errorString() const { return lastError; }
+
+    // 解压单个条目到 destPath（父目录自动创建），解压过程中校验 CRC32
+    bool extractEntry(const ZipEntry &entry, const QString &destPath);
+
+    // 把所有条目按原有相对路径解压到 destDir 下
+    bool extractAll(const QString &destDir);
+
+private:
+    bool readCentralDirectory();
+    qint64 entryDataOffset(const ZipEntry &entry);
+
+    QString path;
+    QFile file;
+    QIODevice *device;        // 指向 file 或外部设备
+    QVector<ZipEntry> entryList;
+    QString lastError;
+};
+
+#endif // ZIPREADER_H